@@ -0,0 +1,270 @@
+#ifndef MPP_HOST_H
+#define MPP_HOST_H
+
+/*
+ * Host-side stand-in for librockchip_mpp.
+ *
+ * Implements the subset of the MPP API used by this repository so the
+ * decode pipeline can be built, run and profiled on a machine without
+ * /dev/mpp_service. The "decoder" produces one synthetic NV12 frame per
+ * non-empty input packet after a configurable latency, starts every stream
+ * with an info-change frame and flags EOS like the real library. The
+ * "encoder" takes NV12 frames on the task interface, reads them in place
+ * and returns one Annex-B packet per frame sized by the rate control mode.
+ * MJPEG input tasks may carry the output frame, as on VDPU720: it comes
+ * back sized from the SOF after a time set by the pixel rate.
+ *
+ * Tuning is read from the environment at mpp_init:
+ *   mpp_host_width / mpp_host_height   coded size            (1920x1080)
+ *   mpp_host_stride_align              hor/ver stride align  (16)
+ *   mpp_host_dec_latency_us            per-frame decode time (2000)
+ *   mpp_host_info_change_interval      frames between size changes, 0 = never
+ *   mpp_host_input_tasks               input port task count (8)
+ *   mpp_host_frame_buffers             internal frame buffer limit (12)
+ *   mpp_host_reorder                   frames held back before output, unless
+ *                                      MPP_DEC_SET_IMMEDIATE_OUT is set (0)
+ *   mpp_host_fill                      write the test pattern, 0 = skip (1)
+ *   mpp_host_hw_cores                  decode cores shared by all contexts,
+ *                                      0 = unlimited (2)
+ *   mpp_host_enc_latency_us            per-frame encode time (4000)
+ *   mpp_host_enc_cores                 encode cores shared by all contexts,
+ *                                      0 = unlimited (2)
+ *   mpp_host_jpeg_mpix                 JPEG decode rate, MPix/s (500)
+ *   mpp_host_jpeg_cores                JPEG decode cores, 0 = unlimited (1)
+ *   mpp_host_bit_depth                 10 = compact 10-bit decoder frames (8)
+ *   mpp_log_level                      MPP_LOG_* threshold   (4, info)
+ */
+
+#include <pthread.h>
+#include "rockchip/rk_mpi.h"
+#include "rockchip/mpp_log.h"
+
+#define MPP_HOST_META_MAX       16
+#define MPP_HOST_REORDER_MAX    16
+
+#define MPP_HOST_ALIGN(x, a)    (((x) + (a) - 1) & ~((a) - 1))
+
+typedef struct {
+    RK_U32 width;
+    RK_U32 height;
+    RK_U32 stride_align;
+    RK_U32 dec_latency_us;
+    RK_U32 info_change_interval;
+    RK_U32 input_tasks;
+    RK_U32 frame_buffers;
+    RK_U32 reorder;
+    RK_U32 fill;
+    RK_U32 hw_cores;
+    RK_U32 enc_latency_us;
+    RK_U32 enc_cores;
+    RK_U32 jpeg_mpix;
+    RK_U32 jpeg_cores;
+    RK_U32 bit_depth;
+} MppHostConfig;
+
+// Encoder settings by rk_venc_cfg.h name, see enc_cfg_names in mpp_host_enc.c
+typedef enum {
+    ENC_CFG_PREP_WIDTH,
+    ENC_CFG_PREP_HEIGHT,
+    ENC_CFG_PREP_HOR_STRIDE,
+    ENC_CFG_PREP_VER_STRIDE,
+    ENC_CFG_PREP_FORMAT,
+    ENC_CFG_RC_MODE,
+    ENC_CFG_RC_BPS_TARGET,
+    ENC_CFG_RC_BPS_MAX,
+    ENC_CFG_RC_BPS_MIN,
+    ENC_CFG_RC_FPS_IN_FLEX,
+    ENC_CFG_RC_FPS_IN_NUM,
+    ENC_CFG_RC_FPS_IN_DENOM,
+    ENC_CFG_RC_FPS_OUT_FLEX,
+    ENC_CFG_RC_FPS_OUT_NUM,
+    ENC_CFG_RC_FPS_OUT_DENOM,
+    ENC_CFG_RC_GOP,
+    ENC_CFG_RC_QP_INIT,
+    ENC_CFG_RC_QP_MIN,
+    ENC_CFG_RC_QP_MAX,
+    ENC_CFG_RC_QP_MIN_I,
+    ENC_CFG_RC_QP_MAX_I,
+    ENC_CFG_CODEC_TYPE,
+    ENC_CFG_H264_PROFILE,
+    ENC_CFG_H264_LEVEL,
+    ENC_CFG_H264_CABAC_EN,
+    ENC_CFG_NUM,
+} MppHostEncCfgKey;
+
+// MppEncCfg: values, and which of them the user set since the last get
+typedef struct {
+    RK_S64          val[ENC_CFG_NUM];
+    RK_U8           set[ENC_CFG_NUM];
+} MppHostEncCfg;
+
+typedef enum {
+    META_TYPE_S32,
+    META_TYPE_S64,
+    META_TYPE_PTR,
+} MppHostMetaType;
+
+typedef struct {
+    MppMetaKey      key;
+    MppHostMetaType type;
+    union {
+        RK_S32      s32;
+        RK_S64      s64;
+        void        *ptr;
+    } val;
+} MppHostMetaNode;
+
+// Values are consumed by the get calls, as in the real library
+typedef struct {
+    RK_S32          count;
+    MppHostMetaNode node[MPP_HOST_META_MAX];
+} MppHostMeta;
+
+typedef struct MppHostGroup_t MppHostGroup;
+
+typedef struct MppHostBuffer_t {
+    MppHostGroup            *group;
+    struct MppHostBuffer_t  *next;
+    void                    *ptr;
+    size_t                  size;
+    int                     fd;
+    int                     index;
+    RK_S32                  ref_count;
+    RK_U32                  used;
+    RK_U32                  own_map;        // ptr is our mapping of fd
+    RK_U32                  own_fd;
+    RK_U32                  discard;        // group cleared while in use
+} MppHostBuffer;
+
+struct MppHostGroup_t {
+    MppBufferType           type;
+    MppBufferMode           mode;
+    pthread_mutex_t         lock;
+    pthread_cond_t          cond;
+    MppHostBuffer           *buffers;
+    RK_S32                  count;
+    RK_S32                  used_count;
+    size_t                  usage;
+    size_t                  limit_size;
+    RK_S32                  limit_count;
+    RK_S32                  next_index;
+    RK_U32                  released;       // group_put done, free on last return
+};
+
+typedef struct {
+    RK_U32          width;
+    RK_U32          height;
+    RK_U32          hor_stride;
+    RK_U32          ver_stride;
+    RK_U32          offset_x;
+    RK_U32          offset_y;
+    RK_U32          mode;
+    RK_U32          discard;
+    RK_U32          viewid;
+    RK_U32          poc;
+    RK_U32          errinfo;
+    RK_U32          eos;
+    RK_U32          info_change;
+    RK_S64          pts;
+    RK_S64          dts;
+    size_t          buf_size;
+    MppFrameFormat  fmt;
+    MppFrameColorRange color_range;
+    MppFrameColorSpace colorspace;
+    MppBuffer       buffer;
+    MppHostMeta     *meta;
+} MppHostFrame;
+
+typedef struct {
+    void            *data;
+    size_t          size;
+    void            *pos;
+    size_t          length;
+    RK_S64          pts;
+    RK_S64          dts;
+    RK_U32          flag;
+    RK_U32          own_data;
+    MppBuffer       buffer;
+    MppHostMeta     *meta;
+} MppHostPacket;
+
+#define MPP_PACKET_FLAG_EOS         (0x00000001)
+#define MPP_PACKET_FLAG_EXTRA_DATA  (0x00000002)
+
+typedef struct MppHostTask_t {
+    MppHostMeta             meta;
+    MppPortType             port;
+    RK_U32                  internal;       // simple-flow task, owns its packet copy
+    struct MppHostTask_t    *next;
+} MppHostTask;
+
+typedef struct {
+    MppHostTask     *head;
+    MppHostTask     *tail;
+    RK_S32          count;
+} MppHostTaskList;
+
+typedef struct {
+    MppCtxType      type;
+    MppCodingType   coding;
+    MppHostConfig   cfg;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       thread;
+    RK_U32          thread_started;
+    RK_U32          stop;
+
+    // Input port: idle tasks wait for the user, pending ones for the decoder
+    MppHostTask     *in_tasks;
+    MppHostTaskList in_idle;
+    MppHostTaskList in_pending;
+    MppHostTaskList in_internal;
+
+    // Output port: ready tasks carry one KEY_OUTPUT_FRAME each
+    MppHostTaskList out_ready;
+    MppHostTaskList out_free;
+
+    MppPollType     input_timeout;
+    MppPollType     output_timeout;
+
+    // Decoder state, owned by the decode thread
+    MppBufferGroup  frm_grp;
+    RK_U32          ext_grp;
+    RK_U32          info_change_wait;
+    RK_U32          eos_in;
+    RK_U32          frame_index;
+    RK_U32          cur_width;
+    RK_U32          cur_height;
+    RK_U32          reset_gen;
+    RK_U32          immediate_out;  // MPP_DEC_SET_IMMEDIATE_OUT: no reorder hold
+    MppFrameFormat  out_fmt;        // MPP_DEC_SET_OUTPUT_FORMAT, FBC or NV12
+    MppFrame        reorder[MPP_HOST_REORDER_MAX];
+    RK_U32          reorder_count;
+
+    // Encoder state: the config under lock, rate control on the encode thread
+    MppHostEncCfg   enc_cfg;
+    RK_U32          enc_cfg_gen;    // bumped by MPP_ENC_SET_CFG, restarts the GOP
+    RK_U32          enc_idr_req;
+    RK_U32          enc_frames;     // frames since the last IDR
+    RK_S64          enc_fullness;   // bits over the rate budget so far
+    RK_U32          enc_seed;
+} MppHostCtx;
+
+// Internal helpers shared between the stand-in modules
+void mpp_host_config_load(MppHostConfig *cfg);
+void mpp_host_task_list_push(MppHostTaskList *list, MppHostTask *task);
+MppHostTask *mpp_host_task_list_pop(MppHostTaskList *list);
+
+MPP_RET mpp_host_meta_set(MppHostMeta *meta, MppMetaKey key, MppHostMetaType type, const void *val);
+MPP_RET mpp_host_meta_get(MppHostMeta *meta, MppMetaKey key, MppHostMetaType type, void *val);
+
+MPP_RET mpp_host_buffer_get_block(MppBufferGroup group, MppBuffer *buffer, size_t size,
+                                  volatile RK_U32 *abort_flag);
+void mpp_host_group_wake(MppBufferGroup group);
+
+void mpp_host_enc_defaults(MppHostCtx *p);
+MPP_RET mpp_host_enc_control(MppHostCtx *p, MpiCmd cmd, MppParam param);
+void *mpp_host_enc_thread(void *arg);
+
+#endif // MPP_HOST_H
@@ -0,0 +1,551 @@
+#define MODULE_TAG "mpp_host_buffer"
+
+#include "mpp_host.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * Buffers are memfd mappings so that the fd handed out by
+ * mpp_buffer_get_fd can be mmap'ed or passed to another process exactly like
+ * a dma-buf on the board.
+ */
+static MppHostBuffer *buffer_alloc(size_t size)
+{
+    MppHostBuffer *buf = calloc(1, sizeof(MppHostBuffer));
+    if (!buf)
+        return NULL;
+
+    buf->fd = memfd_create("mpp_host_buf", MFD_CLOEXEC);
+    if (buf->fd < 0)
+        goto ERR_RET;
+
+    if (ftruncate(buf->fd, size) < 0)
+        goto ERR_RET;
+
+    // dma-buf heaps hand out populated memory, the cost is paid here
+    buf->ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, buf->fd, 0);
+    if (buf->ptr == MAP_FAILED)
+        goto ERR_RET;
+
+    buf->size = size;
+    buf->own_map = 1;
+    buf->own_fd = 1;
+    return buf;
+
+ERR_RET:
+    if (buf->fd >= 0)
+        close(buf->fd);
+    free(buf);
+    return NULL;
+}
+
+// Map an imported fd, read-only when that is all the fd allows
+static void *map_fd(int fd, size_t size)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (ptr == MAP_FAILED)
+        ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return ptr;
+}
+
+static void buffer_free(MppHostBuffer *buf)
+{
+    if (buf->own_map && buf->ptr)
+        munmap(buf->ptr, buf->size);
+    if (buf->own_fd && buf->fd >= 0)
+        close(buf->fd);
+    free(buf);
+}
+
+// Caller holds group->lock
+static void group_link(MppHostGroup *grp, MppHostBuffer *buf)
+{
+    buf->group = grp;
+    buf->index = grp->next_index++;
+    buf->next = grp->buffers;
+    grp->buffers = buf;
+    grp->count++;
+    grp->usage += buf->size;
+}
+
+// Caller holds group->lock
+static void group_unlink(MppHostGroup *grp, MppHostBuffer *buf)
+{
+    MppHostBuffer **pp = &grp->buffers;
+
+    while (*pp && *pp != buf)
+        pp = &(*pp)->next;
+    if (*pp)
+        *pp = buf->next;
+
+    grp->count--;
+    grp->usage -= buf->size;
+}
+
+// Caller holds group->lock
+static void group_free_unused(MppHostGroup *grp)
+{
+    MppHostBuffer *buf = grp->buffers;
+
+    while (buf) {
+        MppHostBuffer *next = buf->next;
+        if (!buf->used) {
+            group_unlink(grp, buf);
+            buffer_free(buf);
+        }
+        buf = next;
+    }
+}
+
+static void group_destroy(MppHostGroup *grp)
+{
+    pthread_mutex_destroy(&grp->lock);
+    pthread_cond_destroy(&grp->cond);
+    free(grp);
+}
+
+/*
+ * Take an unused buffer of at least size bytes, or grow the group when its
+ * limits allow. Internal groups drop unused buffers of the wrong size to
+ * make room, external groups only ever hand out committed buffers.
+ * Caller holds group->lock.
+ */
+static MppHostBuffer *group_take(MppHostGroup *grp, size_t size)
+{
+    MppHostBuffer *buf;
+
+    for (buf = grp->buffers; buf; buf = buf->next) {
+        if (!buf->used && buf->size >= size)
+            goto TAKE;
+    }
+
+    if (grp->mode == MPP_BUFFER_EXTERNAL)
+        return NULL;
+
+    if (grp->limit_size && size > grp->limit_size)
+        return NULL;
+
+    if (grp->limit_count && grp->count >= grp->limit_count) {
+        group_free_unused(grp);
+        if (grp->count >= grp->limit_count)
+            return NULL;
+    }
+
+    buf = buffer_alloc(size);
+    if (!buf)
+        return NULL;
+    group_link(grp, buf);
+
+TAKE:
+    buf->used = 1;
+    buf->ref_count = 1;
+    grp->used_count++;
+    return buf;
+}
+
+MPP_RET mpp_buffer_group_get(MppBufferGroup *group, MppBufferType type, MppBufferMode mode,
+                             const char *tag, const char *caller)
+{
+    MppHostGroup *grp;
+    (void)tag;
+    (void)caller;
+
+    if (!group)
+        return MPP_ERR_NULL_PTR;
+
+    grp = calloc(1, sizeof(MppHostGroup));
+    if (!grp) {
+        *group = NULL;
+        return MPP_ERR_MALLOC;
+    }
+
+    grp->type = (MppBufferType)(type & MPP_BUFFER_TYPE_MASK);
+    grp->mode = mode;
+    pthread_mutex_init(&grp->lock, NULL);
+    pthread_cond_init(&grp->cond, NULL);
+
+    *group = grp;
+    return MPP_OK;
+}
+
+/*
+ * Buffers still referenced stay valid; the group is freed when the last of
+ * them comes back.
+ */
+MPP_RET mpp_buffer_group_put(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    RK_U32 empty;
+
+    if (!grp)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&grp->lock);
+    grp->released = 1;
+    group_free_unused(grp);
+    empty = (grp->count == 0);
+    pthread_cond_broadcast(&grp->cond);
+    pthread_mutex_unlock(&grp->lock);
+
+    if (empty)
+        group_destroy(grp);
+
+    return MPP_OK;
+}
+
+/*
+ * Free unused buffers. Buffers still in use are discarded when they come
+ * back, so a group resized at info change does not keep old-size frames.
+ */
+MPP_RET mpp_buffer_group_clear(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    MppHostBuffer *buf;
+
+    if (!grp)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&grp->lock);
+    group_free_unused(grp);
+    for (buf = grp->buffers; buf; buf = buf->next)
+        buf->discard = 1;
+    pthread_mutex_unlock(&grp->lock);
+    return MPP_OK;
+}
+
+RK_S32 mpp_buffer_group_unused(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    RK_S32 unused;
+
+    if (!grp)
+        return 0;
+
+    pthread_mutex_lock(&grp->lock);
+    if (grp->mode == MPP_BUFFER_INTERNAL && grp->limit_count)
+        unused = grp->limit_count - grp->used_count;
+    else
+        unused = grp->count - grp->used_count;
+    pthread_mutex_unlock(&grp->lock);
+    return unused;
+}
+
+size_t mpp_buffer_group_usage(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    size_t usage;
+
+    if (!grp)
+        return 0;
+
+    pthread_mutex_lock(&grp->lock);
+    usage = grp->usage;
+    pthread_mutex_unlock(&grp->lock);
+    return usage;
+}
+
+MppBufferMode mpp_buffer_group_mode(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    return grp ? grp->mode : MPP_BUFFER_MODE_BUTT;
+}
+
+MppBufferType mpp_buffer_group_type(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    return grp ? grp->type : MPP_BUFFER_TYPE_BUTT;
+}
+
+MPP_RET mpp_buffer_group_limit_config(MppBufferGroup group, size_t size, RK_S32 count)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+
+    if (!grp)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&grp->lock);
+    grp->limit_size = size;
+    grp->limit_count = count;
+    pthread_mutex_unlock(&grp->lock);
+    return MPP_OK;
+}
+
+MPP_RET mpp_buffer_commit(MppBufferGroup group, MppBufferInfo *info)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    MppHostBuffer *buf;
+
+    if (!grp || !info)
+        return MPP_ERR_NULL_PTR;
+
+    if (grp->mode != MPP_BUFFER_EXTERNAL) {
+        mpp_err_f("commit needs an external group\n");
+        return MPP_NOK;
+    }
+
+    buf = calloc(1, sizeof(MppHostBuffer));
+    if (!buf)
+        return MPP_ERR_MALLOC;
+
+    buf->size = info->size;
+    buf->fd = info->fd;
+    buf->ptr = info->ptr;
+
+    // An fd is imported like a dma-buf: our own reference and mapping, so
+    // the caller may free its buffer while the group still uses the memory
+    if (info->fd >= 0) {
+        buf->fd = dup(info->fd);
+        if (buf->fd < 0) {
+            free(buf);
+            return MPP_NOK;
+        }
+        buf->own_fd = 1;
+        buf->ptr = map_fd(buf->fd, buf->size);
+        if (buf->ptr == MAP_FAILED) {
+            mpp_err_f("mmap fd %d size %zu failed\n", buf->fd, buf->size);
+            close(buf->fd);
+            free(buf);
+            return MPP_NOK;
+        }
+        buf->own_map = 1;
+    }
+
+    pthread_mutex_lock(&grp->lock);
+    group_link(grp, buf);
+    if (info->index >= 0)
+        buf->index = info->index;
+    pthread_cond_broadcast(&grp->cond);
+    pthread_mutex_unlock(&grp->lock);
+    return MPP_OK;
+}
+
+MPP_RET mpp_buffer_import_with_tag(MppBufferGroup group, MppBufferInfo *info, MppBuffer *buffer,
+                                   const char *tag, const char *caller)
+{
+    MppHostBuffer *buf;
+    (void)tag;
+    (void)caller;
+
+    if (!info)
+        return MPP_ERR_NULL_PTR;
+
+    if (group)
+        return mpp_buffer_commit(group, info);
+
+    if (!buffer)
+        return MPP_ERR_NULL_PTR;
+
+    buf = calloc(1, sizeof(MppHostBuffer));
+    if (!buf)
+        return MPP_ERR_MALLOC;
+
+    buf->size = info->size;
+    buf->fd = info->fd;
+    buf->ptr = info->ptr;
+    buf->index = info->index;
+    if (!buf->ptr && buf->fd >= 0) {
+        buf->ptr = map_fd(buf->fd, buf->size);
+        if (buf->ptr == MAP_FAILED) {
+            free(buf);
+            return MPP_NOK;
+        }
+        buf->own_map = 1;
+    }
+    buf->used = 1;
+    buf->ref_count = 1;
+
+    *buffer = buf;
+    return MPP_OK;
+}
+
+MPP_RET mpp_buffer_get_with_tag(MppBufferGroup group, MppBuffer *buffer, size_t size,
+                                const char *tag, const char *caller)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    MppHostBuffer *buf;
+    (void)tag;
+
+    if (!grp || !buffer || !size) {
+        mpp_err("%s invalid input group %p buffer %p size %zu\n", caller, group, buffer, size);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    pthread_mutex_lock(&grp->lock);
+    buf = group_take(grp, size);
+    pthread_mutex_unlock(&grp->lock);
+
+    *buffer = buf;
+    return buf ? MPP_OK : MPP_NOK;
+}
+
+MPP_RET mpp_host_buffer_get_block(MppBufferGroup group, MppBuffer *buffer, size_t size,
+                                  volatile RK_U32 *abort_flag)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+    MppHostBuffer *buf = NULL;
+
+    pthread_mutex_lock(&grp->lock);
+    while (!*abort_flag && !(buf = group_take(grp, size)))
+        pthread_cond_wait(&grp->cond, &grp->lock);
+    pthread_mutex_unlock(&grp->lock);
+
+    *buffer = buf;
+    return buf ? MPP_OK : MPP_NOK;
+}
+
+void mpp_host_group_wake(MppBufferGroup group)
+{
+    MppHostGroup *grp = (MppHostGroup *)group;
+
+    pthread_mutex_lock(&grp->lock);
+    pthread_cond_broadcast(&grp->cond);
+    pthread_mutex_unlock(&grp->lock);
+}
+
+MPP_RET mpp_buffer_inc_ref_with_caller(MppBuffer buffer, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    __atomic_add_fetch(&buf->ref_count, 1, __ATOMIC_RELAXED);
+    return MPP_OK;
+}
+
+MPP_RET mpp_buffer_put_with_caller(MppBuffer buffer, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+    MppHostGroup *grp;
+    RK_U32 destroy = 0;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    if (__atomic_sub_fetch(&buf->ref_count, 1, __ATOMIC_ACQ_REL) > 0)
+        return MPP_OK;
+
+    grp = buf->group;
+    if (!grp) {
+        buffer_free(buf);
+        return MPP_OK;
+    }
+
+    pthread_mutex_lock(&grp->lock);
+    buf->used = 0;
+    grp->used_count--;
+    if (grp->released || buf->discard) {
+        group_unlink(grp, buf);
+        buffer_free(buf);
+        destroy = grp->released && grp->count == 0;
+    }
+    pthread_cond_broadcast(&grp->cond);
+    pthread_mutex_unlock(&grp->lock);
+
+    if (destroy)
+        group_destroy(grp);
+
+    return MPP_OK;
+}
+
+MPP_RET mpp_buffer_info_get_with_caller(MppBuffer buffer, MppBufferInfo *info, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf || !info) {
+        mpp_err("%s found NULL buffer or info\n", caller);
+        return MPP_ERR_NULL_PTR;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->type = buf->group ? buf->group->type : MPP_BUFFER_TYPE_EXT_DMA;
+    info->size = buf->size;
+    info->ptr = buf->ptr;
+    info->fd = buf->fd;
+    info->index = buf->index;
+    return MPP_OK;
+}
+
+void *mpp_buffer_get_ptr_with_caller(MppBuffer buffer, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return NULL;
+    }
+    return buf->ptr;
+}
+
+int mpp_buffer_get_fd_with_caller(MppBuffer buffer, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return -1;
+    }
+    return buf->fd;
+}
+
+size_t mpp_buffer_get_size_with_caller(MppBuffer buffer, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return 0;
+    }
+    return buf->size;
+}
+
+int mpp_buffer_get_index_with_caller(MppBuffer buffer, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return -1;
+    }
+    return buf->index;
+}
+
+MPP_RET mpp_buffer_set_index_with_caller(MppBuffer buffer, int index, const char *caller)
+{
+    MppHostBuffer *buf = (MppHostBuffer *)buffer;
+
+    if (!buf) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return MPP_ERR_NULL_PTR;
+    }
+    buf->index = index;
+    return MPP_OK;
+}
+
+// Host memory is coherent, sync only validates the handle
+MPP_RET mpp_buffer_sync_begin_f(MppBuffer buffer, RK_S32 ro, const char *caller)
+{
+    (void)ro;
+    if (!buffer) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return MPP_ERR_NULL_PTR;
+    }
+    return MPP_OK;
+}
+
+MPP_RET mpp_buffer_sync_end_f(MppBuffer buffer, RK_S32 ro, const char *caller)
+{
+    (void)ro;
+    if (!buffer) {
+        mpp_err("%s found NULL buffer\n", caller);
+        return MPP_ERR_NULL_PTR;
+    }
+    return MPP_OK;
+}
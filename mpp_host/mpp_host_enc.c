@@ -0,0 +1,602 @@
+#define MODULE_TAG "mpp_host_enc"
+
+#include "mpp_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include "rockchip/rk_venc_cfg.h"
+
+// Bits of a frame at QP 0 per pixel and complexity unit, from 1080p at QP 26
+// coming out near 30 KB per P frame
+#define ENC_BITS_PER_PIXEL      2.4
+// An intra frame costs this many P frames at the same QP
+#define ENC_INTRA_WEIGHT        4.0
+// Frames over which rate control pays back the bits it is over budget
+#define ENC_CBR_WINDOW          8
+#define ENC_VBR_WINDOW          30
+// Smallest packet: start code, NAL header and a few slice bytes
+#define ENC_MIN_PACKET          16
+
+static const char *enc_cfg_names[ENC_CFG_NUM] = {
+    "prep:width", "prep:height", "prep:hor_stride", "prep:ver_stride", "prep:format",
+    "rc:mode", "rc:bps_target", "rc:bps_max", "rc:bps_min",
+    "rc:fps_in_flex", "rc:fps_in_num", "rc:fps_in_denom",
+    "rc:fps_out_flex", "rc:fps_out_num", "rc:fps_out_denom",
+    "rc:gop", "rc:qp_init", "rc:qp_min", "rc:qp_max", "rc:qp_min_i", "rc:qp_max_i",
+    "codec:type", "h264:profile", "h264:level", "h264:cabac_en",
+};
+
+static int enc_cfg_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < ENC_CFG_NUM; i++) {
+        if (!strcmp(name, enc_cfg_names[i]))
+            return i;
+    }
+    return -1;
+}
+
+MPP_RET mpp_enc_cfg_init(MppEncCfg *cfg)
+{
+    if (!cfg)
+        return MPP_ERR_NULL_PTR;
+
+    *cfg = calloc(1, sizeof(MppHostEncCfg));
+    return *cfg ? MPP_OK : MPP_ERR_MALLOC;
+}
+
+MPP_RET mpp_enc_cfg_deinit(MppEncCfg cfg)
+{
+    free(cfg);
+    return MPP_OK;
+}
+
+static MPP_RET enc_cfg_set(MppEncCfg cfg, const char *name, RK_S64 val)
+{
+    MppHostEncCfg *c = (MppHostEncCfg *)cfg;
+    int i;
+
+    if (!c || !name)
+        return MPP_ERR_NULL_PTR;
+
+    i = enc_cfg_find(name);
+    if (i < 0) {
+        mpp_err("failed to set %s, no such encoder config\n", name);
+        return MPP_NOK;
+    }
+    c->val[i] = val;
+    c->set[i] = 1;
+    return MPP_OK;
+}
+
+static MPP_RET enc_cfg_get(MppEncCfg cfg, const char *name, RK_S64 *val)
+{
+    MppHostEncCfg *c = (MppHostEncCfg *)cfg;
+    int i;
+
+    if (!c || !name || !val)
+        return MPP_ERR_NULL_PTR;
+
+    i = enc_cfg_find(name);
+    if (i < 0) {
+        mpp_err("failed to get %s, no such encoder config\n", name);
+        return MPP_NOK;
+    }
+    *val = c->val[i];
+    return MPP_OK;
+}
+
+MPP_RET mpp_enc_cfg_set_s32(MppEncCfg cfg, const char *name, RK_S32 val)
+{
+    return enc_cfg_set(cfg, name, val);
+}
+
+MPP_RET mpp_enc_cfg_set_u32(MppEncCfg cfg, const char *name, RK_U32 val)
+{
+    return enc_cfg_set(cfg, name, val);
+}
+
+MPP_RET mpp_enc_cfg_get_s32(MppEncCfg cfg, const char *name, RK_S32 *val)
+{
+    RK_S64 v = 0;
+    MPP_RET ret = enc_cfg_get(cfg, name, &v);
+
+    if (!ret)
+        *val = (RK_S32)v;
+    return ret;
+}
+
+MPP_RET mpp_enc_cfg_get_u32(MppEncCfg cfg, const char *name, RK_U32 *val)
+{
+    RK_S64 v = 0;
+    MPP_RET ret = enc_cfg_get(cfg, name, &v);
+
+    if (!ret)
+        *val = (RK_U32)v;
+    return ret;
+}
+
+// Caller holds p->lock
+void mpp_host_enc_defaults(MppHostCtx *p)
+{
+    RK_S64 *v = p->enc_cfg.val;
+
+    memset(&p->enc_cfg, 0, sizeof(p->enc_cfg));
+    v[ENC_CFG_PREP_FORMAT] = MPP_FMT_YUV420SP;
+    v[ENC_CFG_RC_MODE] = MPP_ENC_RC_MODE_VBR;
+    v[ENC_CFG_RC_FPS_IN_NUM] = 30;
+    v[ENC_CFG_RC_FPS_IN_DENOM] = 1;
+    v[ENC_CFG_RC_FPS_OUT_NUM] = 30;
+    v[ENC_CFG_RC_FPS_OUT_DENOM] = 1;
+    v[ENC_CFG_RC_GOP] = 60;
+    v[ENC_CFG_RC_QP_INIT] = -1;
+    v[ENC_CFG_RC_QP_MIN] = 10;
+    v[ENC_CFG_RC_QP_MAX] = 51;
+    v[ENC_CFG_RC_QP_MIN_I] = 10;
+    v[ENC_CFG_RC_QP_MAX_I] = 51;
+    v[ENC_CFG_CODEC_TYPE] = p->coding;
+    v[ENC_CFG_H264_PROFILE] = 100;
+    v[ENC_CFG_H264_LEVEL] = 40;
+    v[ENC_CFG_H264_CABAC_EN] = 1;
+}
+
+static double cfg_fps(const MppHostEncCfg *cfg)
+{
+    const RK_S64 *v = cfg->val;
+
+    return v[ENC_CFG_RC_FPS_OUT_DENOM] > 0 && v[ENC_CFG_RC_FPS_OUT_NUM] > 0 ?
+           (double)v[ENC_CFG_RC_FPS_OUT_NUM] / v[ENC_CFG_RC_FPS_OUT_DENOM] : 30;
+}
+
+/*
+ * Merge the user's changes into the context config and check the result.
+ * Missing strides follow the width, missing bit rates follow the size as
+ * mpi_enc_test picks them. Caller holds p->lock.
+ */
+static MPP_RET enc_set_cfg(MppHostCtx *p, const MppHostEncCfg *user)
+{
+    MppHostEncCfg cfg = p->enc_cfg;
+    RK_S64 *v = cfg.val;
+    RK_U32 i;
+
+    for (i = 0; i < ENC_CFG_NUM; i++) {
+        if (user->set[i])
+            v[i] = user->val[i];
+    }
+
+    if (v[ENC_CFG_PREP_WIDTH] <= 0 || v[ENC_CFG_PREP_HEIGHT] <= 0) {
+        mpp_err("invalid prep size %lldx%lld\n", v[ENC_CFG_PREP_WIDTH], v[ENC_CFG_PREP_HEIGHT]);
+        return MPP_ERR_VALUE;
+    }
+    if (v[ENC_CFG_PREP_HOR_STRIDE] < v[ENC_CFG_PREP_WIDTH])
+        v[ENC_CFG_PREP_HOR_STRIDE] = MPP_HOST_ALIGN(v[ENC_CFG_PREP_WIDTH], 16);
+    if (v[ENC_CFG_PREP_VER_STRIDE] < v[ENC_CFG_PREP_HEIGHT])
+        v[ENC_CFG_PREP_VER_STRIDE] = MPP_HOST_ALIGN(v[ENC_CFG_PREP_HEIGHT], 16);
+    if (v[ENC_CFG_PREP_FORMAT] != MPP_FMT_YUV420SP) {
+        mpp_err("prep format %lld not supported by the host stand-in, NV12 only\n",
+                v[ENC_CFG_PREP_FORMAT]);
+        return MPP_ERR_VALUE;
+    }
+    if (v[ENC_CFG_CODEC_TYPE] != p->coding) {
+        mpp_err("codec:type %llx differs from the context coding %x\n",
+                v[ENC_CFG_CODEC_TYPE], p->coding);
+        return MPP_ERR_VALUE;
+    }
+    if (v[ENC_CFG_RC_GOP] < 0)
+        v[ENC_CFG_RC_GOP] = 0;
+
+    switch (v[ENC_CFG_RC_MODE]) {
+    case MPP_ENC_RC_MODE_FIXQP : {
+        if (v[ENC_CFG_RC_QP_INIT] < 0 || v[ENC_CFG_RC_QP_INIT] > 51) {
+            mpp_err("fixqp needs rc:qp_init in 0..51, not %lld\n", v[ENC_CFG_RC_QP_INIT]);
+            return MPP_ERR_VALUE;
+        }
+    } break;
+    case MPP_ENC_RC_MODE_CBR :
+    case MPP_ENC_RC_MODE_VBR :
+    case MPP_ENC_RC_MODE_AVBR : {
+        RK_S64 target = v[ENC_CFG_RC_BPS_TARGET];
+
+        if (target <= 0)
+            target = v[ENC_CFG_PREP_WIDTH] * v[ENC_CFG_PREP_HEIGHT] / 8 * (RK_S64)cfg_fps(&cfg);
+        v[ENC_CFG_RC_BPS_TARGET] = target;
+        if (v[ENC_CFG_RC_BPS_MAX] < target)
+            v[ENC_CFG_RC_BPS_MAX] = target * 17 / 16;
+        if (v[ENC_CFG_RC_BPS_MIN] <= 0 || v[ENC_CFG_RC_BPS_MIN] > target)
+            v[ENC_CFG_RC_BPS_MIN] = v[ENC_CFG_RC_MODE] == MPP_ENC_RC_MODE_CBR ?
+                                    target * 15 / 16 : target / 16;
+    } break;
+    default : {
+        mpp_err("invalid rc:mode %lld\n", v[ENC_CFG_RC_MODE]);
+        return MPP_ERR_VALUE;
+    }
+    }
+    if (v[ENC_CFG_RC_QP_MIN] < 0 || v[ENC_CFG_RC_QP_MAX] > 51 ||
+        v[ENC_CFG_RC_QP_MIN] > v[ENC_CFG_RC_QP_MAX]) {
+        mpp_err("invalid qp range %lld..%lld\n", v[ENC_CFG_RC_QP_MIN], v[ENC_CFG_RC_QP_MAX]);
+        return MPP_ERR_VALUE;
+    }
+    if (v[ENC_CFG_RC_QP_MIN_I] < 0 || v[ENC_CFG_RC_QP_MAX_I] > 51 ||
+        v[ENC_CFG_RC_QP_MIN_I] > v[ENC_CFG_RC_QP_MAX_I]) {
+        v[ENC_CFG_RC_QP_MIN_I] = v[ENC_CFG_RC_QP_MIN];
+        v[ENC_CFG_RC_QP_MAX_I] = v[ENC_CFG_RC_QP_MAX];
+    }
+
+    memset(cfg.set, 0, sizeof(cfg.set));
+    p->enc_cfg = cfg;
+    p->enc_cfg_gen++;
+    mpp_logd("encoder %lldx%lld rc mode %lld bps %lld gop %lld\n",
+             v[ENC_CFG_PREP_WIDTH], v[ENC_CFG_PREP_HEIGHT], v[ENC_CFG_RC_MODE],
+             v[ENC_CFG_RC_BPS_TARGET], v[ENC_CFG_RC_GOP]);
+    return MPP_OK;
+}
+
+/*
+ * Parameter sets for the configured stream. Only the bytes a parser looks
+ * at are meaningful: NAL types, the profile and the level. The rest is
+ * filler that never forms a start code.
+ */
+static size_t write_header(const MppHostEncCfg *cfg, MppCodingType coding, RK_U8 *dst, size_t cap)
+{
+    static const RK_U8 hevc_vps[] = {
+        0, 0, 0, 1, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+        0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0x95, 0x98, 0x09,
+    };
+    // general_level_idc 120 (level 4) is the 13th RBSP byte after the header
+    static const RK_U8 hevc_sps[] = {
+        0, 0, 0, 1, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00,
+        0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0xa0, 0x03, 0xc0, 0x80, 0x10, 0xe5, 0x96, 0x56,
+    };
+    static const RK_U8 hevc_pps[] = { 0, 0, 0, 1, 0x44, 0x01, 0xc1, 0x72, 0xb4, 0x62, 0x40 };
+    static const RK_U8 avc_pps[] = { 0, 0, 0, 1, 0x68, 0xee, 0x3c, 0x80 };
+    RK_U8 avc_sps[] = { 0, 0, 0, 1, 0x67, 0x64, 0x00, 0x28, 0xac, 0x2b, 0x40, 0x3c, 0x01, 0x13, 0xf2, 0xe0 };
+    size_t len;
+
+    if (coding == MPP_VIDEO_CodingHEVC) {
+        len = sizeof(hevc_vps) + sizeof(hevc_sps) + sizeof(hevc_pps);
+        if (len > cap)
+            return 0;
+        memcpy(dst, hevc_vps, sizeof(hevc_vps));
+        memcpy(dst + sizeof(hevc_vps), hevc_sps, sizeof(hevc_sps));
+        memcpy(dst + sizeof(hevc_vps) + sizeof(hevc_sps), hevc_pps, sizeof(hevc_pps));
+        return len;
+    }
+
+    len = sizeof(avc_sps) + sizeof(avc_pps);
+    if (len > cap)
+        return 0;
+    avc_sps[5] = (RK_U8)cfg->val[ENC_CFG_H264_PROFILE];
+    avc_sps[7] = (RK_U8)cfg->val[ENC_CFG_H264_LEVEL];
+    memcpy(dst, avc_sps, sizeof(avc_sps));
+    memcpy(dst + sizeof(avc_sps), avc_pps, sizeof(avc_pps));
+    return len;
+}
+
+// Caller holds p->lock
+MPP_RET mpp_host_enc_control(MppHostCtx *p, MpiCmd cmd, MppParam param)
+{
+    switch (cmd) {
+    case MPP_ENC_SET_CFG : {
+        if (!param)
+            return MPP_ERR_NULL_PTR;
+        return enc_set_cfg(p, (MppHostEncCfg *)param);
+    }
+    case MPP_ENC_GET_CFG : {
+        MppHostEncCfg *cfg = (MppHostEncCfg *)param;
+
+        if (!cfg)
+            return MPP_ERR_NULL_PTR;
+        *cfg = p->enc_cfg;
+        memset(cfg->set, 0, sizeof(cfg->set));
+    } break;
+    case MPP_ENC_SET_IDR_FRAME : {
+        p->enc_idr_req = 1;
+    } break;
+    case MPP_ENC_GET_HDR_SYNC : {
+        MppPacket packet = param;
+        RK_U8 *pos;
+        size_t len;
+
+        if (!packet)
+            return MPP_ERR_NULL_PTR;
+        pos = (RK_U8 *)mpp_packet_get_pos(packet);
+        len = write_header(&p->enc_cfg, p->coding, pos,
+                           mpp_packet_get_size(packet) - (pos - (RK_U8 *)mpp_packet_get_data(packet)));
+        if (!len) {
+            mpp_err("packet too small for the stream header\n");
+            return MPP_ERR_VALUE;
+        }
+        mpp_packet_set_length(packet, len);
+    } break;
+    default : {
+        mpp_logd("control %08x ignored by the host stand-in encoder\n", cmd);
+    } break;
+    }
+    return MPP_OK;
+}
+
+static void sleep_us(RK_U32 us)
+{
+    struct timespec ts;
+
+    if (!us)
+        return;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) && errno == EINTR)
+        ;
+}
+
+// Encode cores shared by every context, the two VEPU580 cores of the RK3588
+static pthread_mutex_t enc_core_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t enc_core_cond = PTHREAD_COND_INITIALIZER;
+static RK_U32 enc_core_busy;
+
+static void enc_core_acquire(MppHostCtx *p)
+{
+    if (!p->cfg.enc_cores)
+        return;
+
+    pthread_mutex_lock(&enc_core_lock);
+    while (enc_core_busy >= p->cfg.enc_cores)
+        pthread_cond_wait(&enc_core_cond, &enc_core_lock);
+    enc_core_busy++;
+    pthread_mutex_unlock(&enc_core_lock);
+}
+
+static void enc_core_release(MppHostCtx *p)
+{
+    if (!p->cfg.enc_cores)
+        return;
+
+    pthread_mutex_lock(&enc_core_lock);
+    enc_core_busy--;
+    pthread_cond_signal(&enc_core_cond);
+    pthread_mutex_unlock(&enc_core_lock);
+}
+
+/*
+ * Picture complexity from the frame itself, read in place as the hardware
+ * would: mean horizontal and vertical luma gradient over a few rows, 1.0
+ * for ordinary content.
+ */
+static double frame_complexity(MppFrame frame)
+{
+    const RK_U8 *base = mpp_buffer_get_ptr(mpp_frame_get_buffer(frame));
+    RK_U32 width = mpp_frame_get_width(frame);
+    RK_U32 height = mpp_frame_get_height(frame);
+    RK_U32 stride = mpp_frame_get_hor_stride(frame);
+    RK_U64 sum = 0, count = 0;
+    RK_U32 i, x;
+    double c;
+
+    if (!base || width < 2 || height < 2)
+        return 1.0;
+
+    for (i = 0; i < 16; i++) {
+        const RK_U8 *row = base + (size_t)(i * (height - 1) / 16) * stride;
+
+        for (x = 1; x < width; x += 4) {
+            sum += abs(row[x] - row[x - 1]) + abs(row[x + stride] - row[x]);
+            count++;
+        }
+    }
+    c = 0.5 + (double)sum / count / 8;
+    return c < 0.25 ? 0.25 : c > 4 ? 4 : c;
+}
+
+static RK_U32 next_seed(RK_U32 seed)
+{
+    return seed * 1664525u + 1013904223u;
+}
+
+/*
+ * Bits for one frame and the QP it came out at. The size model is
+ * bits = pixels * ENC_BITS_PER_PIXEL * complexity * 2^(-qp / 6), with
+ * intra frames ENC_INTRA_WEIGHT times dearer. CBR and VBR solve it for
+ * the QP that spends their per-frame budget, VBR scaling the budget by
+ * complexity, and pay back overshoot over their window.
+ */
+static double frame_bits(MppHostCtx *p, const MppHostEncCfg *cfg, RK_U32 intra,
+                         double complexity, RK_S32 *qp_out)
+{
+    const RK_S64 *v = cfg->val;
+    double weight = intra ? ENC_INTRA_WEIGHT : 1.0;
+    double base = (double)v[ENC_CFG_PREP_WIDTH] * v[ENC_CFG_PREP_HEIGHT] *
+                  ENC_BITS_PER_PIXEL * complexity * weight;
+    RK_S64 mode = v[ENC_CFG_RC_MODE];
+    double qp, bits;
+
+    if (mode == MPP_ENC_RC_MODE_FIXQP) {
+        qp = v[ENC_CFG_RC_QP_INIT];
+    } else {
+        double fps = cfg_fps(cfg);
+        double avg = v[ENC_CFG_RC_BPS_TARGET] / fps;
+        RK_S64 gop = v[ENC_CFG_RC_GOP];
+        double budget = gop ? avg * gop / (gop - 1 + ENC_INTRA_WEIGHT) * weight : avg * weight;
+        RK_S64 qp_min = intra ? v[ENC_CFG_RC_QP_MIN_I] : v[ENC_CFG_RC_QP_MIN];
+        RK_S64 qp_max = intra ? v[ENC_CFG_RC_QP_MAX_I] : v[ENC_CFG_RC_QP_MAX];
+
+        if (mode == MPP_ENC_RC_MODE_CBR) {
+            budget -= (double)p->enc_fullness / ENC_CBR_WINDOW;
+        } else {
+            double lo = budget * v[ENC_CFG_RC_BPS_MIN] / v[ENC_CFG_RC_BPS_TARGET];
+            double hi = budget * v[ENC_CFG_RC_BPS_MAX] / v[ENC_CFG_RC_BPS_TARGET];
+
+            budget = budget * complexity - (double)p->enc_fullness / ENC_VBR_WINDOW;
+            budget = budget < lo ? lo : budget > hi ? hi : budget;
+        }
+        if (budget < ENC_MIN_PACKET * 8)
+            budget = ENC_MIN_PACKET * 8;
+
+        qp = 6 * log2(base / budget);
+        if (qp < qp_min)
+            qp = qp_min;
+        if (qp > qp_max)
+            qp = qp_max;
+    }
+
+    bits = base * pow(2, -qp / 6);
+    if (mode != MPP_ENC_RC_MODE_FIXQP)
+        p->enc_fullness += (RK_S64)(bits - v[ENC_CFG_RC_BPS_TARGET] / cfg_fps(cfg));
+    *qp_out = (RK_S32)(qp + 0.5);
+    return bits;
+}
+
+/*
+ * One Annex-B access unit for the frame: a single slice NAL of the size
+ * rate control settled on, filled with bytes that never make a start code.
+ * A frame that does not match the configured size gives an empty packet.
+ */
+static MppPacket encode_frame(MppHostCtx *p, const MppHostEncCfg *cfg, MppFrame frame, RK_U32 intra)
+{
+    const RK_S64 *v = cfg->val;
+    MppPacket packet = NULL;
+    MppHostPacket *pkt;
+    RK_U8 *data;
+    size_t size = 0, pos = 0;
+    RK_S32 qp = 0;
+
+    if (mpp_packet_new(&packet))
+        return NULL;
+    pkt = (MppHostPacket *)packet;
+    pkt->pts = mpp_frame_get_pts(frame);
+    pkt->dts = mpp_frame_get_dts(frame);
+    if (mpp_frame_get_eos(frame))
+        pkt->flag |= MPP_PACKET_FLAG_EOS;
+
+    // An EOS frame without a picture only flushes
+    if (!mpp_frame_get_buffer(frame))
+        return packet;
+
+    if (mpp_frame_get_width(frame) != v[ENC_CFG_PREP_WIDTH] ||
+        mpp_frame_get_height(frame) != v[ENC_CFG_PREP_HEIGHT] ||
+        mpp_frame_get_hor_stride(frame) != v[ENC_CFG_PREP_HOR_STRIDE] ||
+        mpp_frame_get_ver_stride(frame) != v[ENC_CFG_PREP_VER_STRIDE]) {
+        mpp_err("frame %ux%u stride %ux%u does not match prep %lldx%lld stride %lldx%lld\n",
+                mpp_frame_get_width(frame), mpp_frame_get_height(frame),
+                mpp_frame_get_hor_stride(frame), mpp_frame_get_ver_stride(frame),
+                v[ENC_CFG_PREP_WIDTH], v[ENC_CFG_PREP_HEIGHT],
+                v[ENC_CFG_PREP_HOR_STRIDE], v[ENC_CFG_PREP_VER_STRIDE]);
+        return packet;
+    }
+
+    // Stand-in for hardware time, the frame stays with the encoder meanwhile
+    enc_core_acquire(p);
+    size = (size_t)(frame_bits(p, cfg, intra, frame_complexity(frame), &qp) / 8);
+    sleep_us(p->cfg.enc_latency_us);
+    enc_core_release(p);
+
+    if (size < ENC_MIN_PACKET)
+        size = ENC_MIN_PACKET;
+    data = malloc(size);
+    if (!data) {
+        mpp_err_f("no memory for a %zu byte packet\n", size);
+        return packet;
+    }
+
+    data[pos++] = 0;
+    data[pos++] = 0;
+    data[pos++] = 0;
+    data[pos++] = 1;
+    if (p->coding == MPP_VIDEO_CodingHEVC) {
+        // IDR_W_RADL or TRAIL_R
+        data[pos++] = intra ? 19 << 1 : 1 << 1;
+        data[pos++] = 0x01;
+    } else {
+        data[pos++] = intra ? 0x65 : 0x41;
+    }
+    // first_mb_in_slice 0 / first_slice_segment_in_pic_flag 1
+    data[pos++] = 0x88;
+    while (pos < size) {
+        p->enc_seed = next_seed(p->enc_seed);
+        data[pos++] = (RK_U8)(p->enc_seed >> 24) | 0x01;
+    }
+
+    pkt->data = pkt->pos = data;
+    pkt->size = pkt->length = size;
+    pkt->own_data = 1;
+    mpp_meta_set_s32(mpp_packet_get_meta(packet), KEY_OUTPUT_INTRA, intra);
+    mpp_meta_set_s32(mpp_packet_get_meta(packet), KEY_ENC_AVERAGE_QP, qp);
+    return packet;
+}
+
+// Caller holds p->lock
+static void output_packet(MppHostCtx *p, MppPacket packet)
+{
+    MppHostTask *task = mpp_host_task_list_pop(&p->out_free);
+
+    if (!task) {
+        task = calloc(1, sizeof(MppHostTask));
+        if (!task) {
+            mpp_err_f("drop packet, no memory for output task\n");
+            mpp_packet_deinit(&packet);
+            return;
+        }
+        task->port = MPP_PORT_OUTPUT;
+    }
+    mpp_task_meta_set_packet(task, KEY_OUTPUT_PACKET, packet);
+    mpp_host_task_list_push(&p->out_ready, task);
+}
+
+/*
+ * Frames in input-task order, one packet each. The input task goes back
+ * to the user as soon as the frame has been read, before its packet is
+ * published, so a frame is never released while the encoder reads it.
+ */
+void *mpp_host_enc_thread(void *arg)
+{
+    MppHostCtx *p = (MppHostCtx *)arg;
+    RK_U32 cfg_gen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->stop) {
+        MppHostTask *task = mpp_host_task_list_pop(&p->in_pending);
+        MppHostEncCfg cfg;
+        MppFrame frame = NULL;
+        MppPacket packet = NULL;
+        RK_S64 gop;
+        RK_U32 intra;
+
+        if (!task) {
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+
+        // A new config starts a new GOP with fresh rate control
+        if (cfg_gen != p->enc_cfg_gen) {
+            cfg_gen = p->enc_cfg_gen;
+            p->enc_frames = 0;
+            p->enc_fullness = 0;
+        }
+        cfg = p->enc_cfg;
+        gop = cfg.val[ENC_CFG_RC_GOP];
+        // gop 0: one intra frame at the start, then only on request
+        intra = p->enc_idr_req || !p->enc_frames || (gop && p->enc_frames % gop == 0);
+        pthread_mutex_unlock(&p->lock);
+
+        mpp_task_meta_get_frame(task, KEY_INPUT_FRAME, &frame);
+        if (frame)
+            packet = encode_frame(p, &cfg, frame, intra);
+
+        pthread_mutex_lock(&p->lock);
+        if (packet && mpp_packet_get_length(packet)) {
+            if (intra) {
+                p->enc_idr_req = 0;
+                p->enc_frames = 0;
+            }
+            p->enc_frames++;
+        }
+        mpp_task_meta_set_frame(task, KEY_INPUT_FRAME, frame);
+        mpp_host_task_list_push(&p->in_idle, task);
+        if (packet)
+            output_packet(p, packet);
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
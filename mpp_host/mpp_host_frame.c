@@ -0,0 +1,579 @@
+#define MODULE_TAG "mpp_host_frame"
+
+#include "mpp_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+static int log_level = -1;
+static pthread_once_t log_level_once = PTHREAD_ONCE_INIT;
+
+static const char *log_level_name[] = {
+    "unknown", "fatal", "error", "warn", "info", "debug", "verbose", "silent",
+};
+
+// Workers log from their own threads, so the environment is read once
+static void log_level_init(void)
+{
+    const char *env = getenv("mpp_log_level");
+
+    log_level = env ? atoi(env) : MPP_LOG_INFO;
+}
+
+int mpp_get_log_level(void)
+{
+    pthread_once(&log_level_once, log_level_init);
+    return log_level;
+}
+
+void mpp_set_log_level(int level)
+{
+    pthread_once(&log_level_once, log_level_init);
+    log_level = level;
+}
+
+void _mpp_log_l(int level, const char *tag, const char *fmt, const char *func, ...)
+{
+    va_list args;
+
+    if (level <= MPP_LOG_UNKNOWN || level >= MPP_LOG_SILENT || level > mpp_get_log_level())
+        return;
+
+    if (tag)
+        fprintf(stderr, "%s: ", tag);
+    if (level <= MPP_LOG_WARN)
+        fprintf(stderr, "%s: ", log_level_name[level]);
+    if (func)
+        fprintf(stderr, "%s ", func);
+
+    va_start(args, func);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+/*
+ * Meta: a short array of typed key/value pairs. Getting a value consumes
+ * it, so a task never hands the same frame or packet out twice.
+ */
+MPP_RET mpp_host_meta_set(MppHostMeta *meta, MppMetaKey key, MppHostMetaType type, const void *val)
+{
+    MppHostMetaNode *node = NULL;
+    RK_S32 i;
+
+    if (!meta)
+        return MPP_ERR_NULL_PTR;
+
+    for (i = 0; i < meta->count; i++) {
+        if (meta->node[i].key == key) {
+            node = &meta->node[i];
+            break;
+        }
+    }
+
+    if (!node) {
+        if (meta->count >= MPP_HOST_META_MAX) {
+            mpp_err_f("meta full, drop key %08x\n", key);
+            return MPP_NOK;
+        }
+        node = &meta->node[meta->count++];
+    }
+
+    node->key = key;
+    node->type = type;
+    switch (type) {
+    case META_TYPE_S32 :
+        node->val.s32 = *(const RK_S32 *)val;
+        break;
+    case META_TYPE_S64 :
+        node->val.s64 = *(const RK_S64 *)val;
+        break;
+    default :
+        node->val.ptr = *(void * const *)val;
+        break;
+    }
+    return MPP_OK;
+}
+
+MPP_RET mpp_host_meta_get(MppHostMeta *meta, MppMetaKey key, MppHostMetaType type, void *val)
+{
+    RK_S32 i;
+
+    if (!meta)
+        return MPP_ERR_NULL_PTR;
+
+    for (i = 0; i < meta->count; i++) {
+        MppHostMetaNode *node = &meta->node[i];
+
+        if (node->key != key || node->type != type)
+            continue;
+
+        switch (type) {
+        case META_TYPE_S32 :
+            *(RK_S32 *)val = node->val.s32;
+            break;
+        case META_TYPE_S64 :
+            *(RK_S64 *)val = node->val.s64;
+            break;
+        default :
+            *(void **)val = node->val.ptr;
+            break;
+        }
+
+        meta->node[i] = meta->node[--meta->count];
+        return MPP_OK;
+    }
+    return MPP_NOK;
+}
+
+MPP_RET mpp_meta_get_with_tag(MppMeta *meta, const char *tag, const char *caller)
+{
+    (void)tag;
+    (void)caller;
+
+    if (!meta)
+        return MPP_ERR_NULL_PTR;
+
+    *meta = calloc(1, sizeof(MppHostMeta));
+    return *meta ? MPP_OK : MPP_ERR_MALLOC;
+}
+
+MPP_RET mpp_meta_put(MppMeta meta)
+{
+    free(meta);
+    return MPP_OK;
+}
+
+RK_S32 mpp_meta_size(MppMeta meta)
+{
+    return meta ? ((MppHostMeta *)meta)->count : 0;
+}
+
+MPP_RET mpp_meta_set_s32(MppMeta meta, MppMetaKey key, RK_S32 val)
+{
+    return mpp_host_meta_set(meta, key, META_TYPE_S32, &val);
+}
+
+MPP_RET mpp_meta_set_s64(MppMeta meta, MppMetaKey key, RK_S64 val)
+{
+    return mpp_host_meta_set(meta, key, META_TYPE_S64, &val);
+}
+
+MPP_RET mpp_meta_set_ptr(MppMeta meta, MppMetaKey key, void *val)
+{
+    return mpp_host_meta_set(meta, key, META_TYPE_PTR, &val);
+}
+
+MPP_RET mpp_meta_get_s32(MppMeta meta, MppMetaKey key, RK_S32 *val)
+{
+    return mpp_host_meta_get(meta, key, META_TYPE_S32, val);
+}
+
+MPP_RET mpp_meta_get_s64(MppMeta meta, MppMetaKey key, RK_S64 *val)
+{
+    return mpp_host_meta_get(meta, key, META_TYPE_S64, val);
+}
+
+MPP_RET mpp_meta_get_ptr(MppMeta meta, MppMetaKey key, void **val)
+{
+    return mpp_host_meta_get(meta, key, META_TYPE_PTR, val);
+}
+
+MPP_RET mpp_meta_set_frame(MppMeta meta, MppMetaKey key, MppFrame frame)
+{
+    return mpp_meta_set_ptr(meta, key, frame);
+}
+
+MPP_RET mpp_meta_set_packet(MppMeta meta, MppMetaKey key, MppPacket packet)
+{
+    return mpp_meta_set_ptr(meta, key, packet);
+}
+
+MPP_RET mpp_meta_set_buffer(MppMeta meta, MppMetaKey key, MppBuffer buffer)
+{
+    return mpp_meta_set_ptr(meta, key, buffer);
+}
+
+MPP_RET mpp_meta_get_frame(MppMeta meta, MppMetaKey key, MppFrame *frame)
+{
+    return mpp_meta_get_ptr(meta, key, frame);
+}
+
+MPP_RET mpp_meta_get_packet(MppMeta meta, MppMetaKey key, MppPacket *packet)
+{
+    return mpp_meta_get_ptr(meta, key, packet);
+}
+
+MPP_RET mpp_meta_get_buffer(MppMeta meta, MppMetaKey key, MppBuffer *buffer)
+{
+    return mpp_meta_get_ptr(meta, key, buffer);
+}
+
+/* Task meta lives inline in the task */
+#define TASK_META(task) ((task) ? &((MppHostTask *)(task))->meta : NULL)
+
+MPP_RET mpp_task_meta_set_s32(MppTask task, MppMetaKey key, RK_S32 val)
+{
+    return mpp_host_meta_set(TASK_META(task), key, META_TYPE_S32, &val);
+}
+
+MPP_RET mpp_task_meta_set_s64(MppTask task, MppMetaKey key, RK_S64 val)
+{
+    return mpp_host_meta_set(TASK_META(task), key, META_TYPE_S64, &val);
+}
+
+MPP_RET mpp_task_meta_set_ptr(MppTask task, MppMetaKey key, void *val)
+{
+    return mpp_host_meta_set(TASK_META(task), key, META_TYPE_PTR, &val);
+}
+
+MPP_RET mpp_task_meta_set_frame(MppTask task, MppMetaKey key, MppFrame frame)
+{
+    return mpp_task_meta_set_ptr(task, key, frame);
+}
+
+MPP_RET mpp_task_meta_set_packet(MppTask task, MppMetaKey key, MppPacket packet)
+{
+    return mpp_task_meta_set_ptr(task, key, packet);
+}
+
+MPP_RET mpp_task_meta_set_buffer(MppTask task, MppMetaKey key, MppBuffer buffer)
+{
+    return mpp_task_meta_set_ptr(task, key, buffer);
+}
+
+MPP_RET mpp_task_meta_get_s32(MppTask task, MppMetaKey key, RK_S32 *val, RK_S32 default_val)
+{
+    MPP_RET ret = mpp_host_meta_get(TASK_META(task), key, META_TYPE_S32, val);
+    if (ret)
+        *val = default_val;
+    return ret;
+}
+
+MPP_RET mpp_task_meta_get_s64(MppTask task, MppMetaKey key, RK_S64 *val, RK_S64 default_val)
+{
+    MPP_RET ret = mpp_host_meta_get(TASK_META(task), key, META_TYPE_S64, val);
+    if (ret)
+        *val = default_val;
+    return ret;
+}
+
+MPP_RET mpp_task_meta_get_ptr(MppTask task, MppMetaKey key, void **val, void *default_val)
+{
+    MPP_RET ret = mpp_host_meta_get(TASK_META(task), key, META_TYPE_PTR, val);
+    if (ret)
+        *val = default_val;
+    return ret;
+}
+
+MPP_RET mpp_task_meta_get_frame(MppTask task, MppMetaKey key, MppFrame *frame)
+{
+    return mpp_task_meta_get_ptr(task, key, frame, NULL);
+}
+
+MPP_RET mpp_task_meta_get_packet(MppTask task, MppMetaKey key, MppPacket *packet)
+{
+    return mpp_task_meta_get_ptr(task, key, packet, NULL);
+}
+
+MPP_RET mpp_task_meta_get_buffer(MppTask task, MppMetaKey key, MppBuffer *buffer)
+{
+    return mpp_task_meta_get_ptr(task, key, buffer, NULL);
+}
+
+/* Frame */
+MPP_RET mpp_frame_init(MppFrame *frame)
+{
+    MppHostFrame *p;
+
+    if (!frame)
+        return MPP_ERR_NULL_PTR;
+
+    p = calloc(1, sizeof(MppHostFrame));
+    if (!p) {
+        *frame = NULL;
+        return MPP_ERR_MALLOC;
+    }
+
+    p->fmt = MPP_FMT_YUV420SP;
+    p->color_range = MPP_FRAME_RANGE_UNSPECIFIED;
+    p->colorspace = MPP_FRAME_SPC_UNSPECIFIED;
+    *frame = p;
+    return MPP_OK;
+}
+
+MPP_RET mpp_frame_deinit(MppFrame *frame)
+{
+    MppHostFrame *p;
+
+    if (!frame || !*frame)
+        return MPP_ERR_NULL_PTR;
+
+    p = (MppHostFrame *)*frame;
+    if (p->buffer)
+        mpp_buffer_put(p->buffer);
+    if (p->meta)
+        mpp_meta_put(p->meta);
+    free(p);
+    *frame = NULL;
+    return MPP_OK;
+}
+
+#define FRAME_ACCESSOR(type, field) \
+    type mpp_frame_get_##field(const MppFrame frame) \
+    { \
+        return frame ? ((MppHostFrame *)frame)->field : (type)0; \
+    } \
+    void mpp_frame_set_##field(MppFrame frame, type field) \
+    { \
+        if (frame) \
+            ((MppHostFrame *)frame)->field = field; \
+    }
+
+FRAME_ACCESSOR(RK_U32, width)
+FRAME_ACCESSOR(RK_U32, height)
+FRAME_ACCESSOR(RK_U32, hor_stride)
+FRAME_ACCESSOR(RK_U32, ver_stride)
+FRAME_ACCESSOR(RK_U32, offset_x)
+FRAME_ACCESSOR(RK_U32, offset_y)
+FRAME_ACCESSOR(RK_U32, mode)
+FRAME_ACCESSOR(RK_U32, discard)
+FRAME_ACCESSOR(RK_U32, viewid)
+FRAME_ACCESSOR(RK_U32, poc)
+FRAME_ACCESSOR(RK_S64, pts)
+FRAME_ACCESSOR(RK_S64, dts)
+FRAME_ACCESSOR(RK_U32, errinfo)
+FRAME_ACCESSOR(size_t, buf_size)
+FRAME_ACCESSOR(RK_U32, eos)
+FRAME_ACCESSOR(RK_U32, info_change)
+FRAME_ACCESSOR(MppFrameColorRange, color_range)
+FRAME_ACCESSOR(MppFrameColorSpace, colorspace)
+
+MppFrameFormat mpp_frame_get_fmt(MppFrame frame)
+{
+    return frame ? ((MppHostFrame *)frame)->fmt : MPP_FMT_BUTT;
+}
+
+void mpp_frame_set_fmt(MppFrame frame, MppFrameFormat fmt)
+{
+    if (frame)
+        ((MppHostFrame *)frame)->fmt = fmt;
+}
+
+MppBuffer mpp_frame_get_buffer(const MppFrame frame)
+{
+    return frame ? ((MppHostFrame *)frame)->buffer : NULL;
+}
+
+// The frame holds its own reference on the buffer
+void mpp_frame_set_buffer(MppFrame frame, MppBuffer buffer)
+{
+    MppHostFrame *p = (MppHostFrame *)frame;
+
+    if (!p || p->buffer == buffer)
+        return;
+
+    if (buffer)
+        mpp_buffer_inc_ref(buffer);
+    if (p->buffer)
+        mpp_buffer_put(p->buffer);
+    p->buffer = buffer;
+}
+
+MppMeta mpp_frame_get_meta(const MppFrame frame)
+{
+    MppHostFrame *p = (MppHostFrame *)frame;
+
+    if (!p)
+        return NULL;
+    if (!p->meta)
+        mpp_meta_get((MppMeta *)&p->meta);
+    return p->meta;
+}
+
+/* Packet */
+MPP_RET mpp_packet_new(MppPacket *packet)
+{
+    if (!packet)
+        return MPP_ERR_NULL_PTR;
+
+    *packet = calloc(1, sizeof(MppHostPacket));
+    return *packet ? MPP_OK : MPP_ERR_MALLOC;
+}
+
+MPP_RET mpp_packet_init(MppPacket *packet, void *data, size_t size)
+{
+    MppHostPacket *p;
+    MPP_RET ret = mpp_packet_new(packet);
+
+    if (ret)
+        return ret;
+
+    p = (MppHostPacket *)*packet;
+    p->data = p->pos = data;
+    p->size = p->length = size;
+    return MPP_OK;
+}
+
+MPP_RET mpp_packet_init_with_buffer(MppPacket *packet, MppBuffer buffer)
+{
+    MppHostPacket *p;
+    MPP_RET ret;
+
+    if (!buffer)
+        return MPP_ERR_NULL_PTR;
+
+    ret = mpp_packet_init(packet, mpp_buffer_get_ptr(buffer), mpp_buffer_get_size(buffer));
+    if (ret)
+        return ret;
+
+    p = (MppHostPacket *)*packet;
+    mpp_buffer_inc_ref(buffer);
+    p->buffer = buffer;
+    return MPP_OK;
+}
+
+MPP_RET mpp_packet_copy_init(MppPacket *packet, const MppPacket src)
+{
+    MppHostPacket *s = (MppHostPacket *)src;
+    MppHostPacket *p;
+    MPP_RET ret;
+
+    if (!packet || !s)
+        return MPP_ERR_NULL_PTR;
+
+    ret = mpp_packet_new(packet);
+    if (ret)
+        return ret;
+
+    p = (MppHostPacket *)*packet;
+    if (s->length) {
+        p->data = malloc(s->length);
+        if (!p->data) {
+            free(p);
+            *packet = NULL;
+            return MPP_ERR_MALLOC;
+        }
+        memcpy(p->data, s->pos, s->length);
+        p->own_data = 1;
+    }
+    p->pos = p->data;
+    p->size = p->length = s->length;
+    p->pts = s->pts;
+    p->dts = s->dts;
+    p->flag = s->flag;
+    return MPP_OK;
+}
+
+MPP_RET mpp_packet_deinit(MppPacket *packet)
+{
+    MppHostPacket *p;
+
+    if (!packet || !*packet)
+        return MPP_ERR_NULL_PTR;
+
+    p = (MppHostPacket *)*packet;
+    if (p->buffer)
+        mpp_buffer_put(p->buffer);
+    if (p->own_data)
+        free(p->data);
+    if (p->meta)
+        mpp_meta_put(p->meta);
+    free(p);
+    *packet = NULL;
+    return MPP_OK;
+}
+
+#define PACKET_ACCESSOR(type, field, name) \
+    type mpp_packet_get_##name(const MppPacket packet) \
+    { \
+        return packet ? ((MppHostPacket *)packet)->field : (type)0; \
+    } \
+    void mpp_packet_set_##name(MppPacket packet, type field) \
+    { \
+        if (packet) \
+            ((MppHostPacket *)packet)->field = field; \
+    }
+
+PACKET_ACCESSOR(void *, data, data)
+PACKET_ACCESSOR(size_t, size, size)
+PACKET_ACCESSOR(void *, pos, pos)
+PACKET_ACCESSOR(size_t, length, length)
+PACKET_ACCESSOR(RK_S64, pts, pts)
+PACKET_ACCESSOR(RK_S64, dts, dts)
+PACKET_ACCESSOR(RK_U32, flag, flag)
+
+MPP_RET mpp_packet_set_eos(MppPacket packet)
+{
+    if (!packet)
+        return MPP_ERR_NULL_PTR;
+    ((MppHostPacket *)packet)->flag |= MPP_PACKET_FLAG_EOS;
+    return MPP_OK;
+}
+
+MPP_RET mpp_packet_clr_eos(MppPacket packet)
+{
+    if (!packet)
+        return MPP_ERR_NULL_PTR;
+    ((MppHostPacket *)packet)->flag &= ~MPP_PACKET_FLAG_EOS;
+    return MPP_OK;
+}
+
+RK_U32 mpp_packet_get_eos(MppPacket packet)
+{
+    return packet ? !!(((MppHostPacket *)packet)->flag & MPP_PACKET_FLAG_EOS) : 0;
+}
+
+MPP_RET mpp_packet_set_extra_data(MppPacket packet)
+{
+    if (!packet)
+        return MPP_ERR_NULL_PTR;
+    ((MppHostPacket *)packet)->flag |= MPP_PACKET_FLAG_EXTRA_DATA;
+    return MPP_OK;
+}
+
+MppBuffer mpp_packet_get_buffer(const MppPacket packet)
+{
+    return packet ? ((MppHostPacket *)packet)->buffer : NULL;
+}
+
+void mpp_packet_set_buffer(MppPacket packet, MppBuffer buffer)
+{
+    MppHostPacket *p = (MppHostPacket *)packet;
+
+    if (!p || p->buffer == buffer)
+        return;
+
+    if (buffer)
+        mpp_buffer_inc_ref(buffer);
+    if (p->buffer)
+        mpp_buffer_put(p->buffer);
+    p->buffer = buffer;
+}
+
+MppMeta mpp_packet_get_meta(const MppPacket packet)
+{
+    MppHostPacket *p = (MppHostPacket *)packet;
+
+    if (!p)
+        return NULL;
+    if (!p->meta)
+        mpp_meta_get((MppMeta *)&p->meta);
+    return p->meta;
+}
+
+MPP_RET mpp_packet_reset(MppPacket packet)
+{
+    MppHostPacket *p = (MppHostPacket *)packet;
+
+    if (!p)
+        return MPP_ERR_NULL_PTR;
+
+    p->pos = p->data;
+    p->length = 0;
+    p->pts = 0;
+    p->dts = 0;
+    p->flag = 0;
+    return MPP_OK;
+}
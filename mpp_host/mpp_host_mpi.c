@@ -0,0 +1,1124 @@
+#define MODULE_TAG "mpp_host"
+
+#include "mpp_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+static RK_U32 env_get_u32(const char *name, RK_U32 default_val)
+{
+    const char *env = getenv(name);
+    return env ? (RK_U32)strtoul(env, NULL, 0) : default_val;
+}
+
+void mpp_host_config_load(MppHostConfig *cfg)
+{
+    cfg->width                = env_get_u32("mpp_host_width", 1920);
+    cfg->height               = env_get_u32("mpp_host_height", 1080);
+    cfg->stride_align         = env_get_u32("mpp_host_stride_align", 16);
+    cfg->dec_latency_us       = env_get_u32("mpp_host_dec_latency_us", 2000);
+    cfg->info_change_interval = env_get_u32("mpp_host_info_change_interval", 0);
+    cfg->input_tasks          = env_get_u32("mpp_host_input_tasks", 8);
+    cfg->frame_buffers        = env_get_u32("mpp_host_frame_buffers", 12);
+    cfg->reorder              = env_get_u32("mpp_host_reorder", 0);
+    cfg->fill                 = env_get_u32("mpp_host_fill", 1);
+    cfg->hw_cores             = env_get_u32("mpp_host_hw_cores", 2);
+    cfg->enc_latency_us       = env_get_u32("mpp_host_enc_latency_us", 4000);
+    cfg->enc_cores            = env_get_u32("mpp_host_enc_cores", 2);
+    cfg->jpeg_mpix            = env_get_u32("mpp_host_jpeg_mpix", 500);
+    cfg->jpeg_cores           = env_get_u32("mpp_host_jpeg_cores", 1);
+    cfg->bit_depth            = env_get_u32("mpp_host_bit_depth", 8);
+
+    // Stride alignment must be a power of two for MPP_HOST_ALIGN
+    if (!cfg->stride_align || (cfg->stride_align & (cfg->stride_align - 1)))
+        cfg->stride_align = 16;
+    if (!cfg->input_tasks)
+        cfg->input_tasks = 1;
+    if (cfg->frame_buffers < 2)
+        cfg->frame_buffers = 2;
+    if (cfg->reorder >= MPP_HOST_REORDER_MAX)
+        cfg->reorder = MPP_HOST_REORDER_MAX - 1;
+    if (!cfg->jpeg_mpix)
+        cfg->jpeg_mpix = 1;
+    if (cfg->bit_depth != 10)
+        cfg->bit_depth = 8;
+}
+
+void mpp_host_task_list_push(MppHostTaskList *list, MppHostTask *task)
+{
+    task->next = NULL;
+    if (list->tail)
+        list->tail->next = task;
+    else
+        list->head = task;
+    list->tail = task;
+    list->count++;
+}
+
+MppHostTask *mpp_host_task_list_pop(MppHostTaskList *list)
+{
+    MppHostTask *task = list->head;
+
+    if (!task)
+        return NULL;
+
+    list->head = task->next;
+    if (!list->head)
+        list->tail = NULL;
+    list->count--;
+    task->next = NULL;
+    return task;
+}
+
+/*
+ * Wait on ctx->cond until *list is non-empty. timeout follows MppPollType.
+ * Caller holds ctx->lock.
+ */
+static MPP_RET wait_list(MppHostCtx *p, MppHostTaskList *list, RK_S32 timeout)
+{
+    struct timespec deadline;
+
+    if (list->count)
+        return MPP_OK;
+    if (timeout == MPP_POLL_NON_BLOCK)
+        return MPP_NOK;
+
+    if (timeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    while (!list->count && !p->stop) {
+        if (timeout > 0) {
+            if (pthread_cond_timedwait(&p->cond, &p->lock, &deadline) == ETIMEDOUT)
+                return list->count ? MPP_OK : MPP_ERR_TIMEOUT;
+        } else {
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+    }
+    return list->count ? MPP_OK : MPP_NOK;
+}
+
+static void sleep_us(RK_U32 us)
+{
+    struct timespec ts;
+
+    if (!us)
+        return;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) && errno == EINTR)
+        ;
+}
+
+/*
+ * Decode cores shared by every context in the process, like the two VDPU381
+ * cores of the RK3588: more streams than cores queue for the hardware.
+ */
+static pthread_mutex_t hw_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hw_cond = PTHREAD_COND_INITIALIZER;
+static RK_U32 hw_busy;
+
+static void hw_core_acquire(MppHostCtx *p)
+{
+    if (!p->cfg.hw_cores)
+        return;
+
+    pthread_mutex_lock(&hw_lock);
+    while (hw_busy >= p->cfg.hw_cores)
+        pthread_cond_wait(&hw_cond, &hw_lock);
+    hw_busy++;
+    pthread_mutex_unlock(&hw_lock);
+}
+
+static void hw_core_release(MppHostCtx *p)
+{
+    if (!p->cfg.hw_cores)
+        return;
+
+    pthread_mutex_lock(&hw_lock);
+    hw_busy--;
+    pthread_cond_signal(&hw_cond);
+    pthread_mutex_unlock(&hw_lock);
+}
+
+// The single VDPU720 JPEG decoder, shared the same way
+static pthread_mutex_t jpeg_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jpeg_cond = PTHREAD_COND_INITIALIZER;
+static RK_U32 jpeg_busy;
+
+static void jpeg_core_acquire(MppHostCtx *p)
+{
+    if (!p->cfg.jpeg_cores)
+        return;
+
+    pthread_mutex_lock(&jpeg_lock);
+    while (jpeg_busy >= p->cfg.jpeg_cores)
+        pthread_cond_wait(&jpeg_cond, &jpeg_lock);
+    jpeg_busy++;
+    pthread_mutex_unlock(&jpeg_lock);
+}
+
+static void jpeg_core_release(MppHostCtx *p)
+{
+    if (!p->cfg.jpeg_cores)
+        return;
+
+    pthread_mutex_lock(&jpeg_lock);
+    jpeg_busy--;
+    pthread_cond_signal(&jpeg_cond);
+    pthread_mutex_unlock(&jpeg_lock);
+}
+
+// Release what an output task still carries, a frame or an encoded packet
+static void drop_output(MppHostTask *task)
+{
+    MppFrame frame = NULL;
+    MppPacket packet = NULL;
+
+    if (!mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, &frame) && frame)
+        mpp_frame_deinit(&frame);
+    if (!mpp_task_meta_get_packet(task, KEY_OUTPUT_PACKET, &packet) && packet)
+        mpp_packet_deinit(&packet);
+    task->meta.count = 0;
+}
+
+/* Output side: wrap a frame in an output task and publish it */
+static void output_frame(MppHostCtx *p, MppFrame frame)
+{
+    MppHostTask *task;
+
+    pthread_mutex_lock(&p->lock);
+    task = mpp_host_task_list_pop(&p->out_free);
+    if (!task) {
+        task = calloc(1, sizeof(MppHostTask));
+        if (!task) {
+            pthread_mutex_unlock(&p->lock);
+            mpp_err_f("drop frame, no memory for output task\n");
+            mpp_frame_deinit(&frame);
+            return;
+        }
+        task->port = MPP_PORT_OUTPUT;
+    }
+    mpp_task_meta_set_frame(task, KEY_OUTPUT_FRAME, frame);
+    mpp_host_task_list_push(&p->out_ready, task);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void update_size(MppHostCtx *p)
+{
+    RK_U32 width = p->cfg.width;
+    RK_U32 height = p->cfg.height;
+
+    // Alternate between the configured size and half of it
+    if (p->cfg.info_change_interval && (p->frame_index / p->cfg.info_change_interval) & 1) {
+        width = MPP_HOST_ALIGN(width / 2, 2);
+        height = MPP_HOST_ALIGN(height / 2, 2);
+    }
+    p->cur_width = width;
+    p->cur_height = height;
+}
+
+// FBC frame layout (TRM 5.3.8): 16-byte heads per 16x16 block, then payload
+#define HOST_FBC_BLOCK          16
+#define HOST_FBC_HEAD           16
+
+static void fbc_geometry(RK_U32 width, RK_U32 height, RK_U32 *blocks_x, RK_U32 *blocks_y,
+                         size_t *head_size)
+{
+    *blocks_x = MPP_HOST_ALIGN(width, 64) / HOST_FBC_BLOCK;
+    *blocks_y = (MPP_HOST_ALIGN(height, 64) + HOST_FBC_BLOCK) / HOST_FBC_BLOCK;
+    *head_size = MPP_HOST_ALIGN((size_t)*blocks_x * *blocks_y * HOST_FBC_HEAD, 4096);
+}
+
+// Tiled frames (TRM 5.3.5): 8x8 luma tiles, 8 bytes x 4 rows of chroma
+#define HOST_TILE               8
+
+static void fill_frame_info(MppHostCtx *p, MppFrame frame)
+{
+    RK_U32 hor_stride = MPP_HOST_ALIGN(p->cur_width, p->cfg.stride_align);
+    RK_U32 ver_stride = MPP_HOST_ALIGN(p->cur_height, p->cfg.stride_align);
+    MppFrameFormat fmt = MPP_FMT_YUV420SP;
+
+    mpp_frame_set_width(frame, p->cur_width);
+    mpp_frame_set_height(frame, p->cur_height);
+    if (MPP_FRAME_FMT_IS_FBC(p->out_fmt)) {
+        RK_U32 blocks_x, blocks_y;
+        size_t head_size;
+
+        // Room for heads and a payload that did not compress at all
+        fbc_geometry(p->cur_width, p->cur_height, &blocks_x, &blocks_y, &head_size);
+        hor_stride = MPP_HOST_ALIGN(p->cur_width, 64);
+        mpp_frame_set_hor_stride(frame, hor_stride);
+        mpp_frame_set_ver_stride(frame, ver_stride);
+        mpp_frame_set_buf_size(frame, head_size + (size_t)blocks_x * blocks_y *
+                               HOST_FBC_BLOCK * HOST_FBC_BLOCK * 3 / 2);
+        mpp_frame_set_fmt(frame, p->out_fmt);
+        return;
+    }
+    // Compact 10-bit: four samples in five bytes, the stride in bytes
+    if (p->cfg.bit_depth == 10) {
+        hor_stride = MPP_HOST_ALIGN((p->cur_width * 10 + 7) / 8, p->cfg.stride_align);
+        fmt = MPP_FMT_YUV420SP_10BIT;
+    }
+    if (MPP_FRAME_FMT_IS_TILE(p->out_fmt)) {
+        hor_stride = MPP_HOST_ALIGN(hor_stride, HOST_TILE);
+        ver_stride = MPP_HOST_ALIGN(ver_stride, HOST_TILE);
+        fmt |= MPP_FRAME_TILE_FLAG;
+    }
+    mpp_frame_set_hor_stride(frame, hor_stride);
+    mpp_frame_set_ver_stride(frame, ver_stride);
+    mpp_frame_set_buf_size(frame, (size_t)hor_stride * ver_stride * 3 / 2);
+    mpp_frame_set_fmt(frame, fmt);
+}
+
+/*
+ * Emit an info-change frame and park the decoder until the user answers
+ * with MPP_DEC_SET_INFO_CHANGE_READY. Returns non-zero when stopped.
+ */
+static RK_U32 info_change(MppHostCtx *p)
+{
+    MppFrame frame = NULL;
+    RK_U32 stop;
+
+    update_size(p);
+    if (mpp_frame_init(&frame))
+        return 1;
+    fill_frame_info(p, frame);
+    mpp_frame_set_info_change(frame, 1);
+
+    pthread_mutex_lock(&p->lock);
+    p->info_change_wait = 1;
+    pthread_mutex_unlock(&p->lock);
+
+    output_frame(p, frame);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->info_change_wait && !p->stop)
+        pthread_cond_wait(&p->cond, &p->lock);
+    stop = p->stop;
+    pthread_mutex_unlock(&p->lock);
+
+    if (stop)
+        return 1;
+
+    // Internal group: drop buffers of the old size, bound the pool for the new one
+    if (!p->ext_grp) {
+        if (!p->frm_grp)
+            mpp_buffer_group_get_internal(&p->frm_grp, MPP_BUFFER_TYPE_DRM);
+        else
+            mpp_buffer_group_clear(p->frm_grp);
+        mpp_buffer_group_limit_config(p->frm_grp, 0, p->cfg.frame_buffers);
+    }
+    return 0;
+}
+
+// NV12 test pattern: luma rows ramp with the frame index, chroma is neutral
+static void fill_pattern(MppFrame frame, RK_U32 index)
+{
+    RK_U8 *base = mpp_buffer_get_ptr(mpp_frame_get_buffer(frame));
+    RK_U32 hor_stride = mpp_frame_get_hor_stride(frame);
+    RK_U32 ver_stride = mpp_frame_get_ver_stride(frame);
+    RK_U32 y;
+
+    for (y = 0; y < ver_stride; y++)
+        memset(base + (size_t)y * hor_stride, (y + index) & 0xff, hor_stride);
+    memset(base + (size_t)hor_stride * ver_stride, 128, (size_t)hor_stride * ver_stride / 2);
+}
+
+// A row of equal 10-bit samples, compact: the same five bytes over and over
+static void pack10_row(RK_U8 *row, size_t len, RK_U32 sample)
+{
+    RK_U64 group = 0;
+    size_t i;
+
+    for (i = 0; i < 4; i++)
+        group |= (RK_U64)sample << (10 * i);
+    for (i = 0; i < len; i++)
+        row[i] = group >> (8 * (i % 5));
+}
+
+// Picture row y of a plane into place, linear or scattered over its tiles
+static void store_row(RK_U8 *plane, size_t stride, RK_U32 tile_h, RK_U32 y, const RK_U8 *row)
+{
+    RK_U8 *dst = plane + (size_t)(y - y % tile_h) * stride + (y % tile_h) * HOST_TILE;
+    size_t x;
+
+    for (x = 0; x < stride; x += HOST_TILE, dst += HOST_TILE * tile_h)
+        memcpy(dst, row + x, HOST_TILE);
+}
+
+/*
+ * The NV12 pattern for 10-bit or tiled frames: the same luma ramp, the low
+ * two bits of 10-bit samples varying by row so dithering shows. A tiled
+ * frame detiles to what a linear one holds.
+ */
+static void fill_pattern_ext(MppFrame frame, RK_U32 index)
+{
+    RK_U8 *base = mpp_buffer_get_ptr(mpp_frame_get_buffer(frame));
+    MppFrameFormat fmt = mpp_frame_get_fmt(frame);
+    RK_U32 hor_stride = mpp_frame_get_hor_stride(frame);
+    RK_U32 ver_stride = mpp_frame_get_ver_stride(frame);
+    RK_U32 depth10 = (fmt & MPP_FRAME_FMT_MASK) == MPP_FMT_YUV420SP_10BIT;
+    RK_U32 tiled = MPP_FRAME_FMT_IS_TILE(fmt) != 0;
+    RK_U8 *uv = base + (size_t)hor_stride * ver_stride;
+    RK_U8 *row = malloc(hor_stride);
+    RK_U32 y;
+
+    if (!row)
+        return;
+    for (y = 0; y < ver_stride; y++) {
+        RK_U32 v = (y + index) & 0xff;
+
+        if (depth10)
+            pack10_row(row, hor_stride, v << 2 | (y & 3));
+        else
+            memset(row, v, hor_stride);
+        if (tiled)
+            store_row(base, hor_stride, HOST_TILE, y, row);
+        else
+            memcpy(base + (size_t)y * hor_stride, row, hor_stride);
+    }
+    // Neutral chroma: 8-bit bytes are the same tiled or not
+    if (!depth10) {
+        memset(uv, 128, (size_t)hor_stride * ver_stride / 2);
+        free(row);
+        return;
+    }
+    pack10_row(row, hor_stride, 512);
+    for (y = 0; y < ver_stride / 2; y++) {
+        if (tiled)
+            store_row(uv, hor_stride, HOST_TILE / 2, y, row);
+        else
+            memcpy(uv + (size_t)y * hor_stride, row, hor_stride);
+    }
+    free(row);
+}
+
+/*
+ * FBC stand-in: heads with plausible sub-block sizes drawn from the seed, a
+ * share of solid blocks and of sub-blocks left uncompressed, payload blocks
+ * packed after the heads. The payload is only filled with mpp_host_fill.
+ */
+static void fill_fbc(MppHostCtx *p, MppFrame frame, RK_U32 seed)
+{
+    RK_U8 *base = mpp_buffer_get_ptr(mpp_frame_get_buffer(frame));
+    RK_U32 width = mpp_frame_get_width(frame);
+    RK_U32 height = mpp_frame_get_height(frame);
+    RK_U32 blocks_x, blocks_y, bx, by, i;
+    size_t head_size, pos;
+
+    fbc_geometry(width, height, &blocks_x, &blocks_y, &head_size);
+    memset(base, 0, head_size);
+    pos = head_size;
+    for (by = 0; by < blocks_y; by++) {
+        for (bx = 0; bx < blocks_x; bx++) {
+            RK_U8 *head = base + ((size_t)by * blocks_x + bx) * HOST_FBC_HEAD;
+            RK_U32 h = seed ^ (bx * 0x9e3779b1u) ^ (by * 0x85ebca6bu);
+            RK_U64 codes = 0;
+            RK_U32 hi = 0;
+            size_t bytes = 0;
+
+            h ^= h >> 15;
+            h *= 0x2c1b3c6du;
+            h ^= h >> 12;
+            // Padding blocks and about one in eight picture blocks are solid
+            if (bx * HOST_FBC_BLOCK >= width || by * HOST_FBC_BLOCK >= height || !(h & 7))
+                continue;
+
+            for (i = 0; i < 16; i++) {
+                RK_U32 code;
+
+                h = h * 1664525u + 1013904223u;
+                code = (h >> 24) % 16 ? 2 + (h >> 27) % 20 : 1;
+                bytes += code == 1 ? 24 : code;
+                // Sizes from bit 32 on: ten in the middle words, one across, five above
+                if (i < 10) {
+                    codes |= (RK_U64)code << (6 * i);
+                } else if (i == 10) {
+                    codes |= (RK_U64)(code & 15) << 60;
+                    hi = code >> 4;
+                } else {
+                    hi |= code << (6 * i - 64);
+                }
+            }
+            for (i = 0; i < 4; i++) {
+                head[i] = pos >> (8 * i);
+                head[12 + i] = hi >> (8 * i);
+            }
+            for (i = 0; i < 8; i++)
+                head[4 + i] = codes >> (8 * i);
+            if (p->cfg.fill) {
+                memset(base + pos, h & 0xff, bytes);
+                memset(base + pos + bytes, 0, MPP_HOST_ALIGN(bytes, 16) - bytes);
+            }
+            pos = MPP_HOST_ALIGN(pos + bytes, 16);
+        }
+    }
+}
+
+/*
+ * Pattern seed from the packet's last bytes, which are slice data: the same
+ * access unit gives the same picture on any context, wherever its decode
+ * started, like a real decoder.
+ */
+static RK_U32 packet_seed(MppPacket packet)
+{
+    const RK_U8 *data = mpp_packet_get_pos(packet);
+    size_t length = mpp_packet_get_length(packet);
+    size_t n = length < 16 ? length : 16;
+    RK_U32 seed = 0;
+    size_t i;
+
+    for (i = length - n; i < length; i++)
+        seed = seed * 31 + data[i];
+    return seed;
+}
+
+static MppFrame decode_one(MppHostCtx *p, MppPacket packet)
+{
+    MppFrame frame = NULL;
+    MppBuffer buffer = NULL;
+
+    if (mpp_frame_init(&frame))
+        return NULL;
+    fill_frame_info(p, frame);
+
+    if (mpp_host_buffer_get_block(p->frm_grp, &buffer, mpp_frame_get_buf_size(frame), &p->stop)) {
+        mpp_frame_deinit(&frame);
+        return NULL;
+    }
+
+    // Stand-in for hardware time: the CPU is free while the "VPU" works
+    hw_core_acquire(p);
+    sleep_us(p->cfg.dec_latency_us);
+    hw_core_release(p);
+
+    mpp_frame_set_buffer(frame, buffer);
+    mpp_buffer_put(buffer);
+
+    if (MPP_FRAME_FMT_IS_FBC(mpp_frame_get_fmt(frame)))
+        fill_fbc(p, frame, packet_seed(packet));
+    else if (p->cfg.fill && mpp_frame_get_fmt(frame) != MPP_FMT_YUV420SP)
+        fill_pattern_ext(frame, packet_seed(packet));
+    else if (p->cfg.fill)
+        fill_pattern(frame, packet_seed(packet));
+
+    mpp_frame_set_pts(frame, mpp_packet_get_pts(packet));
+    mpp_frame_set_dts(frame, mpp_packet_get_dts(packet));
+    mpp_frame_set_poc(frame, p->frame_index);
+    p->frame_index++;
+    return frame;
+}
+
+static void flush_reorder(MppHostCtx *p, RK_U32 keep, RK_U32 eos)
+{
+    while (p->reorder_count > keep) {
+        MppFrame frame = p->reorder[0];
+
+        p->reorder_count--;
+        memmove(&p->reorder[0], &p->reorder[1], p->reorder_count * sizeof(MppFrame));
+        if (eos && !p->reorder_count)
+            mpp_frame_set_eos(frame, 1);
+        output_frame(p, frame);
+    }
+}
+
+/*
+ * One frame per non-empty packet. The EOS flag rides on the last frame, or
+ * on an empty frame when nothing is left to flush. Input after EOS is
+ * dropped until reset.
+ */
+static void decode_packet(MppHostCtx *p, MppPacket packet)
+{
+    size_t length = mpp_packet_get_length(packet);
+    RK_U32 eos = mpp_packet_get_eos(packet);
+    RK_U32 gen = p->reset_gen;
+
+    if (p->eos_in)
+        return;
+
+    if (length) {
+        MppFrame frame;
+
+        if (!p->frame_index || (p->cfg.info_change_interval &&
+                                !(p->frame_index % p->cfg.info_change_interval))) {
+            if (info_change(p))
+                return;
+        }
+
+        frame = decode_one(p, packet);
+        if (!frame)
+            return;
+
+        // A reset while we were busy drops the frame
+        if (gen != p->reset_gen) {
+            mpp_frame_deinit(&frame);
+            return;
+        }
+        p->reorder[p->reorder_count++] = frame;
+    }
+
+    if (eos) {
+        p->eos_in = 1;
+        if (p->reorder_count) {
+            flush_reorder(p, 0, 1);
+        } else {
+            MppFrame frame = NULL;
+
+            if (!mpp_frame_init(&frame)) {
+                mpp_frame_set_eos(frame, 1);
+                output_frame(p, frame);
+            }
+        }
+    } else {
+        flush_reorder(p, p->immediate_out ? 0 : p->cfg.reorder, 0);
+    }
+}
+
+// Picture size from the first Huffman SOF; progressive is not decoded
+static MPP_RET jpeg_frame_size(const RK_U8 *data, size_t length, RK_U32 *width, RK_U32 *height)
+{
+    size_t pos = 2;
+
+    if (length < 4 || data[0] != 0xff || data[1] != 0xd8)
+        return MPP_NOK;
+
+    while (pos + 4 <= length) {
+        RK_U32 marker = data[pos + 1];
+
+        if (data[pos] != 0xff)
+            return MPP_NOK;
+        if (marker == 0xff) {
+            pos++;
+            continue;
+        }
+        if (marker == 0xc0 || marker == 0xc1) {
+            if (pos + 9 > length)
+                return MPP_NOK;
+            *height = data[pos + 5] << 8 | data[pos + 6];
+            *width = data[pos + 7] << 8 | data[pos + 8];
+            return *width && *height ? MPP_OK : MPP_NOK;
+        }
+        if (marker == 0xc2 || marker == 0xda || marker == 0xd9)
+            return MPP_NOK;
+        pos += 2 + (data[pos + 2] << 8 | data[pos + 3]);
+    }
+    return MPP_NOK;
+}
+
+/*
+ * MJPEG with the output frame on the input task: decode into the user's
+ * buffer and return that same frame, sized from the SOF. No info change;
+ * errinfo is set when the header is unusable or the buffer too small.
+ */
+static void decode_jpeg(MppHostCtx *p, MppPacket packet, MppFrame frame)
+{
+    MppBuffer buffer = mpp_frame_get_buffer(frame);
+    RK_U32 width = 0, height = 0;
+    RK_U32 hor_stride, ver_stride;
+    size_t size;
+
+    if (!packet || jpeg_frame_size(mpp_packet_get_pos(packet), mpp_packet_get_length(packet),
+                                   &width, &height)) {
+        mpp_frame_set_errinfo(frame, 1);
+        output_frame(p, frame);
+        return;
+    }
+
+    hor_stride = MPP_HOST_ALIGN(width, 16);
+    ver_stride = MPP_HOST_ALIGN(height, 16);
+    size = (size_t)hor_stride * ver_stride * 3 / 2;
+    mpp_frame_set_width(frame, width);
+    mpp_frame_set_height(frame, height);
+    mpp_frame_set_hor_stride(frame, hor_stride);
+    mpp_frame_set_ver_stride(frame, ver_stride);
+    mpp_frame_set_buf_size(frame, size);
+    mpp_frame_set_fmt(frame, MPP_FMT_YUV420SP);
+    mpp_frame_set_pts(frame, mpp_packet_get_pts(packet));
+    mpp_frame_set_dts(frame, mpp_packet_get_dts(packet));
+    if (!buffer || mpp_buffer_get_size(buffer) < size) {
+        mpp_frame_set_errinfo(frame, 1);
+        output_frame(p, frame);
+        return;
+    }
+
+    jpeg_core_acquire(p);
+    sleep_us((RK_U64)width * height / p->cfg.jpeg_mpix);
+    jpeg_core_release(p);
+
+    if (p->cfg.fill)
+        fill_pattern(frame, p->frame_index);
+    mpp_frame_set_poc(frame, p->frame_index);
+    p->frame_index++;
+    output_frame(p, frame);
+}
+
+static void *dec_thread(void *arg)
+{
+    MppHostCtx *p = (MppHostCtx *)arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->stop) {
+        MppHostTask *task = mpp_host_task_list_pop(&p->in_pending);
+        MppPacket packet = NULL;
+        MppFrame frame = NULL;
+
+        if (!task) {
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        mpp_task_meta_get_packet(task, KEY_INPUT_PACKET, &packet);
+        if (p->coding == MPP_VIDEO_CodingMJPEG &&
+            !mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, &frame) && frame)
+            decode_jpeg(p, packet, frame);
+        else if (packet)
+            decode_packet(p, packet);
+
+        pthread_mutex_lock(&p->lock);
+        if (task->internal) {
+            if (packet)
+                mpp_packet_deinit(&packet);
+            mpp_host_task_list_push(&p->in_internal, task);
+        } else {
+            // Hand the packet back with the task so the user can release it
+            mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, packet);
+            mpp_host_task_list_push(&p->in_idle, task);
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static MPP_RET host_poll(MppCtx ctx, MppPortType type, MppPollType timeout)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MPP_RET ret;
+
+    if (!p)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&p->lock);
+    if (type == MPP_PORT_INPUT)
+        ret = wait_list(p, &p->in_idle, timeout);
+    else if (type == MPP_PORT_OUTPUT)
+        ret = wait_list(p, &p->out_ready, timeout);
+    else
+        ret = MPP_ERR_VALUE;
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+static MPP_RET host_dequeue(MppCtx ctx, MppPortType type, MppTask *task)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MppHostTask *t = NULL;
+
+    if (!p || !task)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&p->lock);
+    if (type == MPP_PORT_INPUT)
+        t = mpp_host_task_list_pop(&p->in_idle);
+    else if (type == MPP_PORT_OUTPUT)
+        t = mpp_host_task_list_pop(&p->out_ready);
+    pthread_mutex_unlock(&p->lock);
+
+    *task = t;
+    return t ? MPP_OK : MPP_NOK;
+}
+
+static MPP_RET host_enqueue(MppCtx ctx, MppPortType type, MppTask task)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MppHostTask *t = (MppHostTask *)task;
+
+    if (!p || !t)
+        return MPP_ERR_NULL_PTR;
+
+    if (t->port != type) {
+        mpp_err_f("task %p belongs to port %d, not %d\n", task, t->port, type);
+        return MPP_ERR_VALUE;
+    }
+
+    if (type == MPP_PORT_OUTPUT) {
+        // A frame or packet the user never took is released with the task
+        drop_output(t);
+
+        pthread_mutex_lock(&p->lock);
+        mpp_host_task_list_push(&p->out_free, t);
+        pthread_mutex_unlock(&p->lock);
+        return MPP_OK;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    mpp_host_task_list_push(&p->in_pending, t);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return MPP_OK;
+}
+
+/* Simple flow on top of the same queues, packets are copied */
+static MPP_RET host_decode_put_packet(MppCtx ctx, MppPacket packet)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MppHostTask *task;
+    MppPacket copy = NULL;
+    MPP_RET ret;
+
+    if (!p || !packet)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&p->lock);
+    ret = wait_list(p, &p->in_internal, p->input_timeout);
+    task = ret ? NULL : mpp_host_task_list_pop(&p->in_internal);
+    pthread_mutex_unlock(&p->lock);
+
+    if (!task)
+        return MPP_ERR_BUFFER_FULL;
+
+    ret = mpp_packet_copy_init(&copy, packet);
+    if (ret) {
+        pthread_mutex_lock(&p->lock);
+        mpp_host_task_list_push(&p->in_internal, task);
+        pthread_mutex_unlock(&p->lock);
+        return ret;
+    }
+
+    // The whole packet is consumed
+    mpp_packet_set_length(packet, 0);
+
+    mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, copy);
+    pthread_mutex_lock(&p->lock);
+    mpp_host_task_list_push(&p->in_pending, task);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return MPP_OK;
+}
+
+static MPP_RET host_decode_get_frame(MppCtx ctx, MppFrame *frame)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MppHostTask *task = NULL;
+    MPP_RET ret;
+
+    if (!p || !frame)
+        return MPP_ERR_NULL_PTR;
+
+    *frame = NULL;
+    pthread_mutex_lock(&p->lock);
+    ret = wait_list(p, &p->out_ready, p->output_timeout);
+    if (!ret)
+        task = mpp_host_task_list_pop(&p->out_ready);
+    pthread_mutex_unlock(&p->lock);
+
+    // Nothing ready is not an error in non-block mode
+    if (!task)
+        return ret == MPP_ERR_TIMEOUT ? ret : MPP_OK;
+
+    mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, frame);
+    task->meta.count = 0;
+
+    pthread_mutex_lock(&p->lock);
+    mpp_host_task_list_push(&p->out_free, task);
+    pthread_mutex_unlock(&p->lock);
+    return MPP_OK;
+}
+
+static MPP_RET host_decode(MppCtx ctx, MppPacket packet, MppFrame *frame)
+{
+    MPP_RET ret = host_decode_put_packet(ctx, packet);
+
+    if (ret)
+        return ret;
+    return host_decode_get_frame(ctx, frame);
+}
+
+static MPP_RET host_reset(MppCtx ctx)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MppHostTask *task;
+
+    if (!p)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&p->lock);
+    while ((task = mpp_host_task_list_pop(&p->in_pending))) {
+        MppPacket packet = NULL;
+
+        mpp_task_meta_get_packet(task, KEY_INPUT_PACKET, &packet);
+        if (task->internal) {
+            if (packet)
+                mpp_packet_deinit(&packet);
+            mpp_host_task_list_push(&p->in_internal, task);
+        } else {
+            mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, packet);
+            mpp_host_task_list_push(&p->in_idle, task);
+        }
+    }
+
+    while ((task = mpp_host_task_list_pop(&p->out_ready))) {
+        drop_output(task);
+        mpp_host_task_list_push(&p->out_free, task);
+    }
+
+    while (p->reorder_count)
+        mpp_frame_deinit(&p->reorder[--p->reorder_count]);
+
+    p->reset_gen++;
+    p->eos_in = 0;
+    p->info_change_wait = 0;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return MPP_OK;
+}
+
+static MPP_RET host_control(MppCtx ctx, MpiCmd cmd, MppParam param)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MPP_RET ret = MPP_OK;
+
+    if (!p)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&p->lock);
+    if ((cmd & CMD_CTX_ID_MASK) == CMD_CTX_ID_ENC) {
+        ret = p->type == MPP_CTX_ENC ? mpp_host_enc_control(p, cmd, param) : MPP_ERR_VALUE;
+        pthread_mutex_unlock(&p->lock);
+        return ret;
+    }
+
+    switch (cmd) {
+    case MPP_DEC_SET_INFO_CHANGE_READY : {
+        p->info_change_wait = 0;
+        pthread_cond_broadcast(&p->cond);
+    } break;
+    case MPP_DEC_SET_EXT_BUF_GROUP : {
+        if (p->frm_grp && !p->ext_grp)
+            mpp_buffer_group_put(p->frm_grp);
+        p->frm_grp = param;
+        p->ext_grp = (param != NULL);
+    } break;
+    case MPP_SET_INPUT_BLOCK :
+    case MPP_SET_INPUT_TIMEOUT : {
+        p->input_timeout = param ? *(MppPollType *)param : MPP_POLL_NON_BLOCK;
+    } break;
+    case MPP_SET_OUTPUT_BLOCK :
+    case MPP_SET_OUTPUT_TIMEOUT : {
+        p->output_timeout = param ? *(MppPollType *)param : MPP_POLL_NON_BLOCK;
+    } break;
+    case MPP_SET_OUTPUT_BLOCK_TIMEOUT : {
+        p->output_timeout = param ? (MppPollType)*(RK_S64 *)param : MPP_POLL_NON_BLOCK;
+    } break;
+    case MPP_DEC_SET_IMMEDIATE_OUT : {
+        p->immediate_out = param ? *(RK_U32 *)param : 0;
+    } break;
+    case MPP_DEC_SET_OUTPUT_FORMAT : {
+        p->out_fmt = param ? *(MppFrameFormat *)param : MPP_FMT_YUV420SP;
+    } break;
+    case MPP_DEC_GET_STREAM_COUNT : {
+        if (param)
+            *(RK_S32 *)param = p->in_pending.count;
+    } break;
+    default : {
+        mpp_logd("control %08x ignored by the host stand-in\n", cmd);
+    } break;
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+static MppApi host_api = {
+    .size               = sizeof(MppApi),
+    .version            = 0,
+    .decode             = host_decode,
+    .decode_put_packet  = host_decode_put_packet,
+    .decode_get_frame   = host_decode_get_frame,
+    .poll               = host_poll,
+    .dequeue            = host_dequeue,
+    .enqueue            = host_enqueue,
+    .reset              = host_reset,
+    .control            = host_control,
+};
+
+MPP_RET mpp_create(MppCtx *ctx, MppApi **mpi)
+{
+    MppHostCtx *p;
+
+    if (!ctx || !mpi)
+        return MPP_ERR_NULL_PTR;
+
+    p = calloc(1, sizeof(MppHostCtx));
+    if (!p) {
+        *ctx = NULL;
+        return MPP_ERR_MALLOC;
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    p->input_timeout = MPP_POLL_NON_BLOCK;
+    p->output_timeout = MPP_POLL_NON_BLOCK;
+
+    *ctx = p;
+    *mpi = &host_api;
+    return MPP_OK;
+}
+
+MPP_RET mpp_init(MppCtx ctx, MppCtxType type, MppCodingType coding)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    RK_U32 i;
+
+    if (!p)
+        return MPP_ERR_NULL_PTR;
+
+    if (mpp_check_support_format(type, coding)) {
+        mpp_err("type %d coding %x not supported by the host stand-in\n", type, coding);
+        return MPP_NOK;
+    }
+
+    p->type = type;
+    p->coding = coding;
+    mpp_host_config_load(&p->cfg);
+
+    p->in_tasks = calloc(p->cfg.input_tasks * 2, sizeof(MppHostTask));
+    if (!p->in_tasks)
+        return MPP_ERR_MALLOC;
+
+    // First half is the user's input port, second half backs decode_put_packet
+    for (i = 0; i < p->cfg.input_tasks; i++) {
+        MppHostTask *user = &p->in_tasks[i];
+        MppHostTask *internal = &p->in_tasks[p->cfg.input_tasks + i];
+
+        user->port = MPP_PORT_INPUT;
+        mpp_host_task_list_push(&p->in_idle, user);
+        internal->port = MPP_PORT_INPUT;
+        internal->internal = 1;
+        mpp_host_task_list_push(&p->in_internal, internal);
+    }
+
+    if (type == MPP_CTX_ENC) {
+        pthread_mutex_lock(&p->lock);
+        mpp_host_enc_defaults(p);
+        pthread_mutex_unlock(&p->lock);
+
+        if (pthread_create(&p->thread, NULL, mpp_host_enc_thread, p)) {
+            mpp_err("failed to start encode thread\n");
+            return MPP_NOK;
+        }
+        p->thread_started = 1;
+
+        mpp_log("host stand-in encoder latency %u us input tasks %u hw cores %u\n",
+                p->cfg.enc_latency_us, p->cfg.input_tasks, p->cfg.enc_cores);
+        return MPP_OK;
+    }
+
+    if (pthread_create(&p->thread, NULL, dec_thread, p)) {
+        mpp_err("failed to start decode thread\n");
+        return MPP_NOK;
+    }
+    p->thread_started = 1;
+
+    if (coding == MPP_VIDEO_CodingMJPEG)
+        mpp_log("host stand-in jpeg %u MPix/s input tasks %u jpeg cores %u\n",
+                p->cfg.jpeg_mpix, p->cfg.input_tasks, p->cfg.jpeg_cores);
+    else
+        mpp_log("host stand-in %ux%u latency %u us input tasks %u hw cores %u\n",
+                p->cfg.width, p->cfg.height, p->cfg.dec_latency_us, p->cfg.input_tasks,
+                p->cfg.hw_cores);
+    return MPP_OK;
+}
+
+static void free_task_list(MppHostTaskList *list)
+{
+    MppHostTask *task;
+
+    while ((task = mpp_host_task_list_pop(list))) {
+        drop_output(task);
+        free(task);
+    }
+}
+
+MPP_RET mpp_destroy(MppCtx ctx)
+{
+    MppHostCtx *p = (MppHostCtx *)ctx;
+    MppHostTask *task;
+
+    if (!p)
+        return MPP_ERR_NULL_PTR;
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+
+    // The decoder may be parked waiting for a frame buffer
+    if (p->frm_grp)
+        mpp_host_group_wake(p->frm_grp);
+
+    if (p->thread_started)
+        pthread_join(p->thread, NULL);
+
+    // Copied packets of queued simple-flow tasks are ours to free
+    while ((task = mpp_host_task_list_pop(&p->in_pending))) {
+        MppPacket packet = NULL;
+
+        if (task->internal && !mpp_task_meta_get_packet(task, KEY_INPUT_PACKET, &packet) && packet)
+            mpp_packet_deinit(&packet);
+    }
+
+    while (p->reorder_count)
+        mpp_frame_deinit(&p->reorder[--p->reorder_count]);
+
+    free_task_list(&p->out_ready);
+    free_task_list(&p->out_free);
+    free(p->in_tasks);
+
+    if (p->frm_grp && !p->ext_grp)
+        mpp_buffer_group_put(p->frm_grp);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    free(p);
+    return MPP_OK;
+}
+
+MPP_RET mpp_check_support_format(MppCtxType type, MppCodingType coding)
+{
+    if (type == MPP_CTX_ENC)
+        return coding == MPP_VIDEO_CodingAVC || coding == MPP_VIDEO_CodingHEVC ? MPP_OK : MPP_NOK;
+    if (type != MPP_CTX_DEC)
+        return MPP_NOK;
+
+    switch (coding) {
+    case MPP_VIDEO_CodingAVC :
+    case MPP_VIDEO_CodingHEVC :
+    case MPP_VIDEO_CodingVP9 :
+    case MPP_VIDEO_CodingAV1 :
+    case MPP_VIDEO_CodingMJPEG :
+    case MPP_VIDEO_CodingVP8 :
+    case MPP_VIDEO_CodingMPEG2 :
+    case MPP_VIDEO_CodingMPEG4 :
+    case MPP_VIDEO_CodingH263 :
+        return MPP_OK;
+    default :
+        return MPP_NOK;
+    }
+}
+
+void mpp_show_support_format(void)
+{
+    mpp_log("host stand-in decoder: AVC HEVC VP9 AV1 MJPEG VP8 MPEG2 MPEG4 H263\n");
+    mpp_log("host stand-in encoder: AVC HEVC\n");
+}
@@ -0,0 +1,150 @@
+#ifndef MPP_FRAME_H
+#define MPP_FRAME_H
+
+#include "mpp_buffer.h"
+
+/* mpp_frame_get_mode */
+#define MPP_FRAME_FLAG_FRAME            (0x00000000)
+#define MPP_FRAME_FLAG_TOP_FIELD        (0x00000001)
+#define MPP_FRAME_FLAG_BOT_FIELD        (0x00000002)
+#define MPP_FRAME_FLAG_PAIRED_FIELD     (MPP_FRAME_FLAG_TOP_FIELD | MPP_FRAME_FLAG_BOT_FIELD)
+#define MPP_FRAME_FLAG_FIELD_ORDER_MASK (0x0000000C)
+
+typedef enum {
+    MPP_FRAME_RANGE_UNSPECIFIED = 0,
+    MPP_FRAME_RANGE_MPEG        = 1,    ///< limited range
+    MPP_FRAME_RANGE_JPEG        = 2,    ///< full range
+    MPP_FRAME_RANGE_NB,
+} MppFrameColorRange;
+
+typedef enum {
+    MPP_FRAME_SPC_RGB           = 0,
+    MPP_FRAME_SPC_BT709         = 1,
+    MPP_FRAME_SPC_UNSPECIFIED   = 2,
+    MPP_FRAME_SPC_RESERVED      = 3,
+    MPP_FRAME_SPC_FCC           = 4,
+    MPP_FRAME_SPC_BT470BG       = 5,
+    MPP_FRAME_SPC_SMPTE170M     = 6,
+    MPP_FRAME_SPC_SMPTE240M     = 7,
+    MPP_FRAME_SPC_YCOCG         = 8,
+    MPP_FRAME_SPC_BT2020_NCL    = 9,
+    MPP_FRAME_SPC_BT2020_CL     = 10,
+    MPP_FRAME_SPC_NB,
+} MppFrameColorSpace;
+
+#define MPP_FRAME_FMT_MASK          (0x000fffff)
+#define MPP_FRAME_FMT_COLOR_MASK    (0x000f0000)
+#define MPP_FRAME_FMT_YUV           (0x00000000)
+#define MPP_FRAME_FMT_RGB           (0x00010000)
+
+#define MPP_FRAME_FBC_MASK          (0x00f00000)
+#define MPP_FRAME_FBC_NONE          (0x00000000)
+#define MPP_FRAME_FBC_AFBC_V1       (0x00100000)
+#define MPP_FRAME_FBC_AFBC_V2       (0x00200000)
+
+#define MPP_FRAME_FMT_LE_MASK       (0x01000000)
+#define MPP_FRAME_TILE_FLAG         (0x02000000)
+
+#define MPP_FRAME_FMT_IS_YUV(fmt)   (((fmt & MPP_FRAME_FMT_COLOR_MASK) == MPP_FRAME_FMT_YUV) && \
+                                     ((fmt & MPP_FRAME_FMT_MASK) < MPP_FMT_YUV_BUTT))
+#define MPP_FRAME_FMT_IS_RGB(fmt)   (((fmt & MPP_FRAME_FMT_COLOR_MASK) == MPP_FRAME_FMT_RGB) && \
+                                     ((fmt & MPP_FRAME_FMT_MASK) < MPP_FMT_RGB_BUTT))
+#define MPP_FRAME_FMT_IS_FBC(fmt)   (fmt & MPP_FRAME_FBC_MASK)
+#define MPP_FRAME_FMT_IS_TILE(fmt)  (fmt & MPP_FRAME_TILE_FLAG)
+
+typedef enum {
+    MPP_FMT_YUV420SP        = (MPP_FRAME_FMT_YUV + 0),  /* YYYY... UV... (NV12)     */
+    MPP_FMT_YUV420SP_10BIT  = (MPP_FRAME_FMT_YUV + 1),  /* compact 10-bit NV12      */
+    MPP_FMT_YUV422SP        = (MPP_FRAME_FMT_YUV + 2),  /* YYYY... UVUV... (NV16)   */
+    MPP_FMT_YUV422SP_10BIT  = (MPP_FRAME_FMT_YUV + 3),
+    MPP_FMT_YUV420P         = (MPP_FRAME_FMT_YUV + 4),  /* YYYY... U...V...  (I420) */
+    MPP_FMT_YUV420SP_VU     = (MPP_FRAME_FMT_YUV + 5),  /* YYYY... VUVUVU... (NV21) */
+    MPP_FMT_YUV422P         = (MPP_FRAME_FMT_YUV + 6),
+    MPP_FMT_YUV422SP_VU     = (MPP_FRAME_FMT_YUV + 7),
+    MPP_FMT_YUV422_YUYV     = (MPP_FRAME_FMT_YUV + 8),
+    MPP_FMT_YUV422_YVYU     = (MPP_FRAME_FMT_YUV + 9),
+    MPP_FMT_YUV422_UYVY     = (MPP_FRAME_FMT_YUV + 10),
+    MPP_FMT_YUV422_VYUY     = (MPP_FRAME_FMT_YUV + 11),
+    MPP_FMT_YUV400          = (MPP_FRAME_FMT_YUV + 12),
+    MPP_FMT_YUV440SP        = (MPP_FRAME_FMT_YUV + 13),
+    MPP_FMT_YUV411SP        = (MPP_FRAME_FMT_YUV + 14),
+    MPP_FMT_YUV444SP        = (MPP_FRAME_FMT_YUV + 15),
+    MPP_FMT_YUV444P         = (MPP_FRAME_FMT_YUV + 16),
+    MPP_FMT_YUV_BUTT,
+
+    MPP_FMT_RGB565          = (MPP_FRAME_FMT_RGB + 0),
+    MPP_FMT_BGR565          = (MPP_FRAME_FMT_RGB + 1),
+    MPP_FMT_RGB555          = (MPP_FRAME_FMT_RGB + 2),
+    MPP_FMT_BGR555          = (MPP_FRAME_FMT_RGB + 3),
+    MPP_FMT_RGB444          = (MPP_FRAME_FMT_RGB + 4),
+    MPP_FMT_BGR444          = (MPP_FRAME_FMT_RGB + 5),
+    MPP_FMT_RGB888          = (MPP_FRAME_FMT_RGB + 6),
+    MPP_FMT_BGR888          = (MPP_FRAME_FMT_RGB + 7),
+    MPP_FMT_RGB101010       = (MPP_FRAME_FMT_RGB + 8),
+    MPP_FMT_BGR101010       = (MPP_FRAME_FMT_RGB + 9),
+    MPP_FMT_ARGB8888        = (MPP_FRAME_FMT_RGB + 10),
+    MPP_FMT_ABGR8888        = (MPP_FRAME_FMT_RGB + 11),
+    MPP_FMT_BGRA8888        = (MPP_FRAME_FMT_RGB + 12),
+    MPP_FMT_RGBA8888        = (MPP_FRAME_FMT_RGB + 13),
+    MPP_FMT_RGB_BUTT,
+
+    MPP_FMT_BUTT,
+} MppFrameFormat;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+MPP_RET mpp_frame_init(MppFrame *frame);
+MPP_RET mpp_frame_deinit(MppFrame *frame);
+
+RK_U32  mpp_frame_get_width(const MppFrame frame);
+void    mpp_frame_set_width(MppFrame frame, RK_U32 width);
+RK_U32  mpp_frame_get_height(const MppFrame frame);
+void    mpp_frame_set_height(MppFrame frame, RK_U32 height);
+RK_U32  mpp_frame_get_hor_stride(const MppFrame frame);
+void    mpp_frame_set_hor_stride(MppFrame frame, RK_U32 hor_stride);
+RK_U32  mpp_frame_get_ver_stride(const MppFrame frame);
+void    mpp_frame_set_ver_stride(MppFrame frame, RK_U32 ver_stride);
+RK_U32  mpp_frame_get_offset_x(const MppFrame frame);
+void    mpp_frame_set_offset_x(MppFrame frame, RK_U32 offset_x);
+RK_U32  mpp_frame_get_offset_y(const MppFrame frame);
+void    mpp_frame_set_offset_y(MppFrame frame, RK_U32 offset_y);
+RK_U32  mpp_frame_get_mode(const MppFrame frame);
+void    mpp_frame_set_mode(MppFrame frame, RK_U32 mode);
+RK_U32  mpp_frame_get_discard(const MppFrame frame);
+void    mpp_frame_set_discard(MppFrame frame, RK_U32 discard);
+RK_U32  mpp_frame_get_viewid(const MppFrame frame);
+void    mpp_frame_set_viewid(MppFrame frame, RK_U32 viewid);
+RK_U32  mpp_frame_get_poc(const MppFrame frame);
+void    mpp_frame_set_poc(MppFrame frame, RK_U32 poc);
+RK_S64  mpp_frame_get_pts(const MppFrame frame);
+void    mpp_frame_set_pts(MppFrame frame, RK_S64 pts);
+RK_S64  mpp_frame_get_dts(const MppFrame frame);
+void    mpp_frame_set_dts(MppFrame frame, RK_S64 dts);
+RK_U32  mpp_frame_get_errinfo(const MppFrame frame);
+void    mpp_frame_set_errinfo(MppFrame frame, RK_U32 errinfo);
+size_t  mpp_frame_get_buf_size(const MppFrame frame);
+void    mpp_frame_set_buf_size(MppFrame frame, size_t buf_size);
+
+RK_U32  mpp_frame_get_eos(const MppFrame frame);
+void    mpp_frame_set_eos(MppFrame frame, RK_U32 eos);
+RK_U32  mpp_frame_get_info_change(const MppFrame frame);
+void    mpp_frame_set_info_change(MppFrame frame, RK_U32 info_change);
+
+MppFrameFormat mpp_frame_get_fmt(MppFrame frame);
+void    mpp_frame_set_fmt(MppFrame frame, MppFrameFormat fmt);
+MppFrameColorRange mpp_frame_get_color_range(const MppFrame frame);
+void    mpp_frame_set_color_range(MppFrame frame, MppFrameColorRange color_range);
+MppFrameColorSpace mpp_frame_get_colorspace(const MppFrame frame);
+void    mpp_frame_set_colorspace(MppFrame frame, MppFrameColorSpace colorspace);
+
+MppBuffer mpp_frame_get_buffer(const MppFrame frame);
+void    mpp_frame_set_buffer(MppFrame frame, MppBuffer buffer);
+MppMeta mpp_frame_get_meta(const MppFrame frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPP_FRAME_H */
@@ -0,0 +1,43 @@
+#ifndef MPP_LOG_H
+#define MPP_LOG_H
+
+#define MPP_LOG_UNKNOWN         0
+#define MPP_LOG_FATAL           1
+#define MPP_LOG_ERROR           2
+#define MPP_LOG_WARN            3
+#define MPP_LOG_INFO            4
+#define MPP_LOG_DEBUG           5
+#define MPP_LOG_VERBOSE         6
+#define MPP_LOG_SILENT          7
+
+#ifndef MODULE_TAG
+#define MODULE_TAG              NULL
+#endif
+
+#define mpp_logf(fmt, ...)  _mpp_log_l(MPP_LOG_FATAL,   MODULE_TAG, fmt, NULL, ## __VA_ARGS__)
+#define mpp_loge(fmt, ...)  _mpp_log_l(MPP_LOG_ERROR,   MODULE_TAG, fmt, NULL, ## __VA_ARGS__)
+#define mpp_logw(fmt, ...)  _mpp_log_l(MPP_LOG_WARN,    MODULE_TAG, fmt, NULL, ## __VA_ARGS__)
+#define mpp_logi(fmt, ...)  _mpp_log_l(MPP_LOG_INFO,    MODULE_TAG, fmt, NULL, ## __VA_ARGS__)
+#define mpp_logd(fmt, ...)  _mpp_log_l(MPP_LOG_DEBUG,   MODULE_TAG, fmt, NULL, ## __VA_ARGS__)
+#define mpp_logv(fmt, ...)  _mpp_log_l(MPP_LOG_VERBOSE, MODULE_TAG, fmt, NULL, ## __VA_ARGS__)
+
+#define mpp_log(fmt, ...)   mpp_logi(fmt, ## __VA_ARGS__)
+#define mpp_err(fmt, ...)   mpp_loge(fmt, ## __VA_ARGS__)
+
+#define mpp_log_f(fmt, ...) _mpp_log_l(MPP_LOG_INFO,  MODULE_TAG, fmt, __FUNCTION__, ## __VA_ARGS__)
+#define mpp_err_f(fmt, ...) _mpp_log_l(MPP_LOG_ERROR, MODULE_TAG, fmt, __FUNCTION__, ## __VA_ARGS__)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void _mpp_log_l(int level, const char *tag, const char *fmt, const char *func, ...);
+
+void mpp_set_log_level(int level);
+int mpp_get_log_level(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPP_LOG_H */
@@ -0,0 +1,70 @@
+#ifndef MPP_META_H
+#define MPP_META_H
+
+#include "rk_type.h"
+#include "mpp_err.h"
+#include "mpp_frame.h"
+#include "mpp_packet.h"
+
+#define FOURCC_META(a, b, c, d) ((RK_U32)(a) << 24  | \
+                                ((RK_U32)(b) << 16) | \
+                                ((RK_U32)(c) << 8)  | \
+                                ((RK_U32)(d) << 0))
+
+typedef enum MppMetaKey_e {
+    /* data flow key */
+    KEY_INPUT_FRAME             = FOURCC_META('i', 'f', 'r', 'm'),
+    KEY_INPUT_PACKET            = FOURCC_META('i', 'p', 'k', 't'),
+    KEY_OUTPUT_FRAME            = FOURCC_META('o', 'f', 'r', 'm'),
+    KEY_OUTPUT_PACKET           = FOURCC_META('o', 'p', 'k', 't'),
+    KEY_MOTION_INFO             = FOURCC_META('m', 'v', 'i', 'f'),
+    KEY_HDR_INFO                = FOURCC_META('h', 'd', 'r', ' '),
+    KEY_HDR_META_OFFSET         = FOURCC_META('h', 'd', 'r', 'o'),
+    KEY_HDR_META_SIZE           = FOURCC_META('h', 'd', 'r', 'l'),
+
+    /* flow control key */
+    KEY_INPUT_BLOCK             = FOURCC_META('i', 'b', 'l', 'k'),
+    KEY_OUTPUT_BLOCK            = FOURCC_META('o', 'b', 'l', 'k'),
+    KEY_INPUT_IDR_REQ           = FOURCC_META('i', 'i', 'd', 'r'),
+    KEY_OUTPUT_INTRA            = FOURCC_META('o', 'i', 'd', 'r'),
+
+    /* output information */
+    KEY_TEMPORAL_ID             = FOURCC_META('t', 'l', 'i', 'd'),
+    KEY_LONG_REF_IDX            = FOURCC_META('l', 't', 'i', 'd'),
+    KEY_ENC_AVERAGE_QP          = FOURCC_META('a', 'v', 'g', 'q'),
+    KEY_ENC_START_QP            = FOURCC_META('s', 't', 'q', 'p'),
+
+    /* user data */
+    KEY_USER_DATA               = FOURCC_META('u', 's', 'r', 'd'),
+    KEY_USER_DATAS              = FOURCC_META('u', 'r', 'd', 's'),
+} MppMetaKey;
+
+#define mpp_meta_get(meta) mpp_meta_get_with_tag(meta, MODULE_TAG, __FUNCTION__)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+MPP_RET mpp_meta_get_with_tag(MppMeta *meta, const char *tag, const char *caller);
+MPP_RET mpp_meta_put(MppMeta meta);
+RK_S32  mpp_meta_size(MppMeta meta);
+
+MPP_RET mpp_meta_set_s32(MppMeta meta, MppMetaKey key, RK_S32 val);
+MPP_RET mpp_meta_set_s64(MppMeta meta, MppMetaKey key, RK_S64 val);
+MPP_RET mpp_meta_set_ptr(MppMeta meta, MppMetaKey key, void  *val);
+MPP_RET mpp_meta_get_s32(MppMeta meta, MppMetaKey key, RK_S32 *val);
+MPP_RET mpp_meta_get_s64(MppMeta meta, MppMetaKey key, RK_S64 *val);
+MPP_RET mpp_meta_get_ptr(MppMeta meta, MppMetaKey key, void  **val);
+
+MPP_RET mpp_meta_set_frame (MppMeta meta, MppMetaKey key, MppFrame  frame);
+MPP_RET mpp_meta_set_packet(MppMeta meta, MppMetaKey key, MppPacket packet);
+MPP_RET mpp_meta_set_buffer(MppMeta meta, MppMetaKey key, MppBuffer buffer);
+MPP_RET mpp_meta_get_frame (MppMeta meta, MppMetaKey key, MppFrame  *frame);
+MPP_RET mpp_meta_get_packet(MppMeta meta, MppMetaKey key, MppPacket *packet);
+MPP_RET mpp_meta_get_buffer(MppMeta meta, MppMetaKey key, MppBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPP_META_H */
@@ -0,0 +1,54 @@
+#ifndef MPP_PACKET_H
+#define MPP_PACKET_H
+
+#include "mpp_buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * mpp_packet_init only wraps the caller's memory: the caller keeps it alive
+ * until the packet is released by the decoder.
+ * mpp_packet_copy_init makes a packet that owns a private copy of src.
+ * mpp_packet_init_with_buffer references an MppBuffer for the packet lifetime.
+ */
+MPP_RET mpp_packet_new(MppPacket *packet);
+MPP_RET mpp_packet_init(MppPacket *packet, void *data, size_t size);
+MPP_RET mpp_packet_init_with_buffer(MppPacket *packet, MppBuffer buffer);
+MPP_RET mpp_packet_copy_init(MppPacket *packet, const MppPacket src);
+MPP_RET mpp_packet_deinit(MppPacket *packet);
+
+void    mpp_packet_set_data(MppPacket packet, void *data);
+void   *mpp_packet_get_data(const MppPacket packet);
+void    mpp_packet_set_size(MppPacket packet, size_t size);
+size_t  mpp_packet_get_size(const MppPacket packet);
+void    mpp_packet_set_pos(MppPacket packet, void *pos);
+void   *mpp_packet_get_pos(const MppPacket packet);
+void    mpp_packet_set_length(MppPacket packet, size_t size);
+size_t  mpp_packet_get_length(const MppPacket packet);
+
+void    mpp_packet_set_pts(MppPacket packet, RK_S64 pts);
+RK_S64  mpp_packet_get_pts(const MppPacket packet);
+void    mpp_packet_set_dts(MppPacket packet, RK_S64 dts);
+RK_S64  mpp_packet_get_dts(const MppPacket packet);
+
+void    mpp_packet_set_flag(MppPacket packet, RK_U32 flag);
+RK_U32  mpp_packet_get_flag(const MppPacket packet);
+
+MPP_RET mpp_packet_set_eos(MppPacket packet);
+MPP_RET mpp_packet_clr_eos(MppPacket packet);
+RK_U32  mpp_packet_get_eos(MppPacket packet);
+MPP_RET mpp_packet_set_extra_data(MppPacket packet);
+
+void    mpp_packet_set_buffer(MppPacket packet, MppBuffer buffer);
+MppBuffer mpp_packet_get_buffer(const MppPacket packet);
+MppMeta mpp_packet_get_meta(const MppPacket packet);
+
+MPP_RET mpp_packet_reset(MppPacket packet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPP_PACKET_H */
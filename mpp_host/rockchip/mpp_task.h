@@ -0,0 +1,58 @@
+#ifndef MPP_TASK_H
+#define MPP_TASK_H
+
+#include "mpp_meta.h"
+
+/*
+ * Advanced task flow: the user polls a port for a task, dequeues it, fills or
+ * reads its meta and enqueues it back. On the decoder the input port carries
+ * KEY_INPUT_PACKET tasks, the output port carries KEY_OUTPUT_FRAME tasks.
+ * An input task is handed back to the user only once the decoder has
+ * finished with its packet and still carries that KEY_INPUT_PACKET, so the
+ * packet and its memory may be reused or released after the dequeue.
+ * The encoder mirrors it: KEY_INPUT_FRAME tasks in, KEY_OUTPUT_PACKET tasks
+ * out, and an input task comes back once the frame has been read.
+ */
+typedef enum {
+    MPP_PORT_INPUT,
+    MPP_PORT_OUTPUT,
+    MPP_PORT_BUTT,
+} MppPortType;
+
+/*
+ * MPP_POLL_BLOCK      - wait until a task is ready
+ * MPP_POLL_NON_BLOCK  - return MPP_NOK at once when no task is ready
+ * positive value      - timeout in ms, MPP_ERR_TIMEOUT on expiry
+ */
+typedef enum {
+    MPP_POLL_BUTT       = -2,
+    MPP_POLL_BLOCK      = -1,
+    MPP_POLL_NON_BLOCK  = 0,
+    MPP_POLL_MAX        = 8000,
+} MppPollType;
+
+#define MPP_POLL_TIMEOUT_MAX    (MPP_POLL_MAX)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+MPP_RET mpp_task_meta_set_s32(MppTask task, MppMetaKey key, RK_S32 val);
+MPP_RET mpp_task_meta_set_s64(MppTask task, MppMetaKey key, RK_S64 val);
+MPP_RET mpp_task_meta_set_ptr(MppTask task, MppMetaKey key, void  *val);
+MPP_RET mpp_task_meta_set_frame (MppTask task, MppMetaKey key, MppFrame  frame);
+MPP_RET mpp_task_meta_set_packet(MppTask task, MppMetaKey key, MppPacket packet);
+MPP_RET mpp_task_meta_set_buffer(MppTask task, MppMetaKey key, MppBuffer buffer);
+
+MPP_RET mpp_task_meta_get_s32(MppTask task, MppMetaKey key, RK_S32 *val, RK_S32 default_val);
+MPP_RET mpp_task_meta_get_s64(MppTask task, MppMetaKey key, RK_S64 *val, RK_S64 default_val);
+MPP_RET mpp_task_meta_get_ptr(MppTask task, MppMetaKey key, void  **val, void  *default_val);
+MPP_RET mpp_task_meta_get_frame (MppTask task, MppMetaKey key, MppFrame  *frame);
+MPP_RET mpp_task_meta_get_packet(MppTask task, MppMetaKey key, MppPacket *packet);
+MPP_RET mpp_task_meta_get_buffer(MppTask task, MppMetaKey key, MppBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPP_TASK_H */
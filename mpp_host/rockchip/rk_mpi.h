@@ -0,0 +1,51 @@
+#ifndef RK_MPI_H
+#define RK_MPI_H
+
+#include "rk_mpi_cmd.h"
+#include "mpp_task.h"
+
+typedef struct MppApi_t {
+    RK_U32  size;
+    RK_U32  version;
+
+    /* simple data flow */
+    MPP_RET (*decode)(MppCtx ctx, MppPacket packet, MppFrame *frame);
+    MPP_RET (*decode_put_packet)(MppCtx ctx, MppPacket packet);
+    MPP_RET (*decode_get_frame)(MppCtx ctx, MppFrame *frame);
+
+    MPP_RET (*encode)(MppCtx ctx, MppFrame frame, MppPacket *packet);
+    MPP_RET (*encode_put_frame)(MppCtx ctx, MppFrame frame);
+    MPP_RET (*encode_get_packet)(MppCtx ctx, MppPacket *packet);
+
+    MPP_RET (*isp)(MppCtx ctx, MppFrame dst, MppFrame src);
+    MPP_RET (*isp_put_frame)(MppCtx ctx, MppFrame frame);
+    MPP_RET (*isp_get_frame)(MppCtx ctx, MppFrame *frame);
+
+    /* advanced data flow */
+    MPP_RET (*poll)(MppCtx ctx, MppPortType type, MppPollType timeout);
+    MPP_RET (*dequeue)(MppCtx ctx, MppPortType type, MppTask *task);
+    MPP_RET (*enqueue)(MppCtx ctx, MppPortType type, MppTask task);
+
+    MPP_RET (*reset)(MppCtx ctx);
+    MPP_RET (*control)(MppCtx ctx, MpiCmd cmd, MppParam param);
+
+    RK_U32 reserv[16];
+} MppApi;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+MPP_RET mpp_create(MppCtx *ctx, MppApi **mpi);
+MPP_RET mpp_init(MppCtx ctx, MppCtxType type, MppCodingType coding);
+MPP_RET mpp_destroy(MppCtx ctx);
+
+/* coding type support check: MPP_OK when the stand-in can "decode" it */
+MPP_RET mpp_check_support_format(MppCtxType type, MppCodingType coding);
+void    mpp_show_support_format(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RK_MPI_H */
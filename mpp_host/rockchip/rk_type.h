@@ -0,0 +1,66 @@
+#ifndef RK_TYPE_H
+#define RK_TYPE_H
+
+/*
+ * Host-side stand-in for the Rockchip MPP public headers.
+ * Only the subset used by this repository is provided.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef MODULE_TAG
+#define MODULE_TAG              NULL
+#endif
+
+typedef unsigned char           RK_U8;
+typedef unsigned short          RK_U16;
+typedef unsigned int            RK_U32;
+typedef unsigned long long      RK_U64;
+
+typedef signed char             RK_S8;
+typedef signed short            RK_S16;
+typedef signed int              RK_S32;
+typedef signed long long        RK_S64;
+
+typedef void                   *MppCtx;
+typedef void                   *MppParam;
+typedef void                   *MppFrame;
+typedef void                   *MppPacket;
+typedef void                   *MppBuffer;
+typedef void                   *MppBufferGroup;
+typedef void                   *MppTask;
+typedef void                   *MppMeta;
+
+typedef enum {
+    MPP_CTX_DEC,
+    MPP_CTX_ENC,
+    MPP_CTX_ISP,
+    MPP_CTX_BUTT,
+} MppCtxType;
+
+typedef enum {
+    MPP_VIDEO_CodingUnused,
+    MPP_VIDEO_CodingAutoDetect,
+    MPP_VIDEO_CodingMPEG2,
+    MPP_VIDEO_CodingH263,
+    MPP_VIDEO_CodingMPEG4,
+    MPP_VIDEO_CodingWMV,
+    MPP_VIDEO_CodingRV,
+    MPP_VIDEO_CodingAVC,
+    MPP_VIDEO_CodingMJPEG,
+    MPP_VIDEO_CodingVP8,
+    MPP_VIDEO_CodingVP9,
+    MPP_VIDEO_CodingVC1 = 0x01000000,
+    MPP_VIDEO_CodingFLV1,
+    MPP_VIDEO_CodingDIVX3,
+    MPP_VIDEO_CodingVP6,
+    MPP_VIDEO_CodingHEVC,
+    MPP_VIDEO_CodingAVSPLUS,
+    MPP_VIDEO_CodingAVS,
+    MPP_VIDEO_CodingAVS2,
+    MPP_VIDEO_CodingAV1,
+    MPP_VIDEO_CodingMax = 0x7FFFFFFF
+} MppCodingType;
+
+#endif /* RK_TYPE_H */
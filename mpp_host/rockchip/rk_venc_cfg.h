@@ -0,0 +1,32 @@
+#ifndef RK_VENC_CFG_H
+#define RK_VENC_CFG_H
+
+#include "rk_type.h"
+#include "mpp_err.h"
+#include "rk_venc_cmd.h"
+
+/*
+ * Encoder configuration by name, "prep:width", "rc:mode" and so on, read
+ * with MPP_ENC_GET_CFG and applied with MPP_ENC_SET_CFG. The stand-in
+ * knows the prep, rc, codec and h264 names used in this repository; any
+ * other name fails like a typo does in the real library.
+ */
+typedef void *MppEncCfg;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+MPP_RET mpp_enc_cfg_init(MppEncCfg *cfg);
+MPP_RET mpp_enc_cfg_deinit(MppEncCfg cfg);
+
+MPP_RET mpp_enc_cfg_set_s32(MppEncCfg cfg, const char *name, RK_S32 val);
+MPP_RET mpp_enc_cfg_set_u32(MppEncCfg cfg, const char *name, RK_U32 val);
+MPP_RET mpp_enc_cfg_get_s32(MppEncCfg cfg, const char *name, RK_S32 *val);
+MPP_RET mpp_enc_cfg_get_u32(MppEncCfg cfg, const char *name, RK_U32 *val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RK_VENC_CFG_H */
@@ -0,0 +1,20 @@
+#ifndef RK_VENC_CMD_H
+#define RK_VENC_CMD_H
+
+#include "rk_type.h"
+
+/*
+ * Rate control modes as in the real header. The stand-in encoder sizes
+ * packets by them: CBR holds every frame to the target, VBR lets frame
+ * size follow picture complexity between bps_min and bps_max, FixQP
+ * derives size from the QP alone.
+ */
+typedef enum MppEncRcMode_e {
+    MPP_ENC_RC_MODE_VBR,
+    MPP_ENC_RC_MODE_CBR,
+    MPP_ENC_RC_MODE_FIXQP,
+    MPP_ENC_RC_MODE_AVBR,
+    MPP_ENC_RC_MODE_BUTT
+} MppEncRcMode;
+
+#endif /* RK_VENC_CMD_H */
@@ -0,0 +1,503 @@
+#define _GNU_SOURCE
+#include "neon_latency.h"
+#include <sys/ioctl.h>
+#include <dirent.h>
+
+/*
+ * Microbenchmark generator
+ *
+ * Each catalogue entry is an instruction template T(d) that reads and writes
+ * register v<d>. The latency variant repeats T(0) so every instruction waits
+ * for the previous one; the throughput variant interleaves T(0)..T(11) so
+ * INDEP_CHAINS streams can issue back to back. Both loops execute
+ * INSNS_PER_ITER instructions under test per iteration.
+ *
+ * v28-v31 hold constant operands (table registers, multiplicands) and are
+ * never written by a template.
+ */
+
+#define REP4(x)         x x x x
+#define REP24(x)        REP4(x) REP4(x) REP4(x) REP4(x) REP4(x) REP4(x)
+#define INDEP12(T)      T(0) T(1) T(2) T(3) T(4) T(5) T(6) T(7) T(8) T(9) T(10) T(11)
+#define INDEP16(T)      INDEP12(T) T(12) T(13) T(14) T(15)
+
+#define V_CLEAR(d)      "movi v" #d ".16b, #0\n\t"
+
+#define NEON_INIT \
+    "movi v28.16b, #1\n\t" \
+    "movi v29.16b, #2\n\t" \
+    "movi v30.16b, #0\n\t" \
+    "movi v31.16b, #0\n\t" \
+    INDEP16(V_CLEAR)
+
+#define NEON_CLOBBERS \
+    "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", \
+    "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", \
+    "v28", "v29", "v30", "v31"
+
+#define DEFINE_BENCH_FN(fn, body) \
+static void fn(uint64_t iters, void *buf) \
+{ \
+    __asm__ volatile( \
+        NEON_INIT \
+        "1:\n\t" \
+        body \
+        "subs %x0, %x0, #1\n\t" \
+        "b.ne 1b\n\t" \
+        : "+r"(iters), "+r"(buf) \
+        : \
+        : "memory", "cc", NEON_CLOBBERS); \
+}
+
+// Same template for the dependent chain and the independent streams
+#define DEFINE_NEON_OP(id, T) \
+    DEFINE_BENCH_FN(lat_##id, REP24(T(0))) \
+    DEFINE_BENCH_FN(tput_##id, INDEP12(T) INDEP12(T))
+
+// Separate latency template (e.g. load-to-use chains)
+#define DEFINE_NEON_OP2(id, TL, TT) \
+    DEFINE_BENCH_FN(lat_##id, REP24(TL(0))) \
+    DEFINE_BENCH_FN(tput_##id, INDEP12(TT) INDEP12(TT))
+
+// Throughput only (stores, multi-register loads)
+#define DEFINE_NEON_TPUT(id, T) \
+    DEFINE_BENCH_FN(tput_##id, INDEP12(T) INDEP12(T))
+
+#define NEON_OP_ENTRY(id, name, cls)    { name, cls, lat_##id, tput_##id }
+#define NEON_TPUT_ENTRY(id, name, cls)  { name, cls, NULL, tput_##id }
+
+// Arithmetic
+#define T_ADD_4S(d)     "add v" #d ".4s, v" #d ".4s, v31.4s\n\t"
+#define T_MUL_4S(d)     "mul v" #d ".4s, v" #d ".4s, v31.4s\n\t"
+#define T_SQDMULH_8H(d) "sqdmulh v" #d ".8h, v" #d ".8h, v31.8h\n\t"
+#define T_ADDP_4S(d)    "addp v" #d ".4s, v" #d ".4s, v31.4s\n\t"
+#define T_ADDV_4S(d)    "addv s" #d ", v" #d ".4s\n\t"
+#define T_CNT_16B(d)    "cnt v" #d ".16b, v" #d ".16b\n\t"
+#define T_FADD_4S(d)    "fadd v" #d ".4s, v" #d ".4s, v31.4s\n\t"
+#define T_FMUL_4S(d)    "fmul v" #d ".4s, v" #d ".4s, v31.4s\n\t"
+
+// Multiply-accumulate, chained through the accumulator
+#define T_MLA_4S(d)     "mla v" #d ".4s, v30.4s, v31.4s\n\t"
+#define T_FMLA_4S(d)    "fmla v" #d ".4s, v30.4s, v31.4s\n\t"
+#define T_FMLA_2D(d)    "fmla v" #d ".2d, v30.2d, v31.2d\n\t"
+#define T_FMLA_ELEM(d)  "fmla v" #d ".4s, v30.4s, v31.s[0]\n\t"
+#define T_SDOT_4S(d)    ".arch_extension dotprod\n\t" \
+                        "sdot v" #d ".4s, v30.16b, v31.16b\n\t"
+
+// Widening
+#define T_SMULL_4S(d)   "smull v" #d ".4s, v" #d ".4h, v31.4h\n\t"
+#define T_UMULL2_8H(d)  "umull2 v" #d ".8h, v" #d ".16b, v31.16b\n\t"
+#define T_SMLAL_4S(d)   "smlal v" #d ".4s, v30.4h, v31.4h\n\t"
+#define T_SADDL_4S(d)   "saddl v" #d ".4s, v" #d ".4h, v31.4h\n\t"
+#define T_UADDW_8H(d)   "uaddw v" #d ".8h, v" #d ".8h, v31.8b\n\t"
+#define T_USHLL_8H(d)   "ushll v" #d ".8h, v" #d ".8b, #0\n\t"
+
+// Narrowing
+#define T_XTN_4H(d)     "xtn v" #d ".4h, v" #d ".4s\n\t"
+#define T_SQXTUN_8B(d)  "sqxtun v" #d ".8b, v" #d ".8h\n\t"
+#define T_SHRN_4H(d)    "shrn v" #d ".4h, v" #d ".4s, #8\n\t"
+#define T_SQRSHRUN(d)   "sqrshrun v" #d ".8b, v" #d ".8h, #6\n\t"
+
+// Permutes
+#define T_ZIP1_16B(d)   "zip1 v" #d ".16b, v" #d ".16b, v31.16b\n\t"
+#define T_UZP1_8H(d)    "uzp1 v" #d ".8h, v" #d ".8h, v31.8h\n\t"
+#define T_TRN1_4S(d)    "trn1 v" #d ".4s, v" #d ".4s, v31.4s\n\t"
+#define T_EXT_16B(d)    "ext v" #d ".16b, v" #d ".16b, v31.16b, #3\n\t"
+#define T_REV64_16B(d)  "rev64 v" #d ".16b, v" #d ".16b\n\t"
+#define T_DUP_ELEM(d)   "dup v" #d ".4s, v" #d ".s[1]\n\t"
+
+// Table lookups, chained through the index register
+#define T_TBL1(d)       "tbl v" #d ".16b, {v30.16b}, v" #d ".16b\n\t"
+#define T_TBL2(d)       "tbl v" #d ".16b, {v28.16b, v29.16b}, v" #d ".16b\n\t"
+#define T_TBL4(d)       "tbl v" #d ".16b, {v28.16b, v29.16b, v30.16b, v31.16b}, v" #d ".16b\n\t"
+#define T_TBX1(d)       "tbx v" #d ".16b, {v30.16b}, v31.16b\n\t"
+
+// Loads. The latency chain feeds the loaded value back as the next address,
+// so it reports ldr + fmov load-to-use latency.
+#define T_LDR_Q_LAT(d)  "ldr q" #d ", [%x1]\n\t" \
+                        "fmov %x1, d" #d "\n\t"
+#define T_LDR_Q(d)      "ldr q" #d ", [%x1]\n\t"
+#define T_LD1R_4S(d)    "ld1r {v" #d ".4s}, [%x1]\n\t"
+#define T_LD1X4(d)      "ld1 {v0.16b, v1.16b, v2.16b, v3.16b}, [%x1]\n\t"
+#define T_LD2_8H(d)     "ld2 {v4.8h, v5.8h}, [%x1]\n\t"
+#define T_LD3_16B(d)    "ld3 {v8.16b, v9.16b, v10.16b}, [%x1]\n\t"
+#define T_LD4_16B(d)    "ld4 {v12.16b, v13.16b, v14.16b, v15.16b}, [%x1]\n\t"
+
+// Stores
+#define T_STR_Q(d)      "str q" #d ", [%x1]\n\t"
+#define T_ST1X4(d)      "st1 {v0.16b, v1.16b, v2.16b, v3.16b}, [%x1]\n\t"
+#define T_ST2_8H(d)     "st2 {v4.8h, v5.8h}, [%x1]\n\t"
+#define T_ST3_16B(d)    "st3 {v8.16b, v9.16b, v10.16b}, [%x1]\n\t"
+#define T_ST4_16B(d)    "st4 {v12.16b, v13.16b, v14.16b, v15.16b}, [%x1]\n\t"
+
+DEFINE_NEON_OP(add_4s, T_ADD_4S)
+DEFINE_NEON_OP(mul_4s, T_MUL_4S)
+DEFINE_NEON_OP(sqdmulh_8h, T_SQDMULH_8H)
+DEFINE_NEON_OP(addp_4s, T_ADDP_4S)
+DEFINE_NEON_OP(addv_4s, T_ADDV_4S)
+DEFINE_NEON_OP(cnt_16b, T_CNT_16B)
+DEFINE_NEON_OP(fadd_4s, T_FADD_4S)
+DEFINE_NEON_OP(fmul_4s, T_FMUL_4S)
+
+DEFINE_NEON_OP(mla_4s, T_MLA_4S)
+DEFINE_NEON_OP(fmla_4s, T_FMLA_4S)
+DEFINE_NEON_OP(fmla_2d, T_FMLA_2D)
+DEFINE_NEON_OP(fmla_elem, T_FMLA_ELEM)
+DEFINE_NEON_OP(sdot_4s, T_SDOT_4S)
+
+DEFINE_NEON_OP(smull_4s, T_SMULL_4S)
+DEFINE_NEON_OP(umull2_8h, T_UMULL2_8H)
+DEFINE_NEON_OP(smlal_4s, T_SMLAL_4S)
+DEFINE_NEON_OP(saddl_4s, T_SADDL_4S)
+DEFINE_NEON_OP(uaddw_8h, T_UADDW_8H)
+DEFINE_NEON_OP(ushll_8h, T_USHLL_8H)
+
+DEFINE_NEON_OP(xtn_4h, T_XTN_4H)
+DEFINE_NEON_OP(sqxtun_8b, T_SQXTUN_8B)
+DEFINE_NEON_OP(shrn_4h, T_SHRN_4H)
+DEFINE_NEON_OP(sqrshrun_8b, T_SQRSHRUN)
+
+DEFINE_NEON_OP(zip1_16b, T_ZIP1_16B)
+DEFINE_NEON_OP(uzp1_8h, T_UZP1_8H)
+DEFINE_NEON_OP(trn1_4s, T_TRN1_4S)
+DEFINE_NEON_OP(ext_16b, T_EXT_16B)
+DEFINE_NEON_OP(rev64_16b, T_REV64_16B)
+DEFINE_NEON_OP(dup_elem, T_DUP_ELEM)
+
+DEFINE_NEON_OP(tbl1, T_TBL1)
+DEFINE_NEON_OP(tbl2, T_TBL2)
+DEFINE_NEON_OP(tbl4, T_TBL4)
+DEFINE_NEON_OP(tbx1, T_TBX1)
+
+DEFINE_NEON_OP2(ldr_q, T_LDR_Q_LAT, T_LDR_Q)
+DEFINE_NEON_TPUT(ld1r_4s, T_LD1R_4S)
+DEFINE_NEON_TPUT(ld1x4, T_LD1X4)
+DEFINE_NEON_TPUT(ld2_8h, T_LD2_8H)
+DEFINE_NEON_TPUT(ld3_16b, T_LD3_16B)
+DEFINE_NEON_TPUT(ld4_16b, T_LD4_16B)
+
+DEFINE_NEON_TPUT(str_q, T_STR_Q)
+DEFINE_NEON_TPUT(st1x4, T_ST1X4)
+DEFINE_NEON_TPUT(st2_8h, T_ST2_8H)
+DEFINE_NEON_TPUT(st3_16b, T_ST3_16B)
+DEFINE_NEON_TPUT(st4_16b, T_ST4_16B)
+
+static const neon_op_t catalogue[] = {
+    NEON_OP_ENTRY(add_4s,       "add .4s",              OP_CLASS_ARITH),
+    NEON_OP_ENTRY(mul_4s,       "mul .4s",              OP_CLASS_ARITH),
+    NEON_OP_ENTRY(sqdmulh_8h,   "sqdmulh .8h",          OP_CLASS_ARITH),
+    NEON_OP_ENTRY(addp_4s,      "addp .4s",             OP_CLASS_ARITH),
+    NEON_OP_ENTRY(addv_4s,      "addv .4s",             OP_CLASS_ARITH),
+    NEON_OP_ENTRY(cnt_16b,      "cnt .16b",             OP_CLASS_ARITH),
+    NEON_OP_ENTRY(fadd_4s,      "fadd .4s",             OP_CLASS_ARITH),
+    NEON_OP_ENTRY(fmul_4s,      "fmul .4s",             OP_CLASS_ARITH),
+
+    NEON_OP_ENTRY(mla_4s,       "mla .4s (acc)",        OP_CLASS_FMA),
+    NEON_OP_ENTRY(fmla_4s,      "fmla .4s (acc)",       OP_CLASS_FMA),
+    NEON_OP_ENTRY(fmla_2d,      "fmla .2d (acc)",       OP_CLASS_FMA),
+    NEON_OP_ENTRY(fmla_elem,    "fmla .4s by elem",     OP_CLASS_FMA),
+    NEON_OP_ENTRY(sdot_4s,      "sdot .4s (acc)",       OP_CLASS_FMA),
+
+    NEON_OP_ENTRY(smull_4s,     "smull .4s",            OP_CLASS_WIDEN),
+    NEON_OP_ENTRY(umull2_8h,    "umull2 .8h",           OP_CLASS_WIDEN),
+    NEON_OP_ENTRY(smlal_4s,     "smlal .4s (acc)",      OP_CLASS_WIDEN),
+    NEON_OP_ENTRY(saddl_4s,     "saddl .4s",            OP_CLASS_WIDEN),
+    NEON_OP_ENTRY(uaddw_8h,     "uaddw .8h",            OP_CLASS_WIDEN),
+    NEON_OP_ENTRY(ushll_8h,     "ushll .8h (uxtl)",     OP_CLASS_WIDEN),
+
+    NEON_OP_ENTRY(xtn_4h,       "xtn .4h",              OP_CLASS_NARROW),
+    NEON_OP_ENTRY(sqxtun_8b,    "sqxtun .8b",           OP_CLASS_NARROW),
+    NEON_OP_ENTRY(shrn_4h,      "shrn .4h",             OP_CLASS_NARROW),
+    NEON_OP_ENTRY(sqrshrun_8b,  "sqrshrun .8b",         OP_CLASS_NARROW),
+
+    NEON_OP_ENTRY(zip1_16b,     "zip1 .16b",            OP_CLASS_PERMUTE),
+    NEON_OP_ENTRY(uzp1_8h,      "uzp1 .8h",             OP_CLASS_PERMUTE),
+    NEON_OP_ENTRY(trn1_4s,      "trn1 .4s",             OP_CLASS_PERMUTE),
+    NEON_OP_ENTRY(ext_16b,      "ext .16b",             OP_CLASS_PERMUTE),
+    NEON_OP_ENTRY(rev64_16b,    "rev64 .16b",           OP_CLASS_PERMUTE),
+    NEON_OP_ENTRY(dup_elem,     "dup .4s by elem",      OP_CLASS_PERMUTE),
+
+    NEON_OP_ENTRY(tbl1,         "tbl 1 reg",            OP_CLASS_TBL),
+    NEON_OP_ENTRY(tbl2,         "tbl 2 regs",           OP_CLASS_TBL),
+    NEON_OP_ENTRY(tbl4,         "tbl 4 regs",           OP_CLASS_TBL),
+    NEON_OP_ENTRY(tbx1,         "tbx 1 reg",            OP_CLASS_TBL),
+
+    NEON_OP_ENTRY(ldr_q,        "ldr q (+fmov chain)",  OP_CLASS_LOAD),
+    NEON_TPUT_ENTRY(ld1r_4s,    "ld1r .4s",             OP_CLASS_LOAD),
+    NEON_TPUT_ENTRY(ld1x4,      "ld1 x4 .16b",          OP_CLASS_LOAD),
+    NEON_TPUT_ENTRY(ld2_8h,     "ld2 .8h",              OP_CLASS_LOAD),
+    NEON_TPUT_ENTRY(ld3_16b,    "ld3 .16b",             OP_CLASS_LOAD),
+    NEON_TPUT_ENTRY(ld4_16b,    "ld4 .16b",             OP_CLASS_LOAD),
+
+    NEON_TPUT_ENTRY(str_q,      "str q",                OP_CLASS_STORE),
+    NEON_TPUT_ENTRY(st1x4,      "st1 x4 .16b",          OP_CLASS_STORE),
+    NEON_TPUT_ENTRY(st2_8h,     "st2 .8h",              OP_CLASS_STORE),
+    NEON_TPUT_ENTRY(st3_16b,    "st3 .16b",             OP_CLASS_STORE),
+    NEON_TPUT_ENTRY(st4_16b,    "st4 .16b",             OP_CLASS_STORE),
+};
+
+#define NUM_OPS (sizeof(catalogue) / sizeof(catalogue[0]))
+
+static const char *class_names[OP_CLASS_COUNT] = {
+    "arith", "fma", "widen", "narrow", "permute", "tbl", "load", "store"
+};
+
+int pin_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+}
+
+double get_time_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Get CPU frequency from sysfs, used when no cycle counter is available
+static unsigned long get_cpu_freq_khz(int cpu) {
+    char path[256];
+    FILE *f;
+    unsigned long freq = 0;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", cpu);
+    f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%lu", &freq) != 1)
+            freq = 0;
+        fclose(f);
+    }
+    return freq;
+}
+
+// Whether a sysfs cpu list such as "0-3" or "0,4-7" includes cpu
+static int cpu_list_has(const char *list, int cpu) {
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p)
+            break;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+        if (cpu >= first && cpu <= last)
+            return 1;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+/*
+ * perf type of the core PMU that covers cpu, -1 if none lists it. The
+ * A55 and A76 clusters each have their own PMU (armv8_cortex_a55,
+ * armv8_cortex_a76), and a generic hardware event only counts on one.
+ */
+static int core_pmu_type(int cpu) {
+    const char *base = "/sys/bus/event_source/devices";
+    struct dirent *de;
+    int type = -1;
+    DIR *dir;
+
+    dir = opendir(base);
+    if (!dir)
+        return -1;
+    while (type < 0 && (de = readdir(dir)) != NULL) {
+        char path[512], list[256];
+        FILE *f;
+
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s/cpus", base, de->d_name);
+        f = fopen(path, "r");
+        if (!f)
+            continue;
+        if (!fgets(list, sizeof(list), f) || !cpu_list_has(list, cpu)) {
+            fclose(f);
+            continue;
+        }
+        fclose(f);
+
+        snprintf(path, sizeof(path), "%s/%s/type", base, de->d_name);
+        f = fopen(path, "r");
+        if (f) {
+            if (fscanf(f, "%d", &type) != 1)
+                type = -1;
+            fclose(f);
+        }
+    }
+    closedir(dir);
+    return type;
+}
+
+/*
+ * Cycle counter for the calling thread on core_id's PMU; returns -1 when
+ * perf events are unavailable. Open it after pinning to core_id.
+ */
+int cycle_counter_open(int core_id) {
+    struct perf_event_attr attr;
+    int type = core_pmu_type(core_id);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    if (type >= 0) {
+        attr.type = type;
+        attr.config = ARMV8_PMU_CPU_CYCLES;
+    } else {
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    }
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, core_id, -1, 0);
+}
+
+static uint64_t cycle_counter_read(int fd) {
+    uint64_t value = 0;
+    if (read(fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+// Best-of-LAT_REPEATS cycles per instruction for one generated loop
+double measure_cycles(neon_bench_fn fn, uint64_t *buf, int counter_fd, unsigned long freq_khz) {
+    double best = 0;
+
+    // Load templates chase buf[0], which must point back at buf
+    buf[0] = (uint64_t)(uintptr_t)buf;
+    fn(LAT_ITERATIONS / 10, buf);
+
+    for (int r = 0; r < LAT_REPEATS; r++) {
+        uint64_t start_cycles = 0, end_cycles = 0;
+        double start, end, cycles;
+
+        buf[0] = (uint64_t)(uintptr_t)buf;
+        if (counter_fd >= 0)
+            start_cycles = cycle_counter_read(counter_fd);
+        start = get_time_seconds();
+        fn(LAT_ITERATIONS, buf);
+        end = get_time_seconds();
+        if (counter_fd >= 0)
+            end_cycles = cycle_counter_read(counter_fd);
+
+        cycles = (end - start) * freq_khz * 1000.0;
+
+        // A counter that did not move is not counting on this core
+        if (end_cycles != start_cycles)
+            cycles = (double)(end_cycles - start_cycles);
+
+        cycles /= (double)LAT_ITERATIONS * INSNS_PER_ITER;
+        if (r == 0 || cycles < best)
+            best = cycles;
+    }
+    return best;
+}
+
+int run_catalogue(int core_id, neon_op_result_t *results) {
+    uint64_t *buf;
+    int counter_fd;
+    unsigned long freq_khz;
+
+    if (pin_thread_to_core(core_id) != 0) {
+        printf("Failed to pin thread to core %d\n", core_id);
+        return -1;
+    }
+
+    // Each cluster has its own PMU: open the counter on this core's
+    counter_fd = cycle_counter_open(core_id);
+    if (counter_fd < 0)
+        printf("perf cycle counter unavailable on core %d, using time * scaling_cur_freq\n",
+               core_id);
+
+    // Read once here: the sysfs read must not land inside the timed loops
+    freq_khz = get_cpu_freq_khz(core_id);
+
+    if (posix_memalign((void**)&buf, 4096, 4096) != 0) {
+        printf("Memory allocation failed for core %d\n", core_id);
+        if (counter_fd >= 0)
+            close(counter_fd);
+        return -1;
+    }
+    memset(buf, 0, 4096);
+
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        const neon_op_t *op = &catalogue[i];
+
+        results[i].latency_cpi = op->latency_fn ?
+            measure_cycles(op->latency_fn, buf, counter_fd, freq_khz) : 0;
+        results[i].throughput_cpi =
+            measure_cycles(op->throughput_fn, buf, counter_fd, freq_khz);
+    }
+
+    free(buf);
+    if (counter_fd >= 0)
+        close(counter_fd);
+    return 0;
+}
+
+void write_latency_csv(FILE *f, int core_id, const neon_op_result_t *results) {
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        fprintf(f, "%s,%s,%d,%s,", catalogue[i].name,
+                class_names[catalogue[i].op_class], core_id,
+                core_id >= A76_CORE_START ? "A76" : "A55");
+        if (catalogue[i].latency_fn)
+            fprintf(f, "%.2f", results[i].latency_cpi);
+        fprintf(f, ",%.2f\n", results[i].throughput_cpi);
+    }
+}
+
+static void print_cpi(const neon_op_t *op, double cpi, int is_latency) {
+    if (is_latency && !op->latency_fn)
+        printf(" %8s |", "-");
+    else
+        printf(" %8.2f |", cpi);
+}
+
+int main(int argc, char **argv) {
+    const int cores[] = { A55_CORE_START, A76_CORE_START };
+    const int num_cores = sizeof(cores) / sizeof(cores[0]);
+    const char *csv_path = argc > 1 ? argv[1] : LAT_TABLE_CSV;
+    neon_op_result_t results[2][NUM_OPS];
+    FILE *csv;
+
+    printf("NEON instruction latency/throughput characterization on RK3588\n");
+    printf("%d instructions per loop, %d independent chains for throughput\n",
+           INSNS_PER_ITER, INDEP_CHAINS);
+
+    for (int c = 0; c < num_cores; c++) {
+        printf("Measuring core %d (Cortex-%s)...\n", cores[c],
+               cores[c] >= A76_CORE_START ? "A76" : "A55");
+        if (run_catalogue(cores[c], results[c]) != 0)
+            return 1;
+    }
+
+    // Cycles per instruction: dependent chain (lat) and independent streams (tput)
+    printf("\n| %-22s | %-7s | A55 lat  | A55 tput | A76 lat  | A76 tput |\n",
+           "Instruction", "Class");
+    printf("|------------------------|---------|----------|----------|----------|----------|\n");
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        printf("| %-22s | %-7s |", catalogue[i].name, class_names[catalogue[i].op_class]);
+        for (int c = 0; c < num_cores; c++) {
+            print_cpi(&catalogue[i], results[c][i].latency_cpi, 1);
+            print_cpi(&catalogue[i], results[c][i].throughput_cpi, 0);
+        }
+        printf("\n");
+    }
+
+    csv = fopen(csv_path, "w");
+    if (!csv) {
+        printf("Failed to open %s\n", csv_path);
+        return 1;
+    }
+    fprintf(csv, "instruction,class,core,core_type,latency_cycles,throughput_cycles\n");
+    for (int c = 0; c < num_cores; c++)
+        write_latency_csv(csv, cores[c], results[c]);
+    fclose(csv);
+
+    printf("\nTable written to %s\n", csv_path);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef NEON_LATENCY_H
+#define NEON_LATENCY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// RK3588 cluster layout: A55 cores are 0-3, A76 cores are 4-7
+#define A55_CORE_START    0
+#define A76_CORE_START    4
+
+// Every generated loop body holds this many instructions under test
+#define INSNS_PER_ITER    24
+// Independent register chains used by the throughput variants
+#define INDEP_CHAINS      12
+
+#define LAT_ITERATIONS    500000
+#define LAT_REPEATS       3
+
+// ARMv8 PMU common event CPU_CYCLES, for the per-cluster core PMUs
+#define ARMV8_PMU_CPU_CYCLES    0x11
+
+// Default output consumed by the kernel auto-tuner
+#define LAT_TABLE_CSV     "neon_latency_table.csv"
+
+// Instruction classes in the catalogue
+typedef enum {
+    OP_CLASS_ARITH = 0,
+    OP_CLASS_FMA,
+    OP_CLASS_WIDEN,
+    OP_CLASS_NARROW,
+    OP_CLASS_PERMUTE,
+    OP_CLASS_TBL,
+    OP_CLASS_LOAD,
+    OP_CLASS_STORE,
+    OP_CLASS_COUNT
+} op_class_t;
+
+typedef void (*neon_bench_fn)(uint64_t iters, void *buf);
+
+typedef struct {
+    const char *name;
+    op_class_t op_class;
+    neon_bench_fn latency_fn;       // NULL when latency is not meaningful
+    neon_bench_fn throughput_fn;
+} neon_op_t;
+
+typedef struct {
+    double latency_cpi;             // cycles per instruction, dependent chain
+    double throughput_cpi;          // cycles per instruction, independent streams
+} neon_op_result_t;
+
+// Function declarations
+int pin_thread_to_core(int core_id);
+double get_time_seconds(void);
+int cycle_counter_open(int core_id);
+double measure_cycles(neon_bench_fn fn, uint64_t *buf, int counter_fd, unsigned long freq_khz);
+int run_catalogue(int core_id, neon_op_result_t *results);
+void write_latency_csv(FILE *f, int core_id, const neon_op_result_t *results);
+
+#endif // NEON_LATENCY_H
@@ -0,0 +1,316 @@
+#include "rk_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define ALIGN_UP(x, a)  (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+// Thread slot ids index RkPool.caches; released ids are reused by new threads
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key;
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t slot_used;
+static __thread int thread_slot = -1;
+
+static void release_slot(void *arg) {
+    int slot = (int)(intptr_t)arg - 1;
+
+    pthread_mutex_lock(&slot_lock);
+    slot_used &= ~(1u << slot);
+    pthread_mutex_unlock(&slot_lock);
+}
+
+static void create_slot_key(void) {
+    pthread_key_create(&slot_key, release_slot);
+}
+
+// Returns -1 once more than RK_POOL_MAX_THREADS threads are alive
+static int get_thread_slot(void) {
+    if (thread_slot >= 0)
+        return thread_slot;
+
+    pthread_once(&slot_once, create_slot_key);
+
+    pthread_mutex_lock(&slot_lock);
+    for (int i = 0; i < RK_POOL_MAX_THREADS; i++) {
+        if (!(slot_used & (1u << i))) {
+            slot_used |= 1u << i;
+            thread_slot = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&slot_lock);
+
+    if (thread_slot >= 0)
+        pthread_setspecific(slot_key, (void *)(intptr_t)(thread_slot + 1));
+    return thread_slot;
+}
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define MAX_FILL_THREADS        16
+
+typedef struct {
+    uint8_t        *ptr;
+    size_t          size;
+    uint64_t        seed;
+} FillChunk;
+
+static void populate_region(uint8_t *ptr, size_t size) {
+    // Kernels before 5.14 lack MADV_POPULATE_WRITE: fault pages in by hand
+    if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+        return;
+    for (size_t off = 0; off < size; off += RK_PAGE_SIZE)
+        ((volatile uint8_t *)ptr)[off] = 0;
+}
+
+static void *map_region(size_t size, int flags) {
+    int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    size_t map_size;
+    uint8_t *ptr, *aligned;
+
+    size = ALIGN_UP(size, RK_PAGE_SIZE);
+    map_size = size;
+
+    if (flags & RK_ALLOC_HUGE)
+        map_size += RK_HUGE_PAGE_SIZE;
+    else if (flags & RK_ALLOC_POPULATE)
+        mmap_flags |= MAP_POPULATE;
+
+    ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+    if (ptr == MAP_FAILED)
+        return NULL;
+
+    if (flags & RK_ALLOC_HUGE) {
+        // Trim to a 2MB boundary, then prefault after the madvise so the
+        // populate step already gets huge pages
+        aligned = (uint8_t *)ALIGN_UP((uintptr_t)ptr, RK_HUGE_PAGE_SIZE);
+        if (aligned > ptr)
+            munmap(ptr, aligned - ptr);
+        if (aligned + size < ptr + map_size)
+            munmap(aligned + size, ptr + map_size - (aligned + size));
+        ptr = aligned;
+
+        madvise(ptr, size, MADV_HUGEPAGE);
+        if (flags & RK_ALLOC_POPULATE)
+            populate_region(ptr, size);
+    } else if (flags & RK_ALLOC_NOHUGE) {
+        madvise(ptr, size, MADV_NOHUGEPAGE);
+    }
+
+    return ptr;
+}
+
+void *rk_buf_alloc(size_t size, int flags) {
+    return map_region(size, flags);
+}
+
+void rk_buf_free(void *ptr, size_t size) {
+    if (ptr)
+        munmap(ptr, ALIGN_UP(size, RK_PAGE_SIZE));
+}
+
+void rk_buf_fill_random(void *ptr, size_t size, uint64_t seed) {
+    uint64_t state = rk_rng_seed(seed);
+    uint64_t *words = ptr;
+    size_t count = size / sizeof(uint64_t);
+
+    for (size_t i = 0; i < count; i++)
+        words[i] = rk_rng_next(&state);
+    for (size_t i = count * sizeof(uint64_t); i < size; i++)
+        ((uint8_t *)ptr)[i] = (uint8_t)rk_rng_next(&state);
+}
+
+static void *fill_chunk_thread(void *arg) {
+    FillChunk *chunk = arg;
+    rk_buf_fill_random(chunk->ptr, chunk->size, chunk->seed);
+    return NULL;
+}
+
+// First-touch a large buffer from nthreads threads, one huge page aligned
+// chunk each, every thread with its own RNG stream. Chunk i is filled on
+// core i (modulo the online cores), so a caller pinned to one core still
+// gets nthreads cores. Returns the number of threads that took part; the
+// whole buffer is filled either way.
+int rk_buf_parallel_fill(void *ptr, size_t size, int nthreads, uint64_t seed) {
+    pthread_t threads[MAX_FILL_THREADS];
+    FillChunk chunks[MAX_FILL_THREADS];
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_attr_t attr;
+    cpu_set_t cpuset;
+    size_t chunk_size, off = 0;
+    int created = 0, ret;
+
+    if (nthreads > MAX_FILL_THREADS)
+        nthreads = MAX_FILL_THREADS;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    chunk_size = ALIGN_UP((size + nthreads - 1) / nthreads, RK_HUGE_PAGE_SIZE);
+
+    for (int i = 0; i < nthreads && off < size; i++) {
+        chunks[i].ptr = (uint8_t *)ptr + off;
+        chunks[i].size = size - off < chunk_size ? size - off : chunk_size;
+        chunks[i].seed = seed + i;
+        off += chunks[i].size;
+
+        // Workers would otherwise inherit the caller's affinity mask
+        pthread_attr_init(&attr);
+        if (ncpu > 0) {
+            CPU_ZERO(&cpuset);
+            CPU_SET(i % ncpu, &cpuset);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+        }
+        ret = pthread_create(&threads[i], &attr, fill_chunk_thread, &chunks[i]);
+        pthread_attr_destroy(&attr);
+        if (ret != 0) {
+            // Finish the rest on the calling thread
+            rk_buf_fill_random(chunks[i].ptr, size - (chunks[i].ptr - (uint8_t *)ptr), seed + i);
+            break;
+        }
+        created++;
+    }
+
+    for (int i = 0; i < created; i++)
+        pthread_join(threads[i], NULL);
+
+    return created;
+}
+
+int rk_arena_init(RkArena *arena, size_t size, int flags) {
+    memset(arena, 0, sizeof(*arena));
+
+    arena->size = ALIGN_UP(size, RK_PAGE_SIZE);
+    arena->base = map_region(arena->size, flags);
+    if (!arena->base)
+        return -ENOMEM;
+    return 0;
+}
+
+void *rk_arena_alloc(RkArena *arena, size_t size, size_t align) {
+    size_t old_used, start, end;
+
+    if (align < sizeof(void *))
+        align = sizeof(void *);
+
+    old_used = __atomic_load_n(&arena->used, __ATOMIC_RELAXED);
+    do {
+        start = ALIGN_UP((uintptr_t)arena->base + old_used, align) - (uintptr_t)arena->base;
+        end = start + size;
+        if (end > arena->size)
+            return NULL;
+    } while (!__atomic_compare_exchange_n(&arena->used, &old_used, end, 1,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return arena->base + start;
+}
+
+void rk_arena_reset(RkArena *arena) {
+    if (arena->used > arena->high_water)
+        arena->high_water = arena->used;
+    arena->used = 0;
+}
+
+void rk_arena_deinit(RkArena *arena) {
+    if (arena->base)
+        munmap(arena->base, arena->size);
+    memset(arena, 0, sizeof(*arena));
+}
+
+int rk_pool_init(RkPool *pool, size_t block_size, size_t block_count,
+                 size_t align, int flags) {
+    memset(pool, 0, sizeof(*pool));
+
+    if (align < RK_CACHE_LINE)
+        align = RK_CACHE_LINE;
+
+    pool->block_size = ALIGN_UP(block_size, align);
+    pool->block_count = block_count;
+    pool->map_size = ALIGN_UP(pool->block_size * block_count, RK_PAGE_SIZE);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->base = map_region(pool->map_size, flags);
+    pool->free_list = malloc(block_count * sizeof(void *));
+    if (!pool->base || !pool->free_list) {
+        rk_pool_deinit(pool);
+        return -ENOMEM;
+    }
+
+    // Hand out low addresses first
+    for (size_t i = 0; i < block_count; i++)
+        pool->free_list[i] = pool->base + (block_count - 1 - i) * pool->block_size;
+    pool->free_count = block_count;
+
+    // Small pools (e.g. a handful of frames) skip caching so no thread
+    // can strand blocks another thread is waiting for
+    pool->cache_limit = block_count / RK_POOL_MAX_THREADS;
+    if (pool->cache_limit > RK_POOL_CACHE_SIZE)
+        pool->cache_limit = RK_POOL_CACHE_SIZE;
+    return 0;
+}
+
+void *rk_pool_get(RkPool *pool) {
+    int slot = get_thread_slot();
+    RkPoolCache *cache;
+    void *block = NULL;
+
+    if (slot < 0 || !pool->cache_limit) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->free_count)
+            block = pool->free_list[--pool->free_count];
+        pthread_mutex_unlock(&pool->lock);
+        return block;
+    }
+
+    cache = &pool->caches[slot];
+    if (!cache->count) {
+        // Refill half a cache in one lock round trip
+        pthread_mutex_lock(&pool->lock);
+        while (cache->count < (pool->cache_limit + 1) / 2 && pool->free_count)
+            cache->blocks[cache->count++] = pool->free_list[--pool->free_count];
+        pthread_mutex_unlock(&pool->lock);
+
+        if (!cache->count)
+            return NULL;
+    }
+
+    return cache->blocks[--cache->count];
+}
+
+void rk_pool_put(RkPool *pool, void *block) {
+    int slot = get_thread_slot();
+    RkPoolCache *cache;
+
+    if (!block)
+        return;
+
+    if (slot < 0 || !pool->cache_limit) {
+        pthread_mutex_lock(&pool->lock);
+        pool->free_list[pool->free_count++] = block;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    cache = &pool->caches[slot];
+    if (cache->count >= pool->cache_limit) {
+        pthread_mutex_lock(&pool->lock);
+        while (cache->count > pool->cache_limit / 2)
+            pool->free_list[pool->free_count++] = cache->blocks[--cache->count];
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    cache->blocks[cache->count++] = block;
+}
+
+void rk_pool_deinit(RkPool *pool) {
+    if (pool->base)
+        munmap(pool->base, pool->map_size);
+    free(pool->free_list);
+    pthread_mutex_destroy(&pool->lock);
+    memset(pool, 0, sizeof(*pool));
+}
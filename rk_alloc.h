@@ -0,0 +1,96 @@
+#ifndef RK_ALLOC_H
+#define RK_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Alignment choices for hot-path buffers
+#define RK_CACHE_LINE           64
+#define RK_PAGE_SIZE            4096
+#define RK_HUGE_PAGE_SIZE       (2 * 1024 * 1024)
+
+// Per-thread cache geometry for fixed-size pools
+#define RK_POOL_MAX_THREADS     16
+#define RK_POOL_CACHE_SIZE      8
+
+// Allocation flags
+#define RK_ALLOC_POPULATE       (1 << 0)    // prefault the mapping (MAP_POPULATE)
+#define RK_ALLOC_HUGE           (1 << 1)    // 2MB aligned, madvise(MADV_HUGEPAGE)
+#define RK_ALLOC_NOHUGE         (1 << 2)    // force 4KB pages, madvise(MADV_NOHUGEPAGE)
+
+// Per-thread fast RNG (xorshift64*) for buffer initialisation
+static inline uint64_t rk_rng_seed(uint64_t seed) {
+    // splitmix64 spreads nearby seeds; state must never be zero
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    return (seed ^ (seed >> 31)) | 1;
+}
+
+static inline uint64_t rk_rng_next(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Arena allocator: one mapping, bump-pointer allocation, freed all at once
+ * with rk_arena_reset(). Allocation is lock-free so the per-frame arena can
+ * be shared by worker threads; reset must only happen when no allocation
+ * from the current generation is still in use.
+ */
+typedef struct {
+    uint8_t        *base;
+    size_t          size;
+    size_t          used;
+    size_t          high_water;
+} RkArena;
+
+// Per-thread cache of free blocks, cache-line aligned so owners never share a line
+typedef struct {
+    int             count;
+    void           *blocks[RK_POOL_CACHE_SIZE];
+} __attribute__((aligned(RK_CACHE_LINE))) RkPoolCache;
+
+/*
+ * Fixed-size pool: block_count blocks of block_size bytes carved from one
+ * mapping. Each thread keeps up to cache_limit (<= RK_POOL_CACHE_SIZE)
+ * blocks in its own cache and only takes the pool lock to refill or flush
+ * half a cache.
+ */
+typedef struct {
+    uint8_t        *base;
+    size_t          map_size;
+    size_t          block_size;
+    size_t          block_count;
+
+    pthread_mutex_t lock;
+    void          **free_list;
+    size_t          free_count;
+    int             cache_limit;
+
+    RkPoolCache     caches[RK_POOL_MAX_THREADS];
+} RkPool;
+
+// Function declarations
+void *rk_buf_alloc(size_t size, int flags);
+void  rk_buf_free(void *ptr, size_t size);
+void  rk_buf_fill_random(void *ptr, size_t size, uint64_t seed);
+int   rk_buf_parallel_fill(void *ptr, size_t size, int nthreads, uint64_t seed);
+
+int   rk_arena_init(RkArena *arena, size_t size, int flags);
+void *rk_arena_alloc(RkArena *arena, size_t size, size_t align);
+void  rk_arena_reset(RkArena *arena);
+void  rk_arena_deinit(RkArena *arena);
+
+int   rk_pool_init(RkPool *pool, size_t block_size, size_t block_count,
+                   size_t align, int flags);
+void *rk_pool_get(RkPool *pool);
+void  rk_pool_put(RkPool *pool, void *block);
+void  rk_pool_deinit(RkPool *pool);
+
+#endif // RK_ALLOC_H
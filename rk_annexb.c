@@ -0,0 +1,398 @@
+#include "rk_annexb.h"
+#include <string.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// memchr finds the 01, then look back for the two zeros
+const RK_U8 *annexb_find_start_code_scalar(const RK_U8 *p, const RK_U8 *end)
+{
+    const RK_U8 *q = p + 2;
+
+    while (q < end) {
+        q = memchr(q, 1, end - q);
+        if (!q)
+            break;
+        if (!q[-1] && !q[-2])
+            return q - 2;
+        q++;
+    }
+    return end;
+}
+
+#ifdef __ARM_NEON
+/*
+ * Emulation prevention keeps "00 00" rare inside slice data, so most 64B
+ * blocks hold no zero byte at all: one vminvq rejects them. Blocks with a
+ * zero get the exact test at all 64 positions, reading two bytes past the
+ * block so a start code straddling the edge is still seen.
+ */
+const RK_U8 *annexb_find_start_code_neon(const RK_U8 *p, const RK_U8 *end)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+
+    while (end - p >= 64 + 2) {
+        uint8x16_t a = vld1q_u8(p);
+        uint8x16_t b = vld1q_u8(p + 16);
+        uint8x16_t c = vld1q_u8(p + 32);
+        uint8x16_t d = vld1q_u8(p + 48);
+        int i;
+
+        if (vminvq_u8(vminq_u8(vminq_u8(a, b), vminq_u8(c, d)))) {
+            p += 64;
+            continue;
+        }
+
+        for (i = 0; i < 64; i += 16) {
+            uint8x16_t z0 = vceqq_u8(vld1q_u8(p + i), zero);
+            uint8x16_t z1 = vceqq_u8(vld1q_u8(p + i + 1), zero);
+            uint8x16_t o2 = vceqq_u8(vld1q_u8(p + i + 2), one);
+            uint8x16_t hit = vandq_u8(vandq_u8(z0, z1), o2);
+
+            if (vmaxvq_u8(hit)) {
+                // One nibble per byte, lowest set nibble is the first hit
+                uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+                                    vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+                return p + i + (__builtin_ctzll(mask) >> 2);
+            }
+        }
+        p += 64;
+    }
+
+    return annexb_find_start_code_scalar(p, end);
+}
+#endif
+
+const RK_U8 *annexb_find_start_code(const RK_U8 *p, const RK_U8 *end)
+{
+#ifdef __ARM_NEON
+    return annexb_find_start_code_neon(p, end);
+#else
+    return annexb_find_start_code_scalar(p, end);
+#endif
+}
+
+#define NAL_NONE    ((size_t)-1)
+
+static void reset_au_info(RkAuInfo *info)
+{
+    memset(info, 0, sizeof(RkAuInfo));
+    info->vcl_type = -1;
+}
+
+void rk_au_parser_init(RkAuParser *parser, MppCodingType type)
+{
+    memset(parser, 0, sizeof(RkAuParser));
+    parser->type = type;
+    parser->scan = annexb_find_start_code;
+    parser->nal = NAL_NONE;
+    reset_au_info(&parser->building);
+    reset_au_info(&parser->info);
+}
+
+// data holds the bytes from offset 0 on, as left by the last rebase
+void rk_au_parser_set_data(RkAuParser *parser, const RK_U8 *data, size_t size, RK_U32 final)
+{
+    parser->base = data;
+    parser->size = size;
+    parser->final = final;
+}
+
+int rk_au_parser_done(const RkAuParser *parser)
+{
+    return parser->final && parser->started && parser->cur >= parser->size;
+}
+
+// Leading bytes no longer needed by the parser
+size_t rk_au_parser_consumed(const RkAuParser *parser)
+{
+    return parser->started ? parser->cur : parser->scan_pos;
+}
+
+void rk_au_parser_rebase(RkAuParser *parser, size_t shift)
+{
+    parser->cur -= parser->started ? shift : 0;
+    parser->scan_pos -= shift;
+    if (parser->nal != NAL_NONE)
+        parser->nal -= shift;
+}
+
+/*
+ * Classify the NAL unit whose header starts at hdr (after the start code).
+ * Returns 1 for VCL, sets *first when it is the first slice of a picture,
+ * *au_start for non-VCL units that open an AU and *ps for parameter sets.
+ */
+static int classify_nal(MppCodingType type, const RK_U8 *hdr, const RK_U8 *end,
+                        int *nal_type_out, int *first, int *au_start, RK_U32 *ps)
+{
+    int nal_type;
+
+    *nal_type_out = -1;
+    *first = 0;
+    *au_start = 0;
+    *ps = 0;
+
+    if (type == MPP_VIDEO_CodingHEVC) {
+        if (end - hdr < 3)
+            return 0;
+        nal_type = (hdr[0] >> 1) & 0x3f;
+        *nal_type_out = nal_type;
+        if (nal_type <= 31) {
+            // first_slice_segment_in_pic_flag
+            *first = hdr[2] >> 7;
+            return 1;
+        }
+        if (nal_type >= 32 && nal_type <= 34)
+            *ps = ANNEXB_PS_VPS << (nal_type - 32);
+        // VPS, SPS, PPS, AUD, prefix SEI, reserved 41-44 and 48-55
+        *au_start = (nal_type >= 32 && nal_type <= 35) || nal_type == 39 ||
+                    (nal_type >= 41 && nal_type <= 44) || (nal_type >= 48 && nal_type <= 55);
+        return 0;
+    }
+
+    if (end - hdr < 2)
+        return 0;
+    nal_type = hdr[0] & 0x1f;
+    *nal_type_out = nal_type;
+    if (nal_type >= 1 && nal_type <= 5) {
+        // first_mb_in_slice == 0 codes as a single 1 bit
+        *first = hdr[1] >> 7;
+        return 1;
+    }
+    if (nal_type == 7 || nal_type == 8)
+        *ps = nal_type == 7 ? ANNEXB_PS_SPS : ANNEXB_PS_PPS;
+    // SEI, SPS, PPS, AUD, 14-18
+    *au_start = (nal_type >= 6 && nal_type <= 9) || (nal_type >= 14 && nal_type <= 18);
+    return 0;
+}
+
+/*
+ * Next access unit as [offset, offset + len), from its first start code up
+ * to the start code of the next AU. Returns AU_PARSER_MORE when the AU may
+ * continue past the data and more is coming, AU_PARSER_END when the stream
+ * is exhausted.
+ */
+int rk_au_parser_next(RkAuParser *parser, size_t *offset, size_t *len)
+{
+    const RK_U8 *end = parser->base + parser->size;
+
+    for (;;) {
+        RkAuInfo *au = &parser->building;
+        const RK_U8 *hdr;
+        int vcl, nal_type, first, au_start;
+        RK_U32 ps;
+
+        if (parser->nal == NAL_NONE) {
+            const RK_U8 *sc = parser->scan(parser->base + parser->scan_pos, end);
+
+            if (sc < end) {
+                parser->nal = sc - parser->base;
+            } else if (!parser->final) {
+                // A start code may straddle the end, rescan its first bytes
+                if (parser->size > parser->scan_pos + 2)
+                    parser->scan_pos = parser->size - 2;
+                return AU_PARSER_MORE;
+            } else {
+                parser->nal = parser->size;
+            }
+
+            if (!parser->started && parser->nal < parser->size) {
+                // Anything before the first start code is not part of a NAL,
+                // but its zero_byte is: later AUs carry theirs at the end
+                // of the AU before
+                parser->cur = parser->nal;
+                if (parser->cur && !parser->base[parser->cur - 1])
+                    parser->cur--;
+                parser->started = 1;
+            }
+        }
+
+        if (parser->nal >= parser->size) {
+            if (!parser->started || parser->cur >= parser->size)
+                return AU_PARSER_END;
+            break;
+        }
+
+        hdr = parser->base + parser->nal + 3;
+        if (end - hdr < 3 && !parser->final)
+            return AU_PARSER_MORE;
+
+        vcl = classify_nal(parser->type, hdr, end, &nal_type, &first, &au_start, &ps);
+        if (parser->nal != parser->cur && parser->has_vcl && (au_start || (vcl && first)))
+            break;
+
+        // This NAL belongs to the current AU, look for the next one
+        if (vcl && au->vcl_type < 0) {
+            au->vcl_type = nal_type;
+            au->vcl_offset = parser->nal - parser->cur;
+        }
+        if (ps && !au->ps && au->vcl_type < 0)
+            au->ps_offset = parser->nal - parser->cur;
+        if (au->vcl_type < 0)
+            au->ps |= ps;
+        parser->has_vcl |= vcl;
+        parser->nal_count++;
+        parser->scan_pos = hdr - parser->base;
+        parser->nal = NAL_NONE;
+    }
+
+    *offset = parser->cur;
+    *len = parser->nal - parser->cur;
+    parser->info = parser->building;
+    if (parser->info.vcl_type < 0)
+        parser->info.vcl_offset = *len;
+    reset_au_info(&parser->building);
+    parser->cur = parser->nal;
+    parser->has_vcl = 0;
+    parser->au_count++;
+    return AU_PARSER_OK;
+}
+
+/*
+ * Whether a picture whose first slice has NAL type vcl_type can start a
+ * decode: H.264 IDR; H.265 IDR and BLA, or CRA whose RASL pictures are
+ * lost when decoding starts there.
+ */
+RK_U32 annexb_random_access(MppCodingType type, RK_S32 vcl_type)
+{
+    if (type == MPP_VIDEO_CodingHEVC) {
+        if (vcl_type >= 16 && vcl_type <= 20)
+            return ANNEXB_RAP_CLEAN;
+        return vcl_type == 21 ? ANNEXB_RAP_OPEN : ANNEXB_RAP_NONE;
+    }
+    return vcl_type == 5 ? ANNEXB_RAP_CLEAN : ANNEXB_RAP_NONE;
+}
+
+// Copy up to n RBSP bytes from a NAL unit, dropping emulation prevention bytes
+static size_t unescape(RK_U8 *dst, const RK_U8 *src, const RK_U8 *end, size_t n)
+{
+    size_t i = 0;
+    int zeros = 0;
+
+    for (; src < end && i < n; src++) {
+        if (zeros >= 2 && *src == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = *src ? 0 : zeros + 1;
+        dst[i++] = *src;
+    }
+    return i;
+}
+
+/*
+ * level_idc of the SPS whose NAL header starts at hdr, 0 when it is not an
+ * SPS. H.264 level 1b is returned as 9, as level_idc codes it for High.
+ */
+RK_U32 annexb_sps_level(MppCodingType type, const RK_U8 *hdr, const RK_U8 *end)
+{
+    RK_U8 rbsp[16];
+
+    if (type == MPP_VIDEO_CodingHEVC) {
+        // Header, VPS id / sub layers, then profile_tier_level up to general_level_idc
+        if (end - hdr < 3 || ((hdr[0] >> 1) & 0x3f) != 33)
+            return 0;
+        if (unescape(rbsp, hdr + 2, end, 13) < 13)
+            return 0;
+        return rbsp[12];
+    }
+
+    if (end - hdr < 4 || (hdr[0] & 0x1f) != 7)
+        return 0;
+    // Baseline, Main and Extended code level 1b as 11 with constraint_set3_flag
+    if (hdr[3] == 11 && (hdr[2] & 0x10) && (hdr[1] == 66 || hdr[1] == 77 || hdr[1] == 88))
+        return 9;
+    return hdr[3];
+}
+
+// level_idc of the last SPS in data, 0 when there is none
+RK_U32 annexb_scan_level(MppCodingType type, const RK_U8 *data, size_t size)
+{
+    const RK_U8 *end = data + size;
+    const RK_U8 *p = annexb_find_start_code(data, end);
+    RK_U32 level = 0;
+
+    while (p < end) {
+        RK_U32 l = annexb_sps_level(type, p + 3, end);
+
+        if (l)
+            level = l;
+        p = annexb_find_start_code(p + 3, end);
+    }
+    return level;
+}
+
+/*
+ * Reference frames the decoder may hold for a picture size at a level:
+ * H.264 table A-1 MaxDpbMbs, H.265 A.4.2 maxDpbSize. An unknown level gets
+ * the 16 frames both standards allow at most.
+ */
+RK_U32 annexb_max_dpb_frames(MppCodingType type, RK_U32 level_idc, RK_U32 width, RK_U32 height)
+{
+    RK_U32 max_dpb = 0;
+
+    if (!width || !height)
+        return ANNEXB_MAX_DPB;
+
+    if (type == MPP_VIDEO_CodingHEVC) {
+        RK_U64 pic = (RK_U64)width * height;
+        RK_U64 max_luma_ps;
+
+        if (!level_idc)
+            return ANNEXB_MAX_DPB;
+        if (level_idc <= 30)
+            max_luma_ps = 36864;
+        else if (level_idc <= 60)
+            max_luma_ps = 122880;
+        else if (level_idc <= 63)
+            max_luma_ps = 245760;
+        else if (level_idc <= 90)
+            max_luma_ps = 552960;
+        else if (level_idc <= 93)
+            max_luma_ps = 983040;
+        else if (level_idc <= 123)
+            max_luma_ps = 2228224;
+        else if (level_idc <= 156)
+            max_luma_ps = 8912896;
+        else
+            max_luma_ps = 35651584;
+
+        if (pic <= max_luma_ps >> 2)
+            return 16;
+        if (pic <= max_luma_ps >> 1)
+            return 12;
+        if (pic <= (3 * max_luma_ps) >> 2)
+            return 8;
+        return 6;
+    }
+
+    switch (level_idc) {
+    case 9 :
+    case 10 : max_dpb = 396; break;
+    case 11 : max_dpb = 900; break;
+    case 12 :
+    case 13 :
+    case 20 : max_dpb = 2376; break;
+    case 21 : max_dpb = 4752; break;
+    case 22 :
+    case 30 : max_dpb = 8100; break;
+    case 31 : max_dpb = 18000; break;
+    case 32 : max_dpb = 20480; break;
+    case 40 :
+    case 41 : max_dpb = 32768; break;
+    case 42 : max_dpb = 34816; break;
+    case 50 : max_dpb = 110400; break;
+    case 51 :
+    case 52 : max_dpb = 184320; break;
+    case 60 :
+    case 61 :
+    case 62 : max_dpb = 696320; break;
+    default : return ANNEXB_MAX_DPB;
+    }
+
+    max_dpb /= ((width + 15) / 16) * ((height + 15) / 16);
+    if (max_dpb > ANNEXB_MAX_DPB)
+        max_dpb = ANNEXB_MAX_DPB;
+    return max_dpb ? max_dpb : 1;
+}
@@ -0,0 +1,86 @@
+#ifndef RK_ANNEXB_H
+#define RK_ANNEXB_H
+
+#include <stddef.h>
+#include <rockchip/rk_type.h>
+
+// rk_au_parser_next results
+#define AU_PARSER_OK            0
+#define AU_PARSER_MORE          1       // AU runs past the data, feed more
+#define AU_PARSER_END           (-1)
+
+// Largest DPB either standard allows, in frames
+#define ANNEXB_MAX_DPB          16
+
+// Parameter sets an access unit carries, RkAuInfo.ps
+#define ANNEXB_PS_VPS           (1 << 0)
+#define ANNEXB_PS_SPS           (1 << 1)
+#define ANNEXB_PS_PPS           (1 << 2)
+
+// annexb_random_access results
+#define ANNEXB_RAP_NONE         0
+#define ANNEXB_RAP_CLEAN        1       // IDR or BLA: nothing before it is referenced
+#define ANNEXB_RAP_OPEN         2       // CRA: leading pictures reference earlier ones
+
+// Start code scanners: return the first "00 00 01" at or after p, or end
+typedef const RK_U8 *(*AnnexbScanFn)(const RK_U8 *p, const RK_U8 *end);
+
+// What an access unit holds ahead of and at its first slice
+typedef struct {
+    RK_S32          vcl_type;           // NAL type of the first slice, -1 when none
+    RK_U32          ps;                 // ANNEXB_PS_* present
+    size_t          ps_offset;          // first parameter set, from the AU start
+    size_t          vcl_offset;         // first slice, from the AU start
+} RkAuInfo;
+
+/*
+ * Splits an Annex-B elementary stream into access units. AU boundaries
+ * follow H.264 7.4.1.2.3 and H.265 7.4.2.4.4: a parameter set, SEI, AUD or
+ * the first slice of a new picture starts a new AU once the current AU
+ * holds a VCL NAL unit.
+ *
+ * State is kept as offsets into the data so a reader can slide its window:
+ * drop rk_au_parser_consumed() bytes from the front, call
+ * rk_au_parser_rebase() and append more with rk_au_parser_set_data().
+ */
+typedef struct {
+    MppCodingType   type;
+    AnnexbScanFn    scan;
+
+    const RK_U8    *base;
+    size_t          size;
+    RK_U32          final;              // no data follows base + size
+
+    RK_U32          started;            // first start code seen
+    RK_U32          has_vcl;            // current AU holds a VCL NAL
+    size_t          cur;                // start code of the current AU
+    size_t          nal;                // next unclassified start code, or -1
+    size_t          scan_pos;           // resume the start code search here
+
+    RkAuInfo        building;           // current AU, offsets from cur
+    RkAuInfo        info;               // AU last returned by rk_au_parser_next
+
+    RK_U64          nal_count;
+    RK_U64          au_count;
+} RkAuParser;
+
+// Function declarations
+const RK_U8 *annexb_find_start_code_scalar(const RK_U8 *p, const RK_U8 *end);
+#ifdef __ARM_NEON
+const RK_U8 *annexb_find_start_code_neon(const RK_U8 *p, const RK_U8 *end);
+#endif
+const RK_U8 *annexb_find_start_code(const RK_U8 *p, const RK_U8 *end);
+
+void rk_au_parser_init(RkAuParser *parser, MppCodingType type);
+void rk_au_parser_set_data(RkAuParser *parser, const RK_U8 *data, size_t size, RK_U32 final);
+int rk_au_parser_next(RkAuParser *parser, size_t *offset, size_t *len);
+int rk_au_parser_done(const RkAuParser *parser);
+size_t rk_au_parser_consumed(const RkAuParser *parser);
+void rk_au_parser_rebase(RkAuParser *parser, size_t shift);
+
+RK_U32 annexb_random_access(MppCodingType type, RK_S32 vcl_type);
+RK_U32 annexb_sps_level(MppCodingType type, const RK_U8 *hdr, const RK_U8 *end);
+RK_U32 annexb_scan_level(MppCodingType type, const RK_U8 *data, size_t size);
+RK_U32 annexb_max_dpb_frames(MppCodingType type, RK_U32 level_idc, RK_U32 width, RK_U32 height);
+
+#endif // RK_ANNEXB_H
@@ -0,0 +1,165 @@
+#include "rk_dma_budget.h"
+#include <string.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+
+MPP_RET rk_dma_budget_init(RkDmaBudget *b, size_t limit, RK_U32 users)
+{
+    if (!limit)
+        return MPP_ERR_VALUE;
+
+    memset(b, 0, sizeof(RkDmaBudget));
+    b->limit = limit;
+    b->users = users ? users : 1;
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
+    return MPP_OK;
+}
+
+void rk_dma_budget_deinit(RkDmaBudget *b)
+{
+    if (b->used)
+        mpp_err("DMA budget: %zu bytes still reserved\n", b->used);
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->cond);
+}
+
+// Contexts the limit is shared between from the next frame pool on
+void rk_dma_budget_set_users(RkDmaBudget *b, RK_U32 users)
+{
+    pthread_mutex_lock(&b->lock);
+    b->users = users ? users : 1;
+    pthread_mutex_unlock(&b->lock);
+}
+
+// All of size bytes or nothing: MPP_ERR_NOMEM when they do not fit
+MPP_RET rk_dma_budget_reserve(RkDmaBudget *b, size_t size)
+{
+    MPP_RET ret = MPP_OK;
+
+    pthread_mutex_lock(&b->lock);
+    if (size > b->limit - b->used) {
+        b->refused++;
+        ret = MPP_ERR_NOMEM;
+    } else {
+        b->used += size;
+        if (b->used > b->peak)
+            b->peak = b->used;
+    }
+    pthread_mutex_unlock(&b->lock);
+    return ret;
+}
+
+// Caller holds b->lock; the caller stops waiting, its held bytes count as releasable again
+static void stop_waiting(RkDmaBudget *b, size_t held, RK_U32 *waiting)
+{
+    if (*waiting) {
+        b->stalled = held < b->stalled ? b->stalled - held : 0;
+        *waiting = 0;
+    }
+}
+
+/*
+ * Frame buffers of size bytes for a context that already holds held
+ * bytes. The count is capped at the context's fair share of the limit,
+ * limit / users less what it holds, but never below min; reserve frames
+ * above the stream's needs are the first to go. When even min do not fit,
+ * waits up to timeout_ms for a release (0 returns at once, -1 without
+ * limit) and returns MPP_ERR_TIMEOUT if nothing fits yet; *waiting stays
+ * set while the caller is queued, across calls. MPP_ERR_NOMEM when min
+ * cannot fit even once every context that is not waiting has let go.
+ */
+MPP_RET rk_dma_budget_reserve_count(RkDmaBudget *b, size_t size, RK_U32 min, RK_U32 max,
+                                    size_t held, RK_S32 timeout_ms, RK_U32 *waiting,
+                                    RK_U32 *count)
+{
+    struct timespec deadline;
+    size_t share;
+    RK_U32 want = max;
+    MPP_RET ret = MPP_OK;
+
+    *count = max;
+    if (!size)
+        return MPP_OK;
+
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&b->lock);
+    share = b->limit / b->users;
+    if (share > held && (share - held) / size < want)
+        want = (share - held) / size;
+    else if (share <= held)
+        want = 0;
+    if (want < min)
+        want = min;
+
+    for (;;) {
+        size_t avail = b->limit - b->used;
+        size_t others = b->stalled - (*waiting ? held : 0);
+
+        if (avail / size >= min) {
+            *count = avail / size < want ? avail / size : want;
+            if (*count < max)
+                b->trimmed++;
+            b->used += *count * size;
+            if (b->used > b->peak)
+                b->peak = b->used;
+            stop_waiting(b, held, waiting);
+            break;
+        }
+        // Only contexts that are not waiting themselves will ever release
+        if ((size_t)min * size > b->limit - held - others) {
+            b->refused++;
+            stop_waiting(b, held, waiting);
+            ret = MPP_ERR_NOMEM;
+            break;
+        }
+        if (!*waiting) {
+            *waiting = 1;
+            b->stalled += held;
+            b->waited++;
+            // Fewer contexts may release now: let the other waiters check again
+            pthread_cond_broadcast(&b->cond);
+        }
+        if (!timeout_ms) {
+            ret = MPP_ERR_TIMEOUT;
+            break;
+        }
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&b->cond, &b->lock);
+        } else if (pthread_cond_timedwait(&b->cond, &b->lock, &deadline)) {
+            ret = MPP_ERR_TIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+    if (ret)
+        *count = 0;
+    return ret;
+}
+
+// A context that was waiting goes away without its reservation
+void rk_dma_budget_cancel(RkDmaBudget *b, size_t held, RK_U32 *waiting)
+{
+    pthread_mutex_lock(&b->lock);
+    stop_waiting(b, held, waiting);
+    // Its held bytes may now be all that another waiter hopes for
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+}
+
+void rk_dma_budget_release(RkDmaBudget *b, size_t size)
+{
+    pthread_mutex_lock(&b->lock);
+    b->used = size < b->used ? b->used - size : 0;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+}
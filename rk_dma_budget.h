@@ -0,0 +1,44 @@
+#ifndef RK_DMA_BUDGET_H
+#define RK_DMA_BUDGET_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <rockchip/rk_mpi.h>
+
+/*
+ * DMA memory cap shared by every decoder in the process. Each context
+ * reserves its packet buffers when it starts and its frame pool at every
+ * info change, and gives them back when it goes away. A frame pool is
+ * capped at the context's fair share of the limit, so one stream cannot
+ * crowd out the others; a pool whose minimum does not fit yet waits for
+ * other contexts to release, and is refused only when waiting cannot
+ * help. Frames of an old size that are still draining after an info
+ * change are not counted.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;               // signalled on every release
+    size_t          limit;
+    size_t          used;
+    RK_U32          users;              // contexts sharing the limit
+    size_t          stalled;            // bytes held by contexts waiting for more
+
+    // Statistics
+    size_t          peak;
+    RK_U32          trimmed;            // reservations cut short to fit
+    RK_U32          waited;             // reservations that had to wait for a release
+    RK_U32          refused;            // reservations that could never fit
+} RkDmaBudget;
+
+// Function declarations
+MPP_RET rk_dma_budget_init(RkDmaBudget *b, size_t limit, RK_U32 users);
+void rk_dma_budget_deinit(RkDmaBudget *b);
+void rk_dma_budget_set_users(RkDmaBudget *b, RK_U32 users);
+MPP_RET rk_dma_budget_reserve(RkDmaBudget *b, size_t size);
+MPP_RET rk_dma_budget_reserve_count(RkDmaBudget *b, size_t size, RK_U32 min, RK_U32 max,
+                                    size_t held, RK_S32 timeout_ms, RK_U32 *waiting,
+                                    RK_U32 *count);
+void rk_dma_budget_cancel(RkDmaBudget *b, size_t held, RK_U32 *waiting);
+void rk_dma_budget_release(RkDmaBudget *b, size_t size);
+
+#endif // RK_DMA_BUDGET_H
@@ -0,0 +1,294 @@
+#include "rk_fbc.h"
+#include <string.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define ALIGN_UP(x, a)          (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+static RK_U32 rd32(const RK_U8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((RK_U32)p[3] << 24);
+}
+
+static void wr32(RK_U8 *p, RK_U32 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/*
+ * Geometry from the TRM: heads for a 64-aligned width and height plus one
+ * extra block row, the payload stream after the 4 KB aligned heads.
+ */
+void rk_fbc_layout(RkFbcLayout *layout, RK_U32 width, RK_U32 height)
+{
+    size_t w64 = ALIGN_UP(width, 64);
+    size_t h64 = ALIGN_UP(height, 64) + FBC_BLOCK_SIZE;
+
+    layout->width = width;
+    layout->height = height;
+    layout->blocks_x = w64 / FBC_BLOCK_SIZE;
+    layout->blocks_y = h64 / FBC_BLOCK_SIZE;
+    layout->head_stride = (size_t)layout->blocks_x * FBC_HEAD_SIZE;
+    layout->head_size = ALIGN_UP(layout->head_stride * layout->blocks_y, FBC_HEAD_ALIGN);
+    layout->max_size = layout->head_size + w64 * h64 * 3 / 2;
+}
+
+// Size code of sub-block i: bits 6i.. of the three words after the offset
+static RK_U32 sub_code(const RK_U32 *w, RK_U32 i)
+{
+    RK_U32 bit = 6 * i;
+    RK_U32 shift = bit % 32;
+    RK_U32 v = w[bit / 32] >> shift;
+
+    if (shift > 32 - 6)
+        v |= w[bit / 32 + 1] << (32 - shift);
+    return v & 63;
+}
+
+// Payload bytes of the block, adding its raw sub-blocks to *raw
+static size_t block_bytes(const RK_U8 *head, RK_U64 *raw)
+{
+    RK_U32 w[3] = { rd32(head + 4), rd32(head + 8), rd32(head + 12) };
+    size_t bytes = 0;
+    RK_U32 i;
+
+    for (i = 0; i < FBC_SUBBLOCKS; i++) {
+        RK_U32 code = sub_code(w, i);
+
+        if (code == FBC_SUBBLOCK_RAW_CODE) {
+            bytes += FBC_SUBBLOCK_RAW;
+            (*raw)++;
+        } else {
+            bytes += code;
+        }
+    }
+    return bytes;
+}
+
+size_t rk_fbc_block_bytes(const RK_U8 *head)
+{
+    RK_U64 raw = 0;
+
+    return block_bytes(head, &raw);
+}
+
+void rk_fbc_scan_row_scalar(const RK_U8 *heads, RK_U32 count, RkFbcStats *st)
+{
+    RK_U32 i;
+
+    for (i = 0; i < count; i++, heads += FBC_HEAD_SIZE) {
+        size_t bytes = block_bytes(heads, &st->raw_subblocks);
+        size_t end = rd32(heads) + bytes;
+
+        st->blocks++;
+        if (!bytes) {
+            st->solid_blocks++;
+            continue;
+        }
+        st->payload_bytes += bytes;
+        if (end > st->frame_bytes)
+            st->frame_bytes = end;
+    }
+}
+
+#ifdef __ARM_NEON
+// One 6-bit size field of four heads added to size, raw ones counted
+static inline uint32x4_t add_sub_size(uint32x4_t size, uint32x4_t field, uint32x4_t *raw)
+{
+    uint32x4_t code = vandq_u32(field, vdupq_n_u32(63));
+    uint32x4_t is_raw = vceqq_u32(code, vdupq_n_u32(FBC_SUBBLOCK_RAW_CODE));
+
+    // A true lane is all ones, subtracting it counts one
+    *raw = vsubq_u32(*raw, is_raw);
+    return vaddq_u32(size, vbslq_u32(is_raw, vdupq_n_u32(FBC_SUBBLOCK_RAW), code));
+}
+
+static inline RK_U64 sum_lanes(uint64x2_t v)
+{
+    return vgetq_lane_u64(v, 0) + vgetq_lane_u64(v, 1);
+}
+
+/*
+ * Four heads per iteration: vld4q puts the offsets in one register and each
+ * of the three size words in another, so every field is a shift and mask
+ * across the four blocks. Two fields straddle a word boundary.
+ */
+void rk_fbc_scan_row_neon(const RK_U8 *heads, RK_U32 count, RkFbcStats *st)
+{
+    uint64x2_t payload = vdupq_n_u64(0);
+    uint32x4_t end = vdupq_n_u32(0);
+    uint32x4_t solid = vdupq_n_u32(0);
+    uint32x4_t raw = vdupq_n_u32(0);
+    uint32x2_t max2;
+    RK_U32 i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4x4_t h = vld4q_u32((const uint32_t *)(heads + (size_t)i * FBC_HEAD_SIZE));
+        uint32x4_t w0 = h.val[1], w1 = h.val[2], w2 = h.val[3];
+        uint32x4_t size = vdupq_n_u32(0);
+        uint32x4_t zero;
+
+        size = add_sub_size(size, w0, &raw);
+        size = add_sub_size(size, vshrq_n_u32(w0, 6), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w0, 12), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w0, 18), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w0, 24), &raw);
+        size = add_sub_size(size, vorrq_u32(vshrq_n_u32(w0, 30), vshlq_n_u32(w1, 2)), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w1, 4), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w1, 10), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w1, 16), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w1, 22), &raw);
+        size = add_sub_size(size, vorrq_u32(vshrq_n_u32(w1, 28), vshlq_n_u32(w2, 4)), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w2, 2), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w2, 8), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w2, 14), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w2, 20), &raw);
+        size = add_sub_size(size, vshrq_n_u32(w2, 26), &raw);
+
+        // Solid blocks have no payload and do not move the end
+        zero = vceqq_u32(size, vdupq_n_u32(0));
+        solid = vsubq_u32(solid, zero);
+        payload = vpadalq_u32(payload, size);
+        end = vmaxq_u32(end, vbicq_u32(vaddq_u32(h.val[0], size), zero));
+    }
+
+    max2 = vmax_u32(vget_low_u32(end), vget_high_u32(end));
+    max2 = vpmax_u32(max2, max2);
+    if (vget_lane_u32(max2, 0) > st->frame_bytes)
+        st->frame_bytes = vget_lane_u32(max2, 0);
+    st->blocks += i;
+    st->payload_bytes += sum_lanes(payload);
+    st->solid_blocks += sum_lanes(vpaddlq_u32(solid));
+    st->raw_subblocks += sum_lanes(vpaddlq_u32(raw));
+    rk_fbc_scan_row_scalar(heads + (size_t)i * FBC_HEAD_SIZE, count - i, st);
+}
+#endif
+
+/*
+ * Sum the heads of a frame at base. frame_bytes is what the frame really
+ * occupies: the heads and the payload up to the end of its last block.
+ */
+void rk_fbc_stats_with(const RK_U8 *base, const RkFbcLayout *layout, RkFbcStats *st,
+                       RkFbcScanFn scan)
+{
+    RK_U32 y;
+
+    memset(st, 0, sizeof(RkFbcStats));
+    st->head_bytes = layout->head_stride * layout->blocks_y;
+    st->frame_bytes = layout->head_size;
+    for (y = 0; y < layout->blocks_y; y++)
+        scan(base + y * layout->head_stride, layout->blocks_x, st);
+    if (st->frame_bytes > layout->max_size)
+        st->frame_bytes = layout->max_size;
+}
+
+void rk_fbc_stats(const RK_U8 *base, const RkFbcLayout *layout, RkFbcStats *st)
+{
+#ifdef __ARM_NEON
+    rk_fbc_stats_with(base, layout, st, rk_fbc_scan_row_neon);
+#else
+    rk_fbc_stats_with(base, layout, st, rk_fbc_scan_row_scalar);
+#endif
+}
+
+// Running totals over frames: frame_bytes adds up to the DDR traffic
+void rk_fbc_stats_add(RkFbcStats *sum, const RkFbcStats *st)
+{
+    sum->head_bytes += st->head_bytes;
+    sum->payload_bytes += st->payload_bytes;
+    sum->frame_bytes += st->frame_bytes;
+    sum->blocks += st->blocks;
+    sum->solid_blocks += st->solid_blocks;
+    sum->raw_subblocks += st->raw_subblocks;
+}
+
+// The blocks covering roi, clipped to the picture
+void rk_fbc_roi_blocks(const RkFbcLayout *layout, const RkFbcRect *roi, RkFbcRect *blocks)
+{
+    RK_U32 cols = (layout->width + FBC_BLOCK_SIZE - 1) / FBC_BLOCK_SIZE;
+    RK_U32 rows = (layout->height + FBC_BLOCK_SIZE - 1) / FBC_BLOCK_SIZE;
+    RK_U64 x1 = ((RK_U64)roi->x + roi->width + FBC_BLOCK_SIZE - 1) / FBC_BLOCK_SIZE;
+    RK_U64 y1 = ((RK_U64)roi->y + roi->height + FBC_BLOCK_SIZE - 1) / FBC_BLOCK_SIZE;
+
+    blocks->x = roi->x / FBC_BLOCK_SIZE;
+    blocks->y = roi->y / FBC_BLOCK_SIZE;
+    if (x1 > cols)
+        x1 = cols;
+    if (y1 > rows)
+        y1 = rows;
+    blocks->width = x1 > blocks->x ? x1 - blocks->x : 0;
+    blocks->height = y1 > blocks->y ? y1 - blocks->y : 0;
+}
+
+// Payload bytes of a block and where they are; 0 when they are not in the buffer
+static size_t block_payload(const RkFbcLayout *layout, const RK_U8 *head, size_t *offset)
+{
+    size_t bytes = rk_fbc_block_bytes(head);
+
+    *offset = rd32(head);
+    if (*offset < layout->head_size || *offset > layout->max_size - bytes)
+        return 0;
+    return bytes;
+}
+
+// rk_fbc_extract() output size for roi of the frame at base
+size_t rk_fbc_roi_size(const RK_U8 *base, const RkFbcLayout *layout, const RkFbcRect *roi)
+{
+    RkFbcRect b;
+    size_t size, offset;
+    RK_U32 x, y;
+
+    rk_fbc_roi_blocks(layout, roi, &b);
+    size = (size_t)b.width * b.height * FBC_HEAD_SIZE;
+    for (y = 0; y < b.height; y++) {
+        const RK_U8 *head = base + (b.y + y) * layout->head_stride + (size_t)b.x * FBC_HEAD_SIZE;
+
+        for (x = 0; x < b.width; x++, head += FBC_HEAD_SIZE)
+            size += ALIGN_UP(block_payload(layout, head, &offset), FBC_PAYLOAD_ALIGN);
+    }
+    return size;
+}
+
+/*
+ * Copy the blocks covering roi out of the frame at base into dst as a
+ * compact FBC buffer of its own: the region's heads in raster order, then
+ * their payload, offsets rewritten to match. Only those heads and payload
+ * blocks are read, the rest of the frame is not touched. Returns the
+ * bytes written, rk_fbc_roi_size() of the same region.
+ */
+size_t rk_fbc_extract(RK_U8 *dst, const RK_U8 *base, const RkFbcLayout *layout,
+                      const RkFbcRect *roi)
+{
+    RkFbcRect b;
+    RK_U8 *out = dst;
+    size_t pos;
+    RK_U32 x, y;
+
+    rk_fbc_roi_blocks(layout, roi, &b);
+    pos = (size_t)b.width * b.height * FBC_HEAD_SIZE;
+    for (y = 0; y < b.height; y++) {
+        const RK_U8 *head = base + (b.y + y) * layout->head_stride + (size_t)b.x * FBC_HEAD_SIZE;
+
+        for (x = 0; x < b.width; x++, head += FBC_HEAD_SIZE, out += FBC_HEAD_SIZE) {
+            size_t offset;
+            size_t bytes = block_payload(layout, head, &offset);
+            size_t next = ALIGN_UP(pos + bytes, FBC_PAYLOAD_ALIGN);
+
+            memcpy(out, head, FBC_HEAD_SIZE);
+            // Solid, or pointing outside the frame: no payload
+            if (!bytes) {
+                memset(out + 4, 0, FBC_HEAD_SIZE - 4);
+                continue;
+            }
+            memcpy(dst + pos, base + offset, bytes);
+            memset(dst + pos + bytes, 0, next - pos - bytes);
+            wr32(out, pos);
+            pos = next;
+        }
+    }
+    return pos;
+}
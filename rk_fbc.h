@@ -0,0 +1,75 @@
+#ifndef RK_FBC_H
+#define RK_FBC_H
+
+#include <stddef.h>
+#include <rockchip/rk_type.h>
+
+/*
+ * FBC frame (TRM 5.3.8): a raster of 128-bit heads, one per 16x16 block,
+ * then the compact payload stream. Heads follow AFBC 1.x: a 32-bit payload
+ * offset from the head base, then sixteen 6-bit sizes of the block's 4x4
+ * sub-blocks in bytes, 1 meaning stored uncompressed. A block whose sizes
+ * are all zero is a solid colour with no payload.
+ *
+ * The payload coding itself is not documented, so the CPU side works per
+ * block: what a frame occupies in DDR, and cutting a tile region out with
+ * its heads so a consumer reads only those blocks.
+ */
+#define FBC_BLOCK_SIZE          16
+#define FBC_HEAD_SIZE           16
+#define FBC_SUBBLOCKS           16
+// 8-bit 4:2:0 4x4 sub-block stored as is: 16 Y, 4 Cb, 4 Cr
+#define FBC_SUBBLOCK_RAW        24
+#define FBC_SUBBLOCK_RAW_CODE   1
+#define FBC_HEAD_ALIGN          4096
+// Payload block start in an extracted region
+#define FBC_PAYLOAD_ALIGN       16
+
+typedef struct {
+    RK_U32          width;
+    RK_U32          height;
+    RK_U32          blocks_x;           // heads per row, ceil64(width) / 16
+    RK_U32          blocks_y;           // (ceil64(height) + 16) / 16
+    size_t          head_stride;        // bytes per head row
+    size_t          head_size;          // payload stream starts here
+    size_t          max_size;           // heads plus a payload that did not compress
+} RkFbcLayout;
+
+// Block-aligned region in picture pixels
+typedef struct {
+    RK_U32          x;
+    RK_U32          y;
+    RK_U32          width;
+    RK_U32          height;
+} RkFbcRect;
+
+// What one frame holds, summed per block
+typedef struct {
+    RK_U64          head_bytes;
+    RK_U64          payload_bytes;
+    RK_U64          frame_bytes;        // head base to the last payload byte
+    RK_U64          blocks;
+    RK_U64          solid_blocks;
+    RK_U64          raw_subblocks;
+} RkFbcStats;
+
+// Adds one head row of count heads into st
+typedef void (*RkFbcScanFn)(const RK_U8 *heads, RK_U32 count, RkFbcStats *st);
+
+// Function declarations
+void rk_fbc_layout(RkFbcLayout *layout, RK_U32 width, RK_U32 height);
+size_t rk_fbc_block_bytes(const RK_U8 *head);
+void rk_fbc_scan_row_scalar(const RK_U8 *heads, RK_U32 count, RkFbcStats *st);
+#ifdef __ARM_NEON
+void rk_fbc_scan_row_neon(const RK_U8 *heads, RK_U32 count, RkFbcStats *st);
+#endif
+void rk_fbc_stats_with(const RK_U8 *base, const RkFbcLayout *layout, RkFbcStats *st,
+                       RkFbcScanFn scan);
+void rk_fbc_stats(const RK_U8 *base, const RkFbcLayout *layout, RkFbcStats *st);
+void rk_fbc_stats_add(RkFbcStats *sum, const RkFbcStats *st);
+void rk_fbc_roi_blocks(const RkFbcLayout *layout, const RkFbcRect *roi, RkFbcRect *blocks);
+size_t rk_fbc_roi_size(const RK_U8 *base, const RkFbcLayout *layout, const RkFbcRect *roi);
+size_t rk_fbc_extract(RK_U8 *dst, const RK_U8 *base, const RkFbcLayout *layout,
+                      const RkFbcRect *roi);
+
+#endif // RK_FBC_H
@@ -0,0 +1,236 @@
+#define MODULE_TAG "rk_frame_consumer"
+
+/*
+ * Reference consumer for rk_vpu_demo -E: connects to the export socket,
+ * maps each frame's buffer fd read-only, checksums the picture in place
+ * and acks it. -d holds every frame for a while, like an inference or
+ * display process would, to see the decoder throttled by the acks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <rockchip/mpp_log.h>
+#include "rk_frame_export.h"
+#include "rk_frame_crc.h"
+
+// How long to retry while the decoder has not created the socket yet
+#define CONSUMER_CONNECT_MS     5000
+#define CONSUMER_RETRY_US       10000
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static int connect_export(const char *path)
+{
+    struct sockaddr_un addr;
+    RK_U32 tries = CONSUMER_CONNECT_MS * 1000 / CONSUMER_RETRY_US;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    while (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        if ((errno != ENOENT && errno != ECONNREFUSED) || !tries--) {
+            close(fd);
+            return -1;
+        }
+        usleep(CONSUMER_RETRY_US);
+    }
+    return fd;
+}
+
+// One message and the fd it carries, -1 for none; returns the bytes read
+static ssize_t recv_msg(int fd, RkFrameExportMsg *msg, int *buf_fd)
+{
+    union {
+        struct cmsghdr  hdr;
+        char            buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+    struct iovec iov = { msg, sizeof(RkFrameExportMsg) };
+    struct cmsghdr *cmsg;
+    struct msghdr mh;
+    ssize_t n;
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctrl.buf;
+    mh.msg_controllen = sizeof(ctrl.buf);
+    do {
+        n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+
+    *buf_fd = -1;
+    for (cmsg = CMSG_FIRSTHDR(&mh); n > 0 && cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(buf_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return n;
+}
+
+// Picture geometry as the decoder context derives it at info change
+static void msg_layout(const RkFrameExportMsg *msg, RkYuvLayout *layout)
+{
+    memset(layout, 0, sizeof(RkYuvLayout));
+    layout->width = msg->width;
+    layout->height = msg->height;
+    layout->hor_stride = msg->hor_stride;
+    layout->ver_stride = msg->ver_stride;
+    layout->fbc = MPP_FRAME_FMT_IS_FBC(msg->format) != 0;
+    layout->bit_depth = (msg->format & MPP_FRAME_FMT_MASK) == MPP_FMT_YUV420SP_10BIT ? 10 : 8;
+    layout->tile = MPP_FRAME_FMT_IS_TILE(msg->format) ? YUV_TILE_SIZE : 0;
+}
+
+static void usage(const char *prog)
+{
+    mpp_err("Usage: %s [-d ms] [-g golden] [-G golden] socket\n", prog);
+    mpp_err("  -d ms     hold each frame this long before the ack (default 0)\n");
+    mpp_err("  -g file   verify the frame CRC-32s against a golden list\n");
+    mpp_err("  -G file   write the frame CRC-32s as a golden list\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *golden_file = NULL, *golden_out = NULL;
+    RkCrcList crcs, golden;
+    RK_U32 hold_us = 0;
+    RK_U64 frames = 0, bytes = 0;
+    double start = 0, elapsed, map_time = 0;
+    MPP_RET ret = MPP_OK;
+    RK_U32 eos = 0;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "d:g:G:")) != -1) {
+        switch (opt) {
+        case 'd':
+            hold_us = atoi(optarg) * 1000;
+            break;
+        case 'g':
+            golden_file = optarg;
+            break;
+        case 'G':
+            golden_out = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    rk_crc_list_init(&crcs);
+    rk_crc_list_init(&golden);
+    if (golden_file && rk_crc_list_load(&golden, golden_file))
+        return 1;
+
+    fd = connect_export(argv[optind]);
+    if (fd < 0) {
+        mpp_err("Failed to connect to %s\n", argv[optind]);
+        return 1;
+    }
+
+    while (!ret) {
+        RkFrameExportMsg msg;
+        RkFrameExportAck ack;
+        RkYuvLayout layout;
+        double t;
+        void *ptr;
+        int buf_fd;
+        ssize_t n = recv_msg(fd, &msg, &buf_fd);
+
+        if (n != sizeof(msg) || msg.magic != FRAME_EXPORT_MAGIC ||
+            msg.version != FRAME_EXPORT_VERSION) {
+            if (buf_fd >= 0)
+                close(buf_fd);
+            if (n)
+                mpp_err("Bad message from the decoder\n");
+            ret = MPP_NOK;
+            break;
+        }
+        if (msg.type == FRAME_EXPORT_MSG_EOS) {
+            eos = 1;
+            break;
+        }
+        if (buf_fd < 0) {
+            mpp_err("Frame %llu came without its buffer\n", (unsigned long long)msg.seq);
+            ret = MPP_NOK;
+            break;
+        }
+        if (!frames)
+            start = get_time_in_seconds();
+
+        // The decoder's buffer itself: nothing is copied on either side
+        t = get_time_in_seconds();
+        ptr = mmap(NULL, msg.size, PROT_READ, MAP_SHARED, buf_fd, 0);
+        map_time += get_time_in_seconds() - t;
+        if (ptr == MAP_FAILED) {
+            mpp_err("Failed to map frame %llu\n", (unsigned long long)msg.seq);
+            close(buf_fd);
+            ret = MPP_NOK;
+            break;
+        }
+        msg_layout(&msg, &layout);
+        if (!layout.fbc && rk_crc_list_add(&crcs, rk_frame_crc(ptr, &layout), msg.width,
+                                           msg.height))
+            ret = MPP_ERR_MALLOC;
+        if (hold_us)
+            usleep(hold_us);
+        munmap(ptr, msg.size);
+        close(buf_fd);
+
+        ack.magic = FRAME_EXPORT_MAGIC;
+        ack.slot = msg.slot;
+        ack.seq = msg.seq;
+        if (send(fd, &ack, sizeof(ack), MSG_NOSIGNAL) != sizeof(ack)) {
+            mpp_err("Failed to ack frame %llu\n", (unsigned long long)msg.seq);
+            ret = MPP_NOK;
+        }
+        frames++;
+        bytes += msg.size;
+    }
+    close(fd);
+
+    elapsed = frames ? get_time_in_seconds() - start : 0;
+    mpp_log("%llu frames%s, %.1f fps, %llu MB mapped in place (0 bytes copied), "
+            "map %.1f us per frame\n", (unsigned long long)frames,
+            eos ? "" : " (no end of stream)", elapsed > 0 ? frames / elapsed : 0,
+            (unsigned long long)(bytes >> 20), frames ? map_time / frames * 1e6 : 0);
+    if (!ret && golden_out && rk_crc_list_save(&crcs, golden_out))
+        ret = MPP_NOK;
+    if (!ret && golden_file) {
+        RK_S32 first;
+        RK_U32 bad = rk_crc_list_compare(&crcs, &golden, &first);
+
+        if (bad) {
+            mpp_err("%d of %d frames differ from the golden list (%d received, %d golden), "
+                    "first %d\n", bad, crcs.count > golden.count ? crcs.count : golden.count,
+                    crcs.count, golden.count, first);
+            ret = MPP_NOK;
+        } else {
+            mpp_log("all %d frame checksums match\n", crcs.count);
+        }
+    }
+    rk_crc_list_deinit(&crcs);
+    rk_crc_list_deinit(&golden);
+    return ret || !eos ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+#include "rk_frame_crc.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef __ARM_FEATURE_CRC32
+#include <arm_acle.h>
+#endif
+#include <rockchip/mpp_log.h>
+
+// Reflected 0x04C11DB7, as zlib and the ARMv8 CRC32 instructions use
+#define CRC32_POLY              0xEDB88320u
+
+static RK_U32 crc_table[8][256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+// Slicing-by-8 tables: table[k][b] is b's CRC advanced k more zero bytes
+static void crc_table_init(void)
+{
+    RK_U32 i, k;
+
+    for (i = 0; i < 256; i++) {
+        RK_U32 c = i;
+
+        for (k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+        crc_table[0][i] = c;
+    }
+    for (i = 0; i < 256; i++) {
+        for (k = 1; k < 8; k++)
+            crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+    }
+}
+
+// Eight bytes per step through eight table lookups
+RK_U32 rk_crc32_scalar(RK_U32 crc, const RK_U8 *data, size_t len)
+{
+    pthread_once(&crc_table_once, crc_table_init);
+
+    crc = ~crc;
+    while (len >= 8) {
+        RK_U32 lo = crc ^ (data[0] | data[1] << 8 | data[2] << 16 | (RK_U32)data[3] << 24);
+        RK_U32 hi = data[4] | data[5] << 8 | data[6] << 16 | (RK_U32)data[7] << 24;
+
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+              crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+              crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+    return ~crc;
+}
+
+#ifdef __ARM_FEATURE_CRC32
+/*
+ * crc32x takes 8 bytes per instruction. The chain is serial, but at one
+ * result every 2 cycles it still outruns what the DMA buffer reads deliver.
+ */
+RK_U32 rk_crc32_arm(RK_U32 crc, const RK_U8 *data, size_t len)
+{
+    crc = ~crc;
+    while (len && ((uintptr_t)data & 7)) {
+        crc = __crc32b(crc, *data++);
+        len--;
+    }
+    while (len >= 32) {
+        const uint64_t *p = (const uint64_t *)data;
+
+        crc = __crc32d(crc, p[0]);
+        crc = __crc32d(crc, p[1]);
+        crc = __crc32d(crc, p[2]);
+        crc = __crc32d(crc, p[3]);
+        data += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        crc = __crc32d(crc, *(const uint64_t *)data);
+        data += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = __crc32b(crc, *data++);
+    return ~crc;
+}
+#endif
+
+RK_U32 rk_crc32(RK_U32 crc, const RK_U8 *data, size_t len)
+{
+#ifdef __ARM_FEATURE_CRC32
+    return rk_crc32_arm(crc, data, len);
+#else
+    return rk_crc32_scalar(crc, data, len);
+#endif
+}
+
+const char *rk_crc32_impl_name(void)
+{
+#ifdef __ARM_FEATURE_CRC32
+    return "ARMv8 crc32x";
+#else
+    return "slicing-by-8";
+#endif
+}
+
+/*
+ * Chain one picture row of a tiled plane, tile by tile: row r of a tile
+ * row starting at src. The checksum comes out as for the linear row.
+ */
+static RK_U32 crc_tiled_row(RK_U32 crc, const RK_U8 *src, RK_U32 tile_w, RK_U32 tile_h,
+                            RK_U32 r, size_t len, RkCrc32Fn fn)
+{
+    size_t x;
+
+    src += (size_t)r * tile_w;
+    for (x = 0; x < len; x += tile_w, src += (size_t)tile_w * tile_h)
+        crc = fn(crc, src, len - x < tile_w ? len - x : tile_w);
+    return crc;
+}
+
+/*
+ * Checksum of the cropped NV12 picture, read in place from the decoded
+ * frame. Tiled frames give the checksum of their linear picture; 10-bit
+ * frames cover each row's compact samples.
+ */
+RK_U32 rk_frame_crc_with(const RK_U8 *src, const RkYuvLayout *layout, RkCrc32Fn fn)
+{
+    const RK_U8 *uv = src + (size_t)layout->hor_stride * layout->ver_stride;
+    size_t stride = layout->hor_stride;
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+    size_t luma = layout->width;
+    size_t chroma = 2 * cw;
+    RK_U32 t = layout->tile;
+    RK_U32 crc = 0;
+    RK_U32 y;
+
+    if (layout->bit_depth == 10) {
+        luma = (luma * 10 + 7) / 8;
+        chroma = (chroma * 10 + 7) / 8;
+    }
+    if (t && layout->bit_depth != 10) {
+        for (y = 0; y < layout->height; y++)
+            crc = crc_tiled_row(crc, src + (y - y % t) * stride, t, t, y % t, luma, fn);
+        for (y = 0; y < ch; y++)
+            crc = crc_tiled_row(crc, uv + (y - y % (t / 2)) * stride, t, t / 2, y % (t / 2),
+                                chroma, fn);
+        return crc;
+    }
+
+    for (y = 0; y < layout->height; y++)
+        crc = fn(crc, src + (size_t)y * stride, luma);
+    for (y = 0; y < ch; y++)
+        crc = fn(crc, uv + (size_t)y * stride, chroma);
+    return crc;
+}
+
+RK_U32 rk_frame_crc(const RK_U8 *src, const RkYuvLayout *layout)
+{
+    return rk_frame_crc_with(src, layout, rk_crc32);
+}
+
+void rk_crc_list_init(RkCrcList *list)
+{
+    memset(list, 0, sizeof(RkCrcList));
+}
+
+void rk_crc_list_deinit(RkCrcList *list)
+{
+    free(list->crcs);
+    free(list->sizes);
+    memset(list, 0, sizeof(RkCrcList));
+}
+
+MPP_RET rk_crc_list_add(RkCrcList *list, RK_U32 crc, RK_U32 width, RK_U32 height)
+{
+    if (list->count == list->cap) {
+        RK_U32 cap = list->cap ? list->cap * 2 : 1024;
+        RK_U32 *crcs, *sizes;
+
+        if (cap > CRC_LIST_MAX) {
+            mpp_err("more than %d frame checksums\n", CRC_LIST_MAX);
+            return MPP_NOK;
+        }
+        crcs = realloc(list->crcs, cap * sizeof(RK_U32));
+        if (!crcs)
+            return MPP_ERR_MALLOC;
+        list->crcs = crcs;
+        sizes = realloc(list->sizes, cap * sizeof(RK_U32));
+        if (!sizes)
+            return MPP_ERR_MALLOC;
+        list->sizes = sizes;
+        list->cap = cap;
+    }
+    list->crcs[list->count] = crc;
+    list->sizes[list->count] = width << 16 | height;
+    list->count++;
+    return MPP_OK;
+}
+
+/*
+ * One frame per line, "index WxH crc32" in hex; lines starting with # are
+ * comments. The index is informative, frames are taken in file order.
+ */
+MPP_RET rk_crc_list_load(RkCrcList *list, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    RK_U32 lineno = 0;
+    MPP_RET ret = MPP_OK;
+
+    rk_crc_list_init(list);
+    if (!fp) {
+        mpp_err("Failed to open golden list %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        RK_U32 index, width, height, crc;
+
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf(line, "%u %ux%u %x", &index, &width, &height, &crc) != 4) {
+            mpp_err("%s:%d: expected \"index WxH crc32\"\n", path, lineno);
+            ret = MPP_ERR_VALUE;
+            break;
+        }
+        ret = rk_crc_list_add(list, crc, width, height);
+        if (ret)
+            break;
+    }
+    fclose(fp);
+
+    if (ret)
+        rk_crc_list_deinit(list);
+    return ret;
+}
+
+MPP_RET rk_crc_list_save(const RkCrcList *list, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    RK_U32 i;
+
+    if (!fp) {
+        mpp_err("Failed to open golden list %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    fprintf(fp, "# CRC-32 (zlib) of each frame's cropped NV12 picture: index WxH crc32\n");
+    for (i = 0; i < list->count; i++)
+        fprintf(fp, "%u %ux%u %08x\n", i, list->sizes[i] >> 16, list->sizes[i] & 0xffff,
+                list->crcs[i]);
+
+    if (fclose(fp)) {
+        mpp_err("Failed to write golden list %s\n", path);
+        return MPP_NOK;
+    }
+    return MPP_OK;
+}
+
+// Frames that differ, missing and extra frames included; *first is -1 if none
+RK_U32 rk_crc_list_compare(const RkCrcList *got, const RkCrcList *golden, RK_S32 *first)
+{
+    RK_U32 n = got->count < golden->count ? got->count : golden->count;
+    RK_U32 bad = 0;
+    RK_U32 i;
+
+    *first = -1;
+    for (i = 0; i < n; i++) {
+        if (got->crcs[i] == golden->crcs[i] && got->sizes[i] == golden->sizes[i])
+            continue;
+        if (!bad)
+            *first = i;
+        bad++;
+    }
+    if (got->count != golden->count) {
+        if (!bad)
+            *first = n;
+        bad += got->count > golden->count ? got->count - n : golden->count - n;
+    }
+    return bad;
+}
@@ -0,0 +1,46 @@
+#ifndef RK_FRAME_CRC_H
+#define RK_FRAME_CRC_H
+
+#include <stddef.h>
+#include <rockchip/rk_type.h>
+#include <rockchip/mpp_err.h>
+#include "rk_yuv_crop.h"
+
+// Frames a golden list may hold
+#define CRC_LIST_MAX            (1024 * 1024)
+
+/*
+ * CRC-32 with the zlib polynomial, chained like zlib's crc32(): pass 0 to
+ * start and the previous result to continue. Frame checksums cover the
+ * visible NV12 picture, luma rows then interleaved chroma rows, which is
+ * exactly what -o nv12 writes; a golden list can be made from any
+ * decoder's cropped NV12 output with zlib.crc32 per frame.
+ */
+typedef RK_U32 (*RkCrc32Fn)(RK_U32 crc, const RK_U8 *data, size_t len);
+
+// Per-frame checksums in output order, with the picture size of each
+typedef struct {
+    RK_U32         *crcs;
+    RK_U32         *sizes;              // width << 16 | height
+    RK_U32          count;
+    RK_U32          cap;
+} RkCrcList;
+
+// Function declarations
+RK_U32 rk_crc32_scalar(RK_U32 crc, const RK_U8 *data, size_t len);
+#ifdef __ARM_FEATURE_CRC32
+RK_U32 rk_crc32_arm(RK_U32 crc, const RK_U8 *data, size_t len);
+#endif
+RK_U32 rk_crc32(RK_U32 crc, const RK_U8 *data, size_t len);
+const char *rk_crc32_impl_name(void);
+RK_U32 rk_frame_crc(const RK_U8 *src, const RkYuvLayout *layout);
+RK_U32 rk_frame_crc_with(const RK_U8 *src, const RkYuvLayout *layout, RkCrc32Fn fn);
+
+void rk_crc_list_init(RkCrcList *list);
+void rk_crc_list_deinit(RkCrcList *list);
+MPP_RET rk_crc_list_add(RkCrcList *list, RK_U32 crc, RK_U32 width, RK_U32 height);
+MPP_RET rk_crc_list_load(RkCrcList *list, const char *path);
+MPP_RET rk_crc_list_save(const RkCrcList *list, const char *path);
+RK_U32 rk_crc_list_compare(const RkCrcList *got, const RkCrcList *golden, RK_S32 *first);
+
+#endif // RK_FRAME_CRC_H
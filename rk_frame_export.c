@@ -0,0 +1,317 @@
+#include "rk_frame_export.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// One message, with buf_fd as SCM_RIGHTS unless it is negative
+static MPP_RET send_msg(RkFrameExport *ex, const RkFrameExportMsg *msg, int buf_fd)
+{
+    union {
+        struct cmsghdr  hdr;
+        char            buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+    struct iovec iov = { (void *)msg, sizeof(RkFrameExportMsg) };
+    struct msghdr mh;
+    ssize_t n;
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (buf_fd >= 0) {
+        struct cmsghdr *cmsg;
+
+        memset(&ctrl, 0, sizeof(ctrl));
+        mh.msg_control = ctrl.buf;
+        mh.msg_controllen = sizeof(ctrl.buf);
+        cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &buf_fd, sizeof(int));
+    }
+
+    do {
+        n = sendmsg(ex->fd, &mh, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n == (ssize_t)sizeof(RkFrameExportMsg) ? MPP_OK : MPP_NOK;
+}
+
+// Buffers still lent go back to the pool; caller holds the lock
+static void release_slots(RkFrameExport *ex)
+{
+    RK_U32 i;
+
+    for (i = 0; i < FRAME_EXPORT_MAX; i++) {
+        if (ex->slots[i].buf) {
+            mpp_buffer_put(ex->slots[i].buf);
+            ex->slots[i].buf = NULL;
+        }
+    }
+    ex->lent = 0;
+}
+
+/*
+ * Ack thread: each ack returns its frame's buffer to the decoder's pool
+ * and opens a slot. When the consumer hangs up, or sends something that
+ * is not an ack for a lent frame, whatever it held goes back too and the
+ * decoder side fails on its next push.
+ */
+static void *ack_thread(void *arg)
+{
+    RkFrameExport *ex = (RkFrameExport *)arg;
+    RkFrameExportAck ack;
+    ssize_t n;
+
+    for (;;) {
+        RkFrameExportSlot *s;
+        double held;
+
+        n = recv(ex->fd, &ack, sizeof(ack), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n != sizeof(ack))
+            break;
+
+        pthread_mutex_lock(&ex->lock);
+        s = ack.slot < ex->depth ? &ex->slots[ack.slot] : NULL;
+        if (ack.magic != FRAME_EXPORT_MAGIC || !s || !s->buf || s->seq != ack.seq) {
+            pthread_mutex_unlock(&ex->lock);
+            mpp_err("Bad ack from the frame consumer: slot %u frame %llu\n", ack.slot,
+                    (unsigned long long)ack.seq);
+            break;
+        }
+        mpp_buffer_put(s->buf);
+        s->buf = NULL;
+        ex->lent--;
+        ex->acks++;
+        held = get_time_in_seconds() - s->sent;
+        ex->hold_sum += held;
+        if (held > ex->hold_max)
+            ex->hold_max = held;
+        pthread_cond_broadcast(&ex->cond);
+        pthread_mutex_unlock(&ex->lock);
+    }
+
+    pthread_mutex_lock(&ex->lock);
+    ex->closed = 1;
+    release_slots(ex);
+    pthread_cond_broadcast(&ex->cond);
+    pthread_mutex_unlock(&ex->lock);
+    return NULL;
+}
+
+/*
+ * Listen on path and wait for the consumer to connect. The socket file is
+ * removed once it has: one consumer per run.
+ */
+MPP_RET rk_frame_export_init(RkFrameExport *ex, const char *path, RK_U32 depth)
+{
+    struct sockaddr_un addr;
+    MPP_RET ret = MPP_NOK;
+    int lfd;
+
+    memset(ex, 0, sizeof(RkFrameExport));
+    ex->fd = -1;
+    ex->depth = depth < 1 ? 1 : depth > FRAME_EXPORT_MAX ? FRAME_EXPORT_MAX : depth;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        mpp_err("Socket path too long: %s\n", path);
+        return MPP_ERR_VALUE;
+    }
+    snprintf(ex->path, sizeof(ex->path), "%s", path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+    lfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        mpp_err("Failed to create the export socket\n");
+        return MPP_NOK;
+    }
+    // A socket left by an earlier run
+    unlink(path);
+    if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) || listen(lfd, 1)) {
+        mpp_err("Failed to listen on %s\n", path);
+        goto ERR_RET;
+    }
+
+    mpp_log("Waiting for a frame consumer on %s\n", path);
+    do {
+        ex->fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+    } while (ex->fd < 0 && errno == EINTR);
+    unlink(path);
+    if (ex->fd < 0) {
+        mpp_err("Failed to accept the frame consumer\n");
+        goto ERR_RET;
+    }
+
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->cond, NULL);
+    ex->lock_ready = 1;
+    if (pthread_create(&ex->thread, NULL, ack_thread, ex)) {
+        mpp_err("Failed to create the ack thread\n");
+        goto ERR_RET;
+    }
+    ex->thread_started = 1;
+    ret = MPP_OK;
+
+ERR_RET:
+    close(lfd);
+    if (ret)
+        rk_frame_export_deinit(ex);
+    return ret;
+}
+
+/*
+ * Lend the frame's buffer to the consumer: a reference is taken for the
+ * slot and the fd sent with the picture geometry. Blocks while depth
+ * frames are out. Fails once the consumer has gone.
+ */
+MPP_RET rk_frame_export_push(RkFrameExport *ex, MppFrame frame)
+{
+    MppBuffer buf = mpp_frame_get_buffer(frame);
+    double start = get_time_in_seconds();
+    RkFrameExportMsg msg;
+    RkFrameExportSlot *s;
+    RK_U32 slot;
+
+    pthread_mutex_lock(&ex->lock);
+    if (ex->lent == ex->depth)
+        ex->stalls++;
+    while (ex->lent == ex->depth && !ex->closed)
+        pthread_cond_wait(&ex->cond, &ex->lock);
+    if (ex->closed) {
+        RK_U64 acks = ex->acks;
+
+        pthread_mutex_unlock(&ex->lock);
+        mpp_err("The frame consumer went away after %llu frames\n", (unsigned long long)acks);
+        return MPP_NOK;
+    }
+    for (slot = 0; ex->slots[slot].buf; slot++)
+        ;
+    s = &ex->slots[slot];
+    mpp_buffer_inc_ref(buf);
+    s->buf = buf;
+    s->seq = ex->seq++;
+    s->sent = get_time_in_seconds();
+    ex->push_wait += s->sent - start;
+    ex->lent++;
+    if (ex->lent > ex->peak_lent)
+        ex->peak_lent = ex->lent;
+    pthread_mutex_unlock(&ex->lock);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = FRAME_EXPORT_MAGIC;
+    msg.version = FRAME_EXPORT_VERSION;
+    msg.type = FRAME_EXPORT_MSG_FRAME;
+    msg.slot = slot;
+    msg.format = mpp_frame_get_fmt(frame);
+    msg.width = mpp_frame_get_width(frame);
+    msg.height = mpp_frame_get_height(frame);
+    msg.hor_stride = mpp_frame_get_hor_stride(frame);
+    msg.ver_stride = mpp_frame_get_ver_stride(frame);
+    msg.seq = s->seq;
+    msg.size = mpp_buffer_get_size(buf);
+    msg.pts = mpp_frame_get_pts(frame);
+
+    if (send_msg(ex, &msg, mpp_buffer_get_fd(buf))) {
+        mpp_err("Failed to send frame %llu to the consumer\n", (unsigned long long)msg.seq);
+        // Unless the ack thread already gave it back on the hang-up
+        pthread_mutex_lock(&ex->lock);
+        if (s->buf == buf && s->seq == msg.seq) {
+            mpp_buffer_put(buf);
+            s->buf = NULL;
+            ex->lent--;
+        }
+        pthread_mutex_unlock(&ex->lock);
+        return MPP_NOK;
+    }
+    ex->frames++;
+    ex->bytes += msg.size;
+    return MPP_OK;
+}
+
+// Frames the consumer holds now
+RK_U32 rk_frame_export_lent(RkFrameExport *ex)
+{
+    RK_U32 lent;
+
+    pthread_mutex_lock(&ex->lock);
+    lent = ex->lent;
+    pthread_mutex_unlock(&ex->lock);
+    return lent;
+}
+
+/*
+ * End of stream: tell the consumer and wait up to FRAME_EXPORT_DRAIN_MS
+ * for the frames it still holds, so every buffer is back before the
+ * decoder goes away.
+ */
+MPP_RET rk_frame_export_finish(RkFrameExport *ex)
+{
+    RkFrameExportMsg msg;
+    struct timespec deadline;
+    MPP_RET ret = MPP_OK;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.magic = FRAME_EXPORT_MAGIC;
+    msg.version = FRAME_EXPORT_VERSION;
+    msg.type = FRAME_EXPORT_MSG_EOS;
+    msg.seq = ex->seq;
+
+    // Not under the lock: the ack thread may need it to drain the socket
+    if (send_msg(ex, &msg, -1))
+        ret = MPP_NOK;
+
+    pthread_mutex_lock(&ex->lock);
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += FRAME_EXPORT_DRAIN_MS / 1000;
+    deadline.tv_nsec += (FRAME_EXPORT_DRAIN_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (!ret && ex->lent && !ex->closed) {
+        if (pthread_cond_timedwait(&ex->cond, &ex->lock, &deadline) == ETIMEDOUT) {
+            mpp_err("The frame consumer did not ack its last %d frames\n", ex->lent);
+            break;
+        }
+    }
+    if (ex->acks != ex->frames)
+        ret = MPP_NOK;
+    pthread_mutex_unlock(&ex->lock);
+    return ret;
+}
+
+void rk_frame_export_deinit(RkFrameExport *ex)
+{
+    // The ack thread sees the hang-up and returns what is still lent
+    if (ex->thread_started) {
+        shutdown(ex->fd, SHUT_RDWR);
+        pthread_join(ex->thread, NULL);
+        ex->thread_started = 0;
+    }
+    if (ex->lock_ready) {
+        pthread_mutex_lock(&ex->lock);
+        release_slots(ex);
+        pthread_mutex_unlock(&ex->lock);
+        pthread_mutex_destroy(&ex->lock);
+        pthread_cond_destroy(&ex->cond);
+        ex->lock_ready = 0;
+    }
+    if (ex->fd >= 0) {
+        close(ex->fd);
+        ex->fd = -1;
+    }
+}
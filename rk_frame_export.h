@@ -0,0 +1,104 @@
+#ifndef RK_FRAME_EXPORT_H
+#define RK_FRAME_EXPORT_H
+
+#include <pthread.h>
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+#include <rockchip/mpp_frame.h>
+
+// Frames lent to the consumer at once, at most
+#define FRAME_EXPORT_MAX        16
+#define FRAME_EXPORT_PATH_MAX   108     // sun_path
+// How long the end of stream waits for the consumer's last acks
+#define FRAME_EXPORT_DRAIN_MS   5000
+
+// "RKFX", first word of every message both ways
+#define FRAME_EXPORT_MAGIC      0x58464b52u
+#define FRAME_EXPORT_VERSION    1
+
+typedef enum {
+    FRAME_EXPORT_MSG_FRAME = 0,         // carries the buffer fd
+    FRAME_EXPORT_MSG_EOS,               // no more frames, no fd
+} RkFrameExportMsgType;
+
+/*
+ * Wire format on the SOCK_SEQPACKET socket, host byte order: one message
+ * per frame with the frame's buffer fd as SCM_RIGHTS, one ack back per
+ * frame once the consumer is done reading it. The consumer maps the fd
+ * read-only, size bytes; the picture is laid out as the decoder wrote it,
+ * described by format (MppFrameFormat, FBC, tile and 10-bit bits
+ * included) and the strides.
+ */
+typedef struct {
+    RK_U32          magic;
+    RK_U16          version;
+    RK_U16          type;               // RkFrameExportMsgType
+    RK_U32          slot;               // echoed in the ack
+    RK_U32          format;
+    RK_U32          width;
+    RK_U32          height;
+    RK_U32          hor_stride;         // bytes
+    RK_U32          ver_stride;
+    RK_U64          seq;                // frames in output order from 0
+    RK_U64          size;
+    RK_S64          pts;
+} RkFrameExportMsg;
+
+typedef struct {
+    RK_U32          magic;
+    RK_U32          slot;
+    RK_U64          seq;
+} RkFrameExportAck;
+
+typedef struct {
+    MppBuffer       buf;                // reference lent out, NULL = free
+    RK_U64          seq;
+    double          sent;
+} RkFrameExportSlot;
+
+/*
+ * Frame sink for another process: each decoded frame's DMA buffer goes to
+ * the one consumer on a Unix socket as an fd, nothing is copied. The
+ * buffer reference is held until the consumer acks the frame, so at most
+ * depth frames are out of the decoder's pool and a slow consumer stalls
+ * the decoder instead of growing memory. An ack thread takes the acks and
+ * returns the buffers.
+ *
+ * With the real MPP the fd is the frame's dma-buf, with the stand-in a
+ * memfd; the consumer handles both the same way.
+ */
+typedef struct {
+    char            path[FRAME_EXPORT_PATH_MAX];
+    int             fd;                 // the consumer's connection
+    RK_U32          depth;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    RK_U32          lock_ready;
+    RkFrameExportSlot slots[FRAME_EXPORT_MAX];
+    RK_U32          lent;               // slots in use
+    RK_U32          closed;             // consumer gone or protocol error
+    RK_U64          seq;
+
+    pthread_t       thread;
+    RK_U32          thread_started;
+
+    // Statistics
+    RK_U64          frames;
+    RK_U64          acks;
+    RK_U64          bytes;              // frame buffers lent, none copied
+    RK_U32          peak_lent;
+    RK_U32          stalls;             // pushes that found every slot lent
+    double          push_wait;          // decoder side blocked on the consumer
+    double          hold_sum;           // frame sent -> ack received
+    double          hold_max;
+} RkFrameExport;
+
+// Function declarations
+MPP_RET rk_frame_export_init(RkFrameExport *ex, const char *path, RK_U32 depth);
+MPP_RET rk_frame_export_push(RkFrameExport *ex, MppFrame frame);
+RK_U32 rk_frame_export_lent(RkFrameExport *ex);
+MPP_RET rk_frame_export_finish(RkFrameExport *ex);
+void rk_frame_export_deinit(RkFrameExport *ex);
+
+#endif // RK_FRAME_EXPORT_H
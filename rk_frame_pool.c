@@ -0,0 +1,119 @@
+#include "rk_frame_pool.h"
+#include <string.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+MPP_RET rk_frame_pool_init(RkFramePool *pool, RK_U32 reserve)
+{
+    MPP_RET ret = MPP_OK;
+
+    memset(pool, 0, sizeof(RkFramePool));
+    pool->reserve = reserve;
+
+    ret = mpp_buffer_group_get_internal(&pool->alloc_grp, MPP_BUFFER_TYPE_DRM);
+    if (ret) {
+        mpp_err("Failed to get frame allocation group\n");
+        goto ERR_RET;
+    }
+
+    ret = mpp_buffer_group_get_external(&pool->group, MPP_BUFFER_TYPE_DRM);
+    if (ret) {
+        mpp_err("Failed to get external frame group\n");
+        goto ERR_RET;
+    }
+    return MPP_OK;
+
+ERR_RET:
+    rk_frame_pool_deinit(pool);
+    return ret;
+}
+
+// Frames the decoder or the writer still hold stay valid until put
+void rk_frame_pool_deinit(RkFramePool *pool)
+{
+    if (pool->group) {
+        mpp_buffer_group_put(pool->group);
+        pool->group = NULL;
+    }
+    if (pool->alloc_grp) {
+        mpp_buffer_group_put(pool->alloc_grp);
+        pool->alloc_grp = NULL;
+    }
+    pool->count = 0;
+}
+
+/*
+ * Replace the committed frames with count buffers of size bytes. Call while
+ * the decoder waits on the info change. Frames of the old size that are
+ * still in use are freed as they come back.
+ */
+MPP_RET rk_frame_pool_setup(RkFramePool *pool, RK_U32 count, size_t size)
+{
+    MppBuffer bufs[RK_FRAME_POOL_MAX];
+    MPP_RET ret = MPP_OK;
+    double start = get_time_in_seconds();
+    RK_U32 i;
+
+    if (!count || count > RK_FRAME_POOL_MAX) {
+        mpp_err("frame pool of %d buffers out of range\n", count);
+        return MPP_ERR_VALUE;
+    }
+
+    mpp_buffer_group_clear(pool->group);
+    pool->count = 0;
+    pool->buf_size = size;
+
+    for (i = 0; i < count; i++) {
+        MppBufferInfo info;
+
+        /*
+         * Every allocation is held until all are committed: one put back
+         * early is what the allocation group hands out next, and two
+         * frames would share its memory.
+         */
+        bufs[i] = NULL;
+        ret = mpp_buffer_get(pool->alloc_grp, &bufs[i], size);
+        if (ret) {
+            mpp_err("Failed to allocate frame buffer %d of %zu bytes\n", i, size);
+            break;
+        }
+
+        // The external group imports the fd and keeps the memory alive
+        mpp_buffer_info_get(bufs[i], &info);
+        info.index = i;
+        ret = mpp_buffer_commit(pool->group, &info);
+        if (ret) {
+            mpp_err("Failed to commit frame buffer %d\n", i);
+            mpp_buffer_put(bufs[i]);
+            break;
+        }
+        pool->count++;
+    }
+
+    // Drop the allocation side's copies, only the imports remain
+    for (i = 0; i < pool->count; i++)
+        mpp_buffer_put(bufs[i]);
+    mpp_buffer_group_clear(pool->alloc_grp);
+
+    pool->setups++;
+    pool->setup_time += get_time_in_seconds() - start;
+    rk_frame_pool_usage(pool);
+    return ret;
+}
+
+// Bytes committed now, including old-size frames not yet returned
+size_t rk_frame_pool_usage(RkFramePool *pool)
+{
+    size_t usage = mpp_buffer_group_usage(pool->group);
+
+    if (usage > pool->peak_usage)
+        pool->peak_usage = usage;
+    return usage;
+}
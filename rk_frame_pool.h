@@ -0,0 +1,37 @@
+#ifndef RK_FRAME_POOL_H
+#define RK_FRAME_POOL_H
+
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+
+#define RK_FRAME_POOL_MAX       64
+// Frames allocated beyond what the DPB and the output side can hold
+#define RK_FRAME_POOL_RESERVE   2
+
+/*
+ * Decoder frame buffers owned by the application. At every info change the
+ * pool is resized to exactly the frames the new sequence needs and all of
+ * them are allocated before the decoder resumes, so no frame waits on an
+ * allocation. The memory comes from a DRM group and is committed to an
+ * external group, which the decoder takes its frames from.
+ */
+typedef struct {
+    MppBufferGroup  alloc_grp;
+    MppBufferGroup  group;              // external, handed to the decoder
+    RK_U32          reserve;
+    RK_U32          count;              // frames committed for the current size
+    size_t          buf_size;
+
+    // Statistics
+    RK_U32          setups;
+    double          setup_time;         // allocating and committing, all setups
+    size_t          peak_usage;         // bytes, old frames in use included
+} RkFramePool;
+
+// Function declarations
+MPP_RET rk_frame_pool_init(RkFramePool *pool, RK_U32 reserve);
+void rk_frame_pool_deinit(RkFramePool *pool);
+MPP_RET rk_frame_pool_setup(RkFramePool *pool, RK_U32 count, size_t size);
+size_t rk_frame_pool_usage(RkFramePool *pool);
+
+#endif // RK_FRAME_POOL_H
@@ -0,0 +1,231 @@
+#include "rk_jpeg.h"
+#include <string.h>
+#include <rockchip/mpp_log.h>
+
+#define JPEG_SOI                0xd8
+#define JPEG_EOI                0xd9
+#define JPEG_SOS                0xda
+#define JPEG_DRI                0xdd
+#define JPEG_RST0               0xd0
+#define JPEG_RST7               0xd7
+
+static RK_U32 read_u16(const RK_U8 *p)
+{
+    return p[0] << 8 | p[1];
+}
+
+/*
+ * Walk the marker segments up to the first SOS. Only Huffman-coded frames
+ * (SOF0, SOF1, SOF2) are accepted; arithmetic and lossless coding are not
+ * something VDPU720 or this tool handle.
+ */
+MPP_RET rk_jpeg_parse(const RK_U8 *data, size_t len, RkJpegInfo *info)
+{
+    RK_U32 hmax = 1, vmax = 1;
+    RK_U32 have_sof = 0;
+    size_t pos = 2;
+
+    memset(info, 0, sizeof(RkJpegInfo));
+    if (len < 4 || data[0] != 0xff || data[1] != JPEG_SOI)
+        return MPP_ERR_VALUE;
+
+    while (pos + 4 <= len) {
+        RK_U32 marker, size;
+        const RK_U8 *seg;
+
+        if (data[pos] != 0xff)
+            return MPP_ERR_VALUE;
+        marker = data[pos + 1];
+        // Fill bytes before a marker
+        if (marker == 0xff) {
+            pos++;
+            continue;
+        }
+        if (marker == JPEG_EOI)
+            return MPP_ERR_VALUE;
+
+        size = read_u16(data + pos + 2);
+        if (size < 2 || pos + 2 + size > len)
+            return MPP_ERR_VALUE;
+        seg = data + pos + 4;
+
+        switch (marker) {
+        case 0xc0 :
+        case 0xc1 :
+        case 0xc2 : {
+            RK_U32 i;
+
+            if (size < 8)
+                return MPP_ERR_VALUE;
+            info->progressive = marker == 0xc2;
+            info->sof_pos = pos + 5;
+            info->height = read_u16(seg + 1);
+            info->width = read_u16(seg + 3);
+            info->components = seg[5];
+            if (!info->width || !info->height || !info->components ||
+                size < 8 + 3 * info->components)
+                return MPP_ERR_VALUE;
+            for (i = 0; i < info->components; i++) {
+                RK_U32 h = seg[7 + 3 * i] >> 4;
+                RK_U32 v = seg[7 + 3 * i] & 0xf;
+
+                if (h > hmax)
+                    hmax = h;
+                if (v > vmax)
+                    vmax = v;
+            }
+            have_sof = 1;
+        } break;
+        case 0xc3 :
+        case 0xc5 : case 0xc6 : case 0xc7 :
+        case 0xc9 : case 0xca : case 0xcb :
+        case 0xcd : case 0xce : case 0xcf : {
+            return MPP_ERR_VALUE;
+        } break;
+        case JPEG_DRI : {
+            if (size < 4)
+                return MPP_ERR_VALUE;
+            info->restart_interval = read_u16(seg);
+        } break;
+        case JPEG_SOS : {
+            if (!have_sof)
+                return MPP_ERR_VALUE;
+            info->interleaved = seg[0] == info->components;
+            info->scan_pos = pos + 2 + size;
+            // One component: the MCU is a single 8x8 block whatever its sampling
+            info->mcu_width = info->components == 1 ? 8 : 8 * hmax;
+            info->mcu_height = info->components == 1 ? 8 : 8 * vmax;
+            return MPP_OK;
+        } break;
+        default : {
+        } break;
+        }
+        pos += 2 + size;
+    }
+    return MPP_ERR_VALUE;
+}
+
+/*
+ * Find the end of the entropy-coded interval starting at pos: the next RST
+ * marker or any other marker ending the scan. Stuffed 0xff00 bytes and
+ * fill bytes are skipped. Returns the marker offset, or len if none.
+ */
+static size_t find_marker(const RK_U8 *data, size_t pos, size_t len)
+{
+    while (pos + 1 < len) {
+        const RK_U8 *p = memchr(data + pos, 0xff, len - pos - 1);
+
+        if (!p)
+            return len;
+        pos = p - data;
+        if (p[1] == 0x00 || p[1] == 0xff) {
+            pos++;
+            continue;
+        }
+        return pos;
+    }
+    return len;
+}
+
+/*
+ * Cut a baseline JPEG down to the restart intervals covering roi, in place.
+ * Every restart interval starts with fresh DC predictors and byte aligned,
+ * so the selected intervals can be joined, their RST markers renumbered and
+ * the SOF size patched into a smaller valid JPEG with the same restart
+ * interval. The decoder then only reads and decodes that region.
+ *
+ * Intervals must tile the MCU grid: whole rows split into equal parts, or
+ * whole multiples of a row. *decoded is the region the cut image covers, in
+ * source coordinates; it is the whole image, with the data untouched, when
+ * the stream has no suitable restart intervals or the ROI needs all of it.
+ */
+MPP_RET rk_jpeg_slice_roi(RK_U8 *data, size_t *len, const RkJpegInfo *info,
+                          const RkJpegRect *roi, RkJpegRect *decoded)
+{
+    RK_U32 mw = info->mcu_width;
+    RK_U32 mh = info->mcu_height;
+    RK_U32 ri = info->restart_interval;
+    RK_U32 mcus_x = (info->width + mw - 1) / mw;
+    RK_U32 mcus_y = (info->height + mh - 1) / mh;
+    RK_U32 iv_w, iv_h, cols, rows;
+    RK_U32 c0, c1, r0, r1, first, last, k, emitted = 0;
+    size_t pos = info->scan_pos;
+    size_t out = info->scan_pos;
+
+    decoded->x = 0;
+    decoded->y = 0;
+    decoded->width = info->width;
+    decoded->height = info->height;
+
+    if (!roi->width || !roi->height || roi->x + roi->width > info->width ||
+        roi->y + roi->height > info->height)
+        return MPP_ERR_VALUE;
+    if (!ri || info->progressive || !info->interleaved)
+        return MPP_OK;
+
+    if (!(mcus_x % ri)) {
+        iv_w = ri;
+        iv_h = 1;
+    } else if (!(ri % mcus_x)) {
+        iv_w = mcus_x;
+        iv_h = ri / mcus_x;
+    } else {
+        return MPP_OK;
+    }
+    cols = mcus_x / iv_w;
+    rows = (mcus_y + iv_h - 1) / iv_h;
+
+    c0 = roi->x / mw / iv_w;
+    c1 = (roi->x + roi->width - 1) / mw / iv_w;
+    r0 = roi->y / mh / iv_h;
+    r1 = (roi->y + roi->height - 1) / mh / iv_h;
+    if (!c0 && c1 == cols - 1 && !r0 && r1 == rows - 1)
+        return MPP_OK;
+
+    first = r0 * cols + c0;
+    last = r1 * cols + c1;
+    for (k = 0; k <= last; k++) {
+        size_t end = find_marker(data, pos, *len);
+        RK_U32 col = k % cols;
+        RK_U32 rst = end < *len && data[end + 1] >= JPEG_RST0 && data[end + 1] <= JPEG_RST7;
+
+        // Every interval but the image's last ends on RST k mod 8
+        if (k < last && (!rst || data[end + 1] != JPEG_RST0 + (k & 7))) {
+            mpp_err("restart marker %d missing or out of order\n", k);
+            return MPP_NOK;
+        }
+
+        // The output never overtakes the input: it is at most the
+        // previous interval's end, two bytes behind this start
+        if (k >= first && col >= c0 && col <= c1) {
+            if (emitted) {
+                data[out++] = 0xff;
+                data[out++] = JPEG_RST0 + ((emitted - 1) & 7);
+            }
+            memmove(data + out, data + pos, end - pos);
+            out += end - pos;
+            emitted++;
+        }
+        pos = end + 2;
+    }
+    data[out++] = 0xff;
+    data[out++] = JPEG_EOI;
+    *len = out;
+
+    decoded->x = c0 * iv_w * mw;
+    decoded->y = r0 * iv_h * mh;
+    // The last column and row stop at the image edge, partial MCU and all
+    decoded->width = (c1 + 1) * iv_w * mw;
+    if (decoded->width > info->width)
+        decoded->width = info->width;
+    decoded->width -= decoded->x;
+    decoded->height = (r1 + 1) * iv_h * mh;
+    if (decoded->height > info->height)
+        decoded->height = info->height;
+    decoded->height -= decoded->y;
+    data[info->sof_pos] = decoded->height >> 8;
+    data[info->sof_pos + 1] = decoded->height & 0xff;
+    data[info->sof_pos + 2] = decoded->width >> 8;
+    data[info->sof_pos + 3] = decoded->width & 0xff;
+    return MPP_OK;
+}
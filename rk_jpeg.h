@@ -0,0 +1,35 @@
+#ifndef RK_JPEG_H
+#define RK_JPEG_H
+
+#include <stddef.h>
+#include <rockchip/rk_type.h>
+#include <rockchip/mpp_err.h>
+
+// Pixel rectangle in image coordinates
+typedef struct {
+    RK_U32          x;
+    RK_U32          y;
+    RK_U32          width;
+    RK_U32          height;
+} RkJpegRect;
+
+// What the batch decoder needs from the headers before the first scan
+typedef struct {
+    RK_U32          width;
+    RK_U32          height;
+    RK_U32          components;
+    RK_U32          mcu_width;
+    RK_U32          mcu_height;
+    RK_U32          restart_interval;   // MCUs per interval, 0 = no DRI
+    RK_U32          progressive;
+    RK_U32          interleaved;        // first scan carries every component
+    size_t          sof_pos;            // SOF height field, width follows
+    size_t          scan_pos;           // first entropy-coded byte
+} RkJpegInfo;
+
+// Function declarations
+MPP_RET rk_jpeg_parse(const RK_U8 *data, size_t len, RkJpegInfo *info);
+MPP_RET rk_jpeg_slice_roi(RK_U8 *data, size_t *len, const RkJpegInfo *info,
+                          const RkJpegRect *roi, RkJpegRect *decoded);
+
+#endif // RK_JPEG_H
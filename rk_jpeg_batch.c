@@ -0,0 +1,969 @@
+#define MODULE_TAG "rk_jpeg_batch"
+
+#include "rk_jpeg_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+#ifdef HAVE_LIBJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+#define ALIGN16(x)                      (((x) + 15) & ~15)
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void stop_batch(RkJpegBatch *b)
+{
+    __atomic_store_n(&b->abort, 1, __ATOMIC_RELEASE);
+}
+
+static RK_U32 batch_stopped(RkJpegBatch *b)
+{
+    return __atomic_load_n(&b->abort, __ATOMIC_ACQUIRE);
+}
+
+// The ROI on even coordinates for NV12, clipped to the image
+static MPP_RET clamp_roi(const RkJpegBatchConfig *cfg, RK_U32 width, RK_U32 height,
+                         RkJpegRect *roi)
+{
+    if (!cfg->roi_set) {
+        roi->x = 0;
+        roi->y = 0;
+        roi->width = width;
+        roi->height = height;
+        return MPP_OK;
+    }
+
+    roi->x = cfg->roi.x & ~1;
+    roi->y = cfg->roi.y & ~1;
+    if (roi->x >= width || roi->y >= height)
+        return MPP_ERR_VALUE;
+    roi->width = cfg->roi.width + (cfg->roi.x & 1);
+    if (roi->width > width - roi->x)
+        roi->width = width - roi->x;
+    roi->height = cfg->roi.height + (cfg->roi.y & 1);
+    if (roi->height > height - roi->y)
+        roi->height = height - roi->y;
+    return MPP_OK;
+}
+
+/*
+ * Read one file straight into the packet's DMA buffer, check it is a JPEG
+ * VDPU720 decodes and cut it to the ROI in place.
+ */
+static MPP_RET read_job(RkJpegBatch *b, RK_U32 index, MppPacket packet, RkJpegJob *job)
+{
+    const char *path = b->cfg.files[index % b->cfg.count];
+    RK_U8 *data = mpp_packet_get_data(packet);
+    RkJpegInfo info;
+    MPP_RET ret;
+    size_t len;
+    FILE *fp;
+
+    memset(job, 0, sizeof(RkJpegJob));
+    job->index = index;
+    job->packet = packet;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        mpp_err("Failed to open %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+    len = fread(data, 1, b->pool.size, fp);
+    // A full buffer with more to come: the file does not fit
+    if (len == b->pool.size && fgetc(fp) != EOF) {
+        fclose(fp);
+        mpp_err("%s is larger than %zu bytes\n", path, b->pool.size);
+        return MPP_ERR_VALUE;
+    }
+    fclose(fp);
+
+    ret = rk_jpeg_parse(data, len, &info);
+    if (ret) {
+        mpp_err("%s: not a Huffman-coded JPEG\n", path);
+        return ret;
+    }
+    if (info.progressive) {
+        mpp_err("%s: progressive JPEG, VDPU720 decodes baseline only\n", path);
+        return MPP_ERR_VALUE;
+    }
+    if (clamp_roi(&b->cfg, info.width, info.height, &job->roi)) {
+        mpp_err("%s: ROI outside the %dx%d image\n", path, info.width, info.height);
+        return MPP_ERR_VALUE;
+    }
+
+    job->file_bytes = len;
+    ret = rk_jpeg_slice_roi(data, &len, &info, &job->roi, &job->decoded);
+    if (ret) {
+        mpp_err("%s: broken restart intervals\n", path);
+        return ret;
+    }
+    job->src_width = info.width;
+    job->src_height = info.height;
+    job->stream_bytes = len;
+    mpp_packet_set_pos(packet, data);
+    mpp_packet_set_length(packet, len);
+    return MPP_OK;
+}
+
+static void *reader_thread(void *arg)
+{
+    RkJpegBatch *b = (RkJpegBatch *)arg;
+
+    for (;;) {
+        MppPacket packet = NULL;
+        RkJpegJob job;
+        RK_U32 index;
+        double start;
+
+        pthread_mutex_lock(&b->lock);
+        if (b->next >= b->total) {
+            pthread_mutex_unlock(&b->lock);
+            break;
+        }
+        index = b->next++;
+        pthread_mutex_unlock(&b->lock);
+
+        // Pool slots come back as the decoder finishes with packets
+        while (!packet && !batch_stopped(b))
+            packet = rk_pkt_pool_acquire(&b->pool, JPEG_BATCH_POLL_MS);
+        if (!packet)
+            break;
+
+        start = get_time_in_seconds();
+        if (read_job(b, index, packet, &job)) {
+            rk_pkt_pool_cancel(&b->pool, packet);
+            pthread_mutex_lock(&b->lock);
+            b->failed++;
+            pthread_mutex_unlock(&b->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&b->lock);
+        b->read_time += get_time_in_seconds() - start;
+        b->ready[(b->ready_head + b->ready_count) % JPEG_BATCH_SLOTS] = job;
+        b->ready_count++;
+        pthread_cond_broadcast(&b->cond);
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    pthread_mutex_lock(&b->lock);
+    b->readers_done++;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+// Caller holds b->lock; waits up to the poll timeout
+static void wait_batch(RkJpegBatch *b)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += JPEG_BATCH_POLL_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&b->cond, &b->lock, &deadline);
+}
+
+// Next file read, or MPP_NOK once every reader is done and nothing is left
+static MPP_RET pop_job(RkJpegBatch *b, RkJpegJob *job)
+{
+    MPP_RET ret = MPP_NOK;
+    double start = get_time_in_seconds();
+
+    pthread_mutex_lock(&b->lock);
+    while (!b->ready_count && b->readers_done < b->cfg.readers && !batch_stopped(b))
+        wait_batch(b);
+    if (b->ready_count) {
+        *job = b->ready[b->ready_head];
+        b->ready_head = (b->ready_head + 1) % JPEG_BATCH_SLOTS;
+        b->ready_count--;
+        ret = MPP_OK;
+    }
+    b->feed_wait += get_time_in_seconds() - start;
+    pthread_mutex_unlock(&b->lock);
+    return ret;
+}
+
+// Free output frame slot, -1 when stopped
+static int get_frame_slot(RkJpegBatch *b)
+{
+    int slot = -1;
+
+    pthread_mutex_lock(&b->lock);
+    while (!batch_stopped(b)) {
+        RK_U32 i;
+
+        for (i = 0; i < JPEG_BATCH_FRAMES; i++) {
+            if (!b->frm_busy[i])
+                break;
+        }
+        if (i < JPEG_BATCH_FRAMES) {
+            slot = i;
+            break;
+        }
+        wait_batch(b);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return slot;
+}
+
+// Input task back from the decoder: its packet buffer can be refilled
+static MPP_RET take_input_task(RkJpegBatch *b, MppTask *task)
+{
+    MppPacket done = NULL;
+    MPP_RET ret;
+
+    if (b->spare_task) {
+        *task = b->spare_task;
+        b->spare_task = NULL;
+        return MPP_OK;
+    }
+    while ((ret = b->mpi->poll(b->ctx, MPP_PORT_INPUT, JPEG_BATCH_POLL_MS))) {
+        if (batch_stopped(b) || ret != MPP_ERR_TIMEOUT) {
+            mpp_err("mpp input poll failed\n");
+            return MPP_NOK;
+        }
+    }
+    ret = b->mpi->dequeue(b->ctx, MPP_PORT_INPUT, task);
+    if (ret || !*task) {
+        mpp_err("mpp task input dequeue failed\n");
+        return ret ? ret : MPP_NOK;
+    }
+    mpp_task_meta_get_packet(*task, KEY_INPUT_PACKET, &done);
+    if (done)
+        rk_pkt_pool_release(&b->pool, done);
+    return MPP_OK;
+}
+
+// An input task the decoder refused stays with us, emptied, for the next take
+static void keep_input_task(RkJpegBatch *b, MppTask task)
+{
+    mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, NULL);
+    mpp_task_meta_set_frame(task, KEY_OUTPUT_FRAME, NULL);
+    b->spare_task = task;
+}
+
+/*
+ * Pair a read image with an output frame big enough for its decoded
+ * region. On failure the packet is still the caller's to cancel.
+ */
+static MPP_RET feed_job(RkJpegBatch *b, RkJpegJob *job)
+{
+    size_t size = (size_t)ALIGN16(job->decoded.width) * ALIGN16(job->decoded.height) * 3 / 2;
+    MppFrame frame = NULL;
+    MppTask task = NULL;
+    MPP_RET ret;
+    int slot;
+
+    slot = get_frame_slot(b);
+    if (slot < 0)
+        return MPP_NOK;
+
+    // Slots keep their buffer; it only grows for a larger picture
+    if (!b->frm_bufs[slot] || mpp_buffer_get_size(b->frm_bufs[slot]) < size) {
+        if (b->frm_bufs[slot]) {
+            mpp_buffer_put(b->frm_bufs[slot]);
+            b->frm_bufs[slot] = NULL;
+        }
+        ret = mpp_buffer_get(b->frm_grp, &b->frm_bufs[slot], size);
+        if (ret) {
+            mpp_err("Failed to get a %zu byte frame buffer\n", size);
+            return ret;
+        }
+        b->frame_allocs++;
+    }
+
+    ret = mpp_frame_init(&frame);
+    if (ret)
+        return ret;
+    mpp_frame_set_buffer(frame, b->frm_bufs[slot]);
+    mpp_packet_set_pts(job->packet, slot);
+
+    ret = take_input_task(b, &task);
+    if (ret) {
+        mpp_frame_deinit(&frame);
+        return ret;
+    }
+
+    pthread_mutex_lock(&b->lock);
+    job->fed = get_time_in_seconds();
+    b->frm_jobs[slot] = *job;
+    b->frm_busy[slot] = 1;
+    pthread_mutex_unlock(&b->lock);
+
+    // Only this thread takes input tasks back, so the packet cannot come
+    // back before it is marked submitted
+    mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, job->packet);
+    mpp_task_meta_set_frame(task, KEY_OUTPUT_FRAME, frame);
+    ret = b->mpi->enqueue(b->ctx, MPP_PORT_INPUT, task);
+    if (ret) {
+        mpp_err("mpp task input enqueue failed\n");
+        keep_input_task(b, task);
+        mpp_frame_deinit(&frame);
+        pthread_mutex_lock(&b->lock);
+        b->frm_busy[slot] = 0;
+        pthread_mutex_unlock(&b->lock);
+        return ret;
+    }
+    rk_pkt_pool_submit(&b->pool, job->packet);
+    return MPP_OK;
+}
+
+// Empty EOS packet: every image before it has its frame out once EOS comes back
+static MPP_RET feed_eos(RkJpegBatch *b, MppPacket *eos)
+{
+    MppTask task = NULL;
+    MPP_RET ret;
+
+    ret = mpp_packet_init(eos, NULL, 0);
+    if (ret)
+        return ret;
+    mpp_packet_set_eos(*eos);
+
+    ret = take_input_task(b, &task);
+    if (ret)
+        return ret;
+    mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, *eos);
+    ret = b->mpi->enqueue(b->ctx, MPP_PORT_INPUT, task);
+    if (ret) {
+        mpp_err("mpp task input enqueue failed\n");
+        keep_input_task(b, task);
+    }
+    return ret;
+}
+
+// The ROI out of the decoded region as contiguous NV12
+static MPP_RET write_crop(RkJpegBatch *b, const RkJpegJob *job, MppFrame frame)
+{
+    const char *path = b->cfg.files[job->index % b->cfg.count];
+    const char *name = strrchr(path, '/');
+    const RK_U8 *base = mpp_buffer_get_ptr(mpp_frame_get_buffer(frame));
+    RK_U32 hor_stride = mpp_frame_get_hor_stride(frame);
+    RK_U32 ver_stride = mpp_frame_get_ver_stride(frame);
+    RK_U32 x = job->roi.x - job->decoded.x;
+    RK_U32 y = job->roi.y - job->decoded.y;
+    RK_U32 w = job->roi.width;
+    RK_U32 h = job->roi.height;
+    size_t cw = (w + 1) & ~1;
+    size_t size = (size_t)w * h + cw * ((h + 1) / 2);
+    char out[JPEG_BATCH_PATH_MAX];
+    RK_U8 *dst;
+    RK_U32 i;
+    FILE *fp;
+
+    if (size > b->crop_size) {
+        RK_U8 *buf = realloc(b->crop_buf, size);
+
+        if (!buf)
+            return MPP_ERR_MALLOC;
+        b->crop_buf = buf;
+        b->crop_size = size;
+    }
+
+    dst = b->crop_buf;
+    for (i = 0; i < h; i++, dst += w)
+        memcpy(dst, base + (size_t)(y + i) * hor_stride + x, w);
+    base += (size_t)hor_stride * ver_stride;
+    for (i = 0; i < (h + 1) / 2; i++, dst += cw)
+        memcpy(dst, base + (size_t)(y / 2 + i) * hor_stride + x, cw);
+
+    snprintf(out, sizeof(out), "%s/%s.%ux%u.nv12", b->cfg.out_dir, name ? name + 1 : path, w, h);
+    fp = fopen(out, "wb");
+    if (!fp) {
+        mpp_err("Failed to open %s\n", out);
+        return MPP_ERR_OPEN_FILE;
+    }
+    if (fwrite(b->crop_buf, 1, size, fp) != size) {
+        fclose(fp);
+        mpp_err("Failed to write %s\n", out);
+        return MPP_NOK;
+    }
+    fclose(fp);
+    return MPP_OK;
+}
+
+static void collect_frame(RkJpegBatch *b, MppFrame frame)
+{
+    RK_S64 slot = mpp_frame_get_pts(frame);
+    RkJpegJob *job;
+    RK_U32 ok;
+    double latency;
+
+    if (slot < 0 || slot >= JPEG_BATCH_FRAMES || !b->frm_busy[slot] ||
+        mpp_frame_get_buffer(frame) != b->frm_bufs[slot]) {
+        mpp_err("frame for no image in flight\n");
+        return;
+    }
+    job = &b->frm_jobs[slot];
+    latency = get_time_in_seconds() - job->fed;
+
+    ok = !mpp_frame_get_errinfo(frame) &&
+         mpp_frame_get_width(frame) == job->decoded.width &&
+         mpp_frame_get_height(frame) == job->decoded.height;
+    if (!ok)
+        mpp_err("%s: decode failed\n", b->cfg.files[job->index % b->cfg.count]);
+    else if (b->cfg.out_dir && job->index < b->cfg.count && write_crop(b, job, frame))
+        ok = 0;
+
+    pthread_mutex_lock(&b->lock);
+    if (ok) {
+        b->images++;
+        b->src_pixels += (RK_U64)job->src_width * job->src_height;
+        b->dec_pixels += (RK_U64)job->decoded.width * job->decoded.height;
+        b->roi_pixels += (RK_U64)job->roi.width * job->roi.height;
+        b->file_bytes += job->file_bytes;
+        b->stream_bytes += job->stream_bytes;
+        if (job->decoded.width != job->src_width || job->decoded.height != job->src_height)
+            b->sliced++;
+    } else {
+        b->failed++;
+    }
+    b->decode_sum += latency;
+    if (latency > b->decode_max)
+        b->decode_max = latency;
+    b->frm_busy[slot] = 0;
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+}
+
+static void *collect_thread(void *arg)
+{
+    RkJpegBatch *b = (RkJpegBatch *)arg;
+
+    while (!batch_stopped(b)) {
+        MppTask task = NULL;
+        MppFrame frame = NULL;
+        MPP_RET ret;
+        RK_U32 eos = 0;
+
+        ret = b->mpi->poll(b->ctx, MPP_PORT_OUTPUT, JPEG_BATCH_POLL_MS);
+        if (ret == MPP_ERR_TIMEOUT)
+            continue;
+        if (ret || b->mpi->dequeue(b->ctx, MPP_PORT_OUTPUT, &task) || !task) {
+            mpp_err("mpp output dequeue failed\n");
+            stop_batch(b);
+            break;
+        }
+
+        mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, &frame);
+        if (frame) {
+            eos = mpp_frame_get_eos(frame);
+            if (mpp_frame_get_buffer(frame))
+                collect_frame(b, frame);
+            mpp_frame_deinit(&frame);
+        }
+        b->mpi->enqueue(b->ctx, MPP_PORT_OUTPUT, task);
+
+        if (eos) {
+            pthread_mutex_lock(&b->lock);
+            b->collect_eos = 1;
+            pthread_cond_broadcast(&b->cond);
+            pthread_mutex_unlock(&b->lock);
+            break;
+        }
+    }
+    return NULL;
+}
+
+MPP_RET rk_jpeg_batch_init(RkJpegBatch *b, const RkJpegBatchConfig *cfg)
+{
+    MppPollType block = MPP_POLL_BLOCK;
+    MppFrameFormat fmt = MPP_FMT_YUV420SP;
+    MPP_RET ret;
+
+    memset(b, 0, sizeof(RkJpegBatch));
+    b->cfg = *cfg;
+    if (!b->cfg.readers)
+        b->cfg.readers = JPEG_BATCH_READERS;
+    if (b->cfg.readers > JPEG_BATCH_MAX_READERS)
+        b->cfg.readers = JPEG_BATCH_MAX_READERS;
+    if (!b->cfg.max_size)
+        b->cfg.max_size = JPEG_BATCH_MAX_SIZE;
+    b->total = b->cfg.count * (b->cfg.repeat ? b->cfg.repeat : 1);
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->cond, NULL);
+
+    ret = rk_pkt_pool_init(&b->pool, JPEG_BATCH_SLOTS, b->cfg.max_size, NULL, NULL);
+    if (ret) {
+        mpp_err("Failed to allocate %d packet buffers\n", JPEG_BATCH_SLOTS);
+        goto ERR_RET;
+    }
+    ret = mpp_buffer_group_get_internal(&b->frm_grp, MPP_BUFFER_TYPE_DRM);
+    if (ret) {
+        mpp_err("Failed to get frame buffer group\n");
+        goto ERR_RET;
+    }
+
+    ret = mpp_create(&b->ctx, &b->mpi);
+    if (ret) {
+        mpp_err("mpp_create failed\n");
+        goto ERR_RET;
+    }
+    // The feeder and the collector poll with their own timeouts
+    b->mpi->control(b->ctx, MPP_SET_INPUT_TIMEOUT, &block);
+    b->mpi->control(b->ctx, MPP_SET_OUTPUT_TIMEOUT, &block);
+    ret = mpp_init(b->ctx, MPP_CTX_DEC, MPP_VIDEO_CodingMJPEG);
+    if (ret) {
+        mpp_err("mpp_init failed\n");
+        goto ERR_RET;
+    }
+    // 4:2:2 and 4:4:4 pictures come out as NV12 too, through the post-processor
+    b->mpi->control(b->ctx, MPP_DEC_SET_OUTPUT_FORMAT, &fmt);
+    return MPP_OK;
+
+ERR_RET:
+    rk_jpeg_batch_deinit(b);
+    return ret;
+}
+
+MPP_RET rk_jpeg_batch_run(RkJpegBatch *b)
+{
+    pthread_t readers[JPEG_BATCH_MAX_READERS];
+    pthread_t collector;
+    MppPacket eos = NULL;
+    RkJpegJob job;
+    RK_U32 i, started = 0;
+    MPP_RET ret = MPP_OK;
+    double start = get_time_in_seconds();
+
+    if (pthread_create(&collector, NULL, collect_thread, b)) {
+        mpp_err("Failed to create collector thread\n");
+        return MPP_NOK;
+    }
+    for (i = 0; i < b->cfg.readers; i++) {
+        if (pthread_create(&readers[i], NULL, reader_thread, b)) {
+            mpp_err("Failed to create reader thread %d\n", i);
+            break;
+        }
+        started++;
+    }
+    // Readers that never started are done
+    pthread_mutex_lock(&b->lock);
+    b->readers_done += b->cfg.readers - started;
+    pthread_mutex_unlock(&b->lock);
+    if (!started)
+        stop_batch(b);
+
+    while (!batch_stopped(b) && !pop_job(b, &job)) {
+        ret = feed_job(b, &job);
+        if (ret) {
+            rk_pkt_pool_cancel(&b->pool, job.packet);
+            stop_batch(b);
+        }
+    }
+    if (!batch_stopped(b)) {
+        ret = feed_eos(b, &eos);
+        if (ret)
+            stop_batch(b);
+    }
+
+    pthread_join(collector, NULL);
+    stop_batch(b);
+    for (i = 0; i < started; i++)
+        pthread_join(readers[i], NULL);
+    b->elapsed = get_time_in_seconds() - start;
+
+    if (eos) {
+        // The decoder is done with the EOS packet once its frame is out
+        mpp_destroy(b->ctx);
+        b->ctx = NULL;
+        mpp_packet_deinit(&eos);
+    }
+    return b->collect_eos ? ret : MPP_NOK;
+}
+
+void rk_jpeg_batch_deinit(RkJpegBatch *b)
+{
+    RK_U32 i;
+
+    if (b->ctx) {
+        mpp_destroy(b->ctx);
+        b->ctx = NULL;
+    }
+    for (i = 0; i < JPEG_BATCH_FRAMES; i++) {
+        if (b->frm_bufs[i]) {
+            mpp_buffer_put(b->frm_bufs[i]);
+            b->frm_bufs[i] = NULL;
+        }
+    }
+    if (b->frm_grp) {
+        mpp_buffer_group_put(b->frm_grp);
+        b->frm_grp = NULL;
+    }
+    if (b->pool.count)
+        rk_pkt_pool_deinit(&b->pool);
+    free(b->crop_buf);
+    b->crop_buf = NULL;
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->cond);
+}
+
+#ifdef HAVE_LIBJPEG
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf         jmp;
+} CpuJpegError;
+
+typedef struct {
+    const RkJpegBatchConfig *cfg;
+    RK_U32         *next;
+    RK_U32          total;
+    int             core;
+    pthread_t       thread;
+    RkJpegCpuStats  stats;
+} CpuJpegWorker;
+
+static void cpu_jpeg_error_exit(j_common_ptr cinfo)
+{
+    longjmp(((CpuJpegError *)cinfo->err)->jmp, 1);
+}
+
+static RK_U8 *read_file(const char *path, RK_U8 *buf, size_t *cap, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    long size;
+
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return NULL;
+    }
+    if ((size_t)size > *cap) {
+        RK_U8 *grown = realloc(buf, size);
+
+        if (!grown) {
+            fclose(fp);
+            return NULL;
+        }
+        buf = grown;
+        *cap = size;
+    }
+    *len = fread(buf, 1, size, fp);
+    fclose(fp);
+    return buf;
+}
+
+/*
+ * libjpeg-turbo's own partial decode for the ROI: whole rows above it are
+ * skipped (Huffman decoded, not IDCT'd), columns cropped to iMCU
+ * boundaries, and the decode abandoned after the last ROI row. Colour
+ * output stays YCbCr so no colour conversion is charged to the CPU.
+ */
+static void *cpu_jpeg_worker(void *arg)
+{
+    CpuJpegWorker *w = (CpuJpegWorker *)arg;
+    struct jpeg_decompress_struct cinfo;
+    CpuJpegError err;
+    RK_U8 *buf = NULL;
+    size_t cap = 0;
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(w->core, &cpuset);
+    // Best effort: a host without core 4-7 just runs unpinned
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = cpu_jpeg_error_exit;
+    jpeg_create_decompress(&cinfo);
+
+    for (;;) {
+        RK_U32 index = __atomic_fetch_add(w->next, 1, __ATOMIC_RELAXED);
+        const char *path;
+        RkJpegRect roi;
+        JDIMENSION x, width, rows = 0;
+        JSAMPARRAY line;
+        size_t len = 0;
+        RK_U8 *data;
+
+        if (index >= w->total)
+            break;
+        path = w->cfg->files[index % w->cfg->count];
+        data = read_file(path, buf, &cap, &len);
+        if (!data) {
+            w->stats.failed++;
+            continue;
+        }
+        buf = data;
+
+        if (setjmp(err.jmp)) {
+            jpeg_abort_decompress(&cinfo);
+            w->stats.failed++;
+            continue;
+        }
+        jpeg_mem_src(&cinfo, buf, len);
+        jpeg_read_header(&cinfo, TRUE);
+        if (cinfo.num_components == 3)
+            cinfo.out_color_space = JCS_YCbCr;
+        if (clamp_roi(w->cfg, cinfo.image_width, cinfo.image_height, &roi)) {
+            jpeg_abort_decompress(&cinfo);
+            w->stats.failed++;
+            continue;
+        }
+        jpeg_start_decompress(&cinfo);
+
+        x = roi.x;
+        width = roi.width;
+        if (width != cinfo.output_width)
+            jpeg_crop_scanline(&cinfo, &x, &width);
+        if (roi.y)
+            jpeg_skip_scanlines(&cinfo, roi.y);
+        line = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE,
+                                          cinfo.output_width * cinfo.output_components, 1);
+        while (rows < roi.height && cinfo.output_scanline < cinfo.output_height)
+            rows += jpeg_read_scanlines(&cinfo, line, 1);
+        w->stats.src_pixels += (RK_U64)cinfo.image_width * cinfo.image_height;
+        w->stats.dec_pixels += (RK_U64)cinfo.output_width * rows;
+        if (cinfo.output_scanline < cinfo.output_height)
+            jpeg_abort_decompress(&cinfo);
+        else
+            jpeg_finish_decompress(&cinfo);
+        w->stats.images++;
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    free(buf);
+    return NULL;
+}
+
+// Same list and ROI on cfg->cpu_threads threads over the A76 cores
+MPP_RET rk_jpeg_cpu_run(const RkJpegBatchConfig *cfg, RkJpegCpuStats *stats)
+{
+    CpuJpegWorker workers[JPEG_BATCH_MAX_CPU_THREADS];
+    RK_U32 threads = cfg->cpu_threads < JPEG_BATCH_MAX_CPU_THREADS ?
+                     cfg->cpu_threads : JPEG_BATCH_MAX_CPU_THREADS;
+    RK_U32 next = 0;
+    RK_U32 i, started = 0;
+    double start = get_time_in_seconds();
+
+    memset(stats, 0, sizeof(RkJpegCpuStats));
+    memset(workers, 0, sizeof(workers));
+    for (i = 0; i < threads; i++) {
+        workers[i].cfg = cfg;
+        workers[i].next = &next;
+        workers[i].total = cfg->count * (cfg->repeat ? cfg->repeat : 1);
+        workers[i].core = JPEG_BATCH_A76_CORE_START + i % JPEG_BATCH_A76_CORES;
+        if (pthread_create(&workers[i].thread, NULL, cpu_jpeg_worker, &workers[i])) {
+            mpp_err("Failed to create libjpeg thread %d\n", i);
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        stats->images += workers[i].stats.images;
+        stats->failed += workers[i].stats.failed;
+        stats->src_pixels += workers[i].stats.src_pixels;
+        stats->dec_pixels += workers[i].stats.dec_pixels;
+    }
+    stats->elapsed = get_time_in_seconds() - start;
+    stats->threads = started;
+    return started ? MPP_OK : MPP_NOK;
+}
+#else
+MPP_RET rk_jpeg_cpu_run(const RkJpegBatchConfig *cfg, RkJpegCpuStats *stats)
+{
+    (void)cfg;
+    memset(stats, 0, sizeof(RkJpegCpuStats));
+    mpp_err("Built without libjpeg-turbo, no CPU baseline\n");
+    return MPP_NOK;
+}
+#endif
+
+// One path per line; blank lines and # comments skipped
+static MPP_RET load_list(const char *path, char ***files, RK_U32 *count)
+{
+    FILE *fp = fopen(path, "r");
+    char line[JPEG_BATCH_PATH_MAX];
+    RK_U32 cap = *count;
+
+    if (!fp) {
+        mpp_err("Failed to open list %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strcspn(line, "\r\n");
+
+        line[len] = '\0';
+        if (!len || line[0] == '#')
+            continue;
+        if (*count == cap) {
+            char **grown;
+
+            cap = cap ? cap * 2 : 1024;
+            grown = realloc(*files, cap * sizeof(char *));
+            if (!grown) {
+                fclose(fp);
+                return MPP_ERR_MALLOC;
+            }
+            *files = grown;
+        }
+        (*files)[*count] = strdup(line);
+        if (!(*files)[*count]) {
+            fclose(fp);
+            return MPP_ERR_MALLOC;
+        }
+        (*count)++;
+    }
+    fclose(fp);
+    return MPP_OK;
+}
+
+static void print_usage(const char *prog)
+{
+    mpp_err("Usage: %s [-l list] [-r repeat] [-R x,y,w,h] [-j readers] [-S max_mb] "
+            "[-o dir] [-c threads] [file...]\n", prog);
+    mpp_err("  -l list   read the image paths from a file, one per line\n");
+    mpp_err("  -r n      decode the list n times (default 1)\n");
+    mpp_err("  -R roi    decode only x,y,w,h of every image; streams with restart\n");
+    mpp_err("            intervals are cut down to it before the decoder sees them\n");
+    mpp_err("  -j n      file reader threads (default %d, max %d)\n",
+            JPEG_BATCH_READERS, JPEG_BATCH_MAX_READERS);
+    mpp_err("  -S mb     largest JPEG accepted (default %d)\n", JPEG_BATCH_MAX_SIZE / SZ_1M);
+    mpp_err("  -o dir    write each ROI as NV12 to dir, first pass only\n");
+    mpp_err("  -c n      also decode with libjpeg-turbo on n A76 threads for comparison\n");
+}
+
+int main(int argc, char **argv)
+{
+    RkJpegBatchConfig cfg;
+    RkJpegBatch batch;
+    RkJpegCpuStats cpu;
+    char **files = NULL;
+    RK_U32 list_count = 0;
+    MPP_RET ret;
+    double fps;
+    int opt;
+    RK_U32 i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.repeat = 1;
+    cfg.readers = JPEG_BATCH_READERS;
+    cfg.max_size = JPEG_BATCH_MAX_SIZE;
+
+    while ((opt = getopt(argc, argv, "l:r:R:j:S:o:c:")) != -1) {
+        switch (opt) {
+        case 'l':
+            if (load_list(optarg, &files, &list_count))
+                return -1;
+            break;
+        case 'r':
+            cfg.repeat = atoi(optarg);
+            if (!cfg.repeat)
+                cfg.repeat = 1;
+            break;
+        case 'R':
+            if (sscanf(optarg, "%u,%u,%u,%u", &cfg.roi.x, &cfg.roi.y,
+                       &cfg.roi.width, &cfg.roi.height) != 4 ||
+                !cfg.roi.width || !cfg.roi.height) {
+                print_usage(argv[0]);
+                return -1;
+            }
+            cfg.roi_set = 1;
+            break;
+        case 'j':
+            cfg.readers = atoi(optarg);
+            break;
+        case 'S':
+            cfg.max_size = (size_t)atoi(optarg) * SZ_1M;
+            break;
+        case 'o':
+            cfg.out_dir = optarg;
+            break;
+        case 'c':
+            cfg.cpu_threads = atoi(optarg);
+            break;
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    // Files on the command line follow the list
+    for (i = optind; i < (RK_U32)argc; i++) {
+        char **grown = realloc(files, (list_count + 1) * sizeof(char *));
+
+        if (!grown)
+            return -1;
+        files = grown;
+        files[list_count] = strdup(argv[i]);
+        list_count++;
+    }
+    if (!list_count) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    cfg.files = files;
+    cfg.count = list_count;
+
+    ret = rk_jpeg_batch_init(&batch, &cfg);
+    if (ret) {
+        mpp_err("Failed to initialize the JPEG decoder\n");
+        goto FREE_FILES;
+    }
+    ret = rk_jpeg_batch_run(&batch);
+    if (ret)
+        mpp_err("Batch stopped early\n");
+
+    fps = batch.elapsed > 0 ? batch.images / batch.elapsed : 0;
+    mpp_log("VDPU720: %llu images (%llu failed) in %.3f s, %.1f images/s, "
+            "%.1f MPix/s of source, %.1f MPix/s decoded\n",
+            batch.images, batch.failed, batch.elapsed, fps,
+            batch.elapsed > 0 ? batch.src_pixels / batch.elapsed / 1e6 : 0,
+            batch.elapsed > 0 ? batch.dec_pixels / batch.elapsed / 1e6 : 0);
+    if (cfg.roi_set)
+        mpp_log("ROI: %u of %llu images cut at restart intervals, decoder read %.1f%% of "
+                "the file bytes and produced %.1f%% of the source pixels, %.1f%% of them "
+                "inside the ROI\n",
+                batch.sliced, batch.images,
+                batch.file_bytes ? 100.0 * batch.stream_bytes / batch.file_bytes : 0,
+                batch.src_pixels ? 100.0 * batch.dec_pixels / batch.src_pixels : 0,
+                batch.dec_pixels ? 100.0 * batch.roi_pixels / batch.dec_pixels : 0);
+    mpp_log("Pipeline: %d readers, %.3f s reading, decoder waited %.3f s on reads, "
+            "image in decoder avg %.2f ms max %.2f ms, %d frame buffer allocations, "
+            "peak %d packet buffers queued\n",
+            batch.cfg.readers, batch.read_time, batch.feed_wait,
+            batch.images + batch.failed ? batch.decode_sum / (batch.images + batch.failed) * 1000 : 0,
+            batch.decode_max * 1000, batch.frame_allocs, batch.pool.peak_decoder_owned);
+
+    if (cfg.cpu_threads && !rk_jpeg_cpu_run(&cfg, &cpu)) {
+        double cpu_fps = cpu.elapsed > 0 ? cpu.images / cpu.elapsed : 0;
+
+        mpp_log("libjpeg-turbo on %d A76 threads: %llu images (%llu failed) in %.3f s, "
+                "%.1f images/s, %.1f MPix/s of source, %.1f MPix/s decoded\n",
+                cpu.threads, cpu.images, cpu.failed, cpu.elapsed, cpu_fps,
+                cpu.elapsed > 0 ? cpu.src_pixels / cpu.elapsed / 1e6 : 0,
+                cpu.elapsed > 0 ? cpu.dec_pixels / cpu.elapsed / 1e6 : 0);
+        if (cpu_fps > 0)
+            mpp_log("VDPU720 is %.2fx libjpeg-turbo on %d threads\n", fps / cpu_fps, cpu.threads);
+    }
+
+    if (batch.failed)
+        ret = MPP_NOK;
+    rk_jpeg_batch_deinit(&batch);
+
+FREE_FILES:
+    for (i = 0; i < list_count; i++)
+        free(files[i]);
+    free(files);
+    return ret ? -1 : 0;
+}
@@ -0,0 +1,125 @@
+#ifndef RK_JPEG_BATCH_H
+#define RK_JPEG_BATCH_H
+
+#include <pthread.h>
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+#include <rockchip/mpp_frame.h>
+#include <rockchip/mpp_packet.h>
+#include <rockchip/mpp_task.h>
+#include "rk_jpeg.h"
+#include "rk_pkt_pool.h"
+
+#define SZ_1K                           (1024)
+#define SZ_1M                           (SZ_1K * SZ_1K)
+
+// File reads in flight ahead of the decoder, one packet buffer each
+#define JPEG_BATCH_SLOTS                16
+// Largest JPEG accepted, the packet buffer size
+#define JPEG_BATCH_MAX_SIZE             (8 * SZ_1M)
+// Output frames in flight: the decoder's input tasks plus collection
+#define JPEG_BATCH_FRAMES               8
+#define JPEG_BATCH_READERS              2
+#define JPEG_BATCH_MAX_READERS          8
+#define JPEG_BATCH_MAX_CPU_THREADS      8
+// Poll timeout on the decoder ports and the reader queue, ms
+#define JPEG_BATCH_POLL_MS              100
+#define JPEG_BATCH_PATH_MAX             256
+
+// RK3588 cluster layout: A76 cores are 4-7
+#define JPEG_BATCH_A76_CORE_START       4
+#define JPEG_BATCH_A76_CORES            4
+
+typedef struct {
+    char          **files;
+    RK_U32          count;
+    RK_U32          repeat;         // passes over the list
+    RkJpegRect      roi;            // in each image, whole image if unset
+    RK_U32          roi_set;
+    RK_U32          readers;        // file reader threads
+    size_t          max_size;
+    const char     *out_dir;        // cropped NV12 per image, first pass only
+    RK_U32          cpu_threads;    // libjpeg-turbo baseline threads, 0 = none
+} RkJpegBatchConfig;
+
+// One image between the reader and the collector
+typedef struct {
+    RK_U32          index;          // into the file list, over all passes
+    MppPacket       packet;
+    RkJpegRect      decoded;        // what the decoder produces, source coordinates
+    RkJpegRect      roi;            // clamped to the image, even
+    RK_U32          src_width;
+    RK_U32          src_height;
+    size_t          file_bytes;
+    size_t          stream_bytes;   // sent to the decoder after ROI slicing
+    double          fed;            // handed to the decoder
+} RkJpegJob;
+
+/*
+ * Reader threads -> ready queue -> feeder (main thread) -> VDPU720 ->
+ * collector thread. Readers fill the pool's DMA packet buffers straight
+ * from the files and cut them to the ROI in place, so file I/O and header
+ * work overlap the hardware. The feeder pairs each packet with an output
+ * frame on the input task, as the JPEG decoder wants its buffer up front.
+ */
+typedef struct {
+    RkJpegBatchConfig cfg;
+    MppCtx          ctx;
+    MppApi         *mpi;
+    RkPktPool       pool;
+    MppBufferGroup  frm_grp;
+    MppTask         spare_task;     // input task whose enqueue failed, taken before a poll
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    RK_U32          next;           // next image index for the readers
+    RK_U32          total;
+    RK_U32          readers_done;
+    RkJpegJob       ready[JPEG_BATCH_SLOTS];
+    RK_U32          ready_head;
+    RK_U32          ready_count;
+
+    // Output frames; a job rides with its frame, pts is the slot
+    MppBuffer       frm_bufs[JPEG_BATCH_FRAMES];
+    RkJpegJob       frm_jobs[JPEG_BATCH_FRAMES];
+    RK_U32          frm_busy[JPEG_BATCH_FRAMES];
+    RK_U32          frm_free;
+    RK_U32          collect_eos;
+    RK_U32          abort;
+    RK_U8          *crop_buf;
+    size_t          crop_size;
+
+    // Statistics
+    RK_U64          images;
+    RK_U64          failed;
+    RK_U64          src_pixels;     // whole source images
+    RK_U64          dec_pixels;     // what the decoder produced
+    RK_U64          roi_pixels;
+    RK_U64          file_bytes;
+    RK_U64          stream_bytes;
+    RK_U32          sliced;
+    RK_U32          frame_allocs;
+    double          read_time;      // summed over the readers
+    double          feed_wait;      // feeder waiting on readers
+    double          decode_sum;     // fed -> frame collected
+    double          decode_max;
+    double          elapsed;
+} RkJpegBatch;
+
+// libjpeg-turbo baseline over the same list and ROI
+typedef struct {
+    RK_U64          images;
+    RK_U64          failed;
+    RK_U64          src_pixels;
+    RK_U64          dec_pixels;
+    double          elapsed;
+    RK_U32          threads;
+} RkJpegCpuStats;
+
+// Function declarations
+MPP_RET rk_jpeg_batch_init(RkJpegBatch *b, const RkJpegBatchConfig *cfg);
+MPP_RET rk_jpeg_batch_run(RkJpegBatch *b);
+void rk_jpeg_batch_deinit(RkJpegBatch *b);
+MPP_RET rk_jpeg_cpu_run(const RkJpegBatchConfig *cfg, RkJpegCpuStats *stats);
+
+#endif // RK_JPEG_BATCH_H
@@ -0,0 +1,318 @@
+#include "rk_pkt_pool.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/*
+ * A fixed ring of DMA-capable packet buffers. Every slot moves
+ * FREE -> USER (acquire) -> DECODER (submit) -> FREE (release), so a buffer
+ * is never refilled while MPP may still read it.
+ */
+MPP_RET rk_pkt_pool_init(RkPktPool *pool, RK_U32 count, size_t size,
+                         RkPktReleaseCb release_cb, void *opaque)
+{
+    MPP_RET ret = MPP_OK;
+    RK_U32 i;
+
+    if (!pool || !count || count > RK_PKT_POOL_MAX)
+        return MPP_ERR_VALUE;
+
+    memset(pool, 0, sizeof(RkPktPool));
+    pool->size = size;
+    pool->release_cb = release_cb;
+    pool->opaque = opaque;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    ret = mpp_buffer_group_get_internal(&pool->group, MPP_BUFFER_TYPE_DRM);
+    if (ret) {
+        mpp_err("Failed to get packet buffer group\n");
+        goto ERR_RET;
+    }
+
+    for (i = 0; i < count; i++) {
+        ret = mpp_buffer_get(pool->group, &pool->bufs[i], size);
+        if (ret) {
+            mpp_err("Failed to get packet buffer %d\n", i);
+            goto ERR_RET;
+        }
+
+        ret = mpp_packet_init_with_buffer(&pool->pkts[i], pool->bufs[i]);
+        if (ret) {
+            mpp_err("Failed to init packet %d\n", i);
+            goto ERR_RET;
+        }
+        pool->count++;
+    }
+
+    return MPP_OK;
+
+ERR_RET:
+    rk_pkt_pool_deinit(pool);
+    return ret;
+}
+
+void rk_pkt_pool_deinit(RkPktPool *pool)
+{
+    RK_U32 i;
+
+    for (i = 0; i < RK_PKT_POOL_MAX; i++) {
+        if (pool->pkts[i])
+            mpp_packet_deinit(&pool->pkts[i]);
+        if (pool->bufs[i]) {
+            mpp_buffer_put(pool->bufs[i]);
+            pool->bufs[i] = NULL;
+        }
+    }
+
+    for (i = 0; i < RK_PKT_POOL_EXT_MAX; i++) {
+        if (pool->ext[i])
+            mpp_packet_deinit(&pool->ext[i]);
+    }
+
+    if (pool->group) {
+        mpp_buffer_group_put(pool->group);
+        pool->group = NULL;
+    }
+
+    pool->count = 0;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+}
+
+// Caller holds pool->lock; state points at the slot's state on success
+static int find_packet(RkPktPool *pool, MppPacket packet, RkPktSlotState **state)
+{
+    RK_U32 i;
+
+    for (i = 0; i < pool->count; i++) {
+        if (pool->pkts[i] == packet) {
+            *state = &pool->state[i];
+            return i;
+        }
+    }
+
+    for (i = 0; i < RK_PKT_POOL_EXT_MAX; i++) {
+        if (pool->ext[i] == packet) {
+            *state = &pool->ext_state[i];
+            return -1;
+        }
+    }
+
+    *state = NULL;
+    return -2;
+}
+
+/*
+ * Take a free slot, waiting up to timeout (MppPollType semantics) for the
+ * decoder to release one. The packet comes back empty: pos at the start of
+ * the buffer, length 0, no EOS.
+ */
+MppPacket rk_pkt_pool_acquire(RkPktPool *pool, MppPollType timeout)
+{
+    MppPacket packet = NULL;
+    struct timespec deadline;
+    double start = 0;
+    RK_U32 i;
+
+    if (timeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        for (i = 0; i < pool->count; i++) {
+            if (pool->state[i] == PKT_SLOT_FREE)
+                break;
+        }
+        if (i < pool->count)
+            break;
+
+        if (timeout == MPP_POLL_NON_BLOCK)
+            goto OUT;
+
+        if (!start) {
+            start = get_time_in_seconds();
+            pool->acquire_waits++;
+        }
+
+        if (timeout > 0) {
+            if (pthread_cond_timedwait(&pool->cond, &pool->lock, &deadline) == ETIMEDOUT)
+                goto OUT;
+        } else {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+    }
+
+    pool->state[i] = PKT_SLOT_USER;
+    packet = pool->pkts[i];
+
+    mpp_packet_set_pos(packet, mpp_packet_get_data(packet));
+    mpp_packet_set_length(packet, 0);
+    mpp_packet_set_pts(packet, 0);
+    mpp_packet_set_dts(packet, 0);
+    mpp_packet_clr_eos(packet);
+
+OUT:
+    if (start)
+        pool->acquire_wait_time += get_time_in_seconds() - start;
+    pthread_mutex_unlock(&pool->lock);
+    return packet;
+}
+
+// Caller holds pool->lock; returns a free ext index or -1
+static int find_ext_slot(RkPktPool *pool)
+{
+    int i;
+
+    for (i = 0; i < RK_PKT_POOL_EXT_MAX; i++) {
+        if (!pool->ext[i])
+            return i;
+    }
+    mpp_err("Too many wrapped packets in flight\n");
+    return -1;
+}
+
+/*
+ * Build a packet over caller memory (e.g. an mmapped stream) without copying.
+ * The caller must keep the memory valid until the release callback reports
+ * it back with slot -1.
+ */
+MppPacket rk_pkt_pool_wrap(RkPktPool *pool, void *data, size_t size)
+{
+    MppPacket packet = NULL;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    i = find_ext_slot(pool);
+    if (i >= 0 && !mpp_packet_init(&packet, data, size)) {
+        pool->ext[i] = packet;
+        pool->ext_state[i] = PKT_SLOT_USER;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return packet;
+}
+
+/*
+ * Packet over a window of an existing MppBuffer, e.g. an imported dma-buf
+ * holding the whole stream. The packet keeps a buffer reference until it is
+ * released, and the decoder can read it without staging a copy.
+ */
+MppPacket rk_pkt_pool_wrap_buffer(RkPktPool *pool, MppBuffer buffer, size_t offset, size_t size)
+{
+    MppPacket packet = NULL;
+    int i;
+
+    if (offset + size > mpp_buffer_get_size(buffer))
+        return NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    i = find_ext_slot(pool);
+    if (i >= 0 && !mpp_packet_init_with_buffer(&packet, buffer)) {
+        char *base = mpp_buffer_get_ptr(buffer);
+
+        mpp_packet_set_pos(packet, base + offset);
+        mpp_packet_set_length(packet, size);
+        pool->ext[i] = packet;
+        pool->ext_state[i] = PKT_SLOT_USER;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return packet;
+}
+
+// The packet has been enqueued: MPP owns it until rk_pkt_pool_release
+MPP_RET rk_pkt_pool_submit(RkPktPool *pool, MppPacket packet)
+{
+    RkPktSlotState *state;
+    MPP_RET ret = MPP_OK;
+    int slot;
+
+    pthread_mutex_lock(&pool->lock);
+    slot = find_packet(pool, packet, &state);
+    if (!state || *state != PKT_SLOT_USER) {
+        mpp_err("submit of packet %p not held by the user\n", packet);
+        ret = MPP_NOK;
+    } else {
+        *state = PKT_SLOT_DECODER;
+        pool->decoder_owned++;
+        if (pool->decoder_owned > pool->peak_decoder_owned)
+            pool->peak_decoder_owned = pool->decoder_owned;
+        pool->submitted++;
+        if (slot < 0)
+            pool->ext_submitted++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+// Give back a packet that was acquired or wrapped but never submitted
+MPP_RET rk_pkt_pool_cancel(RkPktPool *pool, MppPacket packet)
+{
+    RkPktSlotState *state;
+    MPP_RET ret = MPP_OK;
+    int slot;
+
+    pthread_mutex_lock(&pool->lock);
+    slot = find_packet(pool, packet, &state);
+    if (!state || *state != PKT_SLOT_USER) {
+        mpp_err("cancel of packet %p not held by the user\n", packet);
+        ret = MPP_NOK;
+    } else if (slot < 0) {
+        RK_U32 i = state - pool->ext_state;
+
+        mpp_packet_deinit(&pool->ext[i]);
+        *state = PKT_SLOT_FREE;
+    } else {
+        *state = PKT_SLOT_FREE;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+/*
+ * The decoder is done with packet (its input task came back). Notifies the
+ * owner, then frees the slot for the next acquire.
+ */
+MPP_RET rk_pkt_pool_release(RkPktPool *pool, MppPacket packet)
+{
+    RkPktSlotState *state;
+    int slot;
+
+    pthread_mutex_lock(&pool->lock);
+    slot = find_packet(pool, packet, &state);
+    if (!state || *state != PKT_SLOT_DECODER) {
+        pthread_mutex_unlock(&pool->lock);
+        mpp_err("release of packet %p not owned by the decoder\n", packet);
+        return MPP_NOK;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // Outside the lock so the callback may acquire or wrap again
+    if (pool->release_cb)
+        pool->release_cb(pool->opaque, packet, slot);
+
+    pthread_mutex_lock(&pool->lock);
+    if (slot < 0)
+        mpp_packet_deinit(&pool->ext[state - pool->ext_state]);
+    *state = PKT_SLOT_FREE;
+    pool->decoder_owned--;
+    pool->released++;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return MPP_OK;
+}
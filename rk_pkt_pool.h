@@ -0,0 +1,64 @@
+#ifndef RK_PKT_POOL_H
+#define RK_PKT_POOL_H
+
+#include <pthread.h>
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+#include <rockchip/mpp_packet.h>
+
+#define RK_PKT_POOL_MAX         32      // buffer-backed slots
+#define RK_PKT_POOL_EXT_MAX     64      // packets over caller memory in flight
+
+// Who may touch a slot's memory
+typedef enum {
+    PKT_SLOT_FREE = 0,
+    PKT_SLOT_USER,                      // acquired, being filled
+    PKT_SLOT_DECODER,                   // queued, owned by MPP until released
+} RkPktSlotState;
+
+/*
+ * Called when the decoder gives a packet back, before the slot is reused.
+ * slot is -1 for a packet made by rk_pkt_pool_wrap, whose data pointer
+ * tells the owner which part of its memory is free again.
+ */
+typedef void (*RkPktReleaseCb)(void *opaque, MppPacket packet, int slot);
+
+typedef struct {
+    MppBufferGroup  group;
+    size_t          size;
+    RK_U32          count;
+    MppBuffer       bufs[RK_PKT_POOL_MAX];
+    MppPacket       pkts[RK_PKT_POOL_MAX];
+    RkPktSlotState  state[RK_PKT_POOL_MAX];
+
+    MppPacket       ext[RK_PKT_POOL_EXT_MAX];
+    RkPktSlotState  ext_state[RK_PKT_POOL_EXT_MAX];
+
+    RkPktReleaseCb  release_cb;
+    void           *opaque;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    // Statistics
+    RK_U32          decoder_owned;
+    RK_U32          peak_decoder_owned;
+    RK_U32          acquire_waits;
+    double          acquire_wait_time;
+    RK_U64          submitted;
+    RK_U64          released;
+    RK_U64          ext_submitted;
+} RkPktPool;
+
+// Function declarations
+MPP_RET rk_pkt_pool_init(RkPktPool *pool, RK_U32 count, size_t size,
+                         RkPktReleaseCb release_cb, void *opaque);
+void rk_pkt_pool_deinit(RkPktPool *pool);
+MppPacket rk_pkt_pool_acquire(RkPktPool *pool, MppPollType timeout);
+MppPacket rk_pkt_pool_wrap(RkPktPool *pool, void *data, size_t size);
+MppPacket rk_pkt_pool_wrap_buffer(RkPktPool *pool, MppBuffer buffer, size_t offset, size_t size);
+MPP_RET rk_pkt_pool_submit(RkPktPool *pool, MppPacket packet);
+MPP_RET rk_pkt_pool_cancel(RkPktPool *pool, MppPacket packet);
+MPP_RET rk_pkt_pool_release(RkPktPool *pool, MppPacket packet);
+
+#endif // RK_PKT_POOL_H
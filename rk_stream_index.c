@@ -0,0 +1,296 @@
+#include "rk_stream_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static const char *codec_name(MppCodingType type)
+{
+    return type == MPP_VIDEO_CodingHEVC ? "h265" : "h264";
+}
+
+static void index_path(char *path, const char *input)
+{
+    snprintf(path, STREAM_INDEX_PATH_MAX, "%s%s", input, STREAM_INDEX_SUFFIX);
+}
+
+static MPP_RET stat_input(const char *path, size_t *size, RK_S64 *mtime_ns)
+{
+    struct stat st;
+
+    if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+        mpp_err("Cannot index %s: not a regular file\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+    *size = st.st_size;
+    *mtime_ns = (RK_S64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return MPP_OK;
+}
+
+static MPP_RET add_key(RkStreamIndex *idx, const RkKeyframe *key)
+{
+    if (idx->count == idx->cap) {
+        RK_U32 cap = idx->cap ? idx->cap * 2 : 256;
+        RkKeyframe *keys = realloc(idx->keys, cap * sizeof(RkKeyframe));
+
+        if (!keys)
+            return MPP_ERR_MALLOC;
+        idx->keys = keys;
+        idx->cap = cap;
+    }
+    idx->keys[idx->count++] = *key;
+    return MPP_OK;
+}
+
+/*
+ * One pass of the access-unit parser over a mapping of the file. An AU
+ * that carries a full set of parameter sets is remembered, and a random
+ * access point without its own set points back at the last one. Points
+ * before any parameter sets cannot start a decode and are left out.
+ */
+MPP_RET rk_stream_index_scan(RkStreamIndex *idx, const char *path, MppCodingType type)
+{
+    RK_U32 full = ANNEXB_PS_SPS | ANNEXB_PS_PPS;
+    size_t ps_offset = 0, ps_len = 0;
+    RkAuParser parser;
+    size_t offset, len;
+    double start = get_time_in_seconds();
+    MPP_RET ret;
+    RK_U8 *map;
+    int fd;
+
+    memset(idx, 0, sizeof(RkStreamIndex));
+    idx->type = type;
+    if (type == MPP_VIDEO_CodingHEVC)
+        full |= ANNEXB_PS_VPS;
+
+    ret = stat_input(path, &idx->size, &idx->mtime_ns);
+    if (ret)
+        return ret;
+    if (!idx->size)
+        return MPP_ERR_VALUE;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        mpp_err("Failed to open %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+    map = mmap(NULL, idx->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        mpp_err("Failed to mmap %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+    madvise(map, idx->size, MADV_SEQUENTIAL);
+
+    rk_au_parser_init(&parser, type);
+    rk_au_parser_set_data(&parser, map, idx->size, 1);
+    while (rk_au_parser_next(&parser, &offset, &len) == AU_PARSER_OK) {
+        const RkAuInfo *au = &parser.info;
+        RK_U32 own = (au->ps & full) == full;
+        RkKeyframe key;
+
+        if (own) {
+            ps_offset = offset + au->ps_offset;
+            ps_len = au->vcl_offset - au->ps_offset;
+        }
+
+        key.rap = annexb_random_access(type, au->vcl_type);
+        if (key.rap == ANNEXB_RAP_NONE || (!own && !ps_len))
+            continue;
+        key.offset = offset;
+        key.au = parser.au_count - 1;
+        key.ps_offset = own ? 0 : ps_offset;
+        key.ps_len = own ? 0 : ps_len;
+        ret = add_key(idx, &key);
+        if (ret)
+            break;
+    }
+    idx->au_count = parser.au_count;
+    munmap(map, idx->size);
+
+    idx->scan_time = get_time_in_seconds() - start;
+    if (ret)
+        rk_stream_index_deinit(idx);
+    return ret;
+}
+
+/*
+ * "stream codec size mtime_ns access_units", then one line per point:
+ * "offset au clean|open ps_offset ps_len". Lines starting with # are
+ * comments.
+ */
+MPP_RET rk_stream_index_save(const RkStreamIndex *idx, const char *path)
+{
+    char file[STREAM_INDEX_PATH_MAX], tmp[STREAM_INDEX_PATH_MAX + 8];
+    FILE *fp;
+    RK_U32 i;
+
+    index_path(file, path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    fp = fopen(tmp, "w");
+    if (!fp)
+        return MPP_ERR_OPEN_FILE;
+
+    fprintf(fp, "# rk_stream_index %d: random access points of %s\n", STREAM_INDEX_VERSION, path);
+    fprintf(fp, "stream %s %zu %lld %llu\n", codec_name(idx->type), idx->size,
+            (long long)idx->mtime_ns, (unsigned long long)idx->au_count);
+    for (i = 0; i < idx->count; i++) {
+        const RkKeyframe *key = &idx->keys[i];
+
+        fprintf(fp, "%zu %llu %s %zu %zu\n", key->offset, (unsigned long long)key->au,
+                key->rap == ANNEXB_RAP_CLEAN ? "clean" : "open", key->ps_offset, key->ps_len);
+    }
+
+    // Readers never see a half-written index
+    if (fclose(fp) || rename(tmp, file)) {
+        unlink(tmp);
+        return MPP_NOK;
+    }
+    return MPP_OK;
+}
+
+// MPP_NOK when there is no saved index or it is for another version of the input
+static MPP_RET load_index(RkStreamIndex *idx, const char *path, MppCodingType type)
+{
+    char file[STREAM_INDEX_PATH_MAX];
+    char line[128], codec[8];
+    unsigned long long au_count;
+    long long mtime_ns;
+    size_t size;
+    RK_U32 header = 0;
+    MPP_RET ret = MPP_OK;
+    FILE *fp;
+
+    memset(idx, 0, sizeof(RkStreamIndex));
+    idx->type = type;
+    ret = stat_input(path, &idx->size, &idx->mtime_ns);
+    if (ret)
+        return ret;
+
+    index_path(file, path);
+    fp = fopen(file, "r");
+    if (!fp)
+        return MPP_NOK;
+
+    while (!ret && fgets(line, sizeof(line), fp)) {
+        unsigned long long au;
+        char rap[8];
+        RkKeyframe key;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (!header) {
+            if (sscanf(line, "stream %7s %zu %lld %llu", codec, &size, &mtime_ns, &au_count) != 4 ||
+                strcmp(codec, codec_name(type)) || size != idx->size ||
+                mtime_ns != idx->mtime_ns)
+                ret = MPP_NOK;
+            idx->au_count = au_count;
+            header = 1;
+            continue;
+        }
+        if (sscanf(line, "%zu %llu %7s %zu %zu", &key.offset, &au, rap, &key.ps_offset,
+                   &key.ps_len) != 5 || key.offset >= idx->size) {
+            mpp_err("%s: bad index line, rescanning\n", file);
+            ret = MPP_NOK;
+            break;
+        }
+        key.au = au;
+        key.rap = strcmp(rap, "clean") ? ANNEXB_RAP_OPEN : ANNEXB_RAP_CLEAN;
+        ret = add_key(idx, &key);
+    }
+    fclose(fp);
+
+    if (!header)
+        ret = MPP_NOK;
+    if (ret)
+        rk_stream_index_deinit(idx);
+    else
+        idx->loaded = 1;
+    return ret;
+}
+
+/*
+ * The saved index when it matches the input, otherwise a fresh scan that
+ * is saved for next time. An input directory we cannot write to only
+ * costs the scan on every run.
+ */
+MPP_RET rk_stream_index_open(RkStreamIndex *idx, const char *path, MppCodingType type)
+{
+    MPP_RET ret;
+
+    if (!load_index(idx, path, type))
+        return MPP_OK;
+
+    ret = rk_stream_index_scan(idx, path, type);
+    if (ret)
+        return ret;
+    if (rk_stream_index_save(idx, path))
+        mpp_log("Could not save the index of %s, it is rescanned next time\n", path);
+    return MPP_OK;
+}
+
+/*
+ * Cut the stream into up to count ranges of about equal access units, each
+ * from a clean random access point (IDR, BLA) so it decodes on its own and
+ * its frames come out complete. Open GOP points are not used: their
+ * leading pictures would be dropped. The first range starts at the stream
+ * start. Returns the number of ranges, fewer when there are too few points.
+ */
+RK_U32 rk_stream_index_split(const RkStreamIndex *idx, RK_U32 count, RkStreamRange *ranges)
+{
+    RK_U32 n = 1, i, k = 0;
+
+    memset(ranges, 0, count * sizeof(RkStreamRange));
+    for (i = 1; i < count; i++) {
+        RK_U64 target = idx->au_count * i / count;
+        RK_S32 best = -1;
+        RK_U64 best_dist = 0;
+
+        for (; k < idx->count; k++) {
+            const RkKeyframe *key = &idx->keys[k];
+            RK_U64 dist = key->au > target ? key->au - target : target - key->au;
+
+            if (key->rap != ANNEXB_RAP_CLEAN || !key->au ||
+                key->offset <= ranges[n - 1].start)
+                continue;
+            // Keys are in stream order, past the target they only get further
+            if (best >= 0 && dist > best_dist)
+                break;
+            best = k;
+            best_dist = dist;
+        }
+        if (best < 0)
+            break;
+
+        ranges[n].start = idx->keys[best].offset;
+        ranges[n].first_au = idx->keys[best].au;
+        ranges[n].prefix_offset = idx->keys[best].ps_offset;
+        ranges[n].prefix_len = idx->keys[best].ps_len;
+        ranges[n - 1].end = ranges[n].start;
+        n++;
+        k = best + 1;
+    }
+    ranges[n - 1].end = idx->size;
+    return n;
+}
+
+void rk_stream_index_deinit(RkStreamIndex *idx)
+{
+    free(idx->keys);
+    idx->keys = NULL;
+    idx->count = 0;
+    idx->cap = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef RK_STREAM_INDEX_H
+#define RK_STREAM_INDEX_H
+
+#include <rockchip/rk_mpi.h>
+#include "rk_stream_src.h"
+
+// Appended to the input path for the saved index
+#define STREAM_INDEX_SUFFIX     ".idx"
+#define STREAM_INDEX_VERSION    1
+#define STREAM_INDEX_PATH_MAX   256
+
+// One random access point, in decode order
+typedef struct {
+    size_t          offset;             // start of its access unit
+    RK_U64          au;                 // access units before it
+    RK_U32          rap;                // ANNEXB_RAP_CLEAN or ANNEXB_RAP_OPEN
+    size_t          ps_offset;          // parameter sets it needs but does not carry
+    size_t          ps_len;             // 0 when it carries its own
+} RkKeyframe;
+
+/*
+ * IDR / IRAP positions of an Annex-B elementary stream, found in one pass
+ * with the access-unit parser and kept next to the input as a text file,
+ * so a later run over the same recording skips the scan. The saved index
+ * is used only while the input's size and mtime still match.
+ */
+typedef struct {
+    MppCodingType   type;
+    size_t          size;               // input bytes
+    RK_S64          mtime_ns;
+    RK_U64          au_count;
+    RkKeyframe     *keys;
+    RK_U32          count;
+    RK_U32          cap;
+
+    RK_U32          loaded;             // from the saved file, not scanned
+    double          scan_time;
+} RkStreamIndex;
+
+// Function declarations
+MPP_RET rk_stream_index_open(RkStreamIndex *idx, const char *path, MppCodingType type);
+MPP_RET rk_stream_index_scan(RkStreamIndex *idx, const char *path, MppCodingType type);
+MPP_RET rk_stream_index_save(const RkStreamIndex *idx, const char *path);
+RK_U32 rk_stream_index_split(const RkStreamIndex *idx, RK_U32 count, RkStreamRange *ranges);
+void rk_stream_index_deinit(RkStreamIndex *idx);
+
+#endif // RK_STREAM_INDEX_H
@@ -0,0 +1,461 @@
+#include "rk_stream_src.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <rockchip/mpp_log.h>
+
+static const char *mode_names[] = { "read", "mmap", "dmabuf" };
+
+const char *rk_stream_src_mode_name(RkStreamSrcMode mode)
+{
+    return mode <= STREAM_SRC_DMABUF ? mode_names[mode] : "unknown";
+}
+
+static int open_path(const char *path, RK_U32 *own_fd)
+{
+    if (!strncmp(path, "fd:", 3)) {
+        *own_fd = 0;
+        return atoi(path + 3);
+    }
+    *own_fd = 1;
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+MPP_RET rk_stream_src_open(RkStreamSrc *src, const char *path, RkStreamSrcMode mode)
+{
+    struct stat st;
+    off_t end;
+
+    memset(src, 0, sizeof(RkStreamSrc));
+    src->mode = mode;
+    src->left = (size_t)-1;
+
+    src->fd = open_path(path, &src->own_fd);
+    if (src->fd < 0) {
+        mpp_err("Failed to open input file %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    if (mode == STREAM_SRC_READ) {
+        src->fp = fdopen(src->fd, "rb");
+        if (!src->fp)
+            goto ERR_RET;
+        // fclose owns the descriptor from here on
+        src->own_fd = 0;
+        return MPP_OK;
+    }
+
+    // dma-buf fds report size through lseek, not fstat
+    if (fstat(src->fd, &st) == 0 && S_ISREG(st.st_mode))
+        end = st.st_size;
+    else
+        end = lseek(src->fd, 0, SEEK_END);
+    if (end <= 0) {
+        mpp_err("Input %s is empty or not seekable\n", path);
+        goto ERR_RET;
+    }
+    src->size = end;
+    src->end = end;
+
+    if (mode == STREAM_SRC_DMABUF) {
+        MppBufferInfo info;
+
+        memset(&info, 0, sizeof(info));
+        info.type = MPP_BUFFER_TYPE_EXT_DMA;
+        info.fd = src->fd;
+        info.size = src->size;
+        info.index = -1;
+        if (mpp_buffer_import(&src->dma_buf, &info)) {
+            mpp_err("Failed to import %s as dma-buf\n", path);
+            goto ERR_RET;
+        }
+        return MPP_OK;
+    }
+
+    src->map = mmap(NULL, src->size, PROT_READ, MAP_SHARED, src->fd, 0);
+    if (src->map == MAP_FAILED) {
+        src->map = NULL;
+        mpp_err("Failed to mmap %s\n", path);
+        goto ERR_RET;
+    }
+
+    // Sequential hint doubles kernel readahead and frees pages behind us
+    madvise(src->map, src->size, MADV_SEQUENTIAL);
+    return MPP_OK;
+
+ERR_RET:
+    rk_stream_src_close(src);
+    return MPP_ERR_OPEN_FILE;
+}
+
+void rk_stream_src_close(RkStreamSrc *src)
+{
+    free(src->stage);
+    src->stage = NULL;
+    free(src->prefix);
+    src->prefix = NULL;
+    free(src->head);
+    src->head = NULL;
+
+    if (src->dma_buf) {
+        mpp_buffer_put(src->dma_buf);
+        src->dma_buf = NULL;
+    }
+
+    if (src->map) {
+        munmap(src->map, src->size);
+        src->map = NULL;
+    }
+
+    if (src->fp) {
+        fclose(src->fp);
+        src->fp = NULL;
+    } else if (src->own_fd && src->fd >= 0) {
+        close(src->fd);
+    }
+    src->fd = -1;
+}
+
+/*
+ * Decode only range of the input, set before the first packet and before
+ * rk_stream_src_set_au_mode. The range prefix is read here and joined to
+ * the first packet, so the decoder sees the parameter sets with the
+ * random access point.
+ */
+MPP_RET rk_stream_src_set_range(RkStreamSrc *src, const RkStreamRange *range)
+{
+    if (range->start > range->end || (src->mode != STREAM_SRC_READ && range->end > src->size)) {
+        mpp_err("Stream range %zu-%zu is outside the input\n", range->start, range->end);
+        return MPP_ERR_VALUE;
+    }
+
+    if (range->prefix_len) {
+        src->prefix = malloc(range->prefix_len);
+        if (!src->prefix)
+            return MPP_ERR_MALLOC;
+        if (pread(src->fd, src->prefix, range->prefix_len, range->prefix_offset) !=
+            (ssize_t)range->prefix_len) {
+            mpp_err("Failed to read %zu bytes of parameter sets at %zu\n",
+                    range->prefix_len, range->prefix_offset);
+            return MPP_NOK;
+        }
+        src->prefix_len = range->prefix_len;
+    }
+
+    src->start = range->start;
+    src->first_au = range->first_au;
+    if (src->mode == STREAM_SRC_READ) {
+        if (fseeko(src->fp, range->start, SEEK_SET)) {
+            mpp_err("Failed to seek to %zu\n", range->start);
+            return MPP_NOK;
+        }
+        src->left = range->end - range->start;
+    } else {
+        src->pos = range->start;
+        src->ahead = range->start;
+        src->end = range->end;
+    }
+    return MPP_OK;
+}
+
+/*
+ * First packet of a range with a prefix: copy both into one heap buffer
+ * and send that instead. MPP copies non-DMA packets anyway, and this is
+ * one packet per range.
+ */
+static MPP_RET join_prefix(RkStreamSrc *src, RkPktPool *pool, MppPacket *packet)
+{
+    MppPacket pkt = *packet;
+    size_t len = mpp_packet_get_length(pkt);
+    MppPacket head;
+
+    src->head = malloc(src->prefix_len + len);
+    if (!src->head)
+        return MPP_ERR_MALLOC;
+    memcpy(src->head, src->prefix, src->prefix_len);
+    memcpy(src->head + src->prefix_len, mpp_packet_get_pos(pkt), len);
+
+    head = rk_pkt_pool_wrap(pool, src->head, src->prefix_len + len);
+    if (!head)
+        return MPP_NOK;
+    mpp_packet_set_pts(head, mpp_packet_get_pts(pkt));
+    mpp_packet_set_dts(head, mpp_packet_get_dts(pkt));
+    if (mpp_packet_get_eos(pkt))
+        mpp_packet_set_eos(head);
+    rk_pkt_pool_cancel(pool, pkt);
+
+    src->bytes_in += src->prefix_len;
+    src->bytes_staged += src->prefix_len + len;
+    src->prefix_len = 0;
+    *packet = head;
+    return MPP_OK;
+}
+
+// Keep STREAM_SRC_READAHEAD bytes requested ahead of pos
+static void readahead_window(RkStreamSrc *src)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t target = src->pos + STREAM_SRC_READAHEAD;
+    size_t start;
+
+    if (target > src->end)
+        target = src->end;
+    if (src->ahead >= target || src->ahead > src->pos + STREAM_SRC_READAHEAD / 2)
+        return;
+
+    start = src->ahead & ~(page - 1);
+    madvise(src->map + start, target - start, MADV_WILLNEED);
+    src->ahead = target;
+}
+
+/*
+ * Hand out one access unit per packet instead of fixed-size chunks, each
+ * stamped with a PTS from its index at fps. Mapped and dma-buf streams are
+ * parsed in place; read mode parses a staging window and copies each AU
+ * into a pool slot.
+ */
+MPP_RET rk_stream_src_set_au_mode(RkStreamSrc *src, MppCodingType type, RK_U32 fps)
+{
+    if (type != MPP_VIDEO_CodingAVC && type != MPP_VIDEO_CodingHEVC) {
+        mpp_err("Access-unit packetizing supports H.264 and H.265 only\n");
+        return MPP_ERR_VALUE;
+    }
+
+    rk_au_parser_init(&src->parser, type);
+    src->fps = fps ? fps : 30;
+    src->au_mode = 1;
+
+    if (src->mode == STREAM_SRC_READ) {
+        src->stage_size = STREAM_SRC_STAGE_SIZE;
+        src->stage = malloc(src->stage_size);
+        if (!src->stage) {
+            mpp_err("Failed to allocate stream staging buffer\n");
+            return MPP_ERR_MALLOC;
+        }
+        src->stage_fill = 0;
+        rk_au_parser_set_data(&src->parser, src->stage, 0, 0);
+    } else {
+        RK_U8 *data = src->map ? src->map : mpp_buffer_get_ptr(src->dma_buf);
+
+        rk_au_parser_set_data(&src->parser, data + src->start, src->end - src->start, 1);
+    }
+    return MPP_OK;
+}
+
+// Slide consumed bytes out of the staging window and read more behind them
+static MPP_RET refill_stage(RkStreamSrc *src)
+{
+    RkAuParser *parser = &src->parser;
+    size_t consumed = rk_au_parser_consumed(parser);
+    size_t len;
+
+    if (consumed) {
+        memmove(src->stage, src->stage + consumed, src->stage_fill - consumed);
+        src->stage_fill -= consumed;
+        rk_au_parser_rebase(parser, consumed);
+    }
+
+    if (src->stage_fill == src->stage_size) {
+        // One AU fills the whole window
+        RK_U8 *stage = realloc(src->stage, src->stage_size * 2);
+
+        if (!stage) {
+            mpp_err("Failed to grow stream staging buffer\n");
+            return MPP_ERR_MALLOC;
+        }
+        src->stage = stage;
+        src->stage_size *= 2;
+    }
+
+    len = src->stage_size - src->stage_fill;
+    if (len > src->left)
+        len = src->left;
+    len = fread(src->stage + src->stage_fill, 1, len, src->fp);
+    src->left -= len;
+    src->stage_fill += len;
+    src->bytes_copied += len;
+    rk_au_parser_set_data(parser, src->stage, src->stage_fill, len == 0);
+    return MPP_OK;
+}
+
+static MPP_RET next_au(RkStreamSrc *src, RkPktPool *pool, MppPacket *packet, RK_U32 *eos)
+{
+    RkAuParser *parser = &src->parser;
+    MppPacket pkt = NULL;
+    size_t offset = 0, len = 0;
+    RK_S64 pts = (src->first_au + parser->au_count) * 1000000 / src->fps;
+    int ret;
+
+    if (src->mode == STREAM_SRC_READ) {
+        pkt = rk_pkt_pool_acquire(pool, MPP_POLL_NON_BLOCK);
+        if (!pkt)
+            return MPP_ERR_BUFFER_FULL;
+    }
+
+    while ((ret = rk_au_parser_next(parser, &offset, &len)) == AU_PARSER_MORE) {
+        if (refill_stage(src)) {
+            if (pkt)
+                rk_pkt_pool_cancel(pool, pkt);
+            return MPP_NOK;
+        }
+    }
+    if (ret == AU_PARSER_END)
+        len = 0;
+
+    if (src->mode == STREAM_SRC_READ) {
+        if (len > pool->size) {
+            mpp_err("Access unit of %zu bytes exceeds the %zu byte packet buffer\n",
+                    len, pool->size);
+            rk_pkt_pool_cancel(pool, pkt);
+            return MPP_NOK;
+        }
+        memcpy(mpp_packet_get_data(pkt), src->stage + offset, len);
+        mpp_packet_set_length(pkt, len);
+        src->bytes_copied += len;
+    } else if (src->mode == STREAM_SRC_MMAP) {
+        // Parser offsets count from the range start
+        src->pos = src->start + offset;
+        readahead_window(src);
+        pkt = rk_pkt_pool_wrap(pool, src->map + src->pos, len);
+        src->bytes_staged += len;
+    } else {
+        pkt = rk_pkt_pool_wrap_buffer(pool, src->dma_buf, src->start + offset, len);
+    }
+    if (!pkt)
+        return MPP_NOK;
+
+    mpp_packet_set_pts(pkt, pts);
+    mpp_packet_set_dts(pkt, pts);
+    *eos = (ret == AU_PARSER_END || rk_au_parser_done(parser));
+    if (*eos)
+        mpp_packet_set_eos(pkt);
+
+    src->bytes_in += len;
+    *packet = pkt;
+    return MPP_OK;
+}
+
+// Fixed-size chunks with NAL units split anywhere, for MPP's own parser
+static MPP_RET next_chunk(RkStreamSrc *src, RkPktPool *pool, size_t chunk,
+                          MppPacket *packet, RK_U32 *eos)
+{
+    MppPacket pkt = NULL;
+    size_t len;
+
+    if (src->mode == STREAM_SRC_READ) {
+        pkt = rk_pkt_pool_acquire(pool, MPP_POLL_NON_BLOCK);
+        if (!pkt)
+            return MPP_ERR_BUFFER_FULL;
+
+        if (chunk > pool->size)
+            chunk = pool->size;
+        if (chunk > src->left)
+            chunk = src->left;
+        len = fread(mpp_packet_get_data(pkt), 1, chunk, src->fp);
+        mpp_packet_set_length(pkt, len);
+        src->left -= len;
+        *eos = (len != chunk || !src->left);
+
+        src->bytes_copied += len;
+    } else {
+        len = src->end - src->pos;
+        if (len > chunk)
+            len = chunk;
+
+        if (src->mode == STREAM_SRC_MMAP) {
+            readahead_window(src);
+            pkt = rk_pkt_pool_wrap(pool, src->map + src->pos, len);
+            src->bytes_staged += len;
+        } else {
+            pkt = rk_pkt_pool_wrap_buffer(pool, src->dma_buf, src->pos, len);
+        }
+        if (!pkt)
+            return MPP_NOK;
+
+        src->pos += len;
+        *eos = (src->pos == src->end);
+    }
+
+    if (*eos)
+        mpp_packet_set_eos(pkt);
+
+    src->bytes_in += len;
+    *packet = pkt;
+    return MPP_OK;
+}
+
+/*
+ * Next chunk of up to chunk bytes (or next access unit in AU mode) as a
+ * packet owned by pool.
+ * MPP_ERR_BUFFER_FULL: every pool slot is with the decoder, release one first.
+ */
+MPP_RET rk_stream_src_next(RkStreamSrc *src, RkPktPool *pool, size_t chunk,
+                           MppPacket *packet, RK_U32 *eos)
+{
+    MPP_RET ret;
+
+    if (src->au_mode)
+        ret = next_au(src, pool, packet, eos);
+    else
+        ret = next_chunk(src, pool, chunk, packet, eos);
+    if (!ret && src->prefix_len) {
+        ret = join_prefix(src, pool, packet);
+        if (ret)
+            rk_pkt_pool_cancel(pool, *packet);
+    }
+
+    // An SPS split across two chunks is missed, the next one is not
+    if (!ret && src->track_level && *packet) {
+        RK_U32 level = annexb_scan_level(src->level_type, mpp_packet_get_pos(*packet),
+                                         mpp_packet_get_length(*packet));
+        if (level)
+            __atomic_store_n(&src->level_idc, level, __ATOMIC_RELEASE);
+    }
+    return ret;
+}
+
+/*
+ * Scan every packet for SPS NAL units and keep the last level_idc, for
+ * sizing the frame buffers before the first frame of a new sequence.
+ */
+void rk_stream_src_track_level(RkStreamSrc *src, MppCodingType type)
+{
+    src->level_type = type;
+    src->track_level = 1;
+}
+
+// Level of the latest SPS fed to the decoder, 0 while none was seen
+RK_U32 rk_stream_src_level(RkStreamSrc *src)
+{
+    return __atomic_load_n(&src->level_idc, __ATOMIC_ACQUIRE);
+}
+
+// PTS the next access unit goes out with, in AU mode
+RK_S64 rk_stream_src_next_pts(RkStreamSrc *src)
+{
+    return (src->first_au + src->parser.au_count) * 1000000 / src->fps;
+}
+
+/*
+ * Release notification for a wrapped packet: mapped pages it covered are
+ * consumed, drop them so the mapping does not pin the whole file.
+ */
+void rk_stream_src_release(RkStreamSrc *src, MppPacket packet)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    RK_U8 *data = mpp_packet_get_data(packet);
+    size_t start, end;
+
+    // data/size, not pos/length: the decoder advances those as it consumes
+    if (src->mode != STREAM_SRC_MMAP || data < src->map || data >= src->map + src->size)
+        return;
+
+    // Whole pages only, neighbours may still be in flight
+    start = ((size_t)(data - src->map) + page - 1) & ~(page - 1);
+    end = ((size_t)(data - src->map) + mpp_packet_get_size(packet)) & ~(page - 1);
+    if (end > start)
+        madvise(src->map + start, end - start, MADV_DONTNEED);
+}
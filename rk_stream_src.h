@@ -0,0 +1,92 @@
+#ifndef RK_STREAM_SRC_H
+#define RK_STREAM_SRC_H
+
+#include <stdio.h>
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+#include <rockchip/mpp_packet.h>
+#include "rk_pkt_pool.h"
+#include "rk_annexb.h"
+
+// Readahead window kept in flight ahead of the packet being built
+#define STREAM_SRC_READAHEAD    (8 * 1024 * 1024)
+// Initial fread staging window when packetizing; grows to fit one AU
+#define STREAM_SRC_STAGE_SIZE   (4 * 1024 * 1024)
+
+typedef enum {
+    STREAM_SRC_READ = 0,        // fread into pool buffers, one copy per byte
+    STREAM_SRC_MMAP,            // packets point into a file mapping, no copy
+    STREAM_SRC_DMABUF,          // whole stream already in a dma-buf, imported once
+} RkStreamSrcMode;
+
+/*
+ * Part of a stream to decode on its own: [start, end) of the input, from a
+ * random access point. Parameter sets the part relies on but does not
+ * carry are read from [prefix_offset, + prefix_len) and sent ahead of it.
+ * first_au numbers the part's AUs on from the stream's, so PTS continue.
+ */
+typedef struct {
+    size_t          start;
+    size_t          end;
+    RK_U64          first_au;
+    size_t          prefix_offset;
+    size_t          prefix_len;
+} RkStreamRange;
+
+/*
+ * Elementary-stream source. The path may be "fd:N" to use an inherited
+ * descriptor, which is how a dma-buf reaches STREAM_SRC_DMABUF.
+ */
+typedef struct {
+    RkStreamSrcMode mode;
+    FILE           *fp;
+    int             fd;
+    RK_U32          own_fd;
+
+    RK_U8          *map;
+    size_t          size;
+    size_t          pos;
+    size_t          end;                // mapped and dma-buf input stop here
+    size_t          left;               // read mode input left to read
+    size_t          ahead;              // readahead issued up to here
+    MppBuffer       dma_buf;
+
+    // Access-unit packetizing, see rk_stream_src_set_au_mode
+    RK_U32          au_mode;
+    RkAuParser      parser;
+    RK_U32          fps;
+    RK_U8          *stage;              // fread window the parser runs over
+    size_t          stage_size;
+    size_t          stage_fill;
+
+    // Range decode, see rk_stream_src_set_range
+    size_t          start;
+    RK_U64          first_au;
+    RK_U8          *prefix;             // parameter sets for the first packet
+    size_t          prefix_len;
+    RK_U8          *head;               // prefix and first packet joined
+
+    // SPS level seen in the packets, see rk_stream_src_track_level
+    MppCodingType   level_type;
+    RK_U32          track_level;
+    RK_U32          level_idc;          // written by the feeder, read atomically
+
+    RK_U64          bytes_in;           // stream bytes handed to the decoder
+    RK_U64          bytes_copied;       // bytes we copied on the way (fread)
+    RK_U64          bytes_staged;       // bytes in non-DMA packets MPP copies itself
+} RkStreamSrc;
+
+// Function declarations
+MPP_RET rk_stream_src_open(RkStreamSrc *src, const char *path, RkStreamSrcMode mode);
+void rk_stream_src_close(RkStreamSrc *src);
+MPP_RET rk_stream_src_set_range(RkStreamSrc *src, const RkStreamRange *range);
+MPP_RET rk_stream_src_set_au_mode(RkStreamSrc *src, MppCodingType type, RK_U32 fps);
+MPP_RET rk_stream_src_next(RkStreamSrc *src, RkPktPool *pool, size_t chunk,
+                           MppPacket *packet, RK_U32 *eos);
+void rk_stream_src_release(RkStreamSrc *src, MppPacket packet);
+void rk_stream_src_track_level(RkStreamSrc *src, MppCodingType type);
+RK_U32 rk_stream_src_level(RkStreamSrc *src);
+RK_S64 rk_stream_src_next_pts(RkStreamSrc *src);
+const char *rk_stream_src_mode_name(RkStreamSrcMode mode);
+
+#endif // RK_STREAM_SRC_H
@@ -0,0 +1,692 @@
+#include "rk_vpu_bench.h"
+#include <pthread.h>
+
+static const bench_kernel_t kernels[] = {
+    { "startcode", run_startcode_bench },
+    { "crop",      run_crop_bench },
+    { "csc",       run_csc_bench },
+    { "crc",       run_crc_bench },
+    { "fbc",       run_fbc_bench },
+    { "unpack",    run_unpack_bench },
+};
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+int pin_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+}
+
+double get_time_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/*
+ * Random slice payload with emulation prevention applied, so the only
+ * "00 00 0x" sequences are the start codes we write, as in a real stream.
+ * Entropy-coded data is close to uniform, about one zero byte in 256.
+ */
+static size_t write_payload(uint8_t *p, size_t len, uint32_t *seed) {
+    size_t n = 0;
+    int zeros = 0;
+
+    while (n < len) {
+        uint32_t r = xorshift32(seed);
+        uint8_t b = (uint8_t)r;
+
+        if (zeros >= 2 && b <= 3) {
+            p[n++] = 0x03;
+            zeros = 0;
+            continue;
+        }
+        p[n++] = b;
+        zeros = b ? 0 : zeros + 1;
+    }
+    // rbsp_trailing_bits: a stream must not end a NAL with a zero byte
+    p[n - 1] = 0x80;
+    return n;
+}
+
+/*
+ * H.264 stream of pictures with 1-4 slices each and SPS/PPS every 30
+ * pictures. Returns the stream size; *pictures and *nals get the counts the
+ * parser must find.
+ */
+static size_t build_stream(uint8_t *buf, size_t size, size_t avg_nal,
+                           uint64_t *pictures, uint64_t *nals) {
+    static const uint8_t sc[4] = { 0, 0, 0, 1 };
+    uint32_t seed = 0x12345678;
+    size_t pos = 0;
+
+    *pictures = 0;
+    *nals = 0;
+    for (;;) {
+        int slices = 1 + (xorshift32(&seed) & 3);
+        int idr = (*pictures % 30) == 0;
+
+        if (pos + (slices + 2) * (2 * avg_nal + 16) > size)
+            break;
+
+        if (idr) {
+            // SPS and PPS with a short body
+            static const uint8_t ps[2][4] = { { 0x67, 0x42, 0xc0, 0x28 }, { 0x68, 0xce, 0x3c, 0x80 } };
+            for (int i = 0; i < 2; i++) {
+                memcpy(buf + pos, sc, 4);
+                memcpy(buf + pos + 4, ps[i], 4);
+                pos += 8;
+                (*nals)++;
+            }
+        }
+
+        for (int s = 0; s < slices; s++) {
+            size_t len = avg_nal / 2 + xorshift32(&seed) % avg_nal;
+
+            memcpy(buf + pos, sc, 4);
+            buf[pos + 4] = idr ? 0x65 : 0x41;
+            // first_mb_in_slice: 0 (a single 1 bit) only for the first slice
+            buf[pos + 5] = s ? 0x40 : 0x88;
+            pos += 6;
+            pos += write_payload(buf + pos, len, &seed);
+            (*nals)++;
+        }
+        (*pictures)++;
+    }
+    return pos;
+}
+
+static uint64_t count_start_codes(AnnexbScanFn scan, const uint8_t *buf, size_t size) {
+    const uint8_t *end = buf + size;
+    const uint8_t *p = scan(buf, end);
+    uint64_t count = 0;
+
+    while (p < end) {
+        count++;
+        p = scan(p + 3, end);
+    }
+    return count;
+}
+
+// Best of SC_REPEATS passes over the stream, GB/s
+static double time_scan(AnnexbScanFn scan, const uint8_t *buf, size_t size, uint64_t *count) {
+    double best = 0;
+
+    for (int r = 0; r < SC_REPEATS; r++) {
+        double start = get_time_seconds();
+        double t;
+
+        *count = count_start_codes(scan, buf, size);
+        t = get_time_seconds() - start;
+        if (!best || t < best)
+            best = t;
+    }
+    return size / best / 1e9;
+}
+
+static double time_parse(const uint8_t *buf, size_t size, uint64_t *aus, uint64_t *nals) {
+    double best = 0;
+
+    for (int r = 0; r < SC_REPEATS; r++) {
+        RkAuParser parser;
+        size_t offset, len;
+        double start = get_time_seconds();
+        double t;
+
+        rk_au_parser_init(&parser, MPP_VIDEO_CodingAVC);
+        rk_au_parser_set_data(&parser, buf, size, 1);
+        while (rk_au_parser_next(&parser, &offset, &len) == AU_PARSER_OK)
+            ;
+        t = get_time_seconds() - start;
+        if (!best || t < best)
+            best = t;
+        *aus = parser.au_count;
+        *nals = parser.nal_count;
+    }
+    return size / best / 1e9;
+}
+
+/*
+ * Start code scanning: memchr for the 01 byte vs NEON zero-block rejection,
+ * on a stream with large NAL units (high bitrate) and one with small ones.
+ */
+int run_startcode_bench(int core_id) {
+    static const size_t avg_nal[] = { 32 * 1024, 1024 };
+    uint8_t *buf = malloc(SC_STREAM_SIZE);
+    int ret = 0;
+
+    if (!buf) {
+        printf("Failed to allocate %d byte stream\n", SC_STREAM_SIZE);
+        return 1;
+    }
+
+    printf("| %-10s | %-14s | %10s | %10s |\n", "Stream", "Kernel", "GB/s", "Found");
+    printf("|------------|----------------|------------|------------|\n");
+    for (size_t i = 0; i < sizeof(avg_nal) / sizeof(avg_nal[0]); i++) {
+        uint64_t pictures, nals, scalar_count, aus, parsed_nals;
+        size_t size = build_stream(buf, SC_STREAM_SIZE, avg_nal[i], &pictures, &nals);
+        char label[32];
+        double gbps;
+
+        snprintf(label, sizeof(label), "%zu KB NAL", avg_nal[i] / 1024);
+
+        gbps = time_scan(annexb_find_start_code_scalar, buf, size, &scalar_count);
+        printf("| %-10s | %-14s | %10.2f | %10llu |\n", label, "scalar memchr",
+               gbps, (unsigned long long)scalar_count);
+#ifdef __ARM_NEON
+        {
+            uint64_t neon_count;
+
+            gbps = time_scan(annexb_find_start_code_neon, buf, size, &neon_count);
+            printf("| %-10s | %-14s | %10.2f | %10llu |\n", label, "neon",
+                   gbps, (unsigned long long)neon_count);
+            if (neon_count != scalar_count) {
+                printf("NEON scanner found %llu start codes, scalar %llu\n",
+                       (unsigned long long)neon_count, (unsigned long long)scalar_count);
+                ret = 1;
+            }
+        }
+#endif
+        gbps = time_parse(buf, size, &aus, &parsed_nals);
+        printf("| %-10s | %-14s | %10.2f | %7llu AU |\n", label, "AU packetizer",
+               gbps, (unsigned long long)aus);
+
+        if (scalar_count != nals || parsed_nals != nals || aus != pictures) {
+            printf("Mismatch: %llu NALs %llu pictures written, scanned %llu, parsed %llu NALs %llu AUs\n",
+                   (unsigned long long)nals, (unsigned long long)pictures,
+                   (unsigned long long)scalar_count, (unsigned long long)parsed_nals,
+                   (unsigned long long)aus);
+            ret = 1;
+        }
+    }
+
+    free(buf);
+    return ret;
+}
+
+static double time_crop(const RkYuvRowOps *ops, RK_U8 *dst, RK_U8 **src,
+                        const RkYuvLayout *layout, RkYuvOutFormat fmt) {
+    size_t bytes = 0;
+    double start = get_time_seconds();
+
+    for (int f = 0; f < CROP_FRAMES; f++)
+        bytes += rk_yuv_crop_with(dst, src[f % CROP_SRC_FRAMES], layout, fmt, ops);
+    return bytes / (get_time_seconds() - start) / 1e9;
+}
+
+// I420 planes must hold the even and odd bytes of the NV12 chroma rows
+static int check_i420(const RK_U8 *nv12, const RK_U8 *i420, const RkYuvLayout *layout) {
+    size_t luma = (size_t)layout->width * layout->height;
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+
+    if (memcmp(nv12, i420, luma))
+        return 1;
+    for (size_t i = 0; i < cw * ch; i++) {
+        if (i420[luma + i] != nv12[luma + 2 * i] || i420[luma + cw * ch + i] != nv12[luma + 2 * i + 1])
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Stride cropping of decoded NV12 into packed NV12 and I420, GB/s of output.
+ * Layouts cover the 1088-line H.264 padding, a wide 2048 stride and an odd
+ * size.
+ */
+int run_crop_bench(int core_id) {
+    static const RkYuvLayout layouts[] = {
+        { 1920, 1080, 1920, 1088 },
+        { 1920, 1080, 2048, 1088 },
+        { 3840, 2160, 3840, 2176 },
+        { 1366, 767, 1408, 768 },
+    };
+    static const RkYuvOutFormat fmts[] = { YUV_OUT_NV12, YUV_OUT_I420 };
+    int ret = 0;
+
+    (void)core_id;
+    printf("| %-22s | %-4s | %12s | %12s |\n", "Layout (stride)", "Out", "scalar GB/s", "neon GB/s");
+    printf("|------------------------|------|--------------|--------------|\n");
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        const RkYuvLayout *layout = &layouts[l];
+        size_t in_size = rk_yuv_out_size(layout, YUV_OUT_RAW);
+        size_t out_size = rk_yuv_out_size(layout, YUV_OUT_NV12);
+        RK_U8 *src[CROP_SRC_FRAMES];
+        RK_U8 *dst = malloc(out_size);
+        RK_U8 *ref = malloc(out_size);
+        RK_U8 *nv12 = malloc(out_size);
+        uint32_t seed = 0x9e3779b9;
+        char label[32];
+
+        snprintf(label, sizeof(label), "%ux%u (%ux%u)", layout->width, layout->height,
+                 layout->hor_stride, layout->ver_stride);
+        for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+            src[f] = malloc(in_size);
+            for (size_t i = 0; i < in_size; i++)
+                src[f][i] = (uint8_t)xorshift32(&seed);
+        }
+
+        rk_yuv_crop_with(nv12, src[0], layout, YUV_OUT_NV12, &rk_yuv_row_ops_scalar);
+        for (size_t k = 0; k < sizeof(fmts) / sizeof(fmts[0]); k++) {
+            double scalar;
+
+            rk_yuv_crop_with(ref, src[0], layout, fmts[k], &rk_yuv_row_ops_scalar);
+            if (fmts[k] == YUV_OUT_I420 && check_i420(nv12, ref, layout)) {
+                printf("I420 planes do not match NV12 for %s\n", label);
+                ret = 1;
+            }
+            scalar = time_crop(&rk_yuv_row_ops_scalar, dst, src, layout, fmts[k]);
+#ifdef __ARM_NEON
+            rk_yuv_crop_with(dst, src[0], layout, fmts[k], &rk_yuv_row_ops_neon);
+            if (memcmp(dst, ref, out_size)) {
+                printf("NEON %s crop differs from scalar for %s\n",
+                       rk_yuv_out_format_name(fmts[k]), label);
+                ret = 1;
+            }
+            printf("| %-22s | %-4s | %12.2f | %12.2f |\n", label, rk_yuv_out_format_name(fmts[k]),
+                   scalar, time_crop(&rk_yuv_row_ops_neon, dst, src, layout, fmts[k]));
+#else
+            printf("| %-22s | %-4s | %12.2f | %12s |\n", label, rk_yuv_out_format_name(fmts[k]),
+                   scalar, "n/a");
+#endif
+        }
+
+        for (int f = 0; f < CROP_SRC_FRAMES; f++)
+            free(src[f]);
+        free(dst);
+        free(ref);
+        free(nv12);
+    }
+    return ret;
+}
+
+typedef void (*CscRowFn)(const RK_U8 *y, const RK_U8 *uv, RK_U8 *dst, RK_U32 width,
+                         const RkCscCoef *coef, RkCscFormat format);
+
+// One thread converting whole frames row by row, megapixels/s
+static double time_csc_rows(CscRowFn row, RK_U8 *dst, RK_U8 **src, const RkYuvLayout *layout,
+                            const RkCscCoef *coef, RkCscFormat format, RK_U32 bpp) {
+    double start = get_time_seconds();
+
+    for (int f = 0; f < CSC_FRAMES; f++) {
+        const RK_U8 *luma = src[f % CROP_SRC_FRAMES];
+        const RK_U8 *chroma = luma + (size_t)layout->hor_stride * layout->ver_stride;
+
+        for (RK_U32 y = 0; y < layout->height; y++)
+            row(luma + (size_t)y * layout->hor_stride, chroma + (size_t)(y / 2) * layout->hor_stride,
+                dst + (size_t)y * layout->width * bpp, layout->width, coef, format);
+    }
+    return (double)CSC_FRAMES * layout->width * layout->height / (get_time_seconds() - start) / 1e6;
+}
+
+// The worker pool on whole frames, megapixels/s of output
+static double time_csc_pool(RkYuvConverter *cvt, RK_U8 *dst, RK_U8 **src, const RkYuvLayout *layout) {
+    double start = get_time_seconds();
+
+    for (int f = 0; f < CSC_FRAMES; f++) {
+        if (!rk_yuv_converter_run(cvt, dst, src[f % CROP_SRC_FRAMES], layout))
+            return 0;
+    }
+    return (double)CSC_FRAMES * cvt->dst_w * cvt->dst_h / (get_time_seconds() - start) / 1e6;
+}
+
+// Limited range black, white and mid grey must land on 0, 255 and 128
+static int check_csc_levels(void) {
+    static const RK_U8 levels[][2] = { { 16, 0 }, { 235, 255 }, { 126, 128 } };
+    RkCscCoef coef;
+    RK_U8 y[2], uv[2] = { 128, 128 }, rgb[6];
+    int ret = 0;
+
+    rk_csc_coef_init(&coef, CSC_BT709, 0);
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        y[0] = y[1] = levels[i][0];
+        rk_nv12_row_to_rgb_scalar(y, uv, rgb, 2, &coef, CSC_RGB24);
+        for (int c = 0; c < 6; c++) {
+            if (abs(rgb[c] - levels[i][1]) > 1) {
+                printf("Y %d converts to %d, expected %d\n", levels[i][0], rgb[c], levels[i][1]);
+                ret = 1;
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+/*
+ * NV12 -> RGB24/BGRA: the row kernel on one core, scalar against NEON, then
+ * the worker pool on whole frames, unscaled and bilinear downscaled.
+ */
+int run_csc_bench(int core_id) {
+    static const RkYuvLayout layout = { 1920, 1080, 1920, 1088 };
+    static const RkCscFormat formats[] = { CSC_RGB24, CSC_BGRA };
+    static const RK_U32 pool_workers[] = { 1, 2, 4 };
+    size_t in_size = rk_yuv_out_size(&layout, YUV_OUT_RAW);
+    size_t out_size = (size_t)layout.width * layout.height * 4;
+    RK_U8 *src[CROP_SRC_FRAMES];
+    RK_U8 *dst = malloc(out_size);
+    RK_U8 *ref = malloc(out_size);
+    uint32_t seed = 0x9e3779b9;
+    RkCscCoef coef;
+    int ret = check_csc_levels();
+
+    for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+        src[f] = malloc(in_size);
+        for (size_t i = 0; i < in_size; i++)
+            src[f][i] = (uint8_t)xorshift32(&seed);
+    }
+
+    rk_csc_coef_init(&coef, CSC_BT709, 0);
+    printf("| %-22s | %-6s | %12s | %12s |\n", "Row kernel", "Out", "scalar MP/s", "neon MP/s");
+    printf("|------------------------|--------|--------------|--------------|\n");
+    for (size_t k = 0; k < sizeof(formats) / sizeof(formats[0]); k++) {
+        RK_U32 bpp = formats[k] == CSC_BGRA ? 4 : 3;
+        double scalar = time_csc_rows(rk_nv12_row_to_rgb_scalar, ref, src, &layout, &coef,
+                                      formats[k], bpp);
+#ifdef __ARM_NEON
+        time_csc_rows(rk_nv12_row_to_rgb_neon, dst, src, &layout, &coef, formats[k], bpp);
+        // Both ran CSC_FRAMES frames, so the last source frame matches
+        if (memcmp(dst, ref, (size_t)layout.width * layout.height * bpp)) {
+            printf("NEON %s conversion differs from scalar\n", rk_csc_format_name(formats[k]));
+            ret = 1;
+        }
+        printf("| %-22s | %-6s | %12.1f | %12.1f |\n", "1920x1080 BT.709", rk_csc_format_name(formats[k]),
+               scalar, time_csc_rows(rk_nv12_row_to_rgb_neon, dst, src, &layout, &coef,
+                                     formats[k], bpp));
+#else
+        printf("| %-22s | %-6s | %12.1f | %12s |\n", "1920x1080 BT.709", rk_csc_format_name(formats[k]),
+               scalar, "n/a");
+#endif
+    }
+
+    // The pool pins its own workers, starting on the A76 cluster
+    printf("\n| %-22s | %-7s | %10s |\n", "Pool, rgb24", "Workers", "MP/s");
+    printf("|------------------------|---------|------------|\n");
+    for (size_t w = 0; w < sizeof(pool_workers) / sizeof(pool_workers[0]); w++) {
+        for (int scaled = 0; scaled < 2; scaled++) {
+            RkCscConfig cfg = { CSC_BT709, 0, CSC_RGB24, 0, 0, pool_workers[w] };
+            RkYuvConverter cvt;
+            char label[32];
+
+            if (scaled) {
+                cfg.dst_width = 1280;
+                cfg.dst_height = 720;
+            }
+            if (rk_yuv_converter_init(&cvt, &cfg)) {
+                ret = 1;
+                continue;
+            }
+            snprintf(label, sizeof(label), "1920x1080 -> %ux%u", scaled ? 1280 : 1920,
+                     scaled ? 720 : 1080);
+            printf("| %-22s | %7u | %10.1f |\n", label, cvt.worker_count,
+                   time_csc_pool(&cvt, dst, src, &layout));
+            rk_yuv_converter_deinit(&cvt);
+        }
+    }
+
+    (void)core_id;
+    for (int f = 0; f < CROP_SRC_FRAMES; f++)
+        free(src[f]);
+    free(dst);
+    free(ref);
+    return ret;
+}
+
+// Whole-frame checksums over the sources in turn, GB/s of picture
+static double time_frame_crc(RkCrc32Fn fn, RK_U8 **src, const RkYuvLayout *layout, uint32_t *sum) {
+    size_t bytes = rk_yuv_out_size(layout, YUV_OUT_NV12);
+    double start = get_time_seconds();
+
+    for (int f = 0; f < CRC_FRAMES; f++)
+        *sum ^= rk_frame_crc_with(src[f % CROP_SRC_FRAMES], layout, fn);
+    return (double)bytes * CRC_FRAMES / (get_time_seconds() - start) / 1e9;
+}
+
+/*
+ * Frame checksums for the decode-only benchmark: the slicing-by-8 table
+ * against the ARMv8 CRC32 instructions, on the same strided frames the
+ * decoder hands out. Both must agree with the standard check value.
+ */
+int run_crc_bench(int core_id) {
+    static const RkYuvLayout layouts[] = {
+        { 1920, 1080, 1920, 1088 },
+        { 3840, 2160, 3840, 2176 },
+        { 1366, 767, 1408, 768 },
+    };
+    static const RK_U8 check[] = "123456789";
+    int ret = 0;
+
+    (void)core_id;
+    if (rk_crc32_scalar(0, check, 9) != CRC_CHECK_VALUE ||
+        rk_crc32(0, check, 9) != CRC_CHECK_VALUE) {
+        printf("CRC-32 of \"123456789\" is not %08x\n", CRC_CHECK_VALUE);
+        return 1;
+    }
+
+    printf("| %-22s | %12s | %12s |\n", "Layout (stride)", "table GB/s", "crc32x GB/s");
+    printf("|------------------------|--------------|--------------|\n");
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        const RkYuvLayout *layout = &layouts[l];
+        size_t in_size = rk_yuv_out_size(layout, YUV_OUT_RAW);
+        RK_U8 *src[CROP_SRC_FRAMES];
+        uint32_t seed = 0x9e3779b9, sum = 0;
+        double scalar;
+        char label[32];
+
+        snprintf(label, sizeof(label), "%ux%u (%ux%u)", layout->width, layout->height,
+                 layout->hor_stride, layout->ver_stride);
+        for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+            src[f] = malloc(in_size);
+            for (size_t i = 0; i < in_size; i++)
+                src[f][i] = (uint8_t)xorshift32(&seed);
+        }
+
+        scalar = time_frame_crc(rk_crc32_scalar, src, layout, &sum);
+#ifdef __ARM_FEATURE_CRC32
+        for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+            if (rk_frame_crc_with(src[f], layout, rk_crc32_arm) !=
+                rk_frame_crc_with(src[f], layout, rk_crc32_scalar)) {
+                printf("crc32x checksum differs from the table for %s\n", label);
+                ret = 1;
+            }
+        }
+        printf("| %-22s | %12.2f | %12.2f |\n", label, scalar,
+               time_frame_crc(rk_crc32_arm, src, layout, &sum));
+#else
+        printf("| %-22s | %12.2f | %12s |\n", label, scalar, "n/a");
+#endif
+
+        for (int f = 0; f < CROP_SRC_FRAMES; f++)
+            free(src[f]);
+    }
+    return ret;
+}
+
+// Random FBC heads: about one block in eight solid, one sub-block in sixteen raw
+static void build_fbc_heads(RK_U8 *heads, const RkFbcLayout *fbc, uint32_t *seed) {
+    size_t pos = fbc->head_size;
+
+    memset(heads, 0, fbc->head_size);
+    for (size_t b = 0; b < (size_t)fbc->blocks_x * fbc->blocks_y; b++) {
+        RK_U8 *head = heads + b * FBC_HEAD_SIZE;
+        uint32_t offset = pos;
+        uint32_t w[3] = { 0 };
+
+        if (!(xorshift32(seed) & 7))
+            continue;
+        for (int i = 0; i < FBC_SUBBLOCKS; i++) {
+            uint32_t r = xorshift32(seed);
+            uint32_t code = r % 16 ? 2 + (r >> 8) % 20 : FBC_SUBBLOCK_RAW_CODE;
+            int bit = 6 * i;
+
+            w[bit / 32] |= code << (bit % 32);
+            if (bit % 32 > 26)
+                w[bit / 32 + 1] |= code >> (32 - bit % 32);
+            pos += code == FBC_SUBBLOCK_RAW_CODE ? FBC_SUBBLOCK_RAW : code;
+        }
+        memcpy(head, &offset, 4);
+        memcpy(head + 4, w, sizeof(w));
+    }
+}
+
+static double time_fbc_scan(RkFbcScanFn scan, RK_U8 **heads, const RkFbcLayout *fbc,
+                            RkFbcStats *st) {
+    double start = get_time_seconds();
+
+    for (int f = 0; f < FBC_FRAMES; f++)
+        rk_fbc_stats_with(heads[f % CROP_SRC_FRAMES], fbc, st, scan);
+    return (double)fbc->head_stride * fbc->blocks_y * FBC_FRAMES /
+           (get_time_seconds() - start) / 1e9;
+}
+
+/*
+ * FBC head scan, what the writer does per compressed frame to learn its
+ * size: scalar field extraction against four heads per NEON iteration.
+ * Both must give the same totals.
+ */
+int run_fbc_bench(int core_id) {
+    static const RK_U32 sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+    int ret = 0;
+
+    (void)core_id;
+    printf("| %-10s | %10s | %12s | %12s |\n", "Picture", "Heads KB", "scalar GB/s", "neon GB/s");
+    printf("|------------|------------|--------------|--------------|\n");
+    for (size_t l = 0; l < sizeof(sizes) / sizeof(sizes[0]); l++) {
+        RkFbcLayout fbc;
+        RkFbcStats ref;
+        RK_U8 *heads[CROP_SRC_FRAMES];
+        uint32_t seed = 0x9e3779b9;
+        double scalar;
+        char label[32];
+
+        rk_fbc_layout(&fbc, sizes[l][0], sizes[l][1]);
+        snprintf(label, sizeof(label), "%ux%u", sizes[l][0], sizes[l][1]);
+        for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+            heads[f] = malloc(fbc.head_size);
+            build_fbc_heads(heads[f], &fbc, &seed);
+        }
+
+        scalar = time_fbc_scan(rk_fbc_scan_row_scalar, heads, &fbc, &ref);
+#ifdef __ARM_NEON
+        for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+            RkFbcStats a, b;
+
+            rk_fbc_stats_with(heads[f], &fbc, &a, rk_fbc_scan_row_scalar);
+            rk_fbc_stats_with(heads[f], &fbc, &b, rk_fbc_scan_row_neon);
+            if (memcmp(&a, &b, sizeof(a))) {
+                printf("NEON head scan differs from scalar for %s\n", label);
+                ret = 1;
+            }
+        }
+        printf("| %-10s | %10zu | %12.2f | %12.2f |\n", label, fbc.head_size >> 10, scalar,
+               time_fbc_scan(rk_fbc_scan_row_neon, heads, &fbc, &ref));
+#else
+        printf("| %-10s | %10zu | %12.2f | %12s |\n", label, fbc.head_size >> 10, scalar, "n/a");
+#endif
+
+        for (int f = 0; f < CROP_SRC_FRAMES; f++)
+            free(heads[f]);
+    }
+    return ret;
+}
+
+/*
+ * Decoder formats that need more than a crop: 8x8 tiled frames detiled to
+ * NV12 and I420, compact 10-bit frames unpacked to P010 and dithered to
+ * NV12. GB/s of output; NEON must match scalar byte for byte.
+ */
+int run_unpack_bench(int core_id) {
+    static const struct {
+        RkYuvLayout layout;
+        RkYuvOutFormat fmt;
+    } cases[] = {
+        { { 1920, 1080, 1920, 1088, 0, 8, YUV_TILE_SIZE }, YUV_OUT_NV12 },
+        { { 1920, 1080, 1920, 1088, 0, 8, YUV_TILE_SIZE }, YUV_OUT_I420 },
+        { { 3840, 2160, 3840, 2176, 0, 8, YUV_TILE_SIZE }, YUV_OUT_NV12 },
+        { { 1920, 1080, 2400, 1088, 0, 10, 0 }, YUV_OUT_P010 },
+        { { 1920, 1080, 2400, 1088, 0, 10, 0 }, YUV_OUT_NV12 },
+        { { 3840, 2160, 4800, 2176, 0, 10, 0 }, YUV_OUT_P010 },
+        { { 3840, 2160, 4800, 2176, 0, 10, 0 }, YUV_OUT_NV12 },
+        { { 3840, 2160, 4800, 2176, 0, 10, 0 }, YUV_OUT_I420 },
+    };
+    int ret = 0;
+
+    (void)core_id;
+    printf("| %-22s | %-4s | %12s | %12s |\n", "Source", "Out", "scalar GB/s", "neon GB/s");
+    printf("|------------------------|------|--------------|--------------|\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const RkYuvLayout *layout = &cases[c].layout;
+        RkYuvOutFormat fmt = cases[c].fmt;
+        size_t in_size = rk_yuv_out_size(layout, YUV_OUT_RAW);
+        size_t out_size = rk_yuv_out_size(layout, fmt);
+        RK_U8 *src[CROP_SRC_FRAMES];
+        RK_U8 *dst = malloc(out_size);
+        RK_U8 *ref = malloc(out_size);
+        uint32_t seed = 0x9e3779b9;
+        double scalar;
+        char label[32];
+
+        snprintf(label, sizeof(label), "%ux%u %s", layout->width, layout->height,
+                 layout->tile ? "tiled" : "10-bit");
+        for (int f = 0; f < CROP_SRC_FRAMES; f++) {
+            src[f] = malloc(in_size);
+            for (size_t i = 0; i < in_size; i++)
+                src[f][i] = (uint8_t)xorshift32(&seed);
+        }
+
+        rk_yuv_crop_with(ref, src[0], layout, fmt, &rk_yuv_row_ops_scalar);
+        scalar = time_crop(&rk_yuv_row_ops_scalar, dst, src, layout, fmt);
+#ifdef __ARM_NEON
+        rk_yuv_crop_with(dst, src[0], layout, fmt, &rk_yuv_row_ops_neon);
+        if (memcmp(dst, ref, out_size)) {
+            printf("NEON %s output differs from scalar for %s\n", rk_yuv_out_format_name(fmt),
+                   label);
+            ret = 1;
+        }
+        printf("| %-22s | %-4s | %12.2f | %12.2f |\n", label, rk_yuv_out_format_name(fmt),
+               scalar, time_crop(&rk_yuv_row_ops_neon, dst, src, layout, fmt));
+#else
+        printf("| %-22s | %-4s | %12.2f | %12s |\n", label, rk_yuv_out_format_name(fmt),
+               scalar, "n/a");
+#endif
+
+        for (int f = 0; f < CROP_SRC_FRAMES; f++)
+            free(src[f]);
+        free(dst);
+        free(ref);
+    }
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    const int cores[] = { A55_CORE_START, A76_CORE_START };
+    const int num_cores = sizeof(cores) / sizeof(cores[0]);
+    const char *only = argc > 1 ? argv[1] : NULL;
+    int ret = 0;
+
+    printf("RK3588 decode-path CPU kernels\n");
+
+    for (size_t k = 0; k < NUM_KERNELS; k++) {
+        if (only && strcmp(only, kernels[k].name))
+            continue;
+
+        for (int c = 0; c < num_cores; c++) {
+            if (pin_thread_to_core(cores[c]) != 0) {
+                printf("\nFailed to pin thread to core %d, skipping\n", cores[c]);
+                continue;
+            }
+            printf("\n%s on core %d (Cortex-%s)\n", kernels[k].name, cores[c],
+                   cores[c] >= A76_CORE_START ? "A76" : "A55");
+            ret |= kernels[k].run(cores[c]);
+        }
+    }
+    return ret;
+}
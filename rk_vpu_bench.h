@@ -0,0 +1,56 @@
+#ifndef RK_VPU_BENCH_H
+#define RK_VPU_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include "rk_annexb.h"
+#include "rk_yuv_crop.h"
+#include "rk_yuv_convert.h"
+#include "rk_frame_crc.h"
+#include "rk_fbc.h"
+
+// RK3588 cluster layout: A55 cores are 0-3, A76 cores are 4-7
+#define A55_CORE_START    0
+#define A76_CORE_START    4
+
+// Synthetic Annex-B stream scanned by the start code kernels
+#define SC_STREAM_SIZE    (64 * 1024 * 1024)
+#define SC_REPEATS        5
+
+// Decoded frames cropped per measurement, cycling over CROP_SRC_FRAMES
+// sources so the working set is well past the L3
+#define CROP_FRAMES       60
+#define CROP_SRC_FRAMES   4
+
+// Frames converted per colour conversion measurement
+#define CSC_FRAMES        30
+
+// Frames checksummed per CRC measurement, and CRC-32 of "123456789"
+#define CRC_FRAMES        60
+#define CRC_CHECK_VALUE   0xCBF43926u
+
+// FBC head scans per measurement, cycling over CROP_SRC_FRAMES frames
+#define FBC_FRAMES        200
+
+// CPU-side kernels of the decode path, each run on both core types
+typedef struct {
+    const char *name;
+    int (*run)(int core_id);
+} bench_kernel_t;
+
+// Function declarations
+int pin_thread_to_core(int core_id);
+double get_time_seconds(void);
+int run_startcode_bench(int core_id);
+int run_crop_bench(int core_id);
+int run_csc_bench(int core_id);
+int run_crc_bench(int core_id);
+int run_fbc_bench(int core_id);
+int run_unpack_bench(int core_id);
+
+#endif // RK_VPU_BENCH_H
@@ -1,30 +1,106 @@
 #include "rk_vpu_demo.h"
+#include "rk_vpu_server.h"
+#include "rk_vpu_split.h"
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <rockchip/mpp_log.h>
 
-MPP_RET init_vpu_decoder(VpuDecContext *ctx, const char *input_file, const char *output_file)
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double get_process_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Writer callback: the frame's bytes are out, on the writer or collector thread
+static void on_frame_written(void *opaque, double pushed, double done)
+{
+    VpuDecContext *ctx = (VpuDecContext *)opaque;
+
+    rk_trace_span(&ctx->trace, TRACE_WRITE, pushed, done);
+}
+
+// Release notification from the packet pool: the decoder is done with packet
+static void on_packet_released(void *opaque, MppPacket packet, int slot)
+{
+    VpuDecContext *ctx = (VpuDecContext *)opaque;
+    // Wrapped packets point into the input mapping
+    if (slot < 0)
+        rk_stream_src_release(&ctx->src, packet);
+
+    ctx->inflight--;
+    ctx->released++;
+}
+
+MPP_RET init_vpu_decoder(VpuDecContext *ctx, const char *input_file, const char *output_file,
+                         const VpuDecConfig *cfg)
 {
     MPP_RET ret = MPP_OK;
-    MppCodingType coding = MPP_VIDEO_CodingAVC;  // H.264 decoder
+    RK_U32 slots;
+    RK_U32 need_split;
 
-    if (!ctx || !input_file || !output_file)
+    if (!ctx || !input_file || !output_file || !cfg)
         return MPP_ERR_NULL_PTR;
 
     memset(ctx, 0, sizeof(VpuDecContext));
+    ctx->cfg = *cfg;
+    ctx->writer.fd = -1;
+
+    ret = rk_trace_init(&ctx->trace, cfg->trace_id, cfg->trace_file != NULL, cfg->fps_interval);
+    if (ret)
+        return ret;
 
     // Open input and output files
-    ctx->fp_input = fopen(input_file, "rb");
-    if (!ctx->fp_input) {
-        mpp_err("Failed to open input file %s\n", input_file);
-        return MPP_ERR_OPEN_FILE;
+    ret = rk_stream_src_open(&ctx->src, input_file, cfg->input_mode);
+    if (ret)
+        goto ERR_RET;
+    if (cfg->range) {
+        ret = rk_stream_src_set_range(&ctx->src, cfg->range);
+        if (ret)
+            goto ERR_RET;
     }
 
-    ctx->fp_output = fopen(output_file, "wb");
-    if (!ctx->fp_output) {
-        mpp_err("Failed to open output file %s\n", output_file);
-        fclose(ctx->fp_input);
-        return MPP_ERR_OPEN_FILE;
+    ret = rk_yuv_writer_open(&ctx->writer, output_file, cfg->output_mode,
+                             cfg->output_format, cfg->output_depth);
+    if (ret)
+        goto ERR_RET;
+    rk_yuv_writer_set_done_cb(&ctx->writer, on_frame_written, ctx);
+    rk_yuv_writer_set_crc_list(&ctx->writer, &ctx->crcs);
+    rk_yuv_writer_set_fbc_roi(&ctx->writer, &cfg->fbc_roi);
+
+    // Colour conversion reads the frame buffers on the writer thread
+    if (cfg->csc && rk_yuv_writer_has_file(ctx->writer.mode)) {
+        ret = rk_yuv_converter_init(&ctx->csc, &cfg->csc_cfg);
+        if (ret)
+            goto ERR_RET;
+        ctx->csc_ready = 1;
+        rk_yuv_writer_set_converter(&ctx->writer, &ctx->csc);
+    }
+
+    // Transcode: the encoded stream goes to output_file, the writer only
+    // checksums or drops the frames
+    if (cfg->transcode) {
+        ret = rk_transcoder_init(&ctx->enc, output_file, &cfg->enc);
+        if (ret)
+            goto ERR_RET;
+        ctx->enc_ready = 1;
+    }
+
+    // Export: output_file is the socket the consumer connects to, the
+    // writer only checksums or drops the frames
+    if (cfg->export_frames) {
+        ret = rk_frame_export_init(&ctx->exp, output_file, cfg->output_depth);
+        if (ret)
+            goto ERR_RET;
+        ctx->exp_ready = 1;
     }
 
     // Create MPP context and decoder
@@ -34,30 +110,95 @@ MPP_RET init_vpu_decoder(VpuDecContext *ctx, const char *input_file, const char
         goto ERR_RET;
     }
 
-    // Initialize decoder
-    ret = mpp_init(ctx->ctx, MPP_CTX_DEC, coding);
+    if (cfg->au_mode) {
+        ret = rk_stream_src_set_au_mode(&ctx->src, cfg->type, cfg->fps);
+        if (ret)
+            goto ERR_RET;
+    }
+
+    // Chunks split NAL units anywhere, MPP has to find frame boundaries
+    // itself. Whole access units go straight to the decoder.
+    need_split = !cfg->au_mode;
+    ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_PARSER_SPLIT_MODE, &need_split);
     if (ret) {
-        mpp_err("mpp_init failed\n");
+        mpp_err("Failed to set split mode\n");
         goto ERR_RET;
     }
 
-    // Setup frame buffer group
-    ret = mpp_buffer_group_get_internal(&ctx->frm_grp, MPP_BUFFER_TYPE_DRM);
+    // Live input: parse the next AU while the hardware decodes this one, and
+    // hand out every frame as soon as it is decoded instead of holding it
+    // back for display reordering
+    if (cfg->low_latency) {
+        RK_U32 enable = 1;
+
+        ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_PARSER_FAST_MODE, &enable);
+        if (!ret)
+            ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_IMMEDIATE_OUT, &enable);
+        if (ret) {
+            mpp_err("Failed to set low-latency mode\n");
+            goto ERR_RET;
+        }
+    }
+
+    // Initialize decoder
+    ret = mpp_init(ctx->ctx, MPP_CTX_DEC, cfg->type);
     if (ret) {
-        mpp_err("Failed to get buffer group\n");
+        mpp_err("mpp_init failed\n");
         goto ERR_RET;
     }
 
-    // Allocate packet buffer
-    ctx->buf_size = READ_BUF_SIZE;
-    ret = mpp_buffer_get(ctx->frm_grp, &ctx->pkt_buf, ctx->buf_size);
+    // Compressed frames: heads and payload instead of linear NV12, a
+    // fraction of the DDR traffic for the decoder's writes and our reads
+    if (cfg->output_format == YUV_OUT_FBC) {
+        MppFrameFormat fmt = MPP_FMT_YUV420SP | MPP_FRAME_FBC_AFBC_V2;
+
+        ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_OUTPUT_FORMAT, &fmt);
+        if (ret) {
+            mpp_err("Failed to set FBC output\n");
+            goto ERR_RET;
+        }
+    }
+    // Tiled frames: the decoder's native write order, detiled by the writer
+    if (cfg->tiled) {
+        MppFrameFormat fmt = MPP_FMT_YUV420SP | MPP_FRAME_TILE_FLAG;
+
+        ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_OUTPUT_FORMAT, &fmt);
+        if (ret) {
+            mpp_err("Failed to set tiled output\n");
+            goto ERR_RET;
+        }
+    }
+
+    // Frame buffers: the decoder allocates its own unless we size them per sequence
+    if (cfg->ext_buffers) {
+        ret = rk_frame_pool_init(&ctx->frm_pool, cfg->frame_reserve);
+        if (ret)
+            goto ERR_RET;
+        ctx->frm_pool_ready = 1;
+        rk_stream_src_track_level(&ctx->src, cfg->type);
+    }
+
+    // Packet ring: everything in flight plus the one being filled.
+    // mmap and dmabuf input only wrap the stream, one spare slot is enough.
+    ctx->buf_size = cfg->au_mode ? AU_BUF_SIZE : READ_BUF_SIZE;
+    slots = cfg->depth + 1 > 2 ? cfg->depth + 1 : 2;
+    if (cfg->input_mode != STREAM_SRC_READ)
+        slots = 1;
+    if (cfg->budget) {
+        ret = rk_dma_budget_reserve(cfg->budget, slots * ctx->buf_size);
+        if (ret) {
+            mpp_err("Packet buffers of %zu bytes exceed the DMA budget\n", slots * ctx->buf_size);
+            goto ERR_RET;
+        }
+        ctx->pkt_reserved = slots * ctx->buf_size;
+    }
+    ret = rk_pkt_pool_init(&ctx->pkt_pool, slots, ctx->buf_size, on_packet_released, ctx);
     if (ret) {
-        mpp_err("Failed to get packet buffer\n");
+        mpp_err("Failed to get packet buffers\n");
         goto ERR_RET;
     }
 
-    ctx->buf = mpp_buffer_get_ptr(ctx->pkt_buf);
-    ctx->type = coding;
+    ctx->type = cfg->type;
     ctx->packet_size = 0;
     ctx->frame_count = 0;
 
@@ -68,163 +209,910 @@ ERR_RET:
     return ret;
 }
 
-MPP_RET decode_frames(VpuDecContext *ctx)
+/*
+ * Dequeue one input task and release the packet it still carries from its
+ * last trip through the decoder. The task is kept in ctx->held until it is
+ * filled. Returns MPP_ERR_TIMEOUT when none is free, also for non-block.
+ */
+static MPP_RET take_input_task(VpuDecContext *ctx, MppPollType timeout)
 {
     MPP_RET ret = MPP_OK;
     MppTask task = NULL;
-    size_t read_size;
-    RK_U32 pkt_done = 0;
-    RK_U32 frm_eos = 0;
-
-    while (!frm_eos) {
-        if (!pkt_done) {
-            read_size = fread(ctx->buf, 1, READ_BUF_SIZE, ctx->fp_input);
-            if (read_size != READ_BUF_SIZE) {
-                mpp_log("File EOF, read size %d\n", read_size);
-                pkt_done = 1;
-            }
+    MppPacket done = NULL;
+    double start = get_time_in_seconds();
+    double end;
 
-            // Create packet
-            ret = mpp_packet_init(&ctx->packet, ctx->buf, read_size);
-            if (ret) {
-                mpp_err("mpp_packet_init failed\n");
-                goto OUT;
-            }
+    // Get task
+    ret = ctx->mpi->poll(ctx->ctx, MPP_PORT_INPUT, timeout);
+    end = get_time_in_seconds();
+    ctx->feed_wait += end - start;
+    if (ret)
+        return timeout == MPP_POLL_NON_BLOCK ? MPP_ERR_TIMEOUT : ret;
+    if (timeout != MPP_POLL_NON_BLOCK)
+        rk_trace_span(&ctx->trace, TRACE_INPUT_WAIT, start, end);
+
+    ret = ctx->mpi->dequeue(ctx->ctx, MPP_PORT_INPUT, &task);
+    if (ret || !task) {
+        mpp_err("mpp task input dequeue failed\n");
+        return ret ? ret : MPP_NOK;
+    }
+
+    mpp_task_meta_get_packet(task, KEY_INPUT_PACKET, &done);
+    if (done && rk_pkt_pool_release(&ctx->pkt_pool, done))
+        return MPP_NOK;
+
+    if (ctx->held_count >= MAX_HELD_TASKS) {
+        mpp_err("too many idle input tasks\n");
+        return MPP_NOK;
+    }
+    ctx->held[ctx->held_count++] = task;
+    return MPP_OK;
+}
+
+/*
+ * Build the next input packet and queue it on a held task. MPP_ERR_TIMEOUT
+ * when every packet slot stayed with the decoder for POLL_TIMEOUT_MS: it
+ * may be waiting on its output, which the caller has to drain first.
+ */
+static MPP_RET queue_packet(VpuDecContext *ctx)
+{
+    MPP_RET ret = MPP_OK;
+    MppTask task;
+    MppPacket packet = NULL;
+    double start = get_time_in_seconds();
+    double now;
+
+    // Every slot still with the decoder: take tasks back until one is released
+    while ((ret = rk_stream_src_next(&ctx->src, &ctx->pkt_pool, ctx->buf_size,
+                                     &packet, &ctx->pkt_eos)) == MPP_ERR_BUFFER_FULL) {
+        ret = take_input_task(ctx, POLL_TIMEOUT_MS);
+        if (ret)
+            return ret;
+        start = get_time_in_seconds();
+    }
+    if (ret) {
+        mpp_err("Failed to build input packet\n");
+        return ret;
+    }
+    now = get_time_in_seconds();
+    rk_trace_span(&ctx->trace, TRACE_READ, start, now);
+
+    if (ctx->pkt_eos)
+        mpp_log("File EOF, %llu bytes\n", ctx->src.bytes_in);
+
+    task = ctx->held[--ctx->held_count];
+    mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, packet);
+    if (!ctx->packet_count)
+        ctx->first_packet = now;
+    // Access units carry a PTS the frame comes back with; chunks do not
+    if (ctx->cfg.au_mode)
+        rk_trace_submit(&ctx->trace, mpp_packet_get_pts(packet), now);
+
+    ret = ctx->mpi->enqueue(ctx->ctx, MPP_PORT_INPUT, task);
+    if (ret) {
+        mpp_err("mpp task input enqueue failed\n");
+        rk_pkt_pool_cancel(&ctx->pkt_pool, packet);
+        return ret;
+    }
+
+    rk_pkt_pool_submit(&ctx->pkt_pool, packet);
+    ctx->inflight++;
+    ctx->packet_count++;
+    return MPP_OK;
+}
+
+// Real-time and paced modes: the next access unit's time has come
+static RK_U32 live_packet_due(VpuDecContext *ctx)
+{
+    double now = get_time_in_seconds();
+
+    if (ctx->pkt_eos)
+        return 0;
+    if (!ctx->due) {
+        ctx->due = now;
+        ctx->pace_start = now;
+        if (ctx->cfg.pace_pts)
+            ctx->pace_pts0 = rk_stream_src_next_pts(&ctx->src);
+    }
+    return now >= ctx->due;
+}
+
+/*
+ * Queue the due packet, note how late it went in and work out when the
+ * next one is due: one interval on, at -S pts where its PTS puts it.
+ */
+static MPP_RET queue_live_packet(VpuDecContext *ctx)
+{
+    double interval = 1.0 / (ctx->cfg.pace_fps ? ctx->cfg.pace_fps : ctx->cfg.fps);
+    double lag = get_time_in_seconds() - ctx->due;
+    MPP_RET ret = queue_packet(ctx);
+
+    if (ret)
+        return ret;
+    if (lag > ctx->max_lag)
+        ctx->max_lag = lag;
+    if (lag > interval)
+        ctx->late_packets++;
+    if (ctx->cfg.pace_pts)
+        ctx->due = ctx->pace_start +
+                   (rk_stream_src_next_pts(&ctx->src) - ctx->pace_pts0) / 1000000.0;
+    else
+        ctx->due += interval;
+    return MPP_OK;
+}
+
+// Frames out of the decoder that the writer, encoder or consumer still hold
+static RK_U32 downstream_frames(VpuDecContext *ctx)
+{
+    RK_U32 count = rk_yuv_writer_queued(&ctx->writer);
+
+    if (ctx->enc_ready)
+        count += rk_transcoder_queued(&ctx->enc);
+    if (ctx->exp_ready)
+        count += rk_frame_export_lent(&ctx->exp);
+    return count;
+}
+
+/*
+ * Whether the feeder may queue a packet now: 0 if so, otherwise ms to
+ * wait before asking again. At the high-water mark of frames downstream
+ * it stops until they are down to half, so the decoder never runs further
+ * ahead of its consumers than that. Paced, each packet waits for its due
+ * time as well.
+ */
+static RK_U32 feed_hold_ms(VpuDecContext *ctx)
+{
+    RK_U32 high_water = ctx->cfg.high_water;
+    double now;
+
+    if (high_water) {
+        RK_U32 queued = downstream_frames(ctx);
 
-            if (pkt_done)
-                mpp_packet_set_eos(ctx->packet);
+        now = get_time_in_seconds();
+        if (queued > ctx->peak_downstream)
+            ctx->peak_downstream = queued;
+        if (!ctx->throttled && queued >= high_water) {
+            ctx->throttled = 1;
+            ctx->throttles++;
+            ctx->throttle_start = now;
+        } else if (ctx->throttled && queued <= high_water / 2) {
+            ctx->throttled = 0;
+            ctx->throttle_time += now - ctx->throttle_start;
         }
+        if (ctx->throttled)
+            return THROTTLE_POLL_MS;
+    }
+
+    if ((ctx->cfg.pace_fps || ctx->cfg.pace_pts) && !live_packet_due(ctx)) {
+        RK_U32 wait_ms = (RK_U32)((ctx->due - get_time_in_seconds()) * 1000);
+
+        return wait_ms < 1 ? 1 : wait_ms > POLL_TIMEOUT_MS ? POLL_TIMEOUT_MS : wait_ms;
+    }
+    return 0;
+}
+
+// Next packet in, paced ones on their due time
+static MPP_RET queue_next_packet(VpuDecContext *ctx)
+{
+    if (ctx->cfg.pace_fps || ctx->cfg.pace_pts)
+        return queue_live_packet(ctx);
+    return queue_packet(ctx);
+}
+
+// Queue one packet, waiting up to timeout for a free input task
+MPP_RET feed_packet(VpuDecContext *ctx, MppPollType timeout)
+{
+    MPP_RET ret = MPP_OK;
+
+    if (!ctx->held_count) {
+        ret = take_input_task(ctx, timeout);
+        if (ret)
+            return ret;
+    }
+    return queue_next_packet(ctx);
+}
+
+/*
+ * Size the external frame buffers for the new sequence in ctx->width x
+ * height, size bytes each: the DPB its level allows at this size, the
+ * frame being decoded, the frames the writer and the encoder may hold and
+ * the configured reserve. Under a DMA budget the pool is capped at the
+ * stream's fair share, down to the DPB, the frame being decoded and one
+ * frame out, and when that much is not free yet it waits up to timeout
+ * for other streams to release: MPP_ERR_TIMEOUT means ask again later,
+ * with ctx->budget_wait set. The decoder is attached to the group on the
+ * first info change.
+ */
+static MPP_RET setup_frame_buffers(VpuDecContext *ctx, size_t size, RK_S32 timeout)
+{
+    MPP_RET ret = MPP_OK;
+    RK_U32 held = ctx->writer.mode == YUV_WRITER_SYNC ||
+                  ctx->writer.mode == YUV_WRITER_NULL ? 0 : ctx->writer.depth;
+    RK_U32 count, min, waited;
+
+    if (ctx->enc_ready)
+        held += TRANSCODE_DEPTH;
+    if (ctx->exp_ready)
+        held += ctx->exp.depth;
+
+    ctx->dpb = annexb_max_dpb_frames(ctx->type, rk_stream_src_level(&ctx->src),
+                                     ctx->width, ctx->height);
+    count = ctx->dpb + 1 + held + ctx->frm_pool.reserve;
+    if (count > RK_FRAME_POOL_MAX)
+        count = RK_FRAME_POOL_MAX;
+
+    // The old size's reservation goes, its frames are freed as they return
+    if (ctx->cfg.budget) {
+        RK_U32 want = count;
+
+        rk_dma_budget_release(ctx->cfg.budget, ctx->frm_reserved);
+        ctx->frm_reserved = 0;
+        min = ctx->dpb + 1 + (held ? 1 : 0);
+        if (min > count)
+            min = count;
+        // Look once without waiting so a wait is noticed and reported
+        waited = ctx->budget_wait;
+        if (!waited)
+            ctx->budget_wait_start = get_time_in_seconds();
+        ret = rk_dma_budget_reserve_count(ctx->cfg.budget, size, min, want, ctx->pkt_reserved,
+                                          0, &ctx->budget_wait, &count);
+        waited |= ctx->budget_wait;
+        if (ret == MPP_ERR_TIMEOUT && timeout)
+            ret = rk_dma_budget_reserve_count(ctx->cfg.budget, size, min, want,
+                                              ctx->pkt_reserved, timeout, &ctx->budget_wait,
+                                              &count);
+        if (ret == MPP_ERR_NOMEM)
+            mpp_err("stream %d: %d frames of %zu bytes exceed the DMA budget\n",
+                    ctx->cfg.trace_id, min, size);
+        if (ret)
+            return ret;
+        if (waited)
+            mpp_log("stream %d: frame pool waited %.3f s for the DMA budget\n",
+                    ctx->cfg.trace_id, get_time_in_seconds() - ctx->budget_wait_start);
+        ctx->frm_reserved = count * size;
+        if (count < want)
+            mpp_log("stream %d: frame pool cut to %d of %d frames by the DMA budget\n",
+                    ctx->cfg.trace_id, count, want);
+    }
+
+    ret = rk_frame_pool_setup(&ctx->frm_pool, count, size);
+    if (ret)
+        return ret;
 
-        // Get task
-        ret = ctx->mpi->poll(ctx->ctx, MPP_PORT_INPUT, MPP_POLL_BLOCK);
+    if (!ctx->frm_pool_attached) {
+        ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_EXT_BUF_GROUP, ctx->frm_pool.group);
         if (ret) {
-            mpp_err("mpp input poll failed\n");
-            goto OUT;
+            mpp_err("Failed to set external frame group\n");
+            return ret;
         }
+        ctx->frm_pool_attached = 1;
+    }
+    return MPP_OK;
+}
 
-        ret = ctx->mpi->dequeue(ctx->ctx, MPP_PORT_INPUT, &task);
+/*
+ * Take one output task: answer info change, write a decoded frame and
+ * note EOS. Returns MPP_ERR_TIMEOUT when nothing is ready, also for non-block.
+ */
+MPP_RET collect_frame(VpuDecContext *ctx, MppPollType timeout)
+{
+    MPP_RET ret = MPP_OK;
+    MppTask task = NULL;
+    MppFrame frame_out = NULL;
+    double start = get_time_in_seconds();
+    double end;
+
+    // Nothing comes out before the new sequence's frame pool fits the budget
+    if (ctx->budget_wait) {
+        ret = setup_frame_buffers(ctx, ctx->budget_buf_size, timeout);
+        if (ret)
+            return ret;
+        ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_INFO_CHANGE_READY, NULL);
         if (ret) {
-            mpp_err("mpp task input dequeue failed\n");
-            goto OUT;
+            mpp_err("info change ready failed\n");
+            return ret;
         }
+        start = get_time_in_seconds();
+    }
 
-        mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, ctx->packet);
-        mpp_task_meta_set_frame (task, KEY_OUTPUT_FRAME, ctx->frame);
+    // Get frame
+    ret = ctx->mpi->poll(ctx->ctx, MPP_PORT_OUTPUT, timeout);
+    end = get_time_in_seconds();
+    ctx->collect_wait += end - start;
+    if (ret)
+        return timeout == MPP_POLL_NON_BLOCK ? MPP_ERR_TIMEOUT : ret;
+    if (timeout != MPP_POLL_NON_BLOCK)
+        rk_trace_span(&ctx->trace, TRACE_OUTPUT_WAIT, start, end);
 
-        ret = ctx->mpi->enqueue(ctx->ctx, MPP_PORT_INPUT, task);
-        if (ret) {
-            mpp_err("mpp task input enqueue failed\n");
-            goto OUT;
+    ret = ctx->mpi->dequeue(ctx->ctx, MPP_PORT_OUTPUT, &task);
+    if (ret || !task) {
+        mpp_err("mpp task output dequeue failed\n");
+        return ret ? ret : MPP_NOK;
+    }
+
+    mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, &frame_out);
+
+    if (frame_out) {
+        RK_U32 eos = mpp_frame_get_eos(frame_out);
+
+        // Write YUV data to file
+        if (mpp_frame_get_info_change(frame_out)) {
+            RK_U32 width = mpp_frame_get_width(frame_out);
+            RK_U32 height = mpp_frame_get_height(frame_out);
+            RK_U32 hor_stride = mpp_frame_get_hor_stride(frame_out);
+            RK_U32 ver_stride = mpp_frame_get_ver_stride(frame_out);
+            MppFrameFormat fmt = mpp_frame_get_fmt(frame_out);
+
+            ctx->width = width;
+            ctx->height = height;
+            ctx->frame_size = hor_stride * ver_stride * 3 / 2;
+            ctx->layout.width = width;
+            ctx->layout.height = height;
+            ctx->layout.hor_stride = hor_stride;
+            ctx->layout.ver_stride = ver_stride;
+            // The writer picks its detile or unpack kernels from these
+            ctx->layout.fbc = MPP_FRAME_FMT_IS_FBC(fmt) != 0;
+            ctx->layout.bit_depth = (fmt & MPP_FRAME_FMT_MASK) == MPP_FMT_YUV420SP_10BIT ? 10 : 8;
+            ctx->layout.tile = MPP_FRAME_FMT_IS_TILE(fmt) ? YUV_TILE_SIZE : 0;
+            ctx->info_time = get_time_in_seconds();
+            ctx->info_pending = 1;
+
+            if (ctx->frm_pool_ready) {
+                ctx->budget_buf_size = mpp_frame_get_buf_size(frame_out);
+                ret = setup_frame_buffers(ctx, ctx->budget_buf_size, timeout);
+            }
+            // Answered from a later call once the budget has room
+            if (!ret)
+                ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_INFO_CHANGE_READY, NULL);
+            if (ret && ret != MPP_ERR_TIMEOUT)
+                mpp_err("info change ready failed\n");
+        } else if (mpp_frame_get_buffer(frame_out)) {
+            if (ctx->info_pending) {
+                double now = get_time_in_seconds();
+                double latency = now - ctx->info_time;
+
+                if (!ctx->frame_count)
+                    ctx->first_frame = now - ctx->first_packet;
+                ctx->info_changes++;
+                ctx->info_latency_sum += latency;
+                if (latency > ctx->info_latency_max)
+                    ctx->info_latency_max = latency;
+                ctx->info_pending = 0;
+            }
+            if (ctx->frm_pool_ready)
+                rk_frame_pool_usage(&ctx->frm_pool);
+            rk_trace_frame(&ctx->trace, mpp_frame_get_pts(frame_out), end);
+
+            // The writer keeps a buffer reference until the frame is on disk
+            ret = rk_yuv_writer_push(&ctx->writer, mpp_frame_get_buffer(frame_out), &ctx->layout);
+            if (ret)
+                mpp_err("Failed to write frame data\n");
+
+            // The consumer maps the buffer itself; it comes back with the ack
+            if (!ret && ctx->exp_ready)
+                ret = rk_frame_export_push(&ctx->exp, frame_out);
+
+            // The encoder reads the decoder's buffer in place and takes the
+            // frame; it goes back to the decoder once its packet is out
+            if (!ret && ctx->enc_ready) {
+                ret = rk_transcoder_push(&ctx->enc, &frame_out);
+                if (ret)
+                    mpp_err("Failed to encode frame\n");
+            }
+            ctx->frame_count++;
         }
+        // A bufferless frame only carries the EOS flag
 
-        // Get frame
-        ret = ctx->mpi->poll(ctx->ctx, MPP_PORT_OUTPUT, MPP_POLL_BLOCK);
-        if (ret) {
-            mpp_err("mpp output poll failed\n");
-            goto OUT;
+        if (eos)
+            ctx->frm_eos = 1;
+        if (frame_out)
+            mpp_frame_deinit(&frame_out);
+    }
+
+    if (ctx->mpi->enqueue(ctx->ctx, MPP_PORT_OUTPUT, task)) {
+        mpp_err("mpp task output enqueue failed\n");
+        return MPP_NOK;
+    }
+    return ret;
+}
+
+static void *feeder_thread(void *arg)
+{
+    VpuDecContext *ctx = (VpuDecContext *)arg;
+
+    while (!ctx->abort && (!ctx->pkt_eos || ctx->inflight)) {
+        MPP_RET ret;
+
+        // Below depth with a task at hand: queue unless paced or throttled,
+        // otherwise wait for a task back
+        if (!ctx->pkt_eos && ctx->held_count && ctx->inflight < ctx->cfg.depth) {
+            RK_U32 hold_ms = feed_hold_ms(ctx);
+
+            if (hold_ms) {
+                usleep(hold_ms * 1000);
+                continue;
+            }
+            ret = queue_next_packet(ctx);
+        } else {
+            ret = take_input_task(ctx, POLL_TIMEOUT_MS);
         }
 
-        ret = ctx->mpi->dequeue(ctx->ctx, MPP_PORT_OUTPUT, &task);
-        if (ret) {
-            mpp_err("mpp task output dequeue failed\n");
-            goto OUT;
+        if (ret && ret != MPP_ERR_TIMEOUT) {
+            mpp_err("feeder failed %d\n", ret);
+            ctx->abort = 1;
         }
+    }
+    return NULL;
+}
 
-        if (task) {
-            MppFrame frame_out = NULL;
-            mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, &frame_out);
-
-            if (frame_out) {
-                // Write YUV data to file
-                if (mpp_frame_get_info_change(frame_out)) {
-                    RK_U32 width = mpp_frame_get_width(frame_out);
-                    RK_U32 height = mpp_frame_get_height(frame_out);
-                    RK_U32 hor_stride = mpp_frame_get_hor_stride(frame_out);
-                    RK_U32 ver_stride = mpp_frame_get_ver_stride(frame_out);
-
-                    ctx->width = width;
-                    ctx->height = height;
-                    ctx->frame_size = hor_stride * ver_stride * 3 / 2;
-
-                    ret = ctx->mpi->control(ctx->ctx, MPP_DEC_SET_INFO_CHANGE_READY, NULL);
-                    if (ret) {
-                        mpp_err("info change ready failed\n");
-                        goto OUT;
-                    }
-                } else {
-                    void *ptr = mpp_buffer_get_ptr(mpp_frame_get_buffer(frame_out));
-                    size_t len = fwrite(ptr, 1, ctx->frame_size, ctx->fp_output);
-                    if (len != ctx->frame_size) {
-                        mpp_err("Failed to write frame data\n");
-                        goto OUT;
-                    }
-                    ctx->frame_count++;
-                }
+static void *collector_thread(void *arg)
+{
+    VpuDecContext *ctx = (VpuDecContext *)arg;
 
-                frm_eos = mpp_frame_get_eos(frame_out);
-                mpp_frame_deinit(&frame_out);
+    while (!ctx->abort && !ctx->frm_eos) {
+        MPP_RET ret = collect_frame(ctx, POLL_TIMEOUT_MS);
+        if (ret && ret != MPP_ERR_TIMEOUT) {
+            mpp_err("collector failed %d\n", ret);
+            ctx->abort = 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * One non-blocking turn for the multi-stream scheduler: up to budget input
+ * steps (queue a packet or take a task back) and up to budget frames out.
+ * In real-time and paced modes a packet waits for its due time, and none
+ * goes in while the stream is at its high-water mark. *progress counts
+ * what was done, 0 when the decoder had nothing ready.
+ */
+MPP_RET step_decoder(VpuDecContext *ctx, RK_U32 budget, RK_U32 *progress)
+{
+    MPP_RET ret = MPP_OK;
+    RK_U32 i;
+
+    *progress = 0;
+    for (i = 0; i < budget; i++) {
+        if (ctx->cfg.low_latency && live_packet_due(ctx) && ctx->held_count &&
+            ctx->inflight < ctx->cfg.depth)
+            ret = queue_live_packet(ctx);
+        else if (!ctx->cfg.low_latency && !ctx->pkt_eos && ctx->held_count &&
+                 ctx->inflight < ctx->cfg.depth && !feed_hold_ms(ctx))
+            ret = queue_next_packet(ctx);
+        else if (!ctx->pkt_eos || ctx->inflight)
+            ret = take_input_task(ctx, MPP_POLL_NON_BLOCK);
+        else
+            break;
+
+        if (ret == MPP_ERR_TIMEOUT)
+            break;
+        if (ret)
+            return ret;
+        (*progress)++;
+    }
+
+    for (i = 0; i < budget && !ctx->frm_eos; i++) {
+        ret = collect_frame(ctx, MPP_POLL_NON_BLOCK);
+        if (ret == MPP_ERR_TIMEOUT)
+            break;
+        if (ret)
+            return ret;
+        (*progress)++;
+    }
+    return MPP_OK;
+}
+
+// Every frame is out and the decoder holds no packet of ours
+RK_U32 decoder_finished(const VpuDecContext *ctx)
+{
+    return ctx->frm_eos && ctx->pkt_eos && !ctx->inflight;
+}
+
+/*
+ * Real-time loop for live input, on the calling thread. Each access unit
+ * is queued once its frame interval comes due, as a camera would deliver
+ * it, and frames are drained the moment the decoder has them. The output
+ * poll never waits past the next packet's due time, so neither side holds
+ * up the other. At most cfg.depth packets are queued: a decoder that falls
+ * behind shows up as late packets, not as a growing queue.
+ */
+static MPP_RET decode_live(VpuDecContext *ctx)
+{
+    MPP_RET ret = MPP_OK;
+
+    while (!ctx->frm_eos) {
+        double now;
+        RK_S32 wait_ms;
+
+        // Take back every input task the decoder is done with
+        while (!(ret = take_input_task(ctx, MPP_POLL_NON_BLOCK)))
+            ;
+        if (ret != MPP_ERR_TIMEOUT)
+            return ret;
+
+        if (live_packet_due(ctx) && ctx->held_count && ctx->inflight < ctx->cfg.depth) {
+            ret = queue_live_packet(ctx);
+            if (ret && ret != MPP_ERR_TIMEOUT)
+                return ret;
+        }
+
+        while (!ctx->frm_eos && !(ret = collect_frame(ctx, MPP_POLL_NON_BLOCK)))
+            ;
+        if (ret && ret != MPP_ERR_TIMEOUT)
+            return ret;
+
+        // Wait for a frame until the next packet is due; 1 ms while one is late
+        now = get_time_in_seconds();
+        wait_ms = ctx->pkt_eos ? POLL_TIMEOUT_MS : (RK_S32)((ctx->due - now) * 1000);
+        if (wait_ms < 1)
+            wait_ms = 1;
+        if (!ctx->frm_eos) {
+            ret = collect_frame(ctx, (MppPollType)wait_ms);
+            if (ret && ret != MPP_ERR_TIMEOUT)
+                return ret;
+        }
+    }
+
+    // Take back packets the decoder still holds
+    while (ctx->inflight) {
+        ret = take_input_task(ctx, POLL_TIMEOUT_MS);
+        if (ret && ret != MPP_ERR_TIMEOUT)
+            return ret;
+    }
+    return MPP_OK;
+}
+
+/*
+ * depth 0: the original lock-step loop, one packet in, then the frames
+ * it brought out.
+ * depth N: a feeder thread keeps up to N packets queued in the decoder
+ * while a collector thread drains and writes frames.
+ * Either way pacing and the high-water mark hold back the next packet.
+ */
+MPP_RET decode_frames(VpuDecContext *ctx)
+{
+    MPP_RET ret = MPP_OK;
+    double start = get_time_in_seconds();
+    double cpu_start = get_process_cpu_seconds();
+
+    if (ctx->cfg.low_latency) {
+        ret = decode_live(ctx);
+    } else if (!ctx->cfg.depth) {
+        while (!ctx->frm_eos) {
+            RK_U32 hold_ms;
+
+            while (!ctx->pkt_eos && (hold_ms = feed_hold_ms(ctx)))
+                usleep(hold_ms * 1000);
+            if (!ctx->pkt_eos) {
+                ret = feed_packet(ctx, POLL_TIMEOUT_MS);
+                if (ret && ret != MPP_ERR_TIMEOUT) {
+                    mpp_err("mpp input poll failed\n");
+                    goto OUT;
+                }
             }
 
-            ret = ctx->mpi->enqueue(ctx->ctx, MPP_PORT_OUTPUT, task);
-            if (ret) {
-                mpp_err("mpp task output enqueue failed\n");
+            // A packet may owe no frame yet (reordering, a new sequence) or
+            // several: take what is ready, wait only once the input is in
+            do {
+                ret = collect_frame(ctx, ctx->pkt_eos ? POLL_TIMEOUT_MS : MPP_POLL_NON_BLOCK);
+            } while (!ret && !ctx->frm_eos);
+            if (ret && ret != MPP_ERR_TIMEOUT) {
+                mpp_err("mpp output poll failed\n");
                 goto OUT;
             }
+            ret = MPP_OK;
+        }
+
+        // Take back packets the decoder still holds
+        while (ctx->inflight) {
+            ret = take_input_task(ctx, POLL_TIMEOUT_MS);
+            if (ret && ret != MPP_ERR_TIMEOUT)
+                goto OUT;
         }
+        ret = MPP_OK;
+    } else {
+        pthread_t feeder, collector;
+
+        if (pthread_create(&collector, NULL, collector_thread, ctx)) {
+            mpp_err("Failed to create collector thread\n");
+            return MPP_NOK;
+        }
+        if (pthread_create(&feeder, NULL, feeder_thread, ctx)) {
+            mpp_err("Failed to create feeder thread\n");
+            ctx->abort = 1;
+            pthread_join(collector, NULL);
+            return MPP_NOK;
+        }
+
+        pthread_join(feeder, NULL);
+        pthread_join(collector, NULL);
+        ret = ctx->abort ? MPP_NOK : MPP_OK;
     }
 
 OUT:
+    // Drain the encoder and the writer so the time covers every byte
+    // reaching the file
+    if (ctx->enc_ready && rk_transcoder_finish(&ctx->enc) && !ret)
+        ret = MPP_NOK;
+    if (ctx->exp_ready && rk_frame_export_finish(&ctx->exp) && !ret)
+        ret = MPP_NOK;
+    if (rk_yuv_writer_close(&ctx->writer) && !ret)
+        ret = MPP_NOK;
+    ctx->elapsed = get_time_in_seconds() - start;
+    // One stream per process here, so the process CPU is the stream's
+    ctx->cpu_time = get_process_cpu_seconds() - cpu_start;
     return ret;
 }
 
-void deinit_vpu_decoder(VpuDecContext *ctx)
+/*
+ * crc output: save the frame checksums to cfg.golden_out and compare them
+ * with cfg.golden. Any differing, missing or extra frame fails the run.
+ */
+MPP_RET check_frame_crcs(VpuDecContext *ctx)
 {
-    if (ctx->packet) {
-        mpp_packet_deinit(&ctx->packet);
-        ctx->packet = NULL;
-    }
+    const RkCrcList *golden = ctx->cfg.golden;
+    RkCrcList *got = &ctx->crcs;
+    RK_S32 first;
+    RK_U32 bad;
+
+    if (ctx->writer.mode != YUV_WRITER_CRC)
+        return MPP_OK;
+
+    if (ctx->cfg.golden_out && rk_crc_list_save(got, ctx->cfg.golden_out))
+        return MPP_NOK;
+    if (!golden)
+        return MPP_OK;
 
-    if (ctx->frame) {
-        mpp_frame_deinit(&ctx->frame);
-        ctx->frame = NULL;
+    bad = rk_crc_list_compare(got, golden, &first);
+    if (!bad) {
+        mpp_log("stream %d: all %d frame checksums match\n", ctx->cfg.trace_id, got->count);
+        return MPP_OK;
     }
 
+    if ((RK_U32)first < got->count && (RK_U32)first < golden->count)
+        mpp_err("stream %d: frame %d %ux%u crc %08x, golden %ux%u crc %08x\n",
+                ctx->cfg.trace_id, first, got->sizes[first] >> 16, got->sizes[first] & 0xffff,
+                got->crcs[first], golden->sizes[first] >> 16, golden->sizes[first] & 0xffff,
+                golden->crcs[first]);
+    // Missing and extra frames count as differing, out of the longer list
+    mpp_err("stream %d: %d of %d frames differ from the golden list (%d decoded, %d golden)\n",
+            ctx->cfg.trace_id, bad, got->count > golden->count ? got->count : golden->count,
+            got->count, golden->count);
+    return MPP_NOK;
+}
+
+/*
+ * Hand the decoder's DMA buffers back once its stream is done and nothing
+ * downstream holds a frame, so a stream waiting on the DMA budget can go
+ * ahead before the others finish. Safe to call again from the deinit.
+ */
+void release_decoder_buffers(VpuDecContext *ctx)
+{
     if (ctx->ctx) {
         mpp_destroy(ctx->ctx);
         ctx->ctx = NULL;
     }
 
-    if (ctx->frm_grp) {
-        mpp_buffer_group_put(ctx->frm_grp);
-        ctx->frm_grp = NULL;
+    // After mpp_destroy nothing can still read the packets
+    if (ctx->pkt_pool.count)
+        rk_pkt_pool_deinit(&ctx->pkt_pool);
+
+    // Frames still queued to the writer were returned by its close
+    if (ctx->frm_pool_ready) {
+        rk_frame_pool_deinit(&ctx->frm_pool);
+        ctx->frm_pool_ready = 0;
+    }
+    if (ctx->cfg.budget) {
+        rk_dma_budget_cancel(ctx->cfg.budget, ctx->pkt_reserved, &ctx->budget_wait);
+        rk_dma_budget_release(ctx->cfg.budget, ctx->pkt_reserved + ctx->frm_reserved);
+        ctx->pkt_reserved = 0;
+        ctx->frm_reserved = 0;
+    }
+}
+
+void deinit_vpu_decoder(VpuDecContext *ctx)
+{
+    // Returns any frame buffers still queued before MPP goes away
+    if (ctx->enc_ready) {
+        rk_transcoder_deinit(&ctx->enc);
+        ctx->enc_ready = 0;
+    }
+    if (ctx->exp_ready) {
+        rk_frame_export_deinit(&ctx->exp);
+        ctx->exp_ready = 0;
     }
+    rk_yuv_writer_close(&ctx->writer);
+    if (ctx->csc_ready) {
+        rk_yuv_converter_deinit(&ctx->csc);
+        ctx->csc_ready = 0;
+    }
+
+    release_decoder_buffers(ctx);
 
-    if (ctx->fp_input) {
-        fclose(ctx->fp_input);
-        ctx->fp_input = NULL;
+    rk_stream_src_close(&ctx->src);
+    rk_trace_deinit(&ctx->trace);
+    rk_crc_list_deinit(&ctx->crcs);
+}
+
+// Conversion rate per worker core type, from each worker's busy time
+static void print_csc_stats(VpuDecContext *ctx)
+{
+    static const char *names[] = { "Cortex-A55", "Cortex-A76", "unpinned" };
+    RkYuvConverter *cvt = &ctx->csc;
+    RK_U64 pixels[3] = { 0 };
+    double busy[3] = { 0 };
+    RK_U32 cores[3] = { 0 };
+    RK_U32 i;
+
+    for (i = 0; i < cvt->worker_count; i++) {
+        RkCscWorker *wk = &cvt->workers[i];
+        int type = wk->core < 0 ? 2 : wk->core >= 4 ? 1 : 0;
+
+        pixels[type] += wk->pixels;
+        busy[type] += wk->busy;
+        cores[type]++;
     }
 
-    if (ctx->fp_output) {
-        fclose(ctx->fp_output);
-        ctx->fp_output = NULL;
+    mpp_log("Colour conversion %s %s%s to %ux%u: %llu frames, %.1f MP/s on %d workers\n",
+            rk_csc_format_name(cvt->cfg.format), cvt->cfg.standard == CSC_BT709 ? "BT.709" : "BT.601",
+            cvt->cfg.full_range ? " full range" : "", cvt->dst_w, cvt->dst_h, cvt->frames,
+            ctx->writer.copy_time > 0 ?
+            (double)cvt->frames * cvt->dst_w * cvt->dst_h / ctx->writer.copy_time / 1e6 : 0,
+            cvt->worker_count);
+    for (i = 0; i < 3; i++) {
+        if (cores[i] && busy[i] > 0)
+            mpp_log("  %s: %d workers, %.1f MP/s per core\n", names[i], cores[i],
+                    pixels[i] / busy[i] / 1e6);
     }
 }
 
-int main(int argc, char **argv)
+/*
+ * What compressed frames cost in DDR against the linear NV12 the decoder
+ * writes otherwise, per frame from their heads, and what reading one region
+ * of them takes.
+ */
+static void print_fbc_stats(VpuDecContext *ctx)
 {
-    MPP_RET ret = MPP_OK;
-    VpuDecContext ctx;
+    RkYuvWriter *w = &ctx->writer;
+    const RkFbcStats *st = &w->fbc;
+    RK_U64 n = w->fbc_frames;
+    double linear;
 
-    if (argc != 3) {
-        mpp_err("Usage: %s input_file output_file\n", argv[0]);
-        return 1;
+    if (!n) {
+        if (ctx->frame_count)
+            mpp_log("FBC: the decoder gave linear frames, stored as raw\n");
+        return;
     }
 
+    linear = (double)w->raw_bytes / w->frames;
+    mpp_log("FBC: %llu frames, %.0f KB per frame in DDR (heads %.0f KB, payload %.0f KB) "
+            "vs %.0f KB linear NV12, %.1f%% of the traffic\n", n,
+            st->frame_bytes / n / 1024.0, st->head_bytes / n / 1024.0,
+            st->payload_bytes / n / 1024.0, linear / 1024,
+            100.0 * st->frame_bytes / n / linear);
+    mpp_log("FBC: %.1f%% solid blocks, %.1f%% of sub-blocks stored raw, heads scanned "
+            "at %.2f GB/s\n", st->blocks ? 100.0 * st->solid_blocks / st->blocks : 0,
+            st->blocks ? 100.0 * st->raw_subblocks / (st->blocks * FBC_SUBBLOCKS) : 0,
+            w->fbc_scan_time > 0 ? st->head_bytes / w->fbc_scan_time / 1e9 : 0);
+    if (w->fbc_roi.width)
+        mpp_log("FBC region %ux%u at %u,%u: %.0f KB read per frame, %.1f%% of the frame\n",
+                w->fbc_roi.width, w->fbc_roi.height, w->fbc_roi.x, w->fbc_roi.y,
+                w->fbc_roi_bytes / n / 1024.0,
+                st->frame_bytes ? 100.0 * w->fbc_roi_bytes / st->frame_bytes : 0);
+}
+
+// First-frame latency and, with preallocated frames, what they cost in memory
+static void print_buffer_stats(VpuDecContext *ctx)
+{
+    RkFramePool *pool = &ctx->frm_pool;
+
+    if (ctx->info_changes)
+        mpp_log("First frame %.2f ms after the first packet, %.2f ms avg %.2f ms max "
+                "after %d info changes, frame buffers %s\n",
+                ctx->first_frame * 1000, ctx->info_latency_sum / ctx->info_changes * 1000,
+                ctx->info_latency_max * 1000, ctx->info_changes,
+                ctx->frm_pool_ready ? "preallocated" : "allocated by the decoder");
+    if (ctx->frm_pool_ready)
+        mpp_log("Frame pool: %d x %zu bytes (dpb %d, level %d, reserve %d), %d setups in %.3f ms, "
+                "peak %.1f MB DMA + %.1f MB packet buffers\n",
+                pool->count, pool->buf_size, ctx->dpb, rk_stream_src_level(&ctx->src),
+                pool->reserve, pool->setups, pool->setup_time * 1000,
+                pool->peak_usage / (double)SZ_1M,
+                ctx->pkt_pool.count * (double)ctx->pkt_pool.size / SZ_1M);
+}
+
+/*
+ * Transcode: what the rate control delivered against its target, how fast
+ * frames went from the decoder through the encoder, and the CPU it took.
+ * cpu is the stream's CPU seconds over elapsed.
+ */
+void print_transcode_stats(VpuDecContext *ctx, double elapsed, double cpu)
+{
+    RkTranscoder *tc = &ctx->enc;
+    const RkTranscodeConfig *cfg = &ctx->cfg.enc;
+    double duration = tc->packets / (double)cfg->fps;
+
+    if (cfg->rc_mode == MPP_ENC_RC_MODE_FIXQP)
+        mpp_log("stream %d: %s fixqp %d, gop %d: %llu frames -> %llu packets (%llu intra), "
+                "%.2f MB, %.0f kbps at %d fps, %d reconfigs\n",
+                ctx->cfg.trace_id, cfg->type == MPP_VIDEO_CodingHEVC ? "h265" : "h264", cfg->qp,
+                cfg->gop, tc->frames_in, tc->packets, tc->intra, tc->bytes / (double)SZ_1M,
+                duration > 0 ? tc->bytes * 8 / duration / 1000 : 0, cfg->fps, tc->reconfigs);
+    else
+        mpp_log("stream %d: %s %s %d kbps, gop %d: %llu frames -> %llu packets (%llu intra), "
+                "%.2f MB, %.0f kbps at %d fps, avg qp %.1f, %d reconfigs\n",
+                ctx->cfg.trace_id, cfg->type == MPP_VIDEO_CodingHEVC ? "h265" : "h264",
+                rk_rc_mode_name(cfg->rc_mode), tc->bps / 1000, cfg->gop, tc->frames_in,
+                tc->packets, tc->intra, tc->bytes / (double)SZ_1M,
+                duration > 0 ? tc->bytes * 8 / duration / 1000 : 0, cfg->fps,
+                tc->packets ? (double)tc->qp_sum / tc->packets : 0, tc->reconfigs);
+    mpp_log("stream %d: end to end %.1f fps, frame to packet avg %.2f ms max %.2f ms, "
+            "decoder waited %.3f s on the encoder, %llu frames encoded in place, "
+            "%llu dithered from 10-bit to NV12 first, CPU %.3f s, %.1f%% of a core\n",
+            ctx->cfg.trace_id, elapsed > 0 ? tc->packets / elapsed : 0,
+            tc->frames_in ? tc->latency_sum / tc->frames_in * 1000 : 0, tc->latency_max * 1000,
+            tc->push_wait, tc->packets > tc->converted ? tc->packets - tc->converted : 0,
+            tc->converted, cpu, elapsed > 0 ? 100 * cpu / elapsed : 0);
+}
+
+/*
+ * Export mode: frames lent to the consumer, how long it held them and how
+ * long the decoder waited for its acks.
+ */
+static void print_export_stats(VpuDecContext *ctx)
+{
+    RkFrameExport *ex = &ctx->exp;
+
+    mpp_log("Export: %llu frames lent (%llu MB, 0 bytes copied), %llu acked, peak %d of %d "
+            "out; held avg %.2f ms max %.2f ms, decoder waited %.3f s on acks (%d full waits)\n",
+            ex->frames, ex->bytes >> 20, ex->acks, ex->peak_lent, ex->depth,
+            ex->acks ? ex->hold_sum / ex->acks * 1000 : 0, ex->hold_max * 1000, ex->push_wait,
+            ex->stalls);
+}
+
+// Real-time mode: how late packets went in and whether frames made the interval
+static void print_live_stats(VpuDecContext *ctx)
+{
+    RkTraceHist *dec = &ctx->trace.hist[TRACE_DECODE];
+    double interval_ms = 1000.0 / ctx->cfg.fps;
+    double p99 = rk_trace_percentile(dec, 0.99) / 1000;
+
+    mpp_log("Real-time at %d fps: %d packets, %d late by over a frame, max lag %.2f ms; "
+            "submit to frame p50 %.2f ms p99 %.2f ms, %s the %.2f ms frame interval\n",
+            ctx->cfg.fps, ctx->packet_count, ctx->late_packets, ctx->max_lag * 1000,
+            rk_trace_percentile(dec, 0.50) / 1000, p99,
+            p99 < interval_ms ? "within" : "over", interval_ms);
+}
+
+/*
+ * Paced and throttled feeding: how closely packets kept to their times,
+ * and how often and how long the frames downstream held the feeder back.
+ */
+static void print_pace_stats(VpuDecContext *ctx)
+{
+    const VpuDecConfig *cfg = &ctx->cfg;
+
+    if (cfg->pace_fps || cfg->pace_pts)
+        mpp_log("Paced at %s%.0f fps: %d packets, %d late by over a frame, max lag %.2f ms\n",
+                cfg->pace_pts ? "PTS, " : "", (double)(cfg->pace_fps ? cfg->pace_fps : cfg->fps),
+                ctx->packet_count, ctx->late_packets, ctx->max_lag * 1000);
+    if (cfg->high_water)
+        mpp_log("High-water mark %d frames: feeder held back %d times for %.3f s, "
+                "peak %d frames downstream\n", cfg->high_water, ctx->throttles,
+                ctx->throttle_time, ctx->peak_downstream);
+}
+
+static MPP_RET run_decode(const char *input_file, const char *output_file, const VpuDecConfig *cfg,
+                          double *fps, RkTraceHist *latency)
+{
+    MPP_RET ret = MPP_OK;
+    VpuDecContext ctx;
+
     // Initialize decoder
-    ret = init_vpu_decoder(&ctx, argv[1], argv[2]);
+    ret = init_vpu_decoder(&ctx, input_file, output_file, cfg);
     if (ret) {
         mpp_err("Failed to initialize decoder\n");
-        return 1;
+        return ret;
     }
 
     // Start decoding
@@ -234,10 +1122,702 @@ int main(int argc, char **argv)
     }
 
     // Print statistics
-    mpp_log("Decoded %d frames\n", ctx.frame_count);
+    *fps = ctx.elapsed > 0 ? ctx.frame_count / ctx.elapsed : 0;
+    mpp_log("Decoded %d frames from %d packets, depth %d: %.1f fps, "
+            "feed wait %.3f s, collect wait %.3f s\n",
+            ctx.frame_count, ctx.packet_count, cfg->depth, *fps,
+            ctx.feed_wait, ctx.collect_wait);
+    mpp_log("Packet pool: %d slots, peak %d with decoder, %llu released\n",
+            ctx.pkt_pool.count, ctx.pkt_pool.peak_decoder_owned, ctx.released);
+    if (ctx.frame_count)
+        mpp_log("Input %s: %llu bytes, per frame %llu copied by us, %llu left for MPP to stage\n",
+                rk_stream_src_mode_name(cfg->input_mode), ctx.src.bytes_in,
+                ctx.src.bytes_copied / ctx.frame_count, ctx.src.bytes_staged / ctx.frame_count);
+    if (ctx.enc_ready)
+        print_transcode_stats(&ctx, ctx.elapsed, ctx.cpu_time);
+    else
+        mpp_log("Output %s: %llu MB in %llu writes, peak %d frames queued, writer busy %.3f s, "
+                "decoder stalled %.3f s on output (%d full-queue waits)\n",
+                rk_yuv_writer_mode_name(ctx.writer.mode), ctx.writer.bytes >> 20,
+                ctx.writer.writes, ctx.writer.peak_queued, ctx.writer.write_time,
+                ctx.writer.stall_time, ctx.writer.stalls);
+    if (ctx.writer.mode == YUV_WRITER_CRC)
+        mpp_log("Checksummed %llu frames with %s: %.2f GB/s of picture on the writer thread\n",
+                ctx.writer.frames, rk_crc32_impl_name(),
+                ctx.writer.write_time > 0 ? ctx.writer.bytes / ctx.writer.write_time / 1e9 : 0);
+    if (ctx.writer.raw_bytes && !ctx.csc_ready && rk_yuv_writer_has_file(ctx.writer.mode)) {
+        // P010 widens packed 10-bit samples, so it can come out larger
+        RK_U64 bytes = ctx.writer.bytes, raw = ctx.writer.raw_bytes;
+
+        mpp_log("Output %s: %llu bytes written for %llu padded bytes (%.1f%% %s), "
+                "%llu bytes copied at %.2f GB/s\n",
+                rk_yuv_out_format_name(ctx.writer.stored_format), bytes, raw,
+                100.0 * (bytes > raw ? bytes - raw : raw - bytes) / raw,
+                bytes > raw ? "larger" : "saved", ctx.writer.copy_bytes,
+                ctx.writer.copy_time > 0 ? ctx.writer.copy_bytes / ctx.writer.copy_time / 1e9 : 0);
+    }
+    if (ctx.csc_ready)
+        print_csc_stats(&ctx);
+    if (ctx.exp_ready)
+        print_export_stats(&ctx);
+    if (cfg->output_format == YUV_OUT_FBC)
+        print_fbc_stats(&ctx);
+    print_buffer_stats(&ctx);
+    if (cfg->au_mode)
+        mpp_log("Packetizer: %llu access units, %llu NAL units\n",
+                ctx.src.parser.au_count, ctx.src.parser.nal_count);
+    rk_trace_print(&ctx.trace, cfg->au_mode);
+    if (cfg->low_latency)
+        print_live_stats(&ctx);
+    print_pace_stats(&ctx);
+    if (latency)
+        *latency = ctx.trace.hist[TRACE_DECODE];
+    if (cfg->trace_file) {
+        RkVpuTrace *trace = &ctx.trace;
+
+        if (!rk_trace_dump(cfg->trace_file, &trace, 1))
+            mpp_log("Trace written to %s\n", cfg->trace_file);
+    }
+    if (check_frame_crcs(&ctx) && !ret)
+        ret = MPP_NOK;
 
     // Cleanup
     deinit_vpu_decoder(&ctx);
 
     return ret;
 }
+
+/*
+ * count streams in one process on threads scheduler threads. Prints one
+ * line per stream and returns the aggregate frame rate in *fps.
+ */
+static MPP_RET run_streams(char **inputs, RK_U32 input_count, const char *output,
+                           const VpuDecConfig *cfg, RK_U32 count, RK_U32 threads,
+                           RK_U32 verbose, double *fps, double *fairness)
+{
+    MPP_RET ret = MPP_OK;
+    RkVpuServer srv;
+    RK_U32 i;
+
+    ret = rk_vpu_server_init(&srv, count, threads, inputs, input_count, output, cfg);
+    if (ret) {
+        mpp_err("Failed to initialize %d streams\n", count);
+        return ret;
+    }
+
+    ret = rk_vpu_server_run(&srv);
+    if (ret)
+        mpp_err("Failed to decode every stream\n");
+
+    *fps = srv.elapsed > 0 ? rk_vpu_server_frames(&srv) / srv.elapsed : 0;
+    *fairness = rk_vpu_server_fairness(&srv);
+    for (i = 0; verbose && i < srv.count; i++) {
+        RkVpuStream *s = &srv.streams[i];
+        RkTraceHist *dec = &s->dec.trace.hist[TRACE_DECODE];
+        RkTraceHist *wr = &s->dec.trace.hist[TRACE_WRITE];
+
+        mpp_log("Stream %2d: %d frames in %.3f s, %.1f fps, first frame %.2f ms, "
+                "longest frame gap %.1f ms, %llu visits (%.0f%% idle), writer stalled %.3f s\n",
+                s->index, s->dec.frame_count, s->end,
+                s->end > 0 ? s->dec.frame_count / s->end : 0, s->dec.first_frame * 1000,
+                s->max_gap * 1000,
+                s->visits, s->visits ? 100.0 * s->idle_visits / s->visits : 0,
+                s->dec.writer.stall_time);
+        if (dec->count || wr->count)
+            mpp_log("           decode p50 %.2f ms p99 %.2f ms, write p50 %.2f ms p99 %.2f ms\n",
+                    rk_trace_percentile(dec, 0.50) / 1000, rk_trace_percentile(dec, 0.99) / 1000,
+                    rk_trace_percentile(wr, 0.50) / 1000, rk_trace_percentile(wr, 0.99) / 1000);
+        if (s->dec.enc_ready)
+            print_transcode_stats(&s->dec, s->end, s->dec.cpu_time);
+        print_pace_stats(&s->dec);
+    }
+    mpp_log("%d streams on %d threads: %llu frames in %.3f s, %.1f fps aggregate, "
+            "fairness %.3f, %llu idle backoffs\n",
+            srv.count, srv.threads, rk_vpu_server_frames(&srv), srv.elapsed, *fps,
+            *fairness, srv.idle_sleeps);
+    if (cfg->transcode)
+        mpp_log("Process CPU %.3f s, %.1f%% of a core, over %d transcoded streams\n",
+                srv.cpu_time, srv.elapsed > 0 ? 100 * srv.cpu_time / srv.elapsed : 0, srv.count);
+
+    for (i = 0; i < srv.count; i++) {
+        if (check_frame_crcs(&srv.streams[i].dec) && !ret)
+            ret = MPP_NOK;
+    }
+
+    if (verbose && cfg->trace_file) {
+        RkVpuTrace *traces[SERVER_MAX_STREAMS];
+
+        for (i = 0; i < srv.count; i++)
+            traces[i] = &srv.streams[i].dec.trace;
+        if (!rk_trace_dump(cfg->trace_file, traces, srv.count))
+            mpp_log("Trace of %d streams written to %s\n", srv.count, cfg->trace_file);
+    }
+
+    rk_vpu_server_deinit(&srv);
+    return ret;
+}
+
+/*
+ * Decode one input as up to segments pieces in parallel, cut at its clean
+ * random access points, and join the outputs in stream order. Returns the
+ * overall frame rate, index and join included, in *fps.
+ */
+static MPP_RET run_split(const char *input_file, const char *output, const VpuDecConfig *cfg,
+                         RK_U32 segments, double *fps)
+{
+    MPP_RET ret = MPP_OK;
+    RkVpuSplit sp;
+    RkStreamIndex *idx = &sp.index;
+    double start = get_time_in_seconds();
+    double setup;
+    RK_U32 i, clean = 0;
+
+    ret = rk_vpu_split_init(&sp, input_file, output, cfg, segments);
+    if (ret) {
+        mpp_err("Failed to set up %d segments\n", segments);
+        return ret;
+    }
+    setup = get_time_in_seconds() - start;
+
+    for (i = 0; i < idx->count; i++)
+        clean += idx->keys[i].rap == ANNEXB_RAP_CLEAN;
+    if (idx->loaded)
+        mpp_log("Index: %d random access points (%d clean) in %llu access units, "
+                "loaded from %s%s\n", idx->count, clean, idx->au_count, input_file,
+                STREAM_INDEX_SUFFIX);
+    else
+        mpp_log("Index: %d random access points (%d clean) in %llu access units, "
+                "scanned in %.1f ms (%.0f MB/s)\n", idx->count, clean, idx->au_count,
+                idx->scan_time * 1000,
+                idx->scan_time > 0 ? idx->size / idx->scan_time / SZ_1M : 0);
+
+    ret = rk_vpu_split_run(&sp);
+    if (ret)
+        mpp_err("Failed to decode every segment\n");
+
+    *fps = sp.elapsed + setup > 0 ? rk_vpu_split_frames(&sp) / (sp.elapsed + setup) : 0;
+    for (i = 0; i < sp.count; i++) {
+        RkVpuSegment *s = &sp.segs[i];
+        RK_U64 last_au = i + 1 < sp.count ? sp.segs[i + 1].range.first_au : idx->au_count;
+
+        mpp_log("Segment %d: bytes %zu-%zu, access units %llu-%llu, %d frames in %.3f s, "
+                "%.1f fps%s\n", s->index, s->range.start, s->range.end, s->range.first_au,
+                last_au, s->dec.frame_count, s->end,
+                s->end > 0 ? s->dec.frame_count / s->end : 0,
+                s->range.prefix_len ? ", parameter sets resent" : "");
+        if (s->dec.enc_ready)
+            print_transcode_stats(&s->dec, s->end, s->dec.cpu_time);
+    }
+    mpp_log("%d segments: %llu frames in %.3f s (setup %.3f s), %.1f fps, "
+            "joined %llu MB of parts in %.3f s, process CPU %.3f s\n",
+            sp.count, rk_vpu_split_frames(&sp), sp.elapsed + setup, setup, *fps,
+            sp.join_bytes >> 20, sp.join_time, sp.cpu_time);
+
+    if (sp.count && check_frame_crcs(&sp.segs[0].dec) && !ret)
+        ret = MPP_NOK;
+
+    if (cfg->trace_file) {
+        RkVpuTrace *traces[SPLIT_MAX_SEGMENTS];
+
+        for (i = 0; i < sp.count; i++)
+            traces[i] = &sp.segs[i].dec.trace;
+        if (!rk_trace_dump(cfg->trace_file, traces, sp.count))
+            mpp_log("Trace of %d segments written to %s\n", sp.count, cfg->trace_file);
+    }
+
+    rk_vpu_split_deinit(&sp);
+    return ret;
+}
+
+/*
+ * Add streams 1, 2, 4, ... up to count and report the aggregate rate after
+ * each step. Once doubling the streams gains less than SERVER_SATURATION
+ * the decoder (or the CPU feeding it) is saturated.
+ */
+static MPP_RET ramp_streams(char **inputs, RK_U32 input_count, const char *output,
+                            const VpuDecConfig *cfg, RK_U32 count, RK_U32 threads)
+{
+    MPP_RET ret = MPP_OK;
+    double fps[SERVER_MAX_STREAMS + 1] = { 0 };
+    double fairness[SERVER_MAX_STREAMS + 1] = { 0 };
+    RK_U32 n, prev = 0, saturated = 0;
+
+    for (n = 1; ; n = n * 2 < count ? n * 2 : count) {
+        ret = run_streams(inputs, input_count, output, cfg, n, threads, n == count,
+                          &fps[n], &fairness[n]);
+        if (ret)
+            return ret;
+        if (prev && !saturated && fps[n] < fps[prev] * (1 + SERVER_SATURATION))
+            saturated = prev;
+        prev = n;
+        if (n == count)
+            break;
+    }
+
+    mpp_log("| streams | aggregate fps | per stream | fairness |\n");
+    for (n = 1; n <= count; n++) {
+        if (fps[n] > 0)
+            mpp_log("| %7d | %13.1f | %10.1f | %8.3f |\n", n, fps[n], fps[n] / n, fairness[n]);
+    }
+    if (saturated)
+        mpp_log("Saturated at %d streams, %.1f fps\n", saturated, fps[saturated]);
+    else
+        mpp_log("Not saturated at %d streams\n", count);
+    return ret;
+}
+
+static void usage(const char *prog)
+{
+    mpp_err("Usage: %s [-d depth] [-c] [-i read|mmap|dmabuf] [-t h264|h265] [-a] [-L] [-f fps] "
+            "[-S fps|pts] [-H frames] [-B MB] [-w sync|thread|direct|uring] [-q frames] [-o raw|nv12|i420|p010|rgb24|bgra|fbc] "
+            "[-C x,y,w,h] [-D] [-E] [-m matrix] [-s WxH] [-j workers] [-e] [-r frames] "
+            "[-n streams [-p threads] [-R]] [-T trace.json] [-v secs] [-g golden] [-G golden] [-x h264|h265 [-M cbr|vbr|fixqp] "
+            "[-b kbps] [-Q qp] [-k gop]] [-P segments] input_file [input_file...] output_file\n",
+            prog);
+    mpp_err("  -d depth  packets kept in flight, 0 = lock-step loop (default %d)\n", DEFAULT_DEPTH);
+    mpp_err("  -c        also run the lock-step loop and report the fps gained; with -L,\n");
+    mpp_err("            the file pipeline and the latency saved\n");
+    mpp_err("  -i mode   input path: read (fread copy), mmap (packets over the file\n");
+    mpp_err("            mapping), dmabuf (input_file is fd:N of a dma-buf)\n");
+    mpp_err("  -t codec  input codec, h264 or h265 (default h264)\n");
+    mpp_err("  -a        one Annex-B access unit per packet instead of %d KB chunks\n",
+            READ_BUF_SIZE / SZ_1K);
+    mpp_err("  -L        real-time mode for live streams: immediate output, parser fast\n");
+    mpp_err("            mode, access units fed at -f fps and frames drained as soon as\n");
+    mpp_err("            they are ready; implies -a\n");
+    mpp_err("  -f fps    frame rate for access-unit PTS and -L pacing (default %d)\n", DEFAULT_FPS);
+    mpp_err("  -S rate   pace the decode: access units fed at this many fps, or at their\n");
+    mpp_err("            PTS with pts, instead of as fast as they decode; implies -a\n");
+    mpp_err("  -H frames stop feeding the decoder while this many frames wait for the\n");
+    mpp_err("            writer, encoder or export consumer, until half have gone\n");
+    mpp_err("  -B MB     DMA budget for the packet and frame buffers of every decoder in\n");
+    mpp_err("            the process; each frame pool is capped at an even share, and\n");
+    mpp_err("            one that does not fit waits for another to finish, implies -e\n");
+    mpp_err("  -w mode   output writes: sync (on the collector), thread (batched on a\n");
+    mpp_err("            writer thread, default), direct (O_DIRECT), uring (io_uring);\n");
+    mpp_err("            null and crc decode only, dropping or checksumming each frame,\n");
+    mpp_err("            and take no output_file\n");
+    mpp_err("  -q frames frames queued to the writer before decoding stalls (default %d)\n",
+            YUV_WRITER_DEPTH);
+    mpp_err("  -o format output layout: nv12 or i420 cropped to the picture size\n");
+    mpp_err("            (default nv12), raw keeps the decoder's stride padding; 10-bit\n");
+    mpp_err("            streams are dithered to 8 bits for these, p010 keeps 10 bits,\n");
+    mpp_err("            rgb24 and bgra convert on a pool of worker threads, fbc has the\n");
+    mpp_err("            decoder write compressed frames (heads and payload) and stores them\n");
+    mpp_err("            as they are, with their DDR size against linear NV12\n");
+    mpp_err("  -C x,y,w,h fbc output: store only the 16x16 blocks covering this region,\n");
+    mpp_err("            heads first with their payload offsets rewritten\n");
+    mpp_err("  -D        have the decoder write %dx%d tiled frames, detiled on output\n",
+            YUV_TILE_SIZE, YUV_TILE_SIZE);
+    mpp_err("  -E        export: output_file is a Unix socket; each frame's buffer fd goes\n");
+    mpp_err("            to the process that connects (see rk_frame_consumer) and returns\n");
+    mpp_err("            to the decoder on its ack, at most -q frames out; frames are\n");
+    mpp_err("            dropped, or checksummed with -w crc\n");
+    mpp_err("  -m matrix bt601, bt709, bt601-full or bt709-full for rgb output (default bt709)\n");
+    mpp_err("  -s WxH    bilinear scale rgb output to WxH\n");
+    mpp_err("  -j n      conversion workers, pinned A76 first (default %d)\n", CSC_DEFAULT_WORKERS);
+    mpp_err("  -e        preallocate frame buffers at each info change, sized from\n");
+    mpp_err("            the stream level's DPB, instead of letting the decoder allocate\n");
+    mpp_err("  -r n      spare frames on top of the DPB and writer queue (default %d)\n",
+            RK_FRAME_POOL_RESERVE);
+    mpp_err("  -n n      decode n streams in one process, inputs reused in turn; %%d in\n");
+    mpp_err("            output_file takes the stream index, else .N is appended\n");
+    mpp_err("  -p n      scheduler threads shared by the streams (default %d)\n",
+            SERVER_DEFAULT_THREADS);
+    mpp_err("  -R        ramp 1, 2, 4 ... n streams and report where fps stops scaling\n");
+    mpp_err("  -T file   write a Chrome trace (chrome://tracing, Perfetto) of every\n");
+    mpp_err("            packet and frame; decode latency needs -a\n");
+    mpp_err("  -v secs   rolling fps line interval, 0 = off (default %d)\n", DEFAULT_FPS_INTERVAL);
+    mpp_err("  -g file   verify the frame CRC-32s against a golden list, implies -w crc\n");
+    mpp_err("  -G file   write the frame CRC-32s as a golden list, implies -w crc\n");
+    mpp_err("  -x codec  transcode: encode the decoded frames in place to h264 or h265\n");
+    mpp_err("            and write that stream to output_file; frames are dropped, or\n");
+    mpp_err("            checksummed with -w crc\n");
+    mpp_err("  -M mode   transcode rate control: cbr (default), vbr or fixqp\n");
+    mpp_err("  -b kbps   cbr and vbr target bit rate, 0 = from the picture size (default 0)\n");
+    mpp_err("  -Q qp     fixqp quantizer (default %d)\n", TRANSCODE_DEFAULT_QP);
+    mpp_err("  -k gop    frames between IDR frames, 0 = first only (default %d)\n",
+            TRANSCODE_DEFAULT_GOP);
+    mpp_err("  -P n      cut the input at IDR frames into n segments (at most %d) and\n",
+            SPLIT_MAX_SEGMENTS);
+    mpp_err("            decode them on n decoders at once, output joined in order; the\n");
+    mpp_err("            keyframe index is kept in input_file%s. With -c, also run the\n",
+            STREAM_INDEX_SUFFIX);
+    mpp_err("            sequential decode and report the time saved\n");
+}
+
+int main(int argc, char **argv)
+{
+    MPP_RET ret = MPP_OK;
+    VpuDecConfig cfg;
+    RK_U32 compare = 0;
+    RK_U32 streams = 0, threads = SERVER_DEFAULT_THREADS, ramp = 0;
+    RK_U32 segments = 0;
+    double fps = 0, base_fps = 0;
+    RkTraceHist latency, base_latency;
+    const char *golden_file = NULL;
+    RkCrcList golden;
+    RkDmaBudget budget;
+    RK_U32 budget_mb = 0;
+    const char *output;
+    RK_U32 inputs, outputs;
+    int opt;
+
+    cfg.type = MPP_VIDEO_CodingAVC;  // H.264 decoder
+    cfg.depth = DEFAULT_DEPTH;
+    cfg.input_mode = STREAM_SRC_READ;
+    cfg.au_mode = 0;
+    cfg.low_latency = 0;
+    cfg.fps = DEFAULT_FPS;
+    cfg.pace_fps = 0;
+    cfg.pace_pts = 0;
+    cfg.high_water = 0;
+    cfg.output_mode = YUV_WRITER_THREAD;
+    cfg.output_depth = YUV_WRITER_DEPTH;
+    cfg.output_format = YUV_OUT_NV12;
+    memset(&cfg.fbc_roi, 0, sizeof(cfg.fbc_roi));
+    cfg.tiled = 0;
+    cfg.export_frames = 0;
+    cfg.csc = 0;
+    memset(&cfg.csc_cfg, 0, sizeof(cfg.csc_cfg));
+    cfg.csc_cfg.standard = CSC_BT709;
+    cfg.csc_cfg.workers = CSC_DEFAULT_WORKERS;
+    cfg.ext_buffers = 0;
+    cfg.frame_reserve = RK_FRAME_POOL_RESERVE;
+    cfg.trace_file = NULL;
+    cfg.fps_interval = DEFAULT_FPS_INTERVAL;
+    cfg.trace_id = 0;
+    cfg.golden = NULL;
+    cfg.golden_out = NULL;
+    cfg.transcode = 0;
+    cfg.enc.type = MPP_VIDEO_CodingAVC;
+    cfg.enc.rc_mode = MPP_ENC_RC_MODE_CBR;
+    cfg.enc.bps = 0;
+    cfg.enc.qp = TRANSCODE_DEFAULT_QP;
+    cfg.enc.gop = TRANSCODE_DEFAULT_GOP;
+    cfg.range = NULL;
+    cfg.budget = NULL;
+
+    while ((opt = getopt(argc, argv,
+                         "d:ci:t:aLf:S:H:B:w:q:o:C:DEm:s:j:er:n:p:RT:v:g:G:x:M:b:Q:k:P:")) != -1) {
+        switch (opt) {
+        case 'd':
+            cfg.depth = atoi(optarg);
+            if (cfg.depth > MAX_DEPTH)
+                cfg.depth = MAX_DEPTH;
+            break;
+        case 'c':
+            compare = 1;
+            break;
+        case 'i':
+            if (!strcmp(optarg, "mmap"))
+                cfg.input_mode = STREAM_SRC_MMAP;
+            else if (!strcmp(optarg, "dmabuf"))
+                cfg.input_mode = STREAM_SRC_DMABUF;
+            else
+                cfg.input_mode = STREAM_SRC_READ;
+            break;
+        case 't':
+            if (!strcmp(optarg, "h265") || !strcmp(optarg, "hevc"))
+                cfg.type = MPP_VIDEO_CodingHEVC;
+            else
+                cfg.type = MPP_VIDEO_CodingAVC;
+            break;
+        case 'a':
+            cfg.au_mode = 1;
+            break;
+        case 'L':
+            cfg.low_latency = 1;
+            break;
+        case 'f':
+            cfg.fps = atoi(optarg);
+            if (!cfg.fps)
+                cfg.fps = DEFAULT_FPS;
+            break;
+        case 'S':
+            if (!strcmp(optarg, "pts")) {
+                cfg.pace_pts = 1;
+            } else {
+                cfg.pace_fps = atoi(optarg);
+                if (!cfg.pace_fps) {
+                    usage(argv[0]);
+                    return 1;
+                }
+            }
+            break;
+        case 'H':
+            cfg.high_water = atoi(optarg);
+            break;
+        case 'B':
+            budget_mb = atoi(optarg);
+            if (!budget_mb) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'w':
+            if (!strcmp(optarg, "sync"))
+                cfg.output_mode = YUV_WRITER_SYNC;
+            else if (!strcmp(optarg, "direct"))
+                cfg.output_mode = YUV_WRITER_DIRECT;
+            else if (!strcmp(optarg, "uring"))
+                cfg.output_mode = YUV_WRITER_URING;
+            else if (!strcmp(optarg, "null"))
+                cfg.output_mode = YUV_WRITER_NULL;
+            else if (!strcmp(optarg, "crc"))
+                cfg.output_mode = YUV_WRITER_CRC;
+            else
+                cfg.output_mode = YUV_WRITER_THREAD;
+            break;
+        case 'q':
+            cfg.output_depth = atoi(optarg);
+            break;
+        case 'o':
+            cfg.csc = !strcmp(optarg, "rgb24") || !strcmp(optarg, "bgra");
+            cfg.csc_cfg.format = strcmp(optarg, "bgra") ? CSC_RGB24 : CSC_BGRA;
+            if (!strcmp(optarg, "raw"))
+                cfg.output_format = YUV_OUT_RAW;
+            else if (!strcmp(optarg, "i420"))
+                cfg.output_format = YUV_OUT_I420;
+            else if (!strcmp(optarg, "fbc"))
+                cfg.output_format = YUV_OUT_FBC;
+            else if (!strcmp(optarg, "p010"))
+                cfg.output_format = YUV_OUT_P010;
+            else
+                cfg.output_format = YUV_OUT_NV12;
+            break;
+        case 'C':
+            if (sscanf(optarg, "%u,%u,%u,%u", &cfg.fbc_roi.x, &cfg.fbc_roi.y,
+                       &cfg.fbc_roi.width, &cfg.fbc_roi.height) != 4 ||
+                !cfg.fbc_roi.width || !cfg.fbc_roi.height) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'D':
+            cfg.tiled = 1;
+            break;
+        case 'E':
+            cfg.export_frames = 1;
+            break;
+        case 'm':
+            cfg.csc_cfg.standard = strncmp(optarg, "bt601", 5) ? CSC_BT709 : CSC_BT601;
+            cfg.csc_cfg.full_range = strstr(optarg, "full") != NULL;
+            break;
+        case 's':
+            if (sscanf(optarg, "%ux%u", &cfg.csc_cfg.dst_width, &cfg.csc_cfg.dst_height) != 2 ||
+                !cfg.csc_cfg.dst_width || !cfg.csc_cfg.dst_height) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'j':
+            cfg.csc_cfg.workers = atoi(optarg);
+            break;
+        case 'e':
+            cfg.ext_buffers = 1;
+            break;
+        case 'r':
+            cfg.frame_reserve = atoi(optarg);
+            break;
+        case 'n':
+            streams = atoi(optarg);
+            if (streams > SERVER_MAX_STREAMS)
+                streams = SERVER_MAX_STREAMS;
+            break;
+        case 'p':
+            threads = atoi(optarg);
+            break;
+        case 'R':
+            ramp = 1;
+            break;
+        case 'T':
+            cfg.trace_file = optarg;
+            break;
+        case 'v':
+            cfg.fps_interval = atof(optarg);
+            break;
+        case 'g':
+            golden_file = optarg;
+            cfg.output_mode = YUV_WRITER_CRC;
+            break;
+        case 'G':
+            cfg.golden_out = optarg;
+            cfg.output_mode = YUV_WRITER_CRC;
+            break;
+        case 'x':
+            cfg.transcode = 1;
+            if (!strcmp(optarg, "h265") || !strcmp(optarg, "hevc"))
+                cfg.enc.type = MPP_VIDEO_CodingHEVC;
+            else
+                cfg.enc.type = MPP_VIDEO_CodingAVC;
+            break;
+        case 'M':
+            if (!strcmp(optarg, "vbr"))
+                cfg.enc.rc_mode = MPP_ENC_RC_MODE_VBR;
+            else if (!strcmp(optarg, "fixqp"))
+                cfg.enc.rc_mode = MPP_ENC_RC_MODE_FIXQP;
+            else
+                cfg.enc.rc_mode = MPP_ENC_RC_MODE_CBR;
+            break;
+        case 'b':
+            cfg.enc.bps = atoi(optarg) * 1000;
+            break;
+        case 'Q':
+            cfg.enc.qp = atoi(optarg);
+            if (cfg.enc.qp > 51)
+                cfg.enc.qp = 51;
+            break;
+        case 'k':
+            cfg.enc.gop = atoi(optarg);
+            break;
+        case 'P':
+            segments = atoi(optarg);
+            if (segments > SPLIT_MAX_SEGMENTS)
+                segments = SPLIT_MAX_SEGMENTS;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // One packet at a time at least, and frames only pair with packets by PTS
+    if (cfg.low_latency) {
+        cfg.au_mode = 1;
+        if (!cfg.depth)
+            cfg.depth = 1;
+    }
+    // Pacing goes by access unit, and only buffers of ours count to a budget
+    if (cfg.pace_fps || cfg.pace_pts)
+        cfg.au_mode = 1;
+    if (budget_mb)
+        cfg.ext_buffers = 1;
+    memset(&latency, 0, sizeof(latency));
+    memset(&base_latency, 0, sizeof(base_latency));
+
+    // The encoded stream replaces the YUV file
+    cfg.enc.fps = cfg.fps;
+    if ((cfg.transcode || cfg.export_frames) && rk_yuv_writer_has_file(cfg.output_mode))
+        cfg.output_mode = YUV_WRITER_NULL;
+
+    // Decode-only modes have no output file argument
+    outputs = cfg.transcode || cfg.export_frames || rk_yuv_writer_has_file(cfg.output_mode);
+    inputs = argc - optind > outputs ? argc - optind - outputs : 0;
+    output = outputs ? argv[argc - 1] : "/dev/null";
+    if (!inputs || (!streams && inputs != 1)) {
+        usage(argv[0]);
+        return 1;
+    }
+    // Checksums, colour conversion and the encoder all read linear NV12
+    if (cfg.output_format == YUV_OUT_FBC &&
+        (cfg.csc || cfg.transcode || cfg.output_mode == YUV_WRITER_CRC)) {
+        mpp_err("-o fbc does not combine with rgb output, -x or crc checks\n");
+        return 1;
+    }
+    if (cfg.fbc_roi.width && cfg.output_format != YUV_OUT_FBC) {
+        mpp_err("-C needs -o fbc\n");
+        return 1;
+    }
+    if (cfg.tiled && (cfg.output_format == YUV_OUT_FBC || cfg.csc || cfg.transcode)) {
+        mpp_err("-D does not combine with -o fbc, rgb output or -x\n");
+        return 1;
+    }
+    // One consumer per run, taking the decoder's frames as they are
+    if (cfg.export_frames && (cfg.transcode || cfg.csc || streams || segments > 1 || compare)) {
+        mpp_err("-E does not combine with -x, rgb output, -n, -P or -c\n");
+        return 1;
+    }
+    // Segments are an offline job on one file
+    if (segments > 1 && (streams || cfg.low_latency)) {
+        mpp_err("-P does not combine with -n or -L\n");
+        return 1;
+    }
+    // Real-time mode keeps its own clock
+    if ((cfg.pace_fps || cfg.pace_pts) && cfg.low_latency) {
+        mpp_err("-S does not combine with -L\n");
+        return 1;
+    }
+
+    rk_crc_list_init(&golden);
+    if (golden_file) {
+        if (rk_crc_list_load(&golden, golden_file))
+            return 1;
+        cfg.golden = &golden;
+    }
+    // Every stream or segment gets an even share of the budget
+    if (budget_mb) {
+        rk_dma_budget_init(&budget, (size_t)budget_mb * SZ_1M,
+                           streams ? streams : segments > 1 ? segments : 1);
+        cfg.budget = &budget;
+    }
+
+    if (streams) {
+        double fairness;
+
+        if (ramp)
+            ret = ramp_streams(&argv[optind], inputs, output, &cfg, streams, threads);
+        else
+            ret = run_streams(&argv[optind], inputs, output, &cfg, streams, threads, 1,
+                              &fps, &fairness);
+        goto OUT;
+    }
+
+    if (segments > 1) {
+        if (compare) {
+            // The sequential run is the only decoder, it gets the whole budget
+            if (cfg.budget)
+                rk_dma_budget_set_users(cfg.budget, 1);
+            ret = run_decode(argv[optind], output, &cfg, &base_fps, NULL);
+            if (cfg.budget)
+                rk_dma_budget_set_users(cfg.budget, segments);
+            if (ret)
+                goto OUT;
+        }
+        ret = run_split(argv[optind], output, &cfg, segments, &fps);
+        if (!ret && compare && base_fps > 0 && fps > 0)
+            mpp_log("%d segments vs sequential: %.1f -> %.1f fps, %.2fx %s\n",
+                    segments, base_fps, fps, fps >= base_fps ? fps / base_fps : base_fps / fps,
+                    fps >= base_fps ? "faster" : "slower");
+        goto OUT;
+    }
+
+    // Real-time mode compares against the file pipeline, otherwise the
+    // pipeline against the lock-step loop
+    if (compare && (cfg.depth || cfg.low_latency)) {
+        VpuDecConfig base = cfg;
+
+        if (cfg.low_latency)
+            base.low_latency = 0;
+        else
+            base.depth = 0;
+        ret = run_decode(argv[optind], output, &base, &base_fps, &base_latency);
+        if (ret)
+            goto OUT;
+    }
+
+    ret = run_decode(argv[optind], output, &cfg, &fps, &latency);
+
+    if (compare && cfg.low_latency && base_latency.count && latency.count)
+        mpp_log("real-time vs file pipeline: submit to frame p50 %.2f -> %.2f ms, "
+                "p99 %.2f -> %.2f ms, max %.2f -> %.2f ms\n",
+                rk_trace_percentile(&base_latency, 0.50) / 1000,
+                rk_trace_percentile(&latency, 0.50) / 1000,
+                rk_trace_percentile(&base_latency, 0.99) / 1000,
+                rk_trace_percentile(&latency, 0.99) / 1000,
+                base_latency.max / 1000, latency.max / 1000);
+    else if (compare && cfg.depth && base_fps > 0)
+        mpp_log("depth %d vs lock-step: %.1f -> %.1f fps (%+.1f%%)\n",
+                cfg.depth, base_fps, fps, (fps / base_fps - 1) * 100);
+
+OUT:
+    if (cfg.budget) {
+        mpp_log("DMA budget: peak %.1f of %d MB reserved, %d frame pools cut to fit, "
+                "%d waited for a release, %d reservations refused\n",
+                budget.peak / (double)SZ_1M, budget_mb, budget.trimmed, budget.waited,
+                budget.refused);
+        rk_dma_budget_deinit(&budget);
+    }
+    rk_crc_list_deinit(&golden);
+    return ret;
+}
@@ -3,10 +3,19 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include <rockchip/rk_mpi.h>
 #include <rockchip/mpp_buffer.h>
 #include <rockchip/mpp_frame.h>
 #include <rockchip/mpp_packet.h>
+#include "rk_pkt_pool.h"
+#include "rk_stream_src.h"
+#include "rk_yuv_writer.h"
+#include "rk_frame_pool.h"
+#include "rk_vpu_trace.h"
+#include "rk_vpu_transcode.h"
+#include "rk_frame_export.h"
+#include "rk_dma_budget.h"
 
 // Maximum frame width and height
 #define MAX_FRAME_WIDTH   3840
@@ -18,46 +27,163 @@
 
 // Buffer size for reading input stream
 #define READ_BUF_SIZE                   (SZ_1M)
+// One access unit per packet in AU mode: room for a 4K intra frame
+#define AU_BUF_SIZE                     (4 * SZ_1M)
+#define DEFAULT_FPS                     30
 #define MAX_FRAMES        300
 
+// Packets kept queued in the decoder by the feeder thread
+#define DEFAULT_DEPTH     4
+#define MAX_DEPTH         16
+#define MAX_HELD_TASKS    64
+
+// Poll timeout while waiting on the other thread, ms
+#define POLL_TIMEOUT_MS   100
+// Feeder recheck while held back by the frames downstream, ms
+#define THROTTLE_POLL_MS  2
+
+// Seconds between rolling fps lines
+#define DEFAULT_FPS_INTERVAL    1
+
+typedef struct {
+    MppCodingType   type;
+    RK_U32          depth;          // 0 = lock-step loop on the calling thread
+    RkStreamSrcMode input_mode;
+    RK_U32          au_mode;        // one access unit per packet, with PTS
+    RK_U32          low_latency;    // live input: immediate output, AUs fed at fps
+    RK_U32          fps;            // PTS step in AU mode
+    RK_U32          pace_fps;       // feed AUs at this rate, 0 = as fast as they decode
+    RK_U32          pace_pts;       // feed AUs at their PTS
+    RK_U32          high_water;     // frames downstream that stop the feeder, 0 = no limit
+    RkYuvWriterMode output_mode;
+    RkYuvOutFormat  output_format;
+    RkFbcRect       fbc_roi;        // fbc output: only this region, width 0 = whole frames
+    RK_U32          tiled;          // decoder writes tiled frames, detiled on output
+    RK_U32          output_depth;   // frames queued to the writer
+    RK_U32          csc;            // write RGB converted by csc_cfg
+    RkCscConfig     csc_cfg;
+    RK_U32          ext_buffers;    // frame buffers preallocated at info change
+    RK_U32          frame_reserve;  // spare frames on top of what the stream needs
+    const char     *trace_file;     // Chrome trace JSON written at the end
+    double          fps_interval;   // rolling fps line every so many seconds, 0 = off
+    RK_U32          trace_id;       // stream index in logs and the trace
+    const RkCrcList *golden;        // expected frame checksums, crc output only
+    const char     *golden_out;     // write the checksums here, crc output only
+    RK_U32          transcode;      // re-encode frames to output_file instead of writing YUV
+    RkTranscodeConfig enc;
+    RK_U32          export_frames;  // lend frame buffers to the consumer on output_file
+    const RkStreamRange *range;     // decode only this part of the input, NULL = all
+    RkDmaBudget    *budget;         // DMA cap shared by all decoders, NULL = none
+} VpuDecConfig;
+
 typedef struct {
-    // Input/output file handles
-    FILE            *fp_input;
-    FILE            *fp_output;
+    // Input stream and output file
+    RkStreamSrc     src;
+    RkYuvWriter     writer;
+    RkYuvConverter  csc;
+    RK_U32          csc_ready;
     
     // MPP contexts
     MppCtx          ctx;
     MppApi         *mpi;
     
-    // Packet for input data
-    MppPacket       packet;
-    // Frame for decoded data
-    MppFrame        frame;
+    VpuDecConfig    cfg;
     
-    // Buffer group for decoder
-    MppBufferGroup  frm_grp;
-    MppBuffer       pkt_buf;
-    MppBuffer       frm_buf;
+    // Frame buffers, sized per sequence when cfg.ext_buffers is set
+    RkFramePool     frm_pool;
+    RK_U32          frm_pool_ready;
+    RK_U32          frm_pool_attached;
+    RK_U32          dpb;
+
+    // Packet buffers, refilled only after the decoder releases them
+    RkPktPool       pkt_pool;
     
     // Frame counter
     RK_U32          frame_count;
     // Frame size
     RK_U32          frame_size;
+    RkYuvLayout     layout;
     
     // Parameters
     RK_U32          width;
     RK_U32          height;
     MppCodingType   type;
     
-    // Buffer for reading input stream
-    char           *buf;
+    // Size of each input read
     size_t          buf_size;
     size_t          packet_size;
+
+    // Pipeline state
+    RK_U32          inflight;       // packets owned by the decoder, feeder side
+    RK_U64          released;       // release notifications received
+    MppTask         held[MAX_HELD_TASKS];   // idle input tasks taken back
+    RK_U32          held_count;
+    RK_U32          pkt_eos;        // EOS packet queued
+    RK_U32          frm_eos;        // EOS frame collected
+    volatile RK_U32 abort;          // one side failed, the other stops
+    RK_U32          packet_count;
+    double          feed_wait;      // seconds blocked waiting for an input task
+    double          collect_wait;   // seconds blocked waiting for a frame
+    double          elapsed;
+
+    // First-frame latency, at stream start and after each info change
+    double          first_packet;
+    double          first_frame;    // seconds after first_packet
+    double          info_time;
+    RK_U32          info_pending;   // no frame since the last info change yet
+    RK_U32          info_changes;
+    double          info_latency_sum;
+    double          info_latency_max;
+
+    // Real-time and paced modes: packets queued after their time came due
+    double          due;            // when the next packet is due, 0 = now
+    double          pace_start;     // first packet queued, paced by PTS from here
+    RK_S64          pace_pts0;
+    RK_U32          late_packets;   // more than one interval behind
+    double          max_lag;
+
+    // Feeder held back while cfg.high_water frames are downstream
+    RK_U32          throttled;
+    RK_U32          throttles;
+    double          throttle_start;
+    double          throttle_time;
+    RK_U32          peak_downstream;
+
+    // Bytes reserved in cfg.budget
+    size_t          pkt_reserved;
+    size_t          frm_reserved;
+    // A new sequence's frame pool waiting for the budget, info change not answered yet
+    RK_U32          budget_wait;
+    size_t          budget_buf_size;
+    double          budget_wait_start;
+
+    // Per-stage latency and the timeline for the trace file
+    RkVpuTrace      trace;
+
+    // Frame checksums in crc output mode
+    RkCrcList       crcs;
+
+    // Encoder fed with the decoded frames in transcode mode
+    RkTranscoder    enc;
+    RK_U32          enc_ready;
+
+    // Frame buffers lent to another process in export mode
+    RkFrameExport   exp;
+    RK_U32          exp_ready;
+    double          cpu_time;       // CPU seconds spent on this stream
 } VpuDecContext;
 
 // Function declarations
-MPP_RET init_vpu_decoder(VpuDecContext *ctx, const char *input_file, const char *output_file);
+MPP_RET init_vpu_decoder(VpuDecContext *ctx, const char *input_file, const char *output_file,
+                         const VpuDecConfig *cfg);
+MPP_RET feed_packet(VpuDecContext *ctx, MppPollType timeout);
+MPP_RET collect_frame(VpuDecContext *ctx, MppPollType timeout);
 MPP_RET decode_frames(VpuDecContext *ctx);
+MPP_RET step_decoder(VpuDecContext *ctx, RK_U32 budget, RK_U32 *progress);
+RK_U32 decoder_finished(const VpuDecContext *ctx);
+MPP_RET check_frame_crcs(VpuDecContext *ctx);
+void print_transcode_stats(VpuDecContext *ctx, double elapsed, double cpu);
+void release_decoder_buffers(VpuDecContext *ctx);
 void deinit_vpu_decoder(VpuDecContext *ctx);
 
 #endif // RK_VPU_DEMO_H
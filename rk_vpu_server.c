@@ -0,0 +1,268 @@
+#include "rk_vpu_server.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double get_cpu_seconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// "%d" in the output path takes the stream index, otherwise ".N" is appended
+static void stream_output_path(char *path, const char *output, RK_U32 index)
+{
+    if (strstr(output, "%d"))
+        snprintf(path, SERVER_PATH_MAX, output, index);
+    else if (!strncmp(output, "/dev/", 5))
+        snprintf(path, SERVER_PATH_MAX, "%s", output);
+    else
+        snprintf(path, SERVER_PATH_MAX, "%s.%u", output, index);
+}
+
+/*
+ * count decoders over inputs, reused round robin when there are fewer
+ * inputs than streams. The feeder depth must be at least one: the server
+ * never blocks on a single stream.
+ */
+MPP_RET rk_vpu_server_init(RkVpuServer *srv, RK_U32 count, RK_U32 threads,
+                           char **inputs, RK_U32 input_count, const char *output,
+                           const VpuDecConfig *cfg)
+{
+    VpuDecConfig stream_cfg = *cfg;
+    MPP_RET ret = MPP_OK;
+    RK_U32 i;
+
+    if (!count || count > SERVER_MAX_STREAMS || !input_count)
+        return MPP_ERR_VALUE;
+
+    memset(srv, 0, sizeof(RkVpuServer));
+    srv->streams = calloc(count, sizeof(RkVpuStream));
+    if (!srv->streams)
+        return MPP_ERR_MALLOC;
+
+    pthread_mutex_init(&srv->lock, NULL);
+    srv->threads = threads ? threads : SERVER_DEFAULT_THREADS;
+    if (srv->threads > SERVER_MAX_THREADS)
+        srv->threads = SERVER_MAX_THREADS;
+    if (srv->threads > count)
+        srv->threads = count;
+    if (!stream_cfg.depth)
+        stream_cfg.depth = DEFAULT_DEPTH;
+    // One aggregate fps line instead of a line per stream
+    srv->fps_interval = cfg->fps_interval;
+    stream_cfg.fps_interval = 0;
+
+    for (i = 0; i < count; i++) {
+        RkVpuStream *s = &srv->streams[i];
+
+        s->index = i;
+        stream_cfg.trace_id = i;
+        // Every stream is checked against the golden list, one writes it
+        stream_cfg.golden_out = i ? NULL : cfg->golden_out;
+        stream_output_path(s->output, output, i);
+        ret = init_vpu_decoder(&s->dec, inputs[i % input_count], s->output, &stream_cfg);
+        if (ret) {
+            mpp_err("Failed to initialize stream %d\n", i);
+            goto ERR_RET;
+        }
+        srv->count++;
+    }
+    return MPP_OK;
+
+ERR_RET:
+    rk_vpu_server_deinit(srv);
+    return ret;
+}
+
+// Caller holds srv->lock
+static void queue_push(RkVpuServer *srv, RK_U32 index)
+{
+    srv->queue[(srv->head + srv->queued) % SERVER_MAX_STREAMS] = index;
+    srv->queued++;
+}
+
+// Caller holds srv->lock; -1 when every queued stream is taken by a worker
+static int queue_pop(RkVpuServer *srv)
+{
+    RK_U32 index;
+
+    if (!srv->queued)
+        return -1;
+    index = srv->queue[srv->head];
+    srv->head = (srv->head + 1) % SERVER_MAX_STREAMS;
+    srv->queued--;
+    return index;
+}
+
+// Stream is fully decoded or failed: drain its encoder and writer and record the end
+static void finish_stream(RkVpuServer *srv, RkVpuStream *s)
+{
+    if (s->dec.enc_ready) {
+        if (rk_transcoder_finish(&s->dec.enc) && !s->ret)
+            s->ret = MPP_NOK;
+        // The encoder's packet thread works for this stream only
+        s->dec.cpu_time += s->dec.enc.cpu_time;
+    }
+    if (rk_yuv_writer_close(&s->dec.writer) && !s->ret)
+        s->ret = MPP_NOK;
+    // Its DMA buffers go back now for streams waiting on the budget
+    if (!s->dec.enc_ready || !rk_transcoder_queued(&s->dec.enc))
+        release_decoder_buffers(&s->dec);
+    s->end = get_time_in_seconds() - srv->start;
+    s->dec.elapsed = s->end;
+    s->done = 1;
+}
+
+static void *server_worker(void *arg)
+{
+    RkVpuServer *srv = (RkVpuServer *)arg;
+
+    pthread_mutex_lock(&srv->lock);
+    while (srv->active) {
+        RkVpuStream *s;
+        RK_U32 frames, progress = 0;
+        double now, cpu;
+        int index = queue_pop(srv);
+
+        // Fewer queued streams than workers: wait for one to come back
+        if (index < 0) {
+            pthread_mutex_unlock(&srv->lock);
+            usleep(SERVER_IDLE_US);
+            pthread_mutex_lock(&srv->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&srv->lock);
+
+        s = &srv->streams[index];
+        frames = s->dec.frame_count;
+        // Workers are shared, so a stream's CPU is the sum of its steps
+        cpu = get_cpu_seconds(CLOCK_THREAD_CPUTIME_ID);
+        s->ret = step_decoder(&s->dec, SERVER_STEP_BUDGET, &progress);
+        s->dec.cpu_time += get_cpu_seconds(CLOCK_THREAD_CPUTIME_ID) - cpu;
+        if (s->ret)
+            mpp_err("stream %d failed %d\n", s->index, s->ret);
+
+        now = get_time_in_seconds() - srv->start;
+        if (s->dec.frame_count != frames) {
+            if (now - s->last_frame > s->max_gap)
+                s->max_gap = now - s->last_frame;
+            s->last_frame = now;
+        }
+        s->visits++;
+        if (!progress)
+            s->idle_visits++;
+
+        if (s->ret || decoder_finished(&s->dec))
+            finish_stream(srv, s);
+
+        pthread_mutex_lock(&srv->lock);
+        srv->window_frames += s->dec.frame_count - frames;
+        if (srv->fps_interval > 0 && now - srv->window_start >= srv->fps_interval) {
+            mpp_log("%d streams: %.1f fps aggregate over %.2f s, %d active\n", srv->count,
+                    srv->window_frames / (now - srv->window_start), now - srv->window_start,
+                    srv->active);
+            srv->window_start = now;
+            srv->window_frames = 0;
+        }
+        if (s->done) {
+            srv->active--;
+        } else {
+            queue_push(srv, index);
+        }
+
+        // A full pass over the queue found nothing ready: back off briefly
+        srv->idle_streak = progress ? 0 : srv->idle_streak + 1;
+        if (srv->idle_streak >= srv->active && srv->active) {
+            srv->idle_streak = 0;
+            srv->idle_sleeps++;
+            pthread_mutex_unlock(&srv->lock);
+            usleep(SERVER_IDLE_US);
+            pthread_mutex_lock(&srv->lock);
+        }
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return NULL;
+}
+
+MPP_RET rk_vpu_server_run(RkVpuServer *srv)
+{
+    MPP_RET ret = MPP_OK;
+    RK_U32 i, started = 0;
+    double cpu;
+
+    srv->start = get_time_in_seconds();
+    cpu = get_cpu_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    for (i = 0; i < srv->count; i++)
+        queue_push(srv, i);
+    srv->active = srv->count;
+
+    for (i = 0; i < srv->threads; i++) {
+        if (pthread_create(&srv->workers[i], NULL, server_worker, srv)) {
+            mpp_err("Failed to create server thread %d\n", i);
+            break;
+        }
+        started++;
+    }
+    // Any one worker drives every stream to the end, only slower
+    if (!started)
+        return MPP_NOK;
+
+    for (i = 0; i < started; i++)
+        pthread_join(srv->workers[i], NULL);
+    srv->elapsed = get_time_in_seconds() - srv->start;
+    srv->cpu_time = get_cpu_seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+    for (i = 0; i < srv->count; i++) {
+        if (srv->streams[i].ret)
+            ret = MPP_NOK;
+    }
+    return ret;
+}
+
+void rk_vpu_server_deinit(RkVpuServer *srv)
+{
+    RK_U32 i;
+
+    for (i = 0; i < srv->count; i++)
+        deinit_vpu_decoder(&srv->streams[i].dec);
+    free(srv->streams);
+    srv->streams = NULL;
+    srv->count = 0;
+    pthread_mutex_destroy(&srv->lock);
+}
+
+RK_U64 rk_vpu_server_frames(const RkVpuServer *srv)
+{
+    RK_U64 frames = 0;
+    RK_U32 i;
+
+    for (i = 0; i < srv->count; i++)
+        frames += srv->streams[i].dec.frame_count;
+    return frames;
+}
+
+// Jain's index over per-stream fps: 1.0 when every stream got the same rate
+double rk_vpu_server_fairness(const RkVpuServer *srv)
+{
+    double sum = 0, sum_sq = 0;
+    RK_U32 i;
+
+    for (i = 0; i < srv->count; i++) {
+        const RkVpuStream *s = &srv->streams[i];
+        double fps = s->end > 0 ? s->dec.frame_count / s->end : 0;
+
+        sum += fps;
+        sum_sq += fps * fps;
+    }
+    return sum_sq > 0 ? sum * sum / (srv->count * sum_sq) : 0;
+}
@@ -0,0 +1,71 @@
+#ifndef RK_VPU_SERVER_H
+#define RK_VPU_SERVER_H
+
+#include <pthread.h>
+#include "rk_vpu_demo.h"
+
+#define SERVER_MAX_STREAMS      32
+#define SERVER_MAX_THREADS      8
+#define SERVER_DEFAULT_THREADS  2
+// Packets in and frames out per visit, so no stream hogs a thread
+#define SERVER_STEP_BUDGET      4
+// Sleep once a whole pass over the run queue found nothing to do, us
+#define SERVER_IDLE_US          200
+#define SERVER_PATH_MAX         256
+// Ramp: doubling the streams gains less than this, the decoder is saturated
+#define SERVER_SATURATION       0.10
+
+typedef struct {
+    VpuDecContext   dec;
+    RK_U32          index;
+    char            output[SERVER_PATH_MAX];
+    RK_U32          done;
+    MPP_RET         ret;
+
+    // Statistics
+    double          end;                // seconds after the server start
+    double          last_frame;
+    double          max_gap;            // longest wait between two frames
+    RK_U64          visits;
+    RK_U64          idle_visits;
+} RkVpuStream;
+
+/*
+ * N decoders in one process. Streams wait in a FIFO run queue; each worker
+ * thread takes the head, gives it one bounded non-blocking step and puts it
+ * back at the tail, so every stream is visited in turn whatever its rate.
+ */
+typedef struct {
+    RkVpuStream    *streams;
+    RK_U32          count;
+    RK_U32          threads;
+    pthread_t       workers[SERVER_MAX_THREADS];
+
+    pthread_mutex_t lock;
+    RK_U32          queue[SERVER_MAX_STREAMS];
+    RK_U32          head;
+    RK_U32          queued;
+    RK_U32          active;             // streams not finished yet
+    RK_U32          idle_streak;        // visits in a row without progress
+
+    double          start;
+    double          elapsed;
+    double          cpu_time;           // process CPU seconds over the run
+    RK_U64          idle_sleeps;
+
+    // Rolling aggregate fps, under lock
+    double          fps_interval;
+    double          window_start;       // seconds after start
+    RK_U32          window_frames;
+} RkVpuServer;
+
+// Function declarations
+MPP_RET rk_vpu_server_init(RkVpuServer *srv, RK_U32 count, RK_U32 threads,
+                           char **inputs, RK_U32 input_count, const char *output,
+                           const VpuDecConfig *cfg);
+MPP_RET rk_vpu_server_run(RkVpuServer *srv);
+void rk_vpu_server_deinit(RkVpuServer *srv);
+RK_U64 rk_vpu_server_frames(const RkVpuServer *srv);
+double rk_vpu_server_fairness(const RkVpuServer *srv);
+
+#endif // RK_VPU_SERVER_H
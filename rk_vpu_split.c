@@ -0,0 +1,253 @@
+#include "rk_vpu_split.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double get_process_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/*
+ * Index the input, cut it into up to count segments and set up a decoder
+ * for each. The frame checksums are compared once, over the joined list,
+ * so the segments get no golden list of their own.
+ */
+MPP_RET rk_vpu_split_init(RkVpuSplit *sp, const char *input, const char *output,
+                          const VpuDecConfig *cfg, RK_U32 count)
+{
+    RkStreamRange ranges[SPLIT_MAX_SEGMENTS];
+    VpuDecConfig seg_cfg = *cfg;
+    MPP_RET ret = MPP_OK;
+    RK_U32 n, i;
+
+    if (!count || count > SPLIT_MAX_SEGMENTS)
+        return MPP_ERR_VALUE;
+
+    memset(sp, 0, sizeof(RkVpuSplit));
+    sp->output = output;
+    sp->cfg = *cfg;
+    sp->parts = cfg->transcode || rk_yuv_writer_has_file(cfg->output_mode);
+
+    ret = rk_stream_index_open(&sp->index, input, cfg->type);
+    if (ret) {
+        mpp_err("Failed to index %s\n", input);
+        return ret;
+    }
+
+    n = rk_stream_index_split(&sp->index, count, ranges);
+    if (n < count)
+        mpp_log("Only %d clean random access points to cut at, decoding %d segments\n",
+                n - 1, n);
+
+    sp->segs = calloc(n, sizeof(RkVpuSegment));
+    if (!sp->segs) {
+        ret = MPP_ERR_MALLOC;
+        goto ERR_RET;
+    }
+
+    seg_cfg.golden = NULL;
+    seg_cfg.golden_out = NULL;
+    seg_cfg.fps_interval = 0;
+    for (i = 0; i < n; i++) {
+        RkVpuSegment *s = &sp->segs[i];
+
+        s->index = i;
+        s->range = ranges[i];
+        if (i && sp->parts)
+            snprintf(s->output, SPLIT_PATH_MAX, "%s%s%u", output, SPLIT_PART_SUFFIX, i);
+        else
+            snprintf(s->output, SPLIT_PATH_MAX, "%s", output);
+
+        // The range stays put in the segment, the decoder keeps the pointer
+        seg_cfg.range = &s->range;
+        seg_cfg.trace_id = i;
+        ret = init_vpu_decoder(&s->dec, input, s->output, &seg_cfg);
+        if (ret) {
+            mpp_err("Failed to initialize segment %d\n", i);
+            goto ERR_RET;
+        }
+        sp->count++;
+    }
+    return MPP_OK;
+
+ERR_RET:
+    rk_vpu_split_deinit(sp);
+    return ret;
+}
+
+static void *segment_thread(void *arg)
+{
+    RkVpuSegment *s = (RkVpuSegment *)arg;
+
+    s->ret = decode_frames(&s->dec);
+    if (s->ret)
+        mpp_err("segment %d failed %d\n", s->index, s->ret);
+    // Segments still waiting on the DMA budget need not wait for the join
+    if (!s->dec.enc_ready || !rk_transcoder_queued(&s->dec.enc))
+        release_decoder_buffers(&s->dec);
+    return NULL;
+}
+
+// Append part to the end of out_fd: in the kernel where it can, else by copy
+static MPP_RET append_part(int out_fd, const char *part, RK_U64 *bytes)
+{
+    int fd = open(part, O_RDONLY | O_CLOEXEC);
+    MPP_RET ret = MPP_OK;
+    char *buf = NULL;
+    ssize_t len;
+
+    if (fd < 0) {
+        mpp_err("Failed to open part %s\n", part);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    while ((len = copy_file_range(fd, NULL, out_fd, NULL, SPLIT_JOIN_CHUNK, 0)) > 0)
+        *bytes += len;
+    if (len < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+        buf = malloc(SPLIT_COPY_SIZE);
+        if (!buf) {
+            close(fd);
+            return MPP_ERR_MALLOC;
+        }
+        while ((len = read(fd, buf, SPLIT_COPY_SIZE)) > 0) {
+            if (write(out_fd, buf, len) != len) {
+                len = -1;
+                break;
+            }
+            *bytes += len;
+        }
+    }
+    if (len < 0) {
+        mpp_err("Failed to append %s to the output\n", part);
+        ret = MPP_NOK;
+    }
+
+    free(buf);
+    close(fd);
+    return ret;
+}
+
+// Part files after the output in stream order, removed once appended
+static MPP_RET join_parts(RkVpuSplit *sp)
+{
+    double start = get_time_in_seconds();
+    MPP_RET ret = MPP_OK;
+    RK_U32 i;
+    int fd;
+
+    // Not O_APPEND: copy_file_range refuses such a target
+    fd = open(sp->output, O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || lseek(fd, 0, SEEK_END) < 0) {
+        if (fd >= 0)
+            close(fd);
+        mpp_err("Failed to open %s to join the segments\n", sp->output);
+        return MPP_ERR_OPEN_FILE;
+    }
+    for (i = 1; i < sp->count && !ret; i++)
+        ret = append_part(fd, sp->segs[i].output, &sp->join_bytes);
+    if (close(fd) && !ret)
+        ret = MPP_NOK;
+
+    sp->join_time = get_time_in_seconds() - start;
+    return ret;
+}
+
+// Later segments' checksums after segment 0's, then checked there
+static MPP_RET join_crcs(RkVpuSplit *sp)
+{
+    RkCrcList *all = &sp->segs[0].dec.crcs;
+    RK_U32 i, j;
+
+    for (i = 1; i < sp->count; i++) {
+        RkCrcList *list = &sp->segs[i].dec.crcs;
+
+        for (j = 0; j < list->count; j++) {
+            if (rk_crc_list_add(all, list->crcs[j], list->sizes[j] >> 16,
+                                list->sizes[j] & 0xffff))
+                return MPP_ERR_MALLOC;
+        }
+    }
+    sp->segs[0].dec.cfg.golden = sp->cfg.golden;
+    sp->segs[0].dec.cfg.golden_out = sp->cfg.golden_out;
+    return MPP_OK;
+}
+
+MPP_RET rk_vpu_split_run(RkVpuSplit *sp)
+{
+    MPP_RET ret = MPP_OK;
+    double cpu;
+    RK_U32 i;
+
+    sp->start = get_time_in_seconds();
+    cpu = get_process_cpu_seconds();
+    for (i = 0; i < sp->count; i++) {
+        RkVpuSegment *s = &sp->segs[i];
+
+        if (pthread_create(&s->thread, NULL, segment_thread, s)) {
+            mpp_err("Failed to create segment thread %d\n", i);
+            ret = MPP_NOK;
+            break;
+        }
+        s->started = 1;
+    }
+
+    // Threads that started run to the end; one that did not fails the run
+    for (i = 0; i < sp->count; i++) {
+        RkVpuSegment *s = &sp->segs[i];
+
+        if (!s->started)
+            continue;
+        pthread_join(s->thread, NULL);
+        s->end = s->dec.elapsed;
+        if (s->ret)
+            ret = MPP_NOK;
+    }
+
+    if (!ret && sp->parts)
+        ret = join_parts(sp);
+    if (!ret && sp->segs[0].dec.writer.mode == YUV_WRITER_CRC)
+        ret = join_crcs(sp);
+    if (sp->parts) {
+        for (i = 1; i < sp->count; i++)
+            unlink(sp->segs[i].output);
+    }
+
+    sp->elapsed = get_time_in_seconds() - sp->start;
+    sp->cpu_time = get_process_cpu_seconds() - cpu;
+    return ret;
+}
+
+void rk_vpu_split_deinit(RkVpuSplit *sp)
+{
+    RK_U32 i;
+
+    for (i = 0; i < sp->count; i++)
+        deinit_vpu_decoder(&sp->segs[i].dec);
+    free(sp->segs);
+    sp->segs = NULL;
+    sp->count = 0;
+    rk_stream_index_deinit(&sp->index);
+}
+
+RK_U64 rk_vpu_split_frames(const RkVpuSplit *sp)
+{
+    RK_U64 frames = 0;
+    RK_U32 i;
+
+    for (i = 0; i < sp->count; i++)
+        frames += sp->segs[i].dec.frame_count;
+    return frames;
+}
@@ -0,0 +1,61 @@
+#ifndef RK_VPU_SPLIT_H
+#define RK_VPU_SPLIT_H
+
+#include <pthread.h>
+#include "rk_vpu_demo.h"
+#include "rk_stream_index.h"
+
+#define SPLIT_MAX_SEGMENTS      8
+#define SPLIT_PATH_MAX          256
+// Part file suffix, followed by the segment index
+#define SPLIT_PART_SUFFIX       ".part"
+// Bytes per copy_file_range call joining the parts
+#define SPLIT_JOIN_CHUNK        (64 * SZ_1M)
+// Copy buffer when the kernel cannot join the parts itself
+#define SPLIT_COPY_SIZE         (SZ_1M)
+
+typedef struct {
+    VpuDecContext   dec;
+    RkStreamRange   range;
+    RK_U32          index;
+    char            output[SPLIT_PATH_MAX];     // the output itself for segment 0
+    pthread_t       thread;
+    RK_U32          started;
+    MPP_RET         ret;
+    double          end;                // seconds after the split start
+} RkVpuSegment;
+
+/*
+ * One long recording decoded as up to SPLIT_MAX_SEGMENTS pieces at once,
+ * each on its own decoder context, so the hardware cores work on
+ * different parts of the file. The stream index supplies clean random
+ * access points to cut at; every segment decodes on its own and its
+ * frames come out in display order, so joining the segments' outputs in
+ * stream order gives the display order of the whole stream.
+ *
+ * Segment 0 writes the output file, the others part files appended to it
+ * at the end; checksums are joined the same way.
+ */
+typedef struct {
+    RkVpuSegment   *segs;
+    RK_U32          count;
+    RkStreamIndex   index;
+    const char     *output;
+    RK_U32          parts;              // segments write part files to be joined
+    VpuDecConfig    cfg;
+
+    double          start;
+    double          elapsed;            // first packet to the output joined
+    double          cpu_time;           // process CPU seconds over the run
+    double          join_time;
+    RK_U64          join_bytes;
+} RkVpuSplit;
+
+// Function declarations
+MPP_RET rk_vpu_split_init(RkVpuSplit *sp, const char *input, const char *output,
+                          const VpuDecConfig *cfg, RK_U32 count);
+MPP_RET rk_vpu_split_run(RkVpuSplit *sp);
+void rk_vpu_split_deinit(RkVpuSplit *sp);
+RK_U64 rk_vpu_split_frames(const RkVpuSplit *sp);
+
+#endif // RK_VPU_SPLIT_H
@@ -0,0 +1,305 @@
+#include "rk_vpu_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+
+static const char *stage_names[TRACE_STAGE_NUM] = {
+    "read", "input wait", "decode", "output wait", "write",
+};
+
+static const RkTraceTrack stage_tracks[TRACE_STAGE_NUM] = {
+    TRACE_TRACK_FEED, TRACE_TRACK_FEED, TRACE_TRACK_COLLECT, TRACE_TRACK_COLLECT, TRACE_TRACK_WRITE,
+};
+
+static const char *track_names[TRACE_TRACK_NUM] = { "feeder", "collector", "writer" };
+
+double rk_trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+MPP_RET rk_trace_init(RkVpuTrace *tr, RK_U32 id, RK_U32 record, double interval)
+{
+    RK_U32 i;
+
+    memset(tr, 0, sizeof(RkVpuTrace));
+    tr->id = id;
+    tr->base = rk_trace_now();
+    tr->window_start = tr->base;
+    tr->interval = interval;
+
+    if (record) {
+        for (i = 0; i < TRACE_TRACK_NUM; i++) {
+            tr->tracks[i].events = malloc(TRACE_EVENTS_MAX * sizeof(RkTraceEvent));
+            if (!tr->tracks[i].events) {
+                rk_trace_deinit(tr);
+                return MPP_ERR_MALLOC;
+            }
+        }
+        tr->record = 1;
+    }
+    return MPP_OK;
+}
+
+void rk_trace_deinit(RkVpuTrace *tr)
+{
+    RK_U32 i;
+
+    for (i = 0; i < TRACE_TRACK_NUM; i++) {
+        free(tr->tracks[i].events);
+        tr->tracks[i].events = NULL;
+    }
+    tr->record = 0;
+}
+
+static RK_U32 hist_bucket(double us)
+{
+    RK_U64 v = us > 0 ? (RK_U64)us : 0;
+    RK_U32 e = 0;
+
+    if (v < TRACE_HIST_LINEAR)
+        return v;
+    while (v >> (e + 1))
+        e++;
+    // e >= 4: 8 sub-buckets between 2^e and 2^(e+1)
+    if (e >= 4 + TRACE_HIST_BUCKETS / TRACE_HIST_SUB - 2)
+        return TRACE_HIST_BUCKETS - 1;
+    return TRACE_HIST_LINEAR + (e - 4) * TRACE_HIST_SUB + ((v >> (e - 3)) & (TRACE_HIST_SUB - 1));
+}
+
+// Upper edge of a bucket in us
+static double bucket_limit(RK_U32 b)
+{
+    RK_U32 e, sub;
+
+    if (b < TRACE_HIST_LINEAR)
+        return b + 1;
+    e = (b - TRACE_HIST_LINEAR) / TRACE_HIST_SUB + 4;
+    sub = (b - TRACE_HIST_LINEAR) % TRACE_HIST_SUB;
+    return (double)((RK_U64)(TRACE_HIST_SUB + sub + 1) << (e - 3));
+}
+
+static void record_event(RkVpuTrace *tr, RkTraceStage stage, double start, double end, RK_U32 id)
+{
+    RkTraceEvents *t = &tr->tracks[stage_tracks[stage]];
+
+    if (t->count >= TRACE_EVENTS_MAX) {
+        t->dropped++;
+        return;
+    }
+    t->events[t->count].start = start;
+    t->events[t->count].end = end;
+    t->events[t->count].stage = stage;
+    t->events[t->count].id = id;
+    t->count++;
+}
+
+static void hist_add(RkTraceHist *h, double seconds)
+{
+    double us = seconds * 1e6;
+
+    h->buckets[hist_bucket(us)]++;
+    h->count++;
+    h->sum += us;
+    if (us > h->max)
+        h->max = us;
+}
+
+// Called only from the thread that owns the stage
+void rk_trace_span(RkVpuTrace *tr, RkTraceStage stage, double start, double end)
+{
+    RkTraceHist *h = &tr->hist[stage];
+
+    hist_add(h, end - start);
+    if (tr->record)
+        record_event(tr, stage, start, end, h->count);
+}
+
+// Feeder side: a packet with this PTS went to the decoder at time
+void rk_trace_submit(RkVpuTrace *tr, RK_S64 pts, double time)
+{
+    RK_U32 tail = __atomic_load_n(&tr->ring_tail, __ATOMIC_ACQUIRE);
+    RK_U32 head = tr->ring_head;
+    RkTraceSubmit *s;
+
+    if (head - tail >= TRACE_RING_SIZE) {
+        tr->ring_drops++;
+        return;
+    }
+
+    s = &tr->ring[head % TRACE_RING_SIZE];
+    s->pts = pts;
+    s->time = time;
+    s->id = tr->submits++;
+    __atomic_store_n(&tr->ring_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Collector side: a frame with this PTS is ready. Its packet is the oldest
+ * unmatched submit with the same PTS; reordered frames match out of order.
+ * Submits far behind the head never got a frame (dropped by the decoder)
+ * and are skipped so the ring keeps moving.
+ */
+static void match_submit(RkVpuTrace *tr, RK_S64 pts, double time)
+{
+    RK_U32 head = __atomic_load_n(&tr->ring_head, __ATOMIC_ACQUIRE);
+    RK_U32 tail = tr->ring_tail;
+    RK_U32 i;
+
+    for (i = tail; i != head; i++) {
+        RkTraceSubmit *s = &tr->ring[i % TRACE_RING_SIZE];
+
+        if (tr->matched[i % TRACE_RING_SIZE] || s->pts != pts)
+            continue;
+        tr->matched[i % TRACE_RING_SIZE] = 1;
+        hist_add(&tr->hist[TRACE_DECODE], time - s->time);
+        if (tr->record)
+            record_event(tr, TRACE_DECODE, s->time, time, s->id);
+        break;
+    }
+
+    while (tail != head && (tr->matched[tail % TRACE_RING_SIZE] ||
+                            head - tail > TRACE_RING_SIZE / 2)) {
+        tr->matched[tail % TRACE_RING_SIZE] = 0;
+        tail++;
+    }
+    __atomic_store_n(&tr->ring_tail, tail, __ATOMIC_RELEASE);
+}
+
+// Collector side: count the frame, match its packet and roll the fps line
+void rk_trace_frame(RkVpuTrace *tr, RK_S64 pts, double time)
+{
+    RkTraceHist *dec = &tr->hist[TRACE_DECODE];
+
+    match_submit(tr, pts, time);
+    tr->frames++;
+    tr->window_frames++;
+
+    if (tr->interval > 0 && time - tr->window_start >= tr->interval) {
+        if (dec->count)
+            mpp_log("stream %d: %.1f fps over %.2f s, %llu frames, decode p50 %.2f ms p99 %.2f ms\n",
+                    tr->id, tr->window_frames / (time - tr->window_start),
+                    time - tr->window_start, tr->frames,
+                    rk_trace_percentile(dec, 0.50) / 1000, rk_trace_percentile(dec, 0.99) / 1000);
+        else
+            mpp_log("stream %d: %.1f fps over %.2f s, %llu frames\n",
+                    tr->id, tr->window_frames / (time - tr->window_start),
+                    time - tr->window_start, tr->frames);
+        tr->window_start = time;
+        tr->window_frames = 0;
+    }
+}
+
+// Latency in us below which a fraction p of the samples fall, to bucket precision
+double rk_trace_percentile(const RkTraceHist *hist, double p)
+{
+    RK_U64 target = (RK_U64)(p * hist->count + 0.5);
+    RK_U64 seen = 0;
+    RK_U32 b;
+
+    if (!hist->count)
+        return 0;
+    if (!target)
+        target = 1;
+
+    for (b = 0; b < TRACE_HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen >= target)
+            return bucket_limit(b) < hist->max ? bucket_limit(b) : hist->max;
+    }
+    return hist->max;
+}
+
+// Only without access-unit packets is an empty decode histogram expected
+void rk_trace_print(const RkVpuTrace *tr, RK_U32 au_mode)
+{
+    RK_U32 i;
+
+    mpp_log("| %-12s | %8s | %9s | %9s | %9s | %9s |\n",
+            "Stage", "count", "avg ms", "p50 ms", "p99 ms", "max ms");
+    for (i = 0; i < TRACE_STAGE_NUM; i++) {
+        const RkTraceHist *h = &tr->hist[i];
+
+        if (!h->count)
+            continue;
+        mpp_log("| %-12s | %8llu | %9.3f | %9.3f | %9.3f | %9.3f |\n", stage_names[i], h->count,
+                h->sum / h->count / 1000, rk_trace_percentile(h, 0.50) / 1000,
+                rk_trace_percentile(h, 0.99) / 1000, h->max / 1000);
+    }
+    if (!tr->hist[TRACE_DECODE].count && !au_mode)
+        mpp_log("Decode latency needs access-unit packets (-a) to pair frames with packets\n");
+    if (tr->ring_drops)
+        mpp_log("%d submits not timed, ring full\n", tr->ring_drops);
+}
+
+/*
+ * Chrome trace (chrome://tracing, Perfetto) of every stream: one process per
+ * stream, one thread row per track. Decode and write spans overlap between
+ * frames, so they are async events; the rest are complete events.
+ */
+MPP_RET rk_trace_dump(const char *path, RkVpuTrace **traces, RK_U32 count)
+{
+    FILE *fp = fopen(path, "w");
+    double base = 0;
+    const char *sep = "";
+    RK_U32 i, k, n;
+
+    if (!fp) {
+        mpp_err("Failed to open trace file %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!i || traces[i]->base < base)
+            base = traces[i]->base;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (i = 0; i < count; i++) {
+        RkVpuTrace *tr = traces[i];
+
+        fprintf(fp, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+                "\"args\":{\"name\":\"stream %u\"}}", sep, tr->id, tr->id);
+        sep = ",";
+        for (k = 0; k < TRACE_TRACK_NUM; k++) {
+            RkTraceEvents *t = &tr->tracks[k];
+
+            fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,"
+                    "\"args\":{\"name\":\"%s\"}}", tr->id, k + 1, track_names[k]);
+            for (n = 0; n < t->count; n++) {
+                RkTraceEvent *e = &t->events[n];
+                double ts = (e->start - base) * 1e6;
+                double dur = (e->end - e->start) * 1e6;
+
+                // Async ids are global: the stream goes in the top bits
+                if (e->stage == TRACE_DECODE || e->stage == TRACE_WRITE) {
+                    RK_U64 id = ((RK_U64)tr->id << 32) | e->id;
+
+                    fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"b\",\"id\":%llu,"
+                            "\"ts\":%.1f,\"pid\":%u,\"tid\":%u}", stage_names[e->stage],
+                            stage_names[e->stage], id, ts, tr->id, k + 1);
+                    fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"e\",\"id\":%llu,"
+                            "\"ts\":%.1f,\"pid\":%u,\"tid\":%u}", stage_names[e->stage],
+                            stage_names[e->stage], id, ts + dur, tr->id, k + 1);
+                } else {
+                    fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,"
+                            "\"pid\":%u,\"tid\":%u}", stage_names[e->stage], ts, dur,
+                            tr->id, k + 1);
+                }
+            }
+            if (t->dropped)
+                mpp_log("stream %d: %d %s events over the trace limit\n",
+                        tr->id, t->dropped, track_names[k]);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp)) {
+        mpp_err("Failed to write trace file %s\n", path);
+        return MPP_NOK;
+    }
+    return MPP_OK;
+}
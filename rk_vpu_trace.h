@@ -0,0 +1,101 @@
+#ifndef RK_VPU_TRACE_H
+#define RK_VPU_TRACE_H
+
+#include <stdio.h>
+#include <rockchip/rk_type.h>
+#include <rockchip/mpp_err.h>
+
+// Log-linear latency buckets in us: exact below 16, then 8 per power of two
+#define TRACE_HIST_LINEAR       16
+#define TRACE_HIST_SUB          8
+#define TRACE_HIST_BUCKETS      (TRACE_HIST_LINEAR + 28 * TRACE_HIST_SUB)
+
+// Timeline events kept per track when a Chrome trace is requested
+#define TRACE_EVENTS_MAX        (64 * 1024)
+// Packets between submit and frame ready, matched by PTS
+#define TRACE_RING_SIZE         256
+
+typedef enum {
+    TRACE_READ = 0,             // building a packet from the input
+    TRACE_INPUT_WAIT,           // waiting for a free input task
+    TRACE_DECODE,               // packet submitted -> frame ready
+    TRACE_OUTPUT_WAIT,          // waiting for a decoded frame
+    TRACE_WRITE,                // frame ready -> its bytes on the way to the file
+    TRACE_STAGE_NUM,
+} RkTraceStage;
+
+// The thread recording a stage; each track has one writer at a time
+typedef enum {
+    TRACE_TRACK_FEED = 0,
+    TRACE_TRACK_COLLECT,
+    TRACE_TRACK_WRITE,
+    TRACE_TRACK_NUM,
+} RkTraceTrack;
+
+typedef struct {
+    RK_U64          count;
+    double          sum;
+    double          max;
+    RK_U32          buckets[TRACE_HIST_BUCKETS];
+} RkTraceHist;
+
+typedef struct {
+    double          start;
+    double          end;
+    RK_U32          stage;
+    RK_U32          id;
+} RkTraceEvent;
+
+typedef struct {
+    RkTraceEvent   *events;
+    RK_U32          count;
+    RK_U32          dropped;
+} RkTraceEvents;
+
+typedef struct {
+    RK_S64          pts;
+    double          time;
+    RK_U32          id;
+} RkTraceSubmit;
+
+/*
+ * Per-stream pipeline instrumentation. Every histogram and event track is
+ * written by the one thread that owns its stage, so recording takes no lock
+ * and no atomic; only the submit ring crosses from the feeder to the
+ * collector, as a single-producer single-consumer queue.
+ */
+typedef struct {
+    RK_U32          id;                 // stream index, the trace pid
+    double          base;               // time origin of the trace
+    RK_U32          record;             // keep timeline events
+
+    RkTraceHist     hist[TRACE_STAGE_NUM];
+    RkTraceEvents   tracks[TRACE_TRACK_NUM];
+
+    // Feeder -> collector: submit times, head published with release
+    RkTraceSubmit   ring[TRACE_RING_SIZE];
+    RK_U32          ring_head;
+    RK_U32          ring_tail;
+    RK_U8           matched[TRACE_RING_SIZE];   // collector only
+    RK_U32          submits;
+    RK_U32          ring_drops;
+
+    // Rolling fps, collector side
+    double          interval;
+    double          window_start;
+    RK_U32          window_frames;
+    RK_U64          frames;
+} RkVpuTrace;
+
+// Function declarations
+double rk_trace_now(void);
+MPP_RET rk_trace_init(RkVpuTrace *tr, RK_U32 id, RK_U32 record, double interval);
+void rk_trace_deinit(RkVpuTrace *tr);
+void rk_trace_span(RkVpuTrace *tr, RkTraceStage stage, double start, double end);
+void rk_trace_submit(RkVpuTrace *tr, RK_S64 pts, double time);
+void rk_trace_frame(RkVpuTrace *tr, RK_S64 pts, double time);
+double rk_trace_percentile(const RkTraceHist *hist, double p);
+void rk_trace_print(const RkVpuTrace *tr, RK_U32 au_mode);
+MPP_RET rk_trace_dump(const char *path, RkVpuTrace **traces, RK_U32 count);
+
+#endif // RK_VPU_TRACE_H
@@ -0,0 +1,549 @@
+#include "rk_vpu_transcode.h"
+#include "rk_yuv_crop.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double get_thread_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Either side may stop the other; the flag is only ever set
+static void stop_transcode(RkTranscoder *tc)
+{
+    __atomic_store_n(&tc->abort, 1, __ATOMIC_RELEASE);
+}
+
+static RK_U32 transcode_stopped(RkTranscoder *tc)
+{
+    return __atomic_load_n(&tc->abort, __ATOMIC_ACQUIRE);
+}
+
+const char *rk_rc_mode_name(MppEncRcMode mode)
+{
+    switch (mode) {
+    case MPP_ENC_RC_MODE_CBR : return "cbr";
+    case MPP_ENC_RC_MODE_VBR : return "vbr";
+    case MPP_ENC_RC_MODE_FIXQP : return "fixqp";
+    case MPP_ENC_RC_MODE_AVBR : return "avbr";
+    default : return "unknown";
+    }
+}
+
+// Write one packet, or fail the transcode; called with no frame waiting on it
+static MPP_RET write_packet(RkTranscoder *tc, MppPacket packet)
+{
+    size_t len = mpp_packet_get_length(packet);
+
+    if (len && fwrite(mpp_packet_get_pos(packet), 1, len, tc->fp) != len) {
+        mpp_err("Failed to write encoded stream\n");
+        return MPP_NOK;
+    }
+    tc->bytes += len;
+    return MPP_OK;
+}
+
+/*
+ * Packet thread: each packet answers the oldest frame in flight. Once it
+ * is written the frame is released, which returns its buffer to the
+ * decoder's pool, and a slot opens for the next frame.
+ */
+static void *packet_thread(void *arg)
+{
+    RkTranscoder *tc = (RkTranscoder *)arg;
+
+    while (!transcode_stopped(tc) && !tc->eos_out) {
+        MppTask task = NULL;
+        MppPacket packet = NULL;
+        MppFrame frame;
+        MPP_RET ret;
+        double now;
+
+        if (tc->mpi->poll(tc->ctx, MPP_PORT_OUTPUT, TRANSCODE_POLL_MS))
+            continue;
+        if (tc->mpi->dequeue(tc->ctx, MPP_PORT_OUTPUT, &task) || !task) {
+            mpp_err("mpp task output dequeue failed\n");
+            tc->ret = MPP_NOK;
+            break;
+        }
+
+        mpp_task_meta_get_packet(task, KEY_OUTPUT_PACKET, &packet);
+        ret = MPP_OK;
+        if (packet) {
+            MppMeta meta = mpp_packet_get_meta(packet);
+            RK_S32 intra = 0, qp = 0;
+
+            pthread_mutex_lock(&tc->lock);
+            frame = tc->count ? tc->frames[tc->head] : NULL;
+            pthread_mutex_unlock(&tc->lock);
+
+            if (mpp_packet_get_length(packet)) {
+                ret = write_packet(tc, packet);
+                if (!mpp_meta_get_s32(meta, KEY_OUTPUT_INTRA, &intra) && intra)
+                    tc->intra++;
+                if (!mpp_meta_get_s32(meta, KEY_ENC_AVERAGE_QP, &qp))
+                    tc->qp_sum += qp;
+                tc->packets++;
+            } else if (frame && mpp_frame_get_buffer(frame)) {
+                mpp_err("frame pts %lld not encoded\n", mpp_packet_get_pts(packet));
+                ret = MPP_NOK;
+            }
+            if (mpp_packet_get_eos(packet))
+                tc->eos_out = 1;
+            mpp_packet_deinit(&packet);
+
+            now = get_time_in_seconds();
+            pthread_mutex_lock(&tc->lock);
+            if (tc->count) {
+                double latency = now - tc->pushed[tc->head];
+
+                tc->latency_sum += latency;
+                if (latency > tc->latency_max)
+                    tc->latency_max = latency;
+                tc->frames[tc->head] = NULL;
+                tc->head = (tc->head + 1) % TRANSCODE_DEPTH;
+                tc->count--;
+            }
+            tc->end = now;
+            pthread_cond_broadcast(&tc->cond);
+            pthread_mutex_unlock(&tc->lock);
+
+            if (frame)
+                mpp_frame_deinit(&frame);
+        }
+
+        if (tc->mpi->enqueue(tc->ctx, MPP_PORT_OUTPUT, task)) {
+            mpp_err("mpp task output enqueue failed\n");
+            ret = MPP_NOK;
+        }
+        if (ret) {
+            tc->ret = ret;
+            break;
+        }
+    }
+
+    // A failure here stops the decoder side at its next push
+    if (tc->ret)
+        stop_transcode(tc);
+    pthread_mutex_lock(&tc->lock);
+    pthread_cond_broadcast(&tc->cond);
+    pthread_mutex_unlock(&tc->lock);
+    tc->cpu_time = get_thread_cpu_seconds();
+    return NULL;
+}
+
+MPP_RET rk_transcoder_init(RkTranscoder *tc, const char *path, const RkTranscodeConfig *cfg)
+{
+    MPP_RET ret = MPP_OK;
+
+    memset(tc, 0, sizeof(RkTranscoder));
+    tc->cfg = *cfg;
+
+    tc->fp = fopen(path, "wb");
+    if (!tc->fp) {
+        mpp_err("Failed to open output file %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    pthread_mutex_init(&tc->lock, NULL);
+    pthread_cond_init(&tc->cond, NULL);
+    tc->lock_ready = 1;
+
+    ret = mpp_enc_cfg_init(&tc->enc_cfg);
+    if (ret) {
+        mpp_err("Failed to get encoder config\n");
+        goto ERR_RET;
+    }
+
+    ret = mpp_create(&tc->ctx, &tc->mpi);
+    if (ret) {
+        mpp_err("mpp_create failed\n");
+        goto ERR_RET;
+    }
+
+    ret = mpp_init(tc->ctx, MPP_CTX_ENC, cfg->type);
+    if (ret) {
+        mpp_err("mpp_init encoder failed\n");
+        goto ERR_RET;
+    }
+
+    if (pthread_create(&tc->thread, NULL, packet_thread, tc)) {
+        mpp_err("Failed to create packet thread\n");
+        ret = MPP_NOK;
+        goto ERR_RET;
+    }
+    tc->thread_started = 1;
+    return MPP_OK;
+
+ERR_RET:
+    rk_transcoder_deinit(tc);
+    return ret;
+}
+
+/*
+ * Set the encoder up for the frame's picture, straight from the decoder's
+ * strides so its buffer can be read as is, and write the parameter sets.
+ * Only called with no frame in flight.
+ */
+static MPP_RET setup_encoder(RkTranscoder *tc, MppFrame frame)
+{
+    MppEncCfg cfg = tc->enc_cfg;
+    RkTranscodeConfig *c = &tc->cfg;
+    RK_U32 width = mpp_frame_get_width(frame);
+    RK_U32 height = mpp_frame_get_height(frame);
+    RK_U8 hdr[TRANSCODE_HDR_SIZE];
+    MppPacket packet = NULL;
+    MPP_RET ret;
+
+    ret = tc->mpi->control(tc->ctx, MPP_ENC_GET_CFG, cfg);
+    if (ret) {
+        mpp_err("Failed to get encoder config\n");
+        return ret;
+    }
+
+    // Same default as mpi_enc_test: an eighth of a bit per pixel per frame
+    tc->bps = c->bps ? c->bps : width * height / 8 * c->fps;
+
+    mpp_enc_cfg_set_s32(cfg, "prep:width", width);
+    mpp_enc_cfg_set_s32(cfg, "prep:height", height);
+    mpp_enc_cfg_set_s32(cfg, "prep:hor_stride", mpp_frame_get_hor_stride(frame));
+    mpp_enc_cfg_set_s32(cfg, "prep:ver_stride", mpp_frame_get_ver_stride(frame));
+    mpp_enc_cfg_set_s32(cfg, "prep:format", mpp_frame_get_fmt(frame));
+
+    mpp_enc_cfg_set_s32(cfg, "rc:mode", c->rc_mode);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_flex", 0);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_num", c->fps);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_denom", 1);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_flex", 0);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_num", c->fps);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_denom", 1);
+    mpp_enc_cfg_set_s32(cfg, "rc:gop", c->gop);
+
+    switch (c->rc_mode) {
+    case MPP_ENC_RC_MODE_FIXQP : {
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_init", c->qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_min", c->qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_max", c->qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_min_i", c->qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_max_i", c->qp);
+    } break;
+    case MPP_ENC_RC_MODE_CBR : {
+        // Tight window around the target
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_target", tc->bps);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_max", tc->bps / 16 * 17);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_min", tc->bps / 16 * 15);
+    } break;
+    default : {
+        // VBR: the rate follows the content between a sixteenth and 17/16 of the target
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_target", tc->bps);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_max", tc->bps / 16 * 17);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_min", tc->bps / 16);
+    } break;
+    }
+
+    mpp_enc_cfg_set_s32(cfg, "codec:type", c->type);
+    if (c->type == MPP_VIDEO_CodingAVC) {
+        // High profile, level 4.0, CABAC
+        mpp_enc_cfg_set_s32(cfg, "h264:profile", 100);
+        mpp_enc_cfg_set_s32(cfg, "h264:level", 40);
+        mpp_enc_cfg_set_s32(cfg, "h264:cabac_en", 1);
+    }
+
+    ret = tc->mpi->control(tc->ctx, MPP_ENC_SET_CFG, cfg);
+    if (ret) {
+        mpp_err("Failed to set encoder config for %ux%u\n", width, height);
+        return ret;
+    }
+
+    // Parameter sets go in front of the first frame of each configuration
+    ret = mpp_packet_init(&packet, hdr, sizeof(hdr));
+    if (ret)
+        return ret;
+    mpp_packet_set_length(packet, 0);
+    ret = tc->mpi->control(tc->ctx, MPP_ENC_GET_HDR_SYNC, packet);
+    if (ret)
+        mpp_err("Failed to get stream header\n");
+    else
+        ret = write_packet(tc, packet);
+    mpp_packet_deinit(&packet);
+    if (ret)
+        return ret;
+
+    if (tc->width)
+        tc->reconfigs++;
+    tc->width = width;
+    tc->height = height;
+    tc->hor_stride = mpp_frame_get_hor_stride(frame);
+    tc->ver_stride = mpp_frame_get_ver_stride(frame);
+    return MPP_OK;
+}
+
+/*
+ * Replace a 10-bit frame with an NV12 copy at 16-aligned strides, the
+ * decoder's frame goes back right away. 8-bit frames and the bufferless
+ * EOS frame are left as they are.
+ */
+static MPP_RET convert_10bit(RkTranscoder *tc, MppFrame *frame)
+{
+    MppFrame src = *frame;
+    MppFrame dst = NULL;
+    MppBuffer buf = NULL;
+    RkYuvLayout layout;
+    RK_U32 hor_stride, ver_stride;
+    MPP_RET ret;
+
+    if (!mpp_frame_get_buffer(src) ||
+        (mpp_frame_get_fmt(src) & MPP_FRAME_FMT_MASK) != MPP_FMT_YUV420SP_10BIT)
+        return MPP_OK;
+
+    memset(&layout, 0, sizeof(layout));
+    layout.width = mpp_frame_get_width(src);
+    layout.height = mpp_frame_get_height(src);
+    layout.hor_stride = mpp_frame_get_hor_stride(src);
+    layout.ver_stride = mpp_frame_get_ver_stride(src);
+    layout.bit_depth = 10;
+    hor_stride = (layout.width + TRANSCODE_STRIDE_ALIGN - 1) & ~(TRANSCODE_STRIDE_ALIGN - 1);
+    ver_stride = (layout.height + TRANSCODE_STRIDE_ALIGN - 1) & ~(TRANSCODE_STRIDE_ALIGN - 1);
+
+    if (!tc->conv_grp) {
+        ret = mpp_buffer_group_get_internal(&tc->conv_grp, MPP_BUFFER_TYPE_DRM);
+        if (ret) {
+            mpp_err("Failed to get buffer group for 10-bit conversion\n");
+            return ret;
+        }
+    }
+    ret = mpp_buffer_get(tc->conv_grp, &buf, (size_t)hor_stride * ver_stride * 3 / 2);
+    if (ret) {
+        mpp_err("Failed to get a %ux%u NV12 buffer for a 10-bit frame\n", hor_stride, ver_stride);
+        return ret;
+    }
+    rk_yuv_unpack10_nv12(mpp_buffer_get_ptr(buf), hor_stride, ver_stride,
+                         mpp_buffer_get_ptr(mpp_frame_get_buffer(src)), &layout);
+
+    ret = mpp_frame_init(&dst);
+    if (ret) {
+        mpp_buffer_put(buf);
+        return ret;
+    }
+    mpp_frame_set_width(dst, layout.width);
+    mpp_frame_set_height(dst, layout.height);
+    mpp_frame_set_hor_stride(dst, hor_stride);
+    mpp_frame_set_ver_stride(dst, ver_stride);
+    mpp_frame_set_fmt(dst, MPP_FMT_YUV420SP);
+    mpp_frame_set_pts(dst, mpp_frame_get_pts(src));
+    mpp_frame_set_eos(dst, mpp_frame_get_eos(src));
+    // The frame holds its own reference
+    mpp_frame_set_buffer(dst, buf);
+    mpp_buffer_put(buf);
+
+    mpp_frame_deinit(&src);
+    *frame = dst;
+    tc->converted++;
+    return MPP_OK;
+}
+
+// Caller holds tc->lock; wait until at most max frames are in flight
+static MPP_RET wait_frames(RkTranscoder *tc, RK_U32 max)
+{
+    double start = get_time_in_seconds();
+
+    while (tc->count > max && !transcode_stopped(tc)) {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TRANSCODE_POLL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&tc->cond, &tc->lock, &deadline);
+    }
+    tc->push_wait += get_time_in_seconds() - start;
+    return transcode_stopped(tc) ? MPP_NOK : MPP_OK;
+}
+
+/*
+ * Hand a decoded frame to the encoder. On success the transcoder owns it
+ * and *frame is cleared. Blocks while TRANSCODE_DEPTH frames are in
+ * flight, and drains the encoder before a change of picture size.
+ */
+MPP_RET rk_transcoder_push(RkTranscoder *tc, MppFrame *frame)
+{
+    MppFrame f;
+    MppTask task = NULL;
+    MppFrame done = NULL;
+    MPP_RET ret;
+    RK_U32 slot;
+    RK_U32 eos;
+    RK_U32 resize;
+
+    // On failure past here *frame is the copy, which the caller releases
+    ret = convert_10bit(tc, frame);
+    if (ret)
+        return ret;
+    f = *frame;
+    eos = mpp_frame_get_eos(f);
+    resize = mpp_frame_get_buffer(f) &&
+             (mpp_frame_get_width(f) != tc->width ||
+              mpp_frame_get_height(f) != tc->height ||
+              mpp_frame_get_hor_stride(f) != tc->hor_stride ||
+              mpp_frame_get_ver_stride(f) != tc->ver_stride);
+
+    pthread_mutex_lock(&tc->lock);
+    ret = wait_frames(tc, resize ? 0 : TRANSCODE_DEPTH - 1);
+    pthread_mutex_unlock(&tc->lock);
+    if (ret)
+        return ret;
+
+    if (resize) {
+        ret = setup_encoder(tc, f);
+        if (ret)
+            return ret;
+    }
+
+    // Input tasks come back as soon as the encoder has read their frame
+    while ((ret = tc->mpi->poll(tc->ctx, MPP_PORT_INPUT, TRANSCODE_POLL_MS))) {
+        if (transcode_stopped(tc) || ret != MPP_ERR_TIMEOUT) {
+            mpp_err("mpp encoder input poll failed\n");
+            return MPP_NOK;
+        }
+    }
+    ret = tc->mpi->dequeue(tc->ctx, MPP_PORT_INPUT, &task);
+    if (ret || !task) {
+        mpp_err("mpp task input dequeue failed\n");
+        return ret ? ret : MPP_NOK;
+    }
+    // The frame it last carried is released by the packet thread
+    mpp_task_meta_get_frame(task, KEY_INPUT_FRAME, &done);
+
+    pthread_mutex_lock(&tc->lock);
+    slot = (tc->head + tc->count) % TRANSCODE_DEPTH;
+    tc->frames[slot] = f;
+    tc->pushed[slot] = get_time_in_seconds();
+    if (!tc->frames_in)
+        tc->start = tc->pushed[slot];
+    tc->count++;
+    pthread_mutex_unlock(&tc->lock);
+
+    mpp_task_meta_set_frame(task, KEY_INPUT_FRAME, f);
+    ret = tc->mpi->enqueue(tc->ctx, MPP_PORT_INPUT, task);
+    if (ret) {
+        mpp_err("mpp task input enqueue failed\n");
+        pthread_mutex_lock(&tc->lock);
+        tc->frames[slot] = NULL;
+        tc->count--;
+        pthread_mutex_unlock(&tc->lock);
+        return ret;
+    }
+
+    // f may already be released by the packet thread
+    if (eos)
+        tc->eos_sent = 1;
+    tc->frames_in++;
+    *frame = NULL;
+    return MPP_OK;
+}
+
+// Frames handed over and not encoded yet
+RK_U32 rk_transcoder_queued(RkTranscoder *tc)
+{
+    RK_U32 count;
+
+    pthread_mutex_lock(&tc->lock);
+    count = tc->count;
+    pthread_mutex_unlock(&tc->lock);
+    return count;
+}
+
+/*
+ * End of the decoded stream: flush the encoder with an EOS frame, wait for
+ * the last packet and close the file. Returns the first failure of either
+ * side.
+ */
+MPP_RET rk_transcoder_finish(RkTranscoder *tc)
+{
+    MPP_RET ret = MPP_OK;
+
+    if (!tc->fp)
+        return tc->ret;
+
+    if (tc->frames_in && !tc->eos_sent && !transcode_stopped(tc)) {
+        MppFrame eos = NULL;
+
+        ret = mpp_frame_init(&eos);
+        if (!ret) {
+            mpp_frame_set_eos(eos, 1);
+            ret = rk_transcoder_push(tc, &eos);
+            if (eos)
+                mpp_frame_deinit(&eos);
+        }
+    }
+    // Nothing was encoded, or a flush is impossible: stop the packet thread
+    if (!tc->frames_in || ret)
+        stop_transcode(tc);
+
+    if (tc->thread_started) {
+        pthread_join(tc->thread, NULL);
+        tc->thread_started = 0;
+    }
+    if (!ret)
+        ret = tc->ret;
+
+    if (fclose(tc->fp) && !ret) {
+        mpp_err("Failed to write encoded stream\n");
+        ret = MPP_NOK;
+    }
+    tc->fp = NULL;
+    return ret;
+}
+
+void rk_transcoder_deinit(RkTranscoder *tc)
+{
+    RK_U32 i;
+
+    stop_transcode(tc);
+    if (tc->thread_started) {
+        pthread_join(tc->thread, NULL);
+        tc->thread_started = 0;
+    }
+
+    // Nothing reads the frames once the encoder is gone
+    if (tc->ctx) {
+        mpp_destroy(tc->ctx);
+        tc->ctx = NULL;
+    }
+    for (i = 0; i < TRANSCODE_DEPTH; i++) {
+        if (tc->frames[i])
+            mpp_frame_deinit(&tc->frames[i]);
+    }
+    tc->count = 0;
+    if (tc->conv_grp) {
+        mpp_buffer_group_put(tc->conv_grp);
+        tc->conv_grp = NULL;
+    }
+
+    if (tc->enc_cfg) {
+        mpp_enc_cfg_deinit(tc->enc_cfg);
+        tc->enc_cfg = NULL;
+    }
+    if (tc->fp) {
+        fclose(tc->fp);
+        tc->fp = NULL;
+    }
+    if (tc->lock_ready) {
+        pthread_mutex_destroy(&tc->lock);
+        pthread_cond_destroy(&tc->cond);
+        tc->lock_ready = 0;
+    }
+}
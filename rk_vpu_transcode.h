@@ -0,0 +1,98 @@
+#ifndef RK_VPU_TRANSCODE_H
+#define RK_VPU_TRANSCODE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <rockchip/rk_mpi.h>
+#include <rockchip/rk_venc_cfg.h>
+#include <rockchip/mpp_frame.h>
+#include <rockchip/mpp_packet.h>
+
+// Decoded frames with the encoder at once; the frame pool sizes for them
+#define TRANSCODE_DEPTH         4
+#define TRANSCODE_DEFAULT_GOP   60
+#define TRANSCODE_DEFAULT_QP    26
+// Room for the parameter sets from MPP_ENC_GET_HDR_SYNC
+#define TRANSCODE_HDR_SIZE      1024
+// Poll timeout on the encoder ports, ms
+#define TRANSCODE_POLL_MS       100
+// Stride alignment of NV12 copies made from 10-bit frames, pixels and rows
+#define TRANSCODE_STRIDE_ALIGN  16
+
+typedef struct {
+    MppCodingType   type;           // AVC or HEVC
+    MppEncRcMode    rc_mode;        // CBR, VBR or FixQP
+    RK_U32          bps;            // CBR and VBR target, 0 = from the picture size
+    RK_U32          qp;             // FixQP
+    RK_U32          gop;            // frames between IDRs, 0 = first frame only
+    RK_U32          fps;
+} RkTranscodeConfig;
+
+/*
+ * Re-encodes decoded frames on a VEPU580 context. A frame goes to the
+ * encoder as the MppFrame the decoder returned, so the encoder reads the
+ * decoder's DMA buffer and nothing is copied; the frame and its buffer
+ * are released back to the decoder once the frame's packet is out. The
+ * encoder takes 8-bit input only, so a 10-bit frame is the exception: it
+ * is dithered to NV12 in a buffer of conv_grp and goes back at once.
+ *
+ * The decoder side pushes frames; a packet thread drains the output port
+ * and writes the elementary stream. Frames come out in order, one packet
+ * each, so in-flight frames are a FIFO matched to packets by position.
+ */
+typedef struct {
+    RkTranscodeConfig cfg;
+    MppCtx          ctx;
+    MppApi         *mpi;
+    MppEncCfg       enc_cfg;
+    FILE           *fp;
+    MppBufferGroup  conv_grp;       // NV12 copies of 10-bit frames, made on the first one
+
+    // Picture the encoder is set up for, 0 before the first frame
+    RK_U32          width;
+    RK_U32          height;
+    RK_U32          hor_stride;
+    RK_U32          ver_stride;
+    RK_U32          bps;
+
+    // In-flight frames, pushed at the tail and released from head
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    RK_U32          lock_ready;
+    MppFrame        frames[TRANSCODE_DEPTH];
+    double          pushed[TRANSCODE_DEPTH];
+    RK_U32          head;
+    RK_U32          count;
+    RK_U32          eos_sent;
+    RK_U32          eos_out;
+    RK_U32          abort;          // atomic, set by either side to stop
+    MPP_RET         ret;            // packet thread failure
+
+    pthread_t       thread;
+    RK_U32          thread_started;
+
+    // Statistics
+    RK_U64          frames_in;
+    RK_U64          packets;
+    RK_U64          intra;
+    RK_U64          bytes;
+    RK_U64          qp_sum;
+    RK_U32          reconfigs;
+    RK_U64          converted;      // 10-bit frames dithered to NV12
+    double          push_wait;      // decoder side blocked on a full encoder
+    double          latency_sum;    // frame handed over -> packet written
+    double          latency_max;
+    double          cpu_time;       // packet thread CPU seconds
+    double          start;          // first frame handed over
+    double          end;            // last packet written
+} RkTranscoder;
+
+// Function declarations
+MPP_RET rk_transcoder_init(RkTranscoder *tc, const char *path, const RkTranscodeConfig *cfg);
+MPP_RET rk_transcoder_push(RkTranscoder *tc, MppFrame *frame);
+RK_U32 rk_transcoder_queued(RkTranscoder *tc);
+MPP_RET rk_transcoder_finish(RkTranscoder *tc);
+void rk_transcoder_deinit(RkTranscoder *tc);
+const char *rk_rc_mode_name(MppEncRcMode mode);
+
+#endif // RK_VPU_TRANSCODE_H
@@ -0,0 +1,550 @@
+#include "rk_yuv_convert.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <rockchip/mpp_log.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// Workers go to the A76 cluster (4-7) first, then the A55 cores
+static const int worker_cores[CSC_MAX_WORKERS] = { 4, 5, 6, 7, 0, 1, 2, 3 };
+
+static const char *format_names[] = { "rgb24", "bgra" };
+
+const char *rk_csc_format_name(RkCscFormat format)
+{
+    return format <= CSC_BGRA ? format_names[format] : "unknown";
+}
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/*
+ * Coefficients rounded to Q6. Sums stay in int16 except where the result
+ * is far above 255 anyway; the NEON path saturates there and the scalar
+ * path clamps, so both give the same bytes.
+ */
+void rk_csc_coef_init(RkCscCoef *coef, RkCscStandard standard, RK_U32 full_range)
+{
+    // Kr/Kb: BT.601 0.299/0.114, BT.709 0.2126/0.0722
+    double kr = standard == CSC_BT709 ? 0.2126 : 0.299;
+    double kb = standard == CSC_BT709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    double ys = full_range ? 1.0 : 255.0 / 219.0;
+    double cs = full_range ? 1.0 : 255.0 / 224.0;
+    double one = 1 << CSC_COEF_SHIFT;
+
+    coef->y = (RK_S16)(ys * one + 0.5);
+    coef->rv = (RK_S16)(2 * (1 - kr) * cs * one + 0.5);
+    coef->gu = (RK_S16)(2 * (1 - kb) * kb / kg * cs * one + 0.5);
+    coef->gv = (RK_S16)(2 * (1 - kr) * kr / kg * cs * one + 0.5);
+    coef->bu = (RK_S16)(2 * (1 - kb) * cs * one + 0.5);
+    coef->y_off = full_range ? 0 : 16;
+}
+
+static inline RK_U8 clamp_q6(RK_S32 v)
+{
+    // int16 saturation as in vqaddq_s16, then round and narrow like vqrshrun
+    if (v > 32767)
+        v = 32767;
+    v = (v + (1 << (CSC_COEF_SHIFT - 1))) >> CSC_COEF_SHIFT;
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+void rk_nv12_row_to_rgb_scalar(const RK_U8 *y, const RK_U8 *uv, RK_U8 *dst, RK_U32 width,
+                               const RkCscCoef *coef, RkCscFormat format)
+{
+    RK_U32 x;
+
+    for (x = 0; x < width; x++) {
+        RK_S32 yy = (y[x] - coef->y_off) * coef->y;
+        RK_S32 u = uv[x & ~1] - 128;
+        RK_S32 v = uv[x | 1] - 128;
+        RK_U8 r = clamp_q6(yy + coef->rv * v);
+        RK_U8 g = clamp_q6(yy - coef->gu * u - coef->gv * v);
+        RK_U8 b = clamp_q6(yy + coef->bu * u);
+
+        if (format == CSC_BGRA) {
+            dst[0] = b;
+            dst[1] = g;
+            dst[2] = r;
+            dst[3] = 0xff;
+            dst += 4;
+        } else {
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            dst += 3;
+        }
+    }
+}
+
+// dst = a + (b - a) * f / 128, rounded
+void rk_blend_rows_scalar(RK_U8 *dst, const RK_U8 *a, const RK_U8 *b, RK_U32 len, RK_U32 f)
+{
+    RK_U32 w0 = (1 << CSC_WEIGHT_SHIFT) - f;
+    RK_U32 i;
+
+    for (i = 0; i < len; i++)
+        dst[i] = (a[i] * w0 + b[i] * f + (1 << (CSC_WEIGHT_SHIFT - 1))) >> CSC_WEIGHT_SHIFT;
+}
+
+#ifdef __ARM_NEON
+/*
+ * 16 pixels per iteration: vld2 splits the 8 CbCr pairs, the chroma terms
+ * are computed once at half width and zipped up to full width.
+ */
+void rk_nv12_row_to_rgb_neon(const RK_U8 *y, const RK_U8 *uv, RK_U8 *dst, RK_U32 width,
+                             const RkCscCoef *coef, RkCscFormat format)
+{
+    const uint8x8_t y_off = vdup_n_u8(coef->y_off);
+    const uint8x8_t c128 = vdup_n_u8(128);
+    const uint8x16_t alpha = vdupq_n_u8(0xff);
+    RK_U32 x = 0;
+    RK_U32 bpp = format == CSC_BGRA ? 4 : 3;
+
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t yv = vld1q_u8(y + x);
+        uint8x8x2_t c = vld2_u8(uv + x);
+        int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(c.val[0], c128));
+        int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(c.val[1], c128));
+        int16x8_t rc = vmulq_n_s16(v, coef->rv);
+        int16x8_t gc = vmlaq_n_s16(vmulq_n_s16(u, coef->gu), v, coef->gv);
+        int16x8_t bc = vmulq_n_s16(u, coef->bu);
+        // (Y - off) widens as unsigned; below-offset values wrap and turn
+        // negative again on the reinterpret
+        int16x8_t yl = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(yv), y_off)), coef->y);
+        int16x8_t yh = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(yv), y_off)), coef->y);
+        int16x8x2_t r2 = vzipq_s16(rc, rc);
+        int16x8x2_t g2 = vzipq_s16(gc, gc);
+        int16x8x2_t b2 = vzipq_s16(bc, bc);
+        uint8x16_t r = vcombine_u8(vqrshrun_n_s16(vqaddq_s16(yl, r2.val[0]), CSC_COEF_SHIFT),
+                                   vqrshrun_n_s16(vqaddq_s16(yh, r2.val[1]), CSC_COEF_SHIFT));
+        uint8x16_t g = vcombine_u8(vqrshrun_n_s16(vqsubq_s16(yl, g2.val[0]), CSC_COEF_SHIFT),
+                                   vqrshrun_n_s16(vqsubq_s16(yh, g2.val[1]), CSC_COEF_SHIFT));
+        uint8x16_t b = vcombine_u8(vqrshrun_n_s16(vqaddq_s16(yl, b2.val[0]), CSC_COEF_SHIFT),
+                                   vqrshrun_n_s16(vqaddq_s16(yh, b2.val[1]), CSC_COEF_SHIFT));
+
+        if (format == CSC_BGRA) {
+            uint8x16x4_t out = { { b, g, r, alpha } };
+            vst4q_u8(dst + x * 4, out);
+        } else {
+            uint8x16x3_t out = { { r, g, b } };
+            vst3q_u8(dst + x * 3, out);
+        }
+    }
+
+    if (x < width)
+        rk_nv12_row_to_rgb_scalar(y + x, uv + x, dst + x * bpp, width - x, coef, format);
+}
+
+void rk_blend_rows_neon(RK_U8 *dst, const RK_U8 *a, const RK_U8 *b, RK_U32 len, RK_U32 f)
+{
+    const uint8x8_t w0 = vdup_n_u8((1 << CSC_WEIGHT_SHIFT) - f);
+    const uint8x8_t w1 = vdup_n_u8(f);
+    RK_U32 i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), w0), vget_low_u8(vb), w1);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), w0), vget_high_u8(vb), w1);
+
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, CSC_WEIGHT_SHIFT),
+                                      vrshrn_n_u16(hi, CSC_WEIGHT_SHIFT)));
+    }
+    rk_blend_rows_scalar(dst + i, a + i, b + i, len - i, f);
+}
+#endif
+
+static inline void convert_row(const RK_U8 *y, const RK_U8 *uv, RK_U8 *dst, RK_U32 width,
+                               const RkCscCoef *coef, RkCscFormat format)
+{
+#ifdef __ARM_NEON
+    rk_nv12_row_to_rgb_neon(y, uv, dst, width, coef, format);
+#else
+    rk_nv12_row_to_rgb_scalar(y, uv, dst, width, coef, format);
+#endif
+}
+
+static inline void blend_rows(RK_U8 *dst, const RK_U8 *a, const RK_U8 *b, RK_U32 len, RK_U32 f)
+{
+    if (!f) {
+        memcpy(dst, a, len);
+        return;
+    }
+#ifdef __ARM_NEON
+    rk_blend_rows_neon(dst, a, b, len, f);
+#else
+    rk_blend_rows_scalar(dst, a, b, len, f);
+#endif
+}
+
+/*
+ * Centre-aligned source position of dst index i: (i + 0.5) * src / dst - 0.5,
+ * as an integer sample and a Q7 weight of the next one.
+ */
+static void map_position(RK_U32 i, RK_U32 src, RK_U32 dst, RK_U32 *p0, RK_U32 *f)
+{
+    RK_S64 pos = ((2 * (RK_S64)i + 1) * src * 65536) / (2 * dst) - 32768;
+
+    if (pos < 0)
+        pos = 0;
+    *p0 = pos >> 16;
+    *f = ((pos & 0xffff) + (1 << (15 - CSC_WEIGHT_SHIFT))) >> (16 - CSC_WEIGHT_SHIFT);
+    if (*f == 1 << CSC_WEIGHT_SHIFT) {
+        (*p0)++;
+        *f = 0;
+    }
+    if (*p0 >= src - 1) {
+        *p0 = src - 1;
+        *f = 0;
+    }
+}
+
+static MPP_RET build_tab(RkCscScaleTab *tab, RK_U32 src, RK_U32 dst)
+{
+    RK_U32 i;
+
+    if (tab->count < dst) {
+        free(tab->x0);
+        free(tab->fx);
+        tab->x0 = malloc(dst * sizeof(RK_U16));
+        tab->fx = malloc(dst);
+        tab->count = dst;
+        if (!tab->x0 || !tab->fx)
+            return MPP_ERR_MALLOC;
+    }
+
+    for (i = 0; i < dst; i++) {
+        RK_U32 x0, f;
+
+        map_position(i, src, dst, &x0, &f);
+        tab->x0[i] = x0;
+        tab->fx[i] = f;
+    }
+    return MPP_OK;
+}
+
+// Horizontal pass over interleaved samples: step 1 for luma, 2 for CbCr
+static void scale_row_h(RK_U8 *dst, const RK_U8 *src, const RkCscScaleTab *tab, RK_U32 count,
+                        RK_U32 step)
+{
+    RK_U32 i, c;
+
+    for (i = 0; i < count; i++) {
+        const RK_U8 *p = src + tab->x0[i] * step;
+        RK_U32 f = tab->fx[i];
+        RK_U32 w0 = (1 << CSC_WEIGHT_SHIFT) - f;
+
+        for (c = 0; c < step; c++) {
+            RK_U32 b = f ? p[c + step] : 0;
+
+            dst[i * step + c] = (p[c] * w0 + b * f + (1 << (CSC_WEIGHT_SHIFT - 1))) >> CSC_WEIGHT_SHIFT;
+        }
+    }
+}
+
+// One plane of the current frame as convert_band reads it
+typedef struct {
+    const RK_U8    *plane;
+    size_t          stride;
+    RK_U32          samples;            // per row, CbCr counted separately
+    RK_U32          unpack;             // 10-bit: unpack each row first
+    RK_U32          chroma;
+} RkYuvRowSource;
+
+static MPP_RET worker_scratch(RkCscWorker *wk, size_t size)
+{
+    RK_U32 i;
+
+    if (wk->scratch_size >= size)
+        return MPP_OK;
+
+    free(wk->vrow);
+    free(wk->hrow);
+    free(wk->vuv);
+    free(wk->huv);
+    wk->vrow = malloc(size);
+    wk->hrow = malloc(size);
+    wk->vuv = malloc(size);
+    wk->huv = malloc(size);
+    for (i = 0; i < 4; i++) {
+        free(wk->unpacked[i]);
+        wk->unpacked[i] = malloc(size);
+        if (!wk->unpacked[i])
+            break;
+    }
+    if (!wk->vrow || !wk->hrow || !wk->vuv || !wk->huv || i < 4) {
+        wk->scratch_size = 0;
+        return MPP_ERR_MALLOC;
+    }
+    wk->scratch_size = size;
+    return MPP_OK;
+}
+
+/*
+ * Source row sy of a plane as 8-bit samples: the frame buffer itself, or
+ * for a 10-bit frame the row unpacked with dither into scratch.
+ */
+static const RK_U8 *source_row(const RkYuvRowSource *rs, RK_U8 *scratch, RK_U32 sy)
+{
+    const RK_U8 *row = rs->plane + (size_t)sy * rs->stride;
+
+    if (!rs->unpack)
+        return row;
+    rk_unpack10_row_dither(scratch, row, rs->samples, sy, rs->chroma);
+    return scratch;
+}
+
+/*
+ * Convert dst rows [y0, y1). Unscaled rows read the frame buffer directly;
+ * scaled rows blend two source rows into worker scratch first, so nothing
+ * bigger than a row is ever copied. 10-bit rows are unpacked to 8 bits one
+ * at a time on the way in, with the same dither as the crop.
+ */
+static void convert_band(RkYuvConverter *cvt, RkCscWorker *wk, RK_U32 y0, RK_U32 y1)
+{
+    const RkYuvLayout *l = &cvt->layout;
+    size_t dst_stride = (size_t)cvt->dst_w * cvt->bpp;
+    RK_U32 scw = (l->width + 1) / 2;
+    RK_U32 sch = (l->height + 1) / 2;
+    RK_U32 dcw = (cvt->dst_w + 1) / 2;
+    RK_U32 dch = (cvt->dst_h + 1) / 2;
+    RkYuvRowSource luma = { cvt->src, l->hor_stride, l->width, l->bit_depth == 10, 0 };
+    RkYuvRowSource chroma = { cvt->src + (size_t)l->hor_stride * l->ver_stride, l->hor_stride,
+                              2 * scw, l->bit_depth == 10, 1 };
+    const RK_U8 *uv = NULL;
+    RK_S32 last_cy = -1;
+    RK_U32 y;
+
+    if (cvt->dst_w == l->width && cvt->dst_h == l->height) {
+        for (y = y0; y < y1; y++) {
+            if ((RK_S32)(y / 2) != last_cy) {
+                uv = source_row(&chroma, wk->unpacked[2], y / 2);
+                last_cy = y / 2;
+            }
+            convert_row(source_row(&luma, wk->unpacked[0], y), uv,
+                        cvt->dst + y * dst_stride, cvt->dst_w, &cvt->coef, cvt->cfg.format);
+        }
+        return;
+    }
+
+    for (y = y0; y < y1; y++) {
+        RK_U32 sy, f;
+        RK_U32 cy = y / 2;
+
+        map_position(y, l->height, cvt->dst_h, &sy, &f);
+        blend_rows(wk->vrow, source_row(&luma, wk->unpacked[0], sy),
+                   source_row(&luma, wk->unpacked[1], sy + (f ? 1 : 0)), l->width, f);
+        scale_row_h(wk->hrow, wk->vrow, &cvt->luma_tab, cvt->dst_w, 1);
+
+        // Two dst rows share a chroma row
+        if ((RK_S32)cy != last_cy) {
+            map_position(cy < dch ? cy : dch - 1, sch, dch, &sy, &f);
+            blend_rows(wk->vuv, source_row(&chroma, wk->unpacked[2], sy),
+                       source_row(&chroma, wk->unpacked[3], sy + (f ? 1 : 0)), 2 * scw, f);
+            scale_row_h(wk->huv, wk->vuv, &cvt->chroma_tab, dcw, 2);
+            last_cy = cy;
+        }
+
+        convert_row(wk->hrow, wk->huv, cvt->dst + y * dst_stride, cvt->dst_w,
+                    &cvt->coef, cvt->cfg.format);
+    }
+}
+
+// Even-sized row bands so chroma rows are not split between workers
+static void band_rows(RkYuvConverter *cvt, RK_U32 index, RK_U32 *y0, RK_U32 *y1)
+{
+    RK_U32 pairs = (cvt->dst_h + 1) / 2;
+    RK_U32 per = pairs / cvt->worker_count;
+    RK_U32 extra = pairs % cvt->worker_count;
+    RK_U32 start = index * per + (index < extra ? index : extra);
+    RK_U32 count = per + (index < extra ? 1 : 0);
+
+    *y0 = start * 2;
+    *y1 = (start + count) * 2;
+    if (*y1 > cvt->dst_h)
+        *y1 = cvt->dst_h;
+}
+
+static void *worker_thread(void *arg)
+{
+    RkCscWorker *wk = (RkCscWorker *)arg;
+    RkYuvConverter *cvt = wk->cvt;
+    RK_U32 seen = 0;
+
+    if (wk->core >= 0) {
+        cpu_set_t cpuset;
+
+        CPU_ZERO(&cpuset);
+        CPU_SET(wk->core, &cpuset);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset)) {
+            mpp_log("csc worker %d could not be pinned to core %d\n", wk->index, wk->core);
+            wk->core = -1;
+        }
+    }
+
+    for (;;) {
+        RK_U32 y0, y1;
+        double start;
+
+        pthread_mutex_lock(&cvt->lock);
+        while (cvt->generation == seen && !cvt->stop)
+            pthread_cond_wait(&cvt->cond, &cvt->lock);
+        if (cvt->stop) {
+            pthread_mutex_unlock(&cvt->lock);
+            break;
+        }
+        seen = cvt->generation;
+        pthread_mutex_unlock(&cvt->lock);
+
+        start = get_time_in_seconds();
+        band_rows(cvt, wk->index, &y0, &y1);
+        if (y1 > y0)
+            convert_band(cvt, wk, y0, y1);
+        wk->busy += get_time_in_seconds() - start;
+        wk->pixels += (RK_U64)(y1 - y0) * cvt->dst_w;
+
+        pthread_mutex_lock(&cvt->lock);
+        if (!--cvt->pending)
+            pthread_cond_broadcast(&cvt->cond);
+        pthread_mutex_unlock(&cvt->lock);
+    }
+    return NULL;
+}
+
+MPP_RET rk_yuv_converter_init(RkYuvConverter *cvt, const RkCscConfig *cfg)
+{
+    RK_U32 i;
+
+    memset(cvt, 0, sizeof(RkYuvConverter));
+    cvt->cfg = *cfg;
+    cvt->worker_count = cfg->workers ? cfg->workers : CSC_DEFAULT_WORKERS;
+    if (cvt->worker_count > CSC_MAX_WORKERS)
+        cvt->worker_count = CSC_MAX_WORKERS;
+    cvt->bpp = cfg->format == CSC_BGRA ? 4 : 3;
+    rk_csc_coef_init(&cvt->coef, cfg->standard, cfg->full_range);
+
+    pthread_mutex_init(&cvt->lock, NULL);
+    pthread_cond_init(&cvt->cond, NULL);
+
+    for (i = 0; i < cvt->worker_count; i++) {
+        RkCscWorker *wk = &cvt->workers[i];
+
+        wk->cvt = cvt;
+        wk->index = i;
+        wk->core = worker_cores[i];
+        if (pthread_create(&wk->thread, NULL, worker_thread, wk)) {
+            mpp_err("Failed to create csc worker %d\n", i);
+            cvt->worker_count = i;
+            rk_yuv_converter_deinit(cvt);
+            return MPP_NOK;
+        }
+    }
+    return MPP_OK;
+}
+
+void rk_yuv_converter_deinit(RkYuvConverter *cvt)
+{
+    RK_U32 i, j;
+
+    pthread_mutex_lock(&cvt->lock);
+    cvt->stop = 1;
+    pthread_cond_broadcast(&cvt->cond);
+    pthread_mutex_unlock(&cvt->lock);
+
+    for (i = 0; i < cvt->worker_count; i++) {
+        RkCscWorker *wk = &cvt->workers[i];
+
+        pthread_join(wk->thread, NULL);
+        free(wk->vrow);
+        free(wk->hrow);
+        free(wk->vuv);
+        free(wk->huv);
+        for (j = 0; j < 4; j++)
+            free(wk->unpacked[j]);
+        wk->scratch_size = 0;
+    }
+
+    free(cvt->luma_tab.x0);
+    free(cvt->luma_tab.fx);
+    free(cvt->chroma_tab.x0);
+    free(cvt->chroma_tab.fx);
+    memset(&cvt->luma_tab, 0, sizeof(RkCscScaleTab));
+    memset(&cvt->chroma_tab, 0, sizeof(RkCscScaleTab));
+
+    pthread_mutex_destroy(&cvt->lock);
+    pthread_cond_destroy(&cvt->cond);
+}
+
+static void dst_size(const RkYuvConverter *cvt, const RkYuvLayout *layout, RK_U32 *w, RK_U32 *h)
+{
+    *w = cvt->cfg.dst_width ? cvt->cfg.dst_width : layout->width;
+    *h = cvt->cfg.dst_height ? cvt->cfg.dst_height : layout->height;
+}
+
+size_t rk_yuv_converter_out_size(const RkYuvConverter *cvt, const RkYuvLayout *layout)
+{
+    RK_U32 w, h;
+
+    dst_size(cvt, layout, &w, &h);
+    return (size_t)w * h * cvt->bpp;
+}
+
+/*
+ * Convert (and scale) one NV12 frame straight out of its buffer into dst,
+ * rk_yuv_converter_out_size() bytes of packed RGB24/BGRA. Blocks until all
+ * workers have finished their bands. Returns the bytes written, 0 on error.
+ */
+size_t rk_yuv_converter_run(RkYuvConverter *cvt, RK_U8 *dst, const RK_U8 *src,
+                            const RkYuvLayout *layout)
+{
+    RK_U32 i;
+
+    // The scaler reads linear rows only
+    if (layout->tile || layout->fbc) {
+        mpp_err("Cannot convert a %s frame\n", layout->fbc ? "compressed" : "tiled");
+        return 0;
+    }
+    dst_size(cvt, layout, &cvt->dst_w, &cvt->dst_h);
+
+    if (memcmp(&cvt->tab_layout, layout, sizeof(RkYuvLayout))) {
+        RK_U32 scw = (layout->width + 1) / 2;
+        RK_U32 dcw = (cvt->dst_w + 1) / 2;
+        size_t scratch = (layout->width > cvt->dst_w ? layout->width : cvt->dst_w) + 32;
+
+        if (build_tab(&cvt->luma_tab, layout->width, cvt->dst_w) ||
+            build_tab(&cvt->chroma_tab, scw, dcw)) {
+            mpp_err("Failed to allocate scaler tables\n");
+            return 0;
+        }
+        for (i = 0; i < cvt->worker_count; i++) {
+            if (worker_scratch(&cvt->workers[i], scratch)) {
+                mpp_err("Failed to allocate scaler rows\n");
+                return 0;
+            }
+        }
+        cvt->tab_layout = *layout;
+    }
+
+    pthread_mutex_lock(&cvt->lock);
+    cvt->src = src;
+    cvt->dst = dst;
+    cvt->layout = *layout;
+    cvt->pending = cvt->worker_count;
+    cvt->generation++;
+    pthread_cond_broadcast(&cvt->cond);
+    while (cvt->pending)
+        pthread_cond_wait(&cvt->cond, &cvt->lock);
+    pthread_mutex_unlock(&cvt->lock);
+
+    cvt->frames++;
+    return (size_t)cvt->dst_w * cvt->dst_h * cvt->bpp;
+}
@@ -0,0 +1,118 @@
+#ifndef RK_YUV_CONVERT_H
+#define RK_YUV_CONVERT_H
+
+#include <pthread.h>
+#include <rockchip/rk_type.h>
+#include <rockchip/mpp_err.h>
+#include "rk_yuv_crop.h"
+
+#define CSC_MAX_WORKERS         8
+#define CSC_DEFAULT_WORKERS     4
+// Fixed point of the matrix coefficients and of the bilinear weights
+#define CSC_COEF_SHIFT          6
+#define CSC_WEIGHT_SHIFT        7
+
+typedef enum {
+    CSC_BT601 = 0,
+    CSC_BT709,
+} RkCscStandard;
+
+typedef enum {
+    CSC_RGB24 = 0,              // R, G, B bytes
+    CSC_BGRA,                   // B, G, R, 0xff bytes (DRM ARGB8888 little endian)
+} RkCscFormat;
+
+/*
+ * YCbCr -> RGB in Q6: R = Y' + rv * V', G = Y' - gu * U' - gv * V',
+ * B = Y' + bu * U' with Y' = y * (Y - y_off) and U', V' centred on 128.
+ */
+typedef struct {
+    RK_S16          y;
+    RK_S16          rv;
+    RK_S16          gu;
+    RK_S16          gv;
+    RK_S16          bu;
+    RK_S16          y_off;
+} RkCscCoef;
+
+typedef struct {
+    RkCscStandard   standard;
+    RK_U32          full_range;
+    RkCscFormat     format;
+    RK_U32          dst_width;          // 0 keeps the picture size
+    RK_U32          dst_height;
+    RK_U32          workers;
+} RkCscConfig;
+
+// Source x positions for one scaled row, shared by every worker
+typedef struct {
+    RK_U16         *x0;
+    RK_U8          *fx;                 // weight of x0 + 1, 0..128
+    RK_U32          count;
+} RkCscScaleTab;
+
+typedef struct RkYuvConverter RkYuvConverter;
+
+typedef struct {
+    RkYuvConverter *cvt;
+    pthread_t       thread;
+    int             core;
+    RK_U32          index;
+
+    // Row scratch for the scaler: vertically blended, then horizontally
+    RK_U8          *vrow;
+    RK_U8          *hrow;
+    RK_U8          *vuv;
+    RK_U8          *huv;
+    RK_U8          *unpacked[4];        // 10-bit source rows at 8 bits: luma a, b, chroma a, b
+    size_t          scratch_size;
+
+    RK_U64          pixels;
+    double          busy;
+} RkCscWorker;
+
+struct RkYuvConverter {
+    RkCscConfig     cfg;
+    RkCscCoef       coef;
+    RK_U32          bpp;
+
+    RkCscWorker     workers[CSC_MAX_WORKERS];
+    RK_U32          worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    RK_U32          generation;         // bumped per frame
+    RK_U32          pending;            // workers still on this frame
+    RK_U32          stop;
+
+    // Current frame
+    const RK_U8    *src;
+    RkYuvLayout     layout;
+    RK_U8          *dst;
+    RK_U32          dst_w;
+    RK_U32          dst_h;
+    RkCscScaleTab   luma_tab;
+    RkCscScaleTab   chroma_tab;
+    RkYuvLayout     tab_layout;         // layout the tables were built for
+
+    RK_U64          frames;
+};
+
+// Function declarations
+void rk_csc_coef_init(RkCscCoef *coef, RkCscStandard standard, RK_U32 full_range);
+void rk_nv12_row_to_rgb_scalar(const RK_U8 *y, const RK_U8 *uv, RK_U8 *dst, RK_U32 width,
+                               const RkCscCoef *coef, RkCscFormat format);
+void rk_blend_rows_scalar(RK_U8 *dst, const RK_U8 *a, const RK_U8 *b, RK_U32 len, RK_U32 f);
+#ifdef __ARM_NEON
+void rk_nv12_row_to_rgb_neon(const RK_U8 *y, const RK_U8 *uv, RK_U8 *dst, RK_U32 width,
+                             const RkCscCoef *coef, RkCscFormat format);
+void rk_blend_rows_neon(RK_U8 *dst, const RK_U8 *a, const RK_U8 *b, RK_U32 len, RK_U32 f);
+#endif
+
+MPP_RET rk_yuv_converter_init(RkYuvConverter *cvt, const RkCscConfig *cfg);
+void rk_yuv_converter_deinit(RkYuvConverter *cvt);
+size_t rk_yuv_converter_out_size(const RkYuvConverter *cvt, const RkYuvLayout *layout);
+size_t rk_yuv_converter_run(RkYuvConverter *cvt, RK_U8 *dst, const RK_U8 *src,
+                            const RkYuvLayout *layout);
+const char *rk_csc_format_name(RkCscFormat format);
+
+#endif // RK_YUV_CONVERT_H
@@ -0,0 +1,475 @@
+#include "rk_yuv_crop.h"
+#include "rk_fbc.h"
+#include <string.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// Pieces of a row staged for a second pass, a multiple of any tile width
+#define YUV_CHUNK               4096
+
+static const char *format_names[] = { "raw", "nv12", "i420", "fbc", "p010" };
+
+/*
+ * 2x2 ordered dither added before dropping the two low bits of 10-bit
+ * samples, for even and odd rows. Chroma pairs share their pixel's value.
+ */
+static const RK_U16 dither_luma[2][8] = {
+    { 0, 2, 0, 2, 0, 2, 0, 2 },
+    { 3, 1, 3, 1, 3, 1, 3, 1 },
+};
+static const RK_U16 dither_chroma[2][8] = {
+    { 0, 0, 2, 2, 0, 0, 2, 2 },
+    { 3, 3, 1, 1, 3, 3, 1, 1 },
+};
+
+const char *rk_yuv_out_format_name(RkYuvOutFormat fmt)
+{
+    return fmt <= YUV_OUT_P010 ? format_names[fmt] : "unknown";
+}
+
+/*
+ * The format frames of this layout are really stored in: P010 needs 10-bit
+ * frames and 8-bit ones stay NV12, FBC needs compressed ones, and tiled
+ * 10-bit frames are stored as the decoder wrote them.
+ */
+RkYuvOutFormat rk_yuv_out_format_for(const RkYuvLayout *layout, RkYuvOutFormat fmt)
+{
+    if (fmt == YUV_OUT_FBC)
+        return layout->fbc ? fmt : YUV_OUT_RAW;
+    if (fmt == YUV_OUT_P010 && layout->bit_depth != 10)
+        return YUV_OUT_NV12;
+    if (fmt != YUV_OUT_RAW && layout->tile && layout->bit_depth == 10)
+        return YUV_OUT_RAW;
+    return fmt;
+}
+
+size_t rk_yuv_out_size(const RkYuvLayout *layout, RkYuvOutFormat fmt)
+{
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+    size_t samples = (size_t)layout->width * layout->height + 2 * cw * ch;
+
+    fmt = rk_yuv_out_format_for(layout, fmt);
+    // An FBC frame takes at most this, its heads tell what it really holds
+    if (fmt == YUV_OUT_FBC) {
+        RkFbcLayout fbc;
+
+        rk_fbc_layout(&fbc, layout->width, layout->height);
+        return fbc.max_size;
+    }
+    if (fmt == YUV_OUT_RAW)
+        return (size_t)layout->hor_stride * layout->ver_stride * 3 / 2;
+    return fmt == YUV_OUT_P010 ? 2 * samples : samples;
+}
+
+void rk_copy_row_scalar(RK_U8 *dst, const RK_U8 *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+void rk_split_uv_row_scalar(RK_U8 *u, RK_U8 *v, const RK_U8 *uv, size_t pairs)
+{
+    size_t i;
+
+    for (i = 0; i < pairs; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+/*
+ * rows picture rows of one tile row: tiles of tile_w bytes x tile_h rows
+ * stored one after the other, len bytes of each row wanted. src may point
+ * at a row inside the first tile.
+ */
+void rk_detile_rows_scalar(RK_U8 *dst, size_t dst_stride, const RK_U8 *src, RK_U32 tile_w,
+                           RK_U32 tile_h, RK_U32 rows, size_t len)
+{
+    size_t tile_size = (size_t)tile_w * tile_h;
+    size_t x;
+    RK_U32 r;
+
+    for (x = 0; x < len; x += tile_w, src += tile_size) {
+        size_t n = len - x < tile_w ? len - x : tile_w;
+
+        for (r = 0; r < rows; r++)
+            memcpy(dst + r * dst_stride + x, src + r * tile_w, n);
+    }
+}
+
+// Sample i of a compact 10-bit row: bit 10i on, little endian
+static inline RK_U32 sample10(const RK_U8 *src, size_t i)
+{
+    size_t bit = i * 10;
+
+    return ((src[bit / 8] | (src[bit / 8 + 1] << 8)) >> (bit % 8)) & 0x3ff;
+}
+
+// count 10-bit samples to P010 words, the sample in the top bits
+void rk_unpack10_row_16_scalar(RK_U16 *dst, const RK_U8 *src, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        dst[i] = sample10(src, i) << 6;
+}
+
+// count 10-bit samples to 8 bits, dither[i % 8] added before the shift
+void rk_unpack10_row_8_scalar(RK_U8 *dst, const RK_U8 *src, size_t count, const RK_U16 *dither)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        RK_U32 v = (sample10(src, i) + dither[i & 7]) >> 2;
+
+        dst[i] = v > 255 ? 255 : v;
+    }
+}
+
+#ifdef __ARM_NEON
+// 64 bytes per iteration through four q registers, memcpy for the tail
+void rk_copy_row_neon(RK_U8 *dst, const RK_U8 *src, size_t len)
+{
+    while (len >= 64) {
+        uint8x16_t a = vld1q_u8(src);
+        uint8x16_t b = vld1q_u8(src + 16);
+        uint8x16_t c = vld1q_u8(src + 32);
+        uint8x16_t d = vld1q_u8(src + 48);
+
+        vst1q_u8(dst, a);
+        vst1q_u8(dst + 16, b);
+        vst1q_u8(dst + 32, c);
+        vst1q_u8(dst + 48, d);
+        src += 64;
+        dst += 64;
+        len -= 64;
+    }
+    if (len)
+        memcpy(dst, src, len);
+}
+
+// vld2q deinterleaves CbCr pairs straight into the two planes
+void rk_split_uv_row_neon(RK_U8 *u, RK_U8 *v, const RK_U8 *uv, size_t pairs)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= pairs; i += 32) {
+        uint8x16x2_t a = vld2q_u8(uv + 2 * i);
+        uint8x16x2_t b = vld2q_u8(uv + 2 * i + 32);
+
+        vst1q_u8(u + i, a.val[0]);
+        vst1q_u8(v + i, a.val[1]);
+        vst1q_u8(u + i + 16, b.val[0]);
+        vst1q_u8(v + i + 16, b.val[1]);
+    }
+    rk_split_uv_row_scalar(u + i, v + i, uv + 2 * i, pairs - i);
+}
+
+/*
+ * 8-byte tiles go in pairs, so each picture row gets one 16-byte store per
+ * two tiles; the tiles themselves are read front to back.
+ */
+void rk_detile_rows_neon(RK_U8 *dst, size_t dst_stride, const RK_U8 *src, RK_U32 tile_w,
+                         RK_U32 tile_h, RK_U32 rows, size_t len)
+{
+    size_t tile_size = (size_t)tile_w * tile_h;
+    size_t x = 0;
+    RK_U32 r;
+
+    if (tile_w == 8) {
+        for (; x + 16 <= len; x += 16, src += 2 * tile_size) {
+            for (r = 0; r < rows; r++)
+                vst1q_u8(dst + r * dst_stride + x,
+                         vcombine_u8(vld1_u8(src + r * 8), vld1_u8(src + tile_size + r * 8)));
+        }
+    } else if (tile_w == 16) {
+        for (; x + 16 <= len; x += 16, src += tile_size) {
+            for (r = 0; r < rows; r++)
+                vst1q_u8(dst + r * dst_stride + x, vld1q_u8(src + r * 16));
+        }
+    }
+    rk_detile_rows_scalar(dst + x, dst_stride, src, tile_w, tile_h, rows, len - x);
+}
+
+// Byte pairs holding each of 8 samples in 10 bytes, and their right shifts
+static const RK_U8 unpack10_index[16] = { 0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9 };
+static const RK_S16 unpack10_shift[8] = { 0, -2, -4, -6, 0, -2, -4, -6 };
+
+/*
+ * Eight samples from the 10 bytes at src: a table lookup gathers the two
+ * bytes of each sample into a 16-bit lane, a per-lane shift and a mask
+ * leave the sample. Reads 16 bytes.
+ */
+static inline uint16x8_t unpack10x8(const RK_U8 *src, uint8x8_t idx_lo, uint8x8_t idx_hi,
+                                    int16x8_t shift)
+{
+    uint8x16_t b = vld1q_u8(src);
+    uint8x8x2_t t = { { vget_low_u8(b), vget_high_u8(b) } };
+    uint8x16_t pairs = vcombine_u8(vtbl2_u8(t, idx_lo), vtbl2_u8(t, idx_hi));
+
+    return vandq_u16(vshlq_u16(vreinterpretq_u16_u8(pairs), shift), vdupq_n_u16(0x3ff));
+}
+
+// The loop stops 16 samples short of the end so the 16-byte loads stay in the row
+void rk_unpack10_row_16_neon(RK_U16 *dst, const RK_U8 *src, size_t count)
+{
+    uint8x8_t idx_lo = vld1_u8(unpack10_index);
+    uint8x8_t idx_hi = vld1_u8(unpack10_index + 8);
+    int16x8_t shift = vld1q_s16(unpack10_shift);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 8)
+        vst1q_u16(dst + i, vshlq_n_u16(unpack10x8(src + i / 4 * 5, idx_lo, idx_hi, shift), 6));
+    for (; i < count; i++)
+        dst[i] = sample10(src, i) << 6;
+}
+
+// Dither added and narrowed with saturation in one step per eight samples
+void rk_unpack10_row_8_neon(RK_U8 *dst, const RK_U8 *src, size_t count, const RK_U16 *dither)
+{
+    uint8x8_t idx_lo = vld1_u8(unpack10_index);
+    uint8x8_t idx_hi = vld1_u8(unpack10_index + 8);
+    int16x8_t shift = vld1q_s16(unpack10_shift);
+    uint16x8_t d = vld1q_u16(dither);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 8) {
+        uint16x8_t v = unpack10x8(src + i / 4 * 5, idx_lo, idx_hi, shift);
+
+        vst1_u8(dst + i, vqshrn_n_u16(vaddq_u16(v, d), 2));
+    }
+    rk_unpack10_row_8_scalar(dst + i, src + i / 4 * 5, count - i, dither);
+}
+#endif
+
+const RkYuvRowOps rk_yuv_row_ops_scalar = {
+    .copy_row           = rk_copy_row_scalar,
+    .split_uv_row       = rk_split_uv_row_scalar,
+    .detile_rows        = rk_detile_rows_scalar,
+    .unpack10_row_16    = rk_unpack10_row_16_scalar,
+    .unpack10_row_8     = rk_unpack10_row_8_scalar,
+};
+
+#ifdef __ARM_NEON
+const RkYuvRowOps rk_yuv_row_ops_neon = {
+    .copy_row           = rk_copy_row_neon,
+    .split_uv_row       = rk_split_uv_row_neon,
+    .detile_rows        = rk_detile_rows_neon,
+    .unpack10_row_16    = rk_unpack10_row_16_neon,
+    .unpack10_row_8     = rk_unpack10_row_8_neon,
+};
+#endif
+
+/*
+ * Compact 10-bit frame to P010, or to 8 bits with ordered dither for NV12
+ * and I420. I420 chroma goes through a small stage to be split.
+ */
+static size_t unpack_10bit(RK_U8 *dst, const RK_U8 *src, const RkYuvLayout *layout,
+                           RkYuvOutFormat fmt, const RkYuvRowOps *ops)
+{
+    const RK_U8 *uv = src + (size_t)layout->hor_stride * layout->ver_stride;
+    size_t stride = layout->hor_stride;
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+    RK_U8 chunk[YUV_CHUNK];
+    RK_U8 *out = dst;
+    RK_U8 *u, *v;
+    RK_U32 y;
+    size_t x;
+
+    if (fmt == YUV_OUT_P010) {
+        RK_U16 *p = (RK_U16 *)dst;
+
+        for (y = 0; y < layout->height; y++, p += layout->width)
+            ops->unpack10_row_16(p, src + y * stride, layout->width);
+        for (y = 0; y < ch; y++, p += 2 * cw)
+            ops->unpack10_row_16(p, uv + y * stride, 2 * cw);
+        return (RK_U8 *)p - dst;
+    }
+
+    for (y = 0; y < layout->height; y++, out += layout->width)
+        ops->unpack10_row_8(out, src + y * stride, layout->width, dither_luma[y & 1]);
+
+    if (fmt == YUV_OUT_NV12) {
+        for (y = 0; y < ch; y++, out += 2 * cw)
+            ops->unpack10_row_8(out, uv + y * stride, 2 * cw, dither_chroma[y & 1]);
+        return out - dst;
+    }
+
+    // Chunks start on a 4-sample group, 5 bytes each
+    u = out;
+    v = out + cw * ch;
+    for (y = 0; y < ch; y++, u += cw, v += cw) {
+        for (x = 0; x < cw; x += YUV_CHUNK / 2) {
+            size_t n = cw - x < YUV_CHUNK / 2 ? cw - x : YUV_CHUNK / 2;
+
+            ops->unpack10_row_8(chunk, uv + y * stride + 2 * x / 4 * 5, 2 * n,
+                                dither_chroma[y & 1]);
+            ops->split_uv_row(u + x, v + x, chunk, n);
+        }
+    }
+    return v - dst;
+}
+
+/*
+ * Tiled frame (TRM 5.3.5) to linear NV12 or I420: a tile row of the plane
+ * is rows picture rows, stored tile by tile. Chroma tiles are as wide in
+ * bytes as luma tiles and half as tall.
+ */
+static size_t detile_frame(RK_U8 *dst, const RK_U8 *src, const RkYuvLayout *layout,
+                           RkYuvOutFormat fmt, const RkYuvRowOps *ops)
+{
+    const RK_U8 *uv = src + (size_t)layout->hor_stride * layout->ver_stride;
+    size_t stride = layout->hor_stride;
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+    RK_U32 t = layout->tile;
+    RK_U8 chunk[YUV_CHUNK];
+    RK_U8 *out = dst;
+    RK_U8 *u, *v;
+    RK_U32 y;
+    size_t x;
+
+    for (y = 0; y < layout->height; y += t) {
+        RK_U32 rows = layout->height - y < t ? layout->height - y : t;
+
+        ops->detile_rows(out + (size_t)y * layout->width, layout->width, src + y * stride,
+                         t, t, rows, layout->width);
+    }
+    out += (size_t)layout->width * layout->height;
+
+    if (fmt == YUV_OUT_NV12) {
+        for (y = 0; y < ch; y += t / 2) {
+            RK_U32 rows = ch - y < t / 2 ? ch - y : t / 2;
+
+            ops->detile_rows(out + y * 2 * cw, 2 * cw, uv + y * stride, t, t / 2, rows, 2 * cw);
+        }
+        return out + 2 * cw * ch - dst;
+    }
+
+    // One chroma row at a time into the stage, then split
+    u = out;
+    v = out + cw * ch;
+    for (y = 0; y < ch; y++, u += cw, v += cw) {
+        RK_U32 r = y % (t / 2);
+        const RK_U8 *row = uv + (y - r) * stride + r * t;
+
+        for (x = 0; x < 2 * cw; x += YUV_CHUNK) {
+            size_t n = 2 * cw - x < YUV_CHUNK ? 2 * cw - x : YUV_CHUNK;
+
+            ops->detile_rows(chunk, 0, row + x / t * t * (t / 2), t, t / 2, 1, n);
+            ops->split_uv_row(u + x / 2, v + x / 2, chunk, n / 2);
+        }
+    }
+    return v - dst;
+}
+
+/*
+ * Pack the visible width x height of an NV12 frame into dst, dropping the
+ * stride padding. 10-bit and tiled frames are unpacked or detiled on the
+ * way, as rk_yuv_out_format_for() picks. Returns the bytes written,
+ * rk_yuv_out_size() of the same layout.
+ */
+size_t rk_yuv_crop_with(RK_U8 *dst, const RK_U8 *src, const RkYuvLayout *layout,
+                        RkYuvOutFormat fmt, const RkYuvRowOps *ops)
+{
+    const RK_U8 *uv = src + (size_t)layout->hor_stride * layout->ver_stride;
+    size_t stride = layout->hor_stride;
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+    RK_U8 *out = dst;
+    RK_U32 y;
+
+    fmt = rk_yuv_out_format_for(layout, fmt);
+    if (fmt == YUV_OUT_RAW || fmt == YUV_OUT_FBC) {
+        size_t len = rk_yuv_out_size(layout, fmt);
+
+        ops->copy_row(dst, src, len);
+        return len;
+    }
+    if (layout->bit_depth == 10)
+        return unpack_10bit(dst, src, layout, fmt, ops);
+    if (layout->tile)
+        return detile_frame(dst, src, layout, fmt, ops);
+
+    for (y = 0; y < layout->height; y++) {
+        // Start pulling in the next row while this one is copied
+        __builtin_prefetch(src + stride);
+        ops->copy_row(out, src, layout->width);
+        src += stride;
+        out += layout->width;
+    }
+
+    if (fmt == YUV_OUT_NV12) {
+        for (y = 0; y < ch; y++) {
+            __builtin_prefetch(uv + stride);
+            ops->copy_row(out, uv, 2 * cw);
+            uv += stride;
+            out += 2 * cw;
+        }
+    } else {
+        RK_U8 *u = out;
+        RK_U8 *v = out + cw * ch;
+
+        for (y = 0; y < ch; y++) {
+            __builtin_prefetch(uv + stride);
+            ops->split_uv_row(u, v, uv, cw);
+            uv += stride;
+            u += cw;
+            v += cw;
+        }
+        out = v;
+    }
+
+    return out - dst;
+}
+
+// One 10-bit row of count samples to 8 bits with the crop's dither for row y
+void rk_unpack10_row_dither(RK_U8 *dst, const RK_U8 *src, size_t count, RK_U32 y, RK_U32 chroma)
+{
+    const RK_U16 *dither = chroma ? dither_chroma[y & 1] : dither_luma[y & 1];
+
+#ifdef __ARM_NEON
+    rk_unpack10_row_8_neon(dst, src, count, dither);
+#else
+    rk_unpack10_row_8_scalar(dst, src, count, dither);
+#endif
+}
+
+/*
+ * 10-bit frame to 8-bit NV12 at the given strides, for a consumer that
+ * wants a padded NV12 buffer rather than tight rows. Same dither as the
+ * crop; the padding is left as it was.
+ */
+void rk_yuv_unpack10_nv12(RK_U8 *dst, RK_U32 hor_stride, RK_U32 ver_stride, const RK_U8 *src,
+                          const RkYuvLayout *layout)
+{
+#ifdef __ARM_NEON
+    const RkYuvRowOps *ops = &rk_yuv_row_ops_neon;
+#else
+    const RkYuvRowOps *ops = &rk_yuv_row_ops_scalar;
+#endif
+    const RK_U8 *uv = src + (size_t)layout->hor_stride * layout->ver_stride;
+    RK_U8 *out = dst + (size_t)hor_stride * ver_stride;
+    size_t stride = layout->hor_stride;
+    size_t cw = (layout->width + 1) / 2;
+    size_t ch = (layout->height + 1) / 2;
+    RK_U32 y;
+
+    for (y = 0; y < layout->height; y++)
+        ops->unpack10_row_8(dst + (size_t)y * hor_stride, src + y * stride, layout->width,
+                            dither_luma[y & 1]);
+    for (y = 0; y < ch; y++)
+        ops->unpack10_row_8(out + (size_t)y * hor_stride, uv + y * stride, 2 * cw,
+                            dither_chroma[y & 1]);
+}
+
+size_t rk_yuv_crop(RK_U8 *dst, const RK_U8 *src, const RkYuvLayout *layout, RkYuvOutFormat fmt)
+{
+#ifdef __ARM_NEON
+    return rk_yuv_crop_with(dst, src, layout, fmt, &rk_yuv_row_ops_neon);
+#else
+    return rk_yuv_crop_with(dst, src, layout, fmt, &rk_yuv_row_ops_scalar);
+#endif
+}
@@ -0,0 +1,71 @@
+#ifndef RK_YUV_CROP_H
+#define RK_YUV_CROP_H
+
+#include <stddef.h>
+#include <rockchip/rk_type.h>
+
+// What the writer stores per frame
+typedef enum {
+    YUV_OUT_RAW = 0,            // whole NV12 buffer, stride padding included
+    YUV_OUT_NV12,               // width x height, semi-planar (TRM 5.3.2)
+    YUV_OUT_I420,               // width x height, planar Y, Cb, Cr (TRM 5.3.1)
+    YUV_OUT_FBC,                // compressed frame as the decoder wrote it (TRM 5.3.8)
+    YUV_OUT_P010,               // width x height, 10-bit in the top of 16-bit words, semi-planar
+} RkYuvOutFormat;
+
+// Luma tile edge of tiled decoder output on the RK3588 (TRM 5.4.5): 8x8
+// luma, 8 bytes x 4 rows of CbCr per tile
+#define YUV_TILE_SIZE           8
+
+// Decoded NV12 frame geometry: chroma plane follows hor_stride * ver_stride luma
+typedef struct {
+    RK_U32          width;
+    RK_U32          height;
+    RK_U32          hor_stride;
+    RK_U32          ver_stride;
+    RK_U32          fbc;                // FBC heads and payload instead, see rk_fbc.h
+    RK_U32          bit_depth;          // 10: compact, 4 samples in 5 bytes; hor_stride in bytes
+    RK_U32          tile;               // tiled planes (TRM 5.3.5): luma tile edge, 0 = linear
+} RkYuvLayout;
+
+// Row kernels used by the crop, swappable for benchmarking
+typedef struct {
+    void (*copy_row)(RK_U8 *dst, const RK_U8 *src, size_t len);
+    void (*split_uv_row)(RK_U8 *u, RK_U8 *v, const RK_U8 *uv, size_t pairs);
+    void (*detile_rows)(RK_U8 *dst, size_t dst_stride, const RK_U8 *src, RK_U32 tile_w,
+                        RK_U32 tile_h, RK_U32 rows, size_t len);
+    void (*unpack10_row_16)(RK_U16 *dst, const RK_U8 *src, size_t count);
+    void (*unpack10_row_8)(RK_U8 *dst, const RK_U8 *src, size_t count, const RK_U16 *dither);
+} RkYuvRowOps;
+
+extern const RkYuvRowOps rk_yuv_row_ops_scalar;
+#ifdef __ARM_NEON
+extern const RkYuvRowOps rk_yuv_row_ops_neon;
+#endif
+
+// Function declarations
+RkYuvOutFormat rk_yuv_out_format_for(const RkYuvLayout *layout, RkYuvOutFormat fmt);
+size_t rk_yuv_out_size(const RkYuvLayout *layout, RkYuvOutFormat fmt);
+size_t rk_yuv_crop(RK_U8 *dst, const RK_U8 *src, const RkYuvLayout *layout, RkYuvOutFormat fmt);
+size_t rk_yuv_crop_with(RK_U8 *dst, const RK_U8 *src, const RkYuvLayout *layout,
+                        RkYuvOutFormat fmt, const RkYuvRowOps *ops);
+void rk_unpack10_row_dither(RK_U8 *dst, const RK_U8 *src, size_t count, RK_U32 y, RK_U32 chroma);
+void rk_yuv_unpack10_nv12(RK_U8 *dst, RK_U32 hor_stride, RK_U32 ver_stride, const RK_U8 *src,
+                          const RkYuvLayout *layout);
+void rk_copy_row_scalar(RK_U8 *dst, const RK_U8 *src, size_t len);
+void rk_split_uv_row_scalar(RK_U8 *u, RK_U8 *v, const RK_U8 *uv, size_t pairs);
+void rk_detile_rows_scalar(RK_U8 *dst, size_t dst_stride, const RK_U8 *src, RK_U32 tile_w,
+                           RK_U32 tile_h, RK_U32 rows, size_t len);
+void rk_unpack10_row_16_scalar(RK_U16 *dst, const RK_U8 *src, size_t count);
+void rk_unpack10_row_8_scalar(RK_U8 *dst, const RK_U8 *src, size_t count, const RK_U16 *dither);
+#ifdef __ARM_NEON
+void rk_copy_row_neon(RK_U8 *dst, const RK_U8 *src, size_t len);
+void rk_split_uv_row_neon(RK_U8 *u, RK_U8 *v, const RK_U8 *uv, size_t pairs);
+void rk_detile_rows_neon(RK_U8 *dst, size_t dst_stride, const RK_U8 *src, RK_U32 tile_w,
+                         RK_U32 tile_h, RK_U32 rows, size_t len);
+void rk_unpack10_row_16_neon(RK_U16 *dst, const RK_U8 *src, size_t count);
+void rk_unpack10_row_8_neon(RK_U8 *dst, const RK_U8 *src, size_t count, const RK_U16 *dither);
+#endif
+const char *rk_yuv_out_format_name(RkYuvOutFormat fmt);
+
+#endif // RK_YUV_CROP_H
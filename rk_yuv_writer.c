@@ -0,0 +1,825 @@
+#include "rk_yuv_writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <rockchip/mpp_log.h>
+
+static const char *mode_names[] = { "sync", "thread", "direct", "uring", "null", "crc" };
+
+const char *rk_yuv_writer_mode_name(RkYuvWriterMode mode)
+{
+    return mode <= YUV_WRITER_CRC ? mode_names[mode] : "unknown";
+}
+
+// Benchmark modes decode without writing anything
+RK_U32 rk_yuv_writer_has_file(RkYuvWriterMode mode)
+{
+    return mode != YUV_WRITER_NULL && mode != YUV_WRITER_CRC;
+}
+
+static double get_time_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Frames are repacked (cropped or colour converted) rather than written as is
+static int needs_pack(const RkYuvWriter *w)
+{
+    RK_U32 pack = w->format == YUV_OUT_FBC ? w->fbc_roi.width != 0 : w->format != YUV_OUT_RAW;
+
+    return rk_yuv_writer_has_file(w->mode) && (w->cvt || pack);
+}
+
+// Bytes per frame in the file; crc mode counts the picture it checksums
+static size_t out_size(const RkYuvWriter *w, const RkYuvLayout *layout)
+{
+    if (w->mode == YUV_WRITER_NULL)
+        return 0;
+    if (w->mode == YUV_WRITER_CRC)
+        return rk_yuv_out_size(layout, YUV_OUT_NV12);
+    return w->cvt ? rk_yuv_converter_out_size(w->cvt, layout) : rk_yuv_out_size(layout, w->format);
+}
+
+// Crop or convert the frame of e into dst, out_size() bytes
+static MPP_RET pack_frame(RkYuvWriter *w, RK_U8 *dst, RkYuvWriterEntry *e)
+{
+    const RK_U8 *src = mpp_buffer_get_ptr(e->buf);
+    double start = get_time_in_seconds();
+
+    if (w->cvt) {
+        if (!rk_yuv_converter_run(w->cvt, dst, src, &e->layout))
+            return MPP_NOK;
+    } else if (w->format == YUV_OUT_FBC && e->layout.fbc) {
+        RkFbcLayout fbc;
+
+        rk_fbc_layout(&fbc, e->layout.width, e->layout.height);
+        rk_fbc_extract(dst, src, &fbc, &w->fbc_roi);
+    } else {
+        // Detiled or unpacked on the way; a linear frame for fbc is stored as is
+        rk_yuv_crop(dst, src, &e->layout, w->format);
+    }
+    w->copy_time += get_time_in_seconds() - start;
+    w->copy_bytes += e->len;
+    return MPP_OK;
+}
+
+/*
+ * Read the heads of an FBC frame on the caller's thread: what the frame
+ * holds in DDR goes into the statistics, and the bytes it puts in the file
+ * are only known from them. Whole frames are written from the buffer up
+ * to the end of the payload, a region is cut out by pack_frame().
+ */
+static size_t scan_fbc(RkYuvWriter *w, MppBuffer buf, const RkYuvLayout *layout)
+{
+    const RK_U8 *base = mpp_buffer_get_ptr(buf);
+    double start = get_time_in_seconds();
+    RkFbcLayout fbc;
+    RkFbcStats st;
+    size_t len;
+
+    rk_fbc_layout(&fbc, layout->width, layout->height);
+    rk_fbc_stats(base, &fbc, &st);
+    rk_fbc_stats_add(&w->fbc, &st);
+    w->fbc_frames++;
+    len = st.frame_bytes;
+    if (w->fbc_roi.width) {
+        len = rk_fbc_roi_size(base, &fbc, &w->fbc_roi);
+        w->fbc_roi_bytes += len;
+    }
+    w->fbc_scan_time += get_time_in_seconds() - start;
+    return len;
+}
+
+// pwritev until every byte of iov is written; iov is consumed
+static MPP_RET pwritev_full(int fd, struct iovec *iov, int count, off_t offset)
+{
+    while (count) {
+        ssize_t n = pwritev(fd, iov, count, offset);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            mpp_err("output write failed: %s\n", strerror(errno));
+            return MPP_NOK;
+        }
+        offset += n;
+
+        while (count && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count) {
+            iov->iov_base = (RK_U8 *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return MPP_OK;
+}
+
+// Drop the n oldest entries, giving their buffers back to the decoder
+static void release_entries(RkYuvWriter *w, RK_U32 n)
+{
+    double now = w->done_cb ? get_time_in_seconds() : 0;
+
+    pthread_mutex_lock(&w->lock);
+    while (n--) {
+        RkYuvWriterEntry *e = &w->queue[w->head];
+
+        if (w->done_cb)
+            w->done_cb(w->done_opaque, e->pushed, now);
+        if (e->buf) {
+            mpp_buffer_put(e->buf);
+            e->buf = NULL;
+        }
+        rk_pool_put(&w->pack_pool, e->pack);
+        e->pack = NULL;
+        w->head = (w->head + 1) % w->depth;
+        w->count--;
+        w->taken--;
+    }
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void set_error(RkYuvWriter *w, MPP_RET ret)
+{
+    pthread_mutex_lock(&w->lock);
+    if (!w->error)
+        w->error = ret;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * Pack buffers are depth blocks of one prefaulted pool, sized for the
+ * largest frame so far. A bigger frame rebuilds the pool, which must only
+ * happen while no entry holds a block.
+ */
+static MPP_RET size_pack_pool(RkYuvWriter *w, size_t len)
+{
+    if (w->pack_pool.base && w->pack_pool.block_size >= len)
+        return MPP_OK;
+
+    if (w->pack_pool.base)
+        rk_pool_deinit(&w->pack_pool);
+    if (rk_pool_init(&w->pack_pool, len, w->depth, YUV_WRITER_ALIGN, RK_ALLOC_POPULATE)) {
+        mpp_err("Failed to allocate %d pack buffers of %zu bytes\n", w->depth, len);
+        return MPP_ERR_MALLOC;
+    }
+    return MPP_OK;
+}
+
+/*
+ * Crop the frame into a pack buffer and hand the frame buffer back to the
+ * decoder right away; the write goes out from the copy. The block goes
+ * back to the pool with the entry.
+ */
+static MPP_RET pack_entry(RkYuvWriter *w, RkYuvWriterEntry *e)
+{
+    if (!e->pack) {
+        if (size_pack_pool(w, e->len))
+            return MPP_ERR_MALLOC;
+        e->pack = rk_pool_get(&w->pack_pool);
+        if (!e->pack) {
+            mpp_err("Pack buffers exhausted\n");
+            return MPP_NOK;
+        }
+    }
+
+    if (pack_frame(w, e->pack, e))
+        return MPP_NOK;
+
+    mpp_buffer_put(e->buf);
+    e->buf = NULL;
+    return MPP_OK;
+}
+
+// Gather n queued frames starting at index first into iov
+static size_t fill_iov(RkYuvWriter *w, RK_U32 first, RK_U32 n, struct iovec *iov)
+{
+    size_t len = 0;
+    RK_U32 i;
+
+    for (i = 0; i < n; i++) {
+        RkYuvWriterEntry *e = &w->queue[(first + i) % w->depth];
+
+        iov[i].iov_base = e->buf ? mpp_buffer_get_ptr(e->buf) : e->pack;
+        iov[i].iov_len = e->len;
+        len += e->len;
+    }
+    return len;
+}
+
+/*
+ * Crop or convert every frame of a batch, if the output asks for it. The
+ * pack pool is sized for the whole batch first, while the blocks are all
+ * back: the previous batch is written, in flight ones are waited out by
+ * the caller.
+ */
+static MPP_RET pack_batch(RkYuvWriter *w, RK_U32 first, RK_U32 n)
+{
+    size_t len = 0;
+    RK_U32 i;
+
+    if (!needs_pack(w))
+        return MPP_OK;
+
+    for (i = 0; i < n; i++) {
+        RkYuvWriterEntry *e = &w->queue[(first + i) % w->depth];
+
+        if (e->len > len)
+            len = e->len;
+    }
+    if (size_pack_pool(w, len))
+        return MPP_ERR_MALLOC;
+
+    for (i = 0; i < n; i++) {
+        if (pack_entry(w, &w->queue[(first + i) % w->depth]))
+            return MPP_NOK;
+    }
+    return MPP_OK;
+}
+
+static MPP_RET write_batch(RkYuvWriter *w, RK_U32 first, RK_U32 n)
+{
+    struct iovec iov[YUV_WRITER_BATCH];
+    size_t len;
+    double start;
+    MPP_RET ret;
+
+    if (pack_batch(w, first, n))
+        return MPP_NOK;
+
+    len = fill_iov(w, first, n, iov);
+    start = get_time_in_seconds();
+    ret = pwritev_full(w->fd, iov, n, w->offset);
+
+    w->write_time += get_time_in_seconds() - start;
+    w->offset += len;
+    w->writes++;
+    return ret;
+}
+
+/*
+ * Checksum n queued frames straight from their buffers. Busy time counts
+ * as write time, so the summary shows what verification costs.
+ */
+static MPP_RET checksum_batch(RkYuvWriter *w, RK_U32 first, RK_U32 n)
+{
+    double start = get_time_in_seconds();
+    MPP_RET ret = MPP_OK;
+    RK_U32 i;
+
+    for (i = 0; i < n && !ret; i++) {
+        RkYuvWriterEntry *e = &w->queue[(first + i) % w->depth];
+        RK_U32 crc = rk_frame_crc(mpp_buffer_get_ptr(e->buf), &e->layout);
+
+        if (w->crcs)
+            ret = rk_crc_list_add(w->crcs, crc, e->layout.width, e->layout.height);
+    }
+    w->write_time += get_time_in_seconds() - start;
+    return ret;
+}
+
+// Write the first len bytes of the stage, keep whatever follows them
+static MPP_RET flush_stage(RkYuvWriter *w, size_t len)
+{
+    struct iovec iov = { w->stage, len };
+    double start = get_time_in_seconds();
+    MPP_RET ret = pwritev_full(w->fd, &iov, 1, w->offset);
+
+    w->write_time += get_time_in_seconds() - start;
+    w->offset += len;
+    w->writes++;
+    if (len < w->stage_fill) {
+        memmove(w->stage, w->stage + len, w->stage_fill - len);
+        w->stage_fill -= len;
+    } else {
+        w->stage_fill = 0;
+    }
+    return ret;
+}
+
+/*
+ * O_DIRECT needs aligned memory, length and offset, which decoded frames
+ * rarely are. Copy them into the stage and write it out in full, aligned
+ * pieces; the frame buffer is free as soon as it is copied. Cropped frames
+ * are packed straight into the stage when they fit.
+ */
+static MPP_RET stage_frame(RkYuvWriter *w, RkYuvWriterEntry *e)
+{
+    const RK_U8 *src;
+    size_t left = e->len;
+    double start;
+
+    if (needs_pack(w)) {
+        // Make room by writing out the aligned part, the tail moves down
+        if (YUV_WRITER_STAGE_SIZE - w->stage_fill < e->len &&
+            w->stage_fill >= YUV_WRITER_ALIGN &&
+            flush_stage(w, w->stage_fill & ~(size_t)(YUV_WRITER_ALIGN - 1)))
+            return MPP_NOK;
+
+        if (YUV_WRITER_STAGE_SIZE - w->stage_fill >= e->len) {
+            if (pack_frame(w, w->stage + w->stage_fill, e))
+                return MPP_NOK;
+            w->stage_fill += e->len;
+            if (w->stage_fill == YUV_WRITER_STAGE_SIZE)
+                return flush_stage(w, YUV_WRITER_STAGE_SIZE);
+            return MPP_OK;
+        }
+        if (pack_entry(w, e))
+            return MPP_NOK;
+    }
+
+    src = e->buf ? mpp_buffer_get_ptr(e->buf) : e->pack;
+    start = get_time_in_seconds();
+    while (left) {
+        size_t n = YUV_WRITER_STAGE_SIZE - w->stage_fill;
+
+        if (n > left)
+            n = left;
+        memcpy(w->stage + w->stage_fill, src, n);
+        w->stage_fill += n;
+        w->copy_bytes += n;
+        src += n;
+        left -= n;
+
+        if (w->stage_fill == YUV_WRITER_STAGE_SIZE && flush_stage(w, YUV_WRITER_STAGE_SIZE))
+            return MPP_NOK;
+    }
+    w->copy_time += get_time_in_seconds() - start;
+
+    // Staged: the pack buffer is free for the next frame that needs one
+    rk_pool_put(&w->pack_pool, e->pack);
+    e->pack = NULL;
+    return MPP_OK;
+}
+
+#ifdef HAVE_LIBURING
+/*
+ * Release completed batches in submission order. With wait, block until
+ * at least one is released: writes complete out of order, and one done
+ * behind an unfinished head frees nothing yet.
+ */
+static MPP_RET reap_batches(RkYuvWriter *w, int wait)
+{
+    struct io_uring_cqe *cqe;
+
+    while (w->batch_count) {
+        RK_U32 in_flight = w->batch_count;
+        RkYuvWriterBatch *b;
+        double start = get_time_in_seconds();
+        int err = wait ? io_uring_wait_cqe(&w->ring, &cqe) : io_uring_peek_cqe(&w->ring, &cqe);
+
+        // Time spent waiting on the device counts as busy
+        w->write_time += get_time_in_seconds() - start;
+
+        if (err == -EAGAIN)
+            break;
+        if (err < 0) {
+            mpp_err("io_uring wait failed: %s\n", strerror(-err));
+            return MPP_NOK;
+        }
+
+        b = io_uring_cqe_get_data(cqe);
+        if (cqe->res < 0) {
+            mpp_err("io_uring write failed: %s\n", strerror(-cqe->res));
+            io_uring_cqe_seen(&w->ring, cqe);
+            return MPP_NOK;
+        }
+        // Short write: finish the rest synchronously
+        if ((size_t)cqe->res < b->len) {
+            struct iovec *iov = b->iov;
+            int count = b->count;
+            size_t skip = cqe->res;
+
+            while (skip >= iov->iov_len) {
+                skip -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            iov->iov_base = (RK_U8 *)iov->iov_base + skip;
+            iov->iov_len -= skip;
+            if (pwritev_full(w->fd, iov, count, b->offset + cqe->res)) {
+                io_uring_cqe_seen(&w->ring, cqe);
+                return MPP_NOK;
+            }
+        }
+        b->done = 1;
+        io_uring_cqe_seen(&w->ring, cqe);
+
+        while (w->batch_count && w->batches[w->batch_head].done) {
+            b = &w->batches[w->batch_head];
+            release_entries(w, b->count);
+            b->done = 0;
+            w->batch_head = (w->batch_head + 1) % YUV_WRITER_URING_DEPTH;
+            w->batch_count--;
+        }
+        if (w->batch_count < in_flight)
+            wait = 0;
+    }
+    return MPP_OK;
+}
+
+static MPP_RET submit_batch(RkYuvWriter *w, RK_U32 first, RK_U32 n)
+{
+    RkYuvWriterBatch *b;
+    struct io_uring_sqe *sqe;
+
+    // The next slot is the head's until the head itself is released
+    while (w->batch_count == YUV_WRITER_URING_DEPTH) {
+        if (reap_batches(w, 1))
+            return MPP_NOK;
+    }
+
+    // Batches in flight write from the pack buffers: wait them out before
+    // a bigger frame rebuilds the pool
+    if (needs_pack(w) && w->pack_pool.base && w->batch_count) {
+        RK_U32 i;
+
+        for (i = 0; i < n; i++) {
+            if (w->queue[(first + i) % w->depth].len > w->pack_pool.block_size)
+                break;
+        }
+        while (i < n && w->batch_count) {
+            if (reap_batches(w, 1))
+                return MPP_NOK;
+        }
+    }
+
+    if (pack_batch(w, first, n))
+        return MPP_NOK;
+
+    b = &w->batches[(w->batch_head + w->batch_count) % YUV_WRITER_URING_DEPTH];
+    b->count = n;
+    b->len = fill_iov(w, first, n, b->iov);
+    b->offset = w->offset;
+    b->done = 0;
+
+    sqe = io_uring_get_sqe(&w->ring);
+    if (!sqe) {
+        mpp_err("io_uring submission queue full\n");
+        return MPP_NOK;
+    }
+    io_uring_prep_writev(sqe, w->fd, b->iov, n, b->offset);
+    io_uring_sqe_set_data(sqe, b);
+    if (io_uring_submit(&w->ring) < 0) {
+        mpp_err("io_uring submit failed\n");
+        return MPP_NOK;
+    }
+
+    w->batch_count++;
+    w->offset += b->len;
+    w->writes++;
+    return reap_batches(w, 0);
+}
+#endif
+
+static void *writer_thread(void *arg)
+{
+    RkYuvWriter *w = (RkYuvWriter *)arg;
+    MPP_RET ret = MPP_OK;
+
+    for (;;) {
+        RK_U32 first, n;
+
+        pthread_mutex_lock(&w->lock);
+        while (w->count == w->taken && !w->stop && !w->error) {
+#ifdef HAVE_LIBURING
+            // Nothing new to submit: collect what is in flight before sleeping
+            if (w->batch_count) {
+                pthread_mutex_unlock(&w->lock);
+                ret = reap_batches(w, 1);
+                pthread_mutex_lock(&w->lock);
+                if (ret)
+                    break;
+                continue;
+            }
+#endif
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (ret || w->error || (w->count == w->taken && w->stop)) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+
+        // Everything queued so far, up to one batch
+        first = (w->head + w->taken) % w->depth;
+        n = w->count - w->taken;
+        if (n > YUV_WRITER_BATCH)
+            n = YUV_WRITER_BATCH;
+        w->taken += n;
+        pthread_mutex_unlock(&w->lock);
+
+        if (w->mode == YUV_WRITER_CRC) {
+            ret = checksum_batch(w, first, n);
+            release_entries(w, n);
+        } else if (w->mode == YUV_WRITER_DIRECT) {
+            RK_U32 i;
+
+            for (i = 0; i < n && !ret; i++)
+                ret = stage_frame(w, &w->queue[(first + i) % w->depth]);
+            release_entries(w, n);
+#ifdef HAVE_LIBURING
+        } else if (w->mode == YUV_WRITER_URING) {
+            ret = submit_batch(w, first, n);
+#endif
+        } else {
+            ret = write_batch(w, first, n);
+            release_entries(w, n);
+        }
+        if (ret)
+            break;
+    }
+
+#ifdef HAVE_LIBURING
+    if (!ret && w->mode == YUV_WRITER_URING) {
+        while (w->batch_count && !ret)
+            ret = reap_batches(w, 1);
+    }
+#endif
+    if (ret)
+        set_error(w, ret);
+    return NULL;
+}
+
+MPP_RET rk_yuv_writer_open(RkYuvWriter *w, const char *path, RkYuvWriterMode mode,
+                           RkYuvOutFormat format, RK_U32 depth)
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+    memset(w, 0, sizeof(RkYuvWriter));
+    w->fd = -1;
+    w->depth = depth ? depth : YUV_WRITER_DEPTH;
+    if (w->depth > YUV_WRITER_QUEUE_MAX)
+        w->depth = YUV_WRITER_QUEUE_MAX;
+
+#ifndef HAVE_LIBURING
+    if (mode == YUV_WRITER_URING) {
+        mpp_log("built without liburing, using the writer thread\n");
+        mode = YUV_WRITER_THREAD;
+    }
+#endif
+    w->mode = mode;
+    w->format = format;
+
+    // Nothing to open: null drops frames on push, crc only needs the thread
+    if (mode == YUV_WRITER_NULL)
+        return MPP_OK;
+    if (mode == YUV_WRITER_CRC)
+        goto START_THREAD;
+
+    if (mode == YUV_WRITER_DIRECT) {
+        w->fd = open(path, flags | O_DIRECT, 0644);
+        // tmpfs and some FUSE filesystems refuse O_DIRECT
+        if (w->fd < 0 && errno == EINVAL) {
+            mpp_log("%s does not support O_DIRECT, using buffered writes\n", path);
+            w->mode = YUV_WRITER_THREAD;
+        }
+    }
+    if (w->fd < 0 && w->mode != YUV_WRITER_DIRECT)
+        w->fd = open(path, flags, 0644);
+    if (w->fd < 0) {
+        mpp_err("Failed to open output file %s\n", path);
+        return MPP_ERR_OPEN_FILE;
+    }
+
+    if (w->mode == YUV_WRITER_SYNC)
+        return MPP_OK;
+
+    // Page aligned and prefaulted, so O_DIRECT writes never fault it in
+    if (w->mode == YUV_WRITER_DIRECT &&
+        !(w->stage = rk_buf_alloc(YUV_WRITER_STAGE_SIZE, RK_ALLOC_POPULATE))) {
+        mpp_err("Failed to allocate output stage\n");
+        goto ERR_RET;
+    }
+
+#ifdef HAVE_LIBURING
+    if (w->mode == YUV_WRITER_URING) {
+        int err = io_uring_queue_init(YUV_WRITER_URING_DEPTH, &w->ring, 0);
+
+        if (err < 0) {
+            mpp_err("io_uring setup failed: %s\n", strerror(-err));
+            goto ERR_RET;
+        }
+        w->ring_ready = 1;
+    }
+#endif
+
+START_THREAD:
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->lock_ready = 1;
+    if (pthread_create(&w->thread, NULL, writer_thread, w)) {
+        mpp_err("Failed to create writer thread\n");
+        goto ERR_RET;
+    }
+    w->thread_started = 1;
+    return MPP_OK;
+
+ERR_RET:
+    rk_yuv_writer_close(w);
+    return MPP_NOK;
+}
+
+// Report every completed frame to cb; call before the first push
+void rk_yuv_writer_set_done_cb(RkYuvWriter *w, RkYuvWriterDoneCb cb, void *opaque)
+{
+    w->done_cb = cb;
+    w->done_opaque = opaque;
+}
+
+// Collect crc mode checksums into list, owned by the caller
+void rk_yuv_writer_set_crc_list(RkYuvWriter *w, RkCrcList *list)
+{
+    w->crcs = list;
+}
+
+// Convert frames with cvt instead of cropping them; call before the first push
+void rk_yuv_writer_set_converter(RkYuvWriter *w, RkYuvConverter *cvt)
+{
+    w->cvt = cvt;
+}
+
+// fbc output: store the 16x16 blocks covering roi instead of whole frames
+void rk_yuv_writer_set_fbc_roi(RkYuvWriter *w, const RkFbcRect *roi)
+{
+    w->fbc_roi = *roi;
+}
+
+/*
+ * Queue buf, a decoded frame of the given layout, for writing. Blocks while
+ * depth frames are already waiting; that time is what the decoder loses to
+ * output I/O.
+ */
+MPP_RET rk_yuv_writer_push(RkYuvWriter *w, MppBuffer buf, const RkYuvLayout *layout)
+{
+    size_t len = out_size(w, layout);
+    MPP_RET ret;
+    double pushed = w->done_cb ? get_time_in_seconds() : 0;
+    double start, done;
+
+    w->stored_format = rk_yuv_out_format_for(layout, w->format);
+    if (w->format == YUV_OUT_FBC && layout->fbc) {
+        size_t fbc_len = scan_fbc(w, buf, layout);
+
+        if (rk_yuv_writer_has_file(w->mode))
+            len = fbc_len;
+    }
+
+    if (w->mode == YUV_WRITER_NULL) {
+        if (w->done_cb)
+            w->done_cb(w->done_opaque, pushed, pushed);
+        w->frames++;
+        w->raw_bytes += rk_yuv_out_size(layout, YUV_OUT_RAW);
+        return MPP_OK;
+    }
+
+    if (w->mode == YUV_WRITER_SYNC) {
+        RkYuvWriterEntry *e = &w->queue[0];
+        struct iovec iov;
+
+        start = get_time_in_seconds();
+        e->buf = buf;
+        e->layout = *layout;
+        e->len = len;
+        if (needs_pack(w)) {
+            mpp_buffer_inc_ref(buf);
+            if (pack_entry(w, e))
+                return MPP_NOK;
+        }
+        fill_iov(w, 0, 1, &iov);
+        e->buf = NULL;
+
+        ret = pwritev_full(w->fd, &iov, 1, w->offset);
+        rk_pool_put(&w->pack_pool, e->pack);
+        e->pack = NULL;
+        done = get_time_in_seconds();
+        if (w->done_cb)
+            w->done_cb(w->done_opaque, start, done);
+        w->stall_time += done - start;
+        w->write_time = w->stall_time - w->copy_time;
+        w->offset += len;
+        w->writes++;
+        w->frames++;
+        w->bytes += len;
+        w->raw_bytes += rk_yuv_out_size(layout, YUV_OUT_RAW);
+        return ret;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    if (w->count >= w->depth && !w->error) {
+        start = get_time_in_seconds();
+        w->stalls++;
+        while (w->count >= w->depth && !w->error)
+            pthread_cond_wait(&w->cond, &w->lock);
+        w->stall_time += get_time_in_seconds() - start;
+    }
+
+    ret = w->error;
+    if (!ret) {
+        RkYuvWriterEntry *e = &w->queue[(w->head + w->count) % w->depth];
+
+        // Keeps the frame out of the decoder's pool until it is written
+        mpp_buffer_inc_ref(buf);
+        e->buf = buf;
+        e->layout = *layout;
+        e->len = len;
+        e->pushed = pushed;
+        w->count++;
+        if (w->count > w->peak_queued)
+            w->peak_queued = w->count;
+        w->frames++;
+        w->bytes += len;
+        w->raw_bytes += rk_yuv_out_size(layout, YUV_OUT_RAW);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ret;
+}
+
+// Frames queued and not written yet, for the caller's backpressure
+RK_U32 rk_yuv_writer_queued(RkYuvWriter *w)
+{
+    RK_U32 count;
+
+    if (!w->lock_ready)
+        return 0;
+    pthread_mutex_lock(&w->lock);
+    count = w->count;
+    pthread_mutex_unlock(&w->lock);
+    return count;
+}
+
+/*
+ * Drain the queue and close. An O_DIRECT tail is padded to the alignment,
+ * written, and the file truncated back to the real size.
+ */
+MPP_RET rk_yuv_writer_close(RkYuvWriter *w)
+{
+    MPP_RET ret = MPP_OK;
+
+    if (w->thread_started) {
+        pthread_mutex_lock(&w->lock);
+        w->stop = 1;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+        w->thread_started = 0;
+
+        ret = w->error;
+    }
+
+#ifdef HAVE_LIBURING
+    // Tearing down the ring waits out writes still in flight
+    if (w->ring_ready) {
+        io_uring_queue_exit(&w->ring);
+        w->ring_ready = 0;
+    }
+#endif
+
+    if (w->lock_ready) {
+        // Frames left behind by an error still hold decoder buffers
+        if (w->count) {
+            w->taken = w->count;
+            release_entries(w, w->count);
+        }
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        w->lock_ready = 0;
+    }
+
+    if (w->stage) {
+        if (!ret && w->stage_fill) {
+            size_t len = (w->stage_fill + YUV_WRITER_ALIGN - 1) & ~(size_t)(YUV_WRITER_ALIGN - 1);
+
+            memset(w->stage + w->stage_fill, 0, len - w->stage_fill);
+            ret = flush_stage(w, len);
+            if (!ret && ftruncate(w->fd, w->bytes)) {
+                mpp_err("Failed to trim output file\n");
+                ret = MPP_NOK;
+            }
+        }
+        rk_buf_free(w->stage, YUV_WRITER_STAGE_SIZE);
+        w->stage = NULL;
+    }
+
+    // Blocks come back with their entries; one left by an error goes too
+    if (w->pack_pool.base)
+        rk_pool_deinit(&w->pack_pool);
+
+    if (w->fd >= 0) {
+        if (close(w->fd) && !ret) {
+            mpp_err("Failed to close output file\n");
+            ret = MPP_NOK;
+        }
+        w->fd = -1;
+    }
+    return ret;
+}
@@ -0,0 +1,128 @@
+#ifndef RK_YUV_WRITER_H
+#define RK_YUV_WRITER_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+#include "rk_yuv_crop.h"
+#include "rk_yuv_convert.h"
+#include "rk_fbc.h"
+#include "rk_frame_crc.h"
+#include "rk_alloc.h"
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#define YUV_WRITER_QUEUE_MAX    32      // frames held by the writer
+#define YUV_WRITER_DEPTH        6       // default queue depth
+#define YUV_WRITER_BATCH        8       // frames gathered into one write
+#define YUV_WRITER_ALIGN        4096    // O_DIRECT address, length and offset unit
+#define YUV_WRITER_STAGE_SIZE   (16 * 1024 * 1024)
+#define YUV_WRITER_URING_DEPTH  4       // batches in flight with io_uring
+
+typedef enum {
+    YUV_WRITER_SYNC = 0,        // write on the caller's thread, as before
+    YUV_WRITER_THREAD,          // writer thread, batched pwritev
+    YUV_WRITER_DIRECT,          // writer thread, O_DIRECT from an aligned stage
+    YUV_WRITER_URING,           // writer thread, batches submitted to io_uring
+    YUV_WRITER_NULL,            // no output, frames dropped on push
+    YUV_WRITER_CRC,             // no output, writer thread checksums each frame
+} RkYuvWriterMode;
+
+typedef struct {
+    MppBuffer       buf;                // reference held until written or packed
+    RkYuvLayout     layout;
+    size_t          len;                // bytes this frame puts in the file
+    RK_U8          *pack;               // cropped or converted copy, from pack_pool
+    double          pushed;             // when the decoder handed it over
+} RkYuvWriterEntry;
+
+// A frame's bytes are written or staged: pushed and done are monotonic seconds
+typedef void (*RkYuvWriterDoneCb)(void *opaque, double pushed, double done);
+
+typedef struct {
+    struct iovec    iov[YUV_WRITER_BATCH];
+    RK_U32          count;
+    size_t          len;
+    off_t           offset;
+    RK_U32          done;
+} RkYuvWriterBatch;
+
+/*
+ * Output stage of the decoder. Frames are queued with a buffer reference
+ * and written by a separate thread, so a slow disk only stalls the decoder
+ * once the queue is full. Buffers go back to the decoder's pool as soon as
+ * their bytes are on the way: after the write, or after they are cropped
+ * into the entry's pack buffer or copied into the O_DIRECT stage.
+ */
+typedef struct {
+    RkYuvWriterMode mode;
+    RkYuvOutFormat  format;
+    RkYuvConverter *cvt;                // RGB output instead of YUV
+    RkYuvWriterDoneCb done_cb;          // called on the thread that completes the frame
+    void           *done_opaque;
+    RkCrcList      *crcs;               // per-frame checksums in crc mode
+    RkFbcRect       fbc_roi;            // fbc output: only the blocks of this region
+    int             fd;
+    off_t           offset;             // file offset of the next write
+    RK_U32          depth;
+
+    RkYuvWriterEntry queue[YUV_WRITER_QUEUE_MAX];   // ring of depth entries
+    RK_U32          head;
+    RK_U32          count;              // queued, including those being written
+    RK_U32          taken;              // at head, handed to the writer thread
+
+    pthread_t       thread;
+    RK_U32          thread_started;
+    RK_U32          lock_ready;
+    RK_U32          stop;
+    MPP_RET         error;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    RkPool          pack_pool;          // depth blocks of the largest packed frame
+    RK_U8          *stage;              // O_DIRECT bounce buffer
+    size_t          stage_fill;
+
+#ifdef HAVE_LIBURING
+    struct io_uring ring;
+    RK_U32          ring_ready;
+    RkYuvWriterBatch batches[YUV_WRITER_URING_DEPTH];
+    RK_U32          batch_head;
+    RK_U32          batch_count;
+#endif
+
+    // Statistics
+    RK_U64          frames;
+    RK_U64          bytes;
+    RK_U64          raw_bytes;          // the same frames with stride padding
+    RkYuvOutFormat  stored_format;      // what format really stored the last frame
+    RK_U64          copy_bytes;         // cropped or staged by the writer
+    double          copy_time;
+    RK_U64          writes;             // write syscalls or io_uring submissions
+    RK_U32          peak_queued;
+    RK_U32          stalls;             // pushes that found the queue full
+    double          stall_time;         // caller blocked on output I/O
+    double          write_time;         // writer thread inside write calls
+    RK_U64          fbc_frames;         // frames that came out compressed
+    RkFbcStats      fbc;                // their heads summed
+    RK_U64          fbc_roi_bytes;      // heads and payload of the region read
+    double          fbc_scan_time;
+} RkYuvWriter;
+
+// Function declarations
+MPP_RET rk_yuv_writer_open(RkYuvWriter *w, const char *path, RkYuvWriterMode mode,
+                           RkYuvOutFormat format, RK_U32 depth);
+void rk_yuv_writer_set_done_cb(RkYuvWriter *w, RkYuvWriterDoneCb cb, void *opaque);
+void rk_yuv_writer_set_crc_list(RkYuvWriter *w, RkCrcList *list);
+void rk_yuv_writer_set_converter(RkYuvWriter *w, RkYuvConverter *cvt);
+void rk_yuv_writer_set_fbc_roi(RkYuvWriter *w, const RkFbcRect *roi);
+MPP_RET rk_yuv_writer_push(RkYuvWriter *w, MppBuffer buf, const RkYuvLayout *layout);
+RK_U32 rk_yuv_writer_queued(RkYuvWriter *w);
+MPP_RET rk_yuv_writer_close(RkYuvWriter *w);
+const char *rk_yuv_writer_mode_name(RkYuvWriterMode mode);
+RK_U32 rk_yuv_writer_has_file(RkYuvWriterMode mode);
+
+#endif // RK_YUV_WRITER_H
@@ -0,0 +1,219 @@
+#include "alloc_bench.h"
+
+static const char *workload_names[WORKLOAD_COUNT] = {
+    "small 32B-2KB", "frame 4K NV12", "frame 8K NV12"
+};
+
+static const char *alloc_names[ALLOC_KIND_COUNT] = {
+    "glibc", "arena", "pool"
+};
+
+int pin_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    pthread_t current_thread = pthread_self();
+    return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+}
+
+double get_time_in_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static inline uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static size_t workload_frame_size(workload_t workload) {
+    return workload == WORKLOAD_FRAME_8K ? FRAME_8K_SIZE : FRAME_4K_SIZE;
+}
+
+static void* alloc_object(AllocThreadData* data, RkArena* arena, size_t size, size_t align) {
+    void* ptr = NULL;
+
+    switch (data->kind) {
+        case ALLOC_GLIBC:
+            // Small objects come from malloc, frames the way the benchmarks do it today
+            if (data->workload == WORKLOAD_SMALL)
+                return malloc(size);
+            if (posix_memalign(&ptr, align, size) != 0)
+                return NULL;
+            return ptr;
+        case ALLOC_ARENA:
+            return rk_arena_alloc(arena, size, align);
+        case ALLOC_POOL:
+            return rk_pool_get(data->pool);
+        default:
+            return NULL;
+    }
+}
+
+static void free_object(AllocThreadData* data, void* ptr) {
+    switch (data->kind) {
+        case ALLOC_GLIBC:
+            free(ptr);
+            break;
+        case ALLOC_POOL:
+            rk_pool_put(data->pool, ptr);
+            break;
+        default:
+            // Arena objects are released by rk_arena_reset()
+            break;
+    }
+}
+
+// Alloc/touch/free churn on one core
+void* alloc_churn_test(void* arg) {
+    AllocThreadData* data = (AllocThreadData*)arg;
+    size_t frame_size = workload_frame_size(data->workload);
+    uint32_t seed = (uint32_t)data->core_id * 2654435761u + 1;
+    void* objs[SMALL_BATCH];
+    struct rusage ru_start, ru_end;
+    long long operations = 0;
+    RkArena arena;
+
+    if (pin_thread_to_core(data->core_id) != 0) {
+        printf("Failed to pin thread to core %d\n", data->core_id);
+        return NULL;
+    }
+
+    if (data->kind == ALLOC_ARENA) {
+        size_t arena_size = data->workload == WORKLOAD_SMALL ?
+            SMALL_BATCH * (SMALL_OBJ_MAX + RK_CACHE_LINE) : frame_size + RK_PAGE_SIZE;
+        if (rk_arena_init(&arena, arena_size, 0) != 0) {
+            printf("Arena allocation failed for core %d\n", data->core_id);
+            return NULL;
+        }
+    }
+
+    getrusage(RUSAGE_THREAD, &ru_start);
+    double start_time = get_time_in_seconds();
+
+    while (get_time_in_seconds() - start_time < ALLOC_TEST_SEC) {
+        if (data->workload == WORKLOAD_SMALL) {
+            for (int i = 0; i < SMALL_BATCH; i++) {
+                size_t size = SMALL_OBJ_MIN + xorshift32(&seed) % (SMALL_OBJ_MAX - SMALL_OBJ_MIN);
+                objs[i] = alloc_object(data, &arena, size, RK_CACHE_LINE);
+                if (!objs[i]) {
+                    printf("Allocation failed for core %d\n", data->core_id);
+                    goto out;
+                }
+                ((volatile char*)objs[i])[0] = (char)i;
+            }
+            for (int i = 0; i < SMALL_BATCH; i++)
+                free_object(data, objs[i]);
+            operations += SMALL_BATCH;
+        } else {
+            // A decoded frame is written once: touch every page
+            char* frame = alloc_object(data, &arena, frame_size, RK_PAGE_SIZE);
+            if (!frame) {
+                printf("Allocation failed for core %d\n", data->core_id);
+                goto out;
+            }
+            for (size_t off = 0; off < frame_size; off += RK_PAGE_SIZE)
+                ((volatile char*)frame)[off] = 1;
+            free_object(data, frame);
+            operations++;
+        }
+
+        if (data->kind == ALLOC_ARENA)
+            rk_arena_reset(&arena);
+    }
+
+out:
+    data->execution_time = get_time_in_seconds() - start_time;
+    getrusage(RUSAGE_THREAD, &ru_end);
+    data->operations = operations;
+    data->minor_faults = ru_end.ru_minflt - ru_start.ru_minflt;
+
+    if (data->kind == ALLOC_ARENA)
+        rk_arena_deinit(&arena);
+    return NULL;
+}
+
+void run_alloc_benchmark(workload_t workload, alloc_kind_t kind) {
+    pthread_t threads[TOTAL_CORES];
+    AllocThreadData thread_data[TOTAL_CORES];
+    RkPool pool;
+    int created = 0;
+
+    if (kind == ALLOC_POOL) {
+        int ret;
+        if (workload == WORKLOAD_SMALL)
+            ret = rk_pool_init(&pool, SMALL_OBJ_MAX, TOTAL_CORES * SMALL_BATCH * 2,
+                               RK_CACHE_LINE, 0);
+        else
+            ret = rk_pool_init(&pool, workload_frame_size(workload), TOTAL_CORES,
+                               RK_PAGE_SIZE, 0);
+        if (ret != 0) {
+            printf("Pool allocation failed\n");
+            return;
+        }
+    }
+
+    memset(thread_data, 0, sizeof(thread_data));
+    for (int i = 0; i < TOTAL_CORES; i++) {
+        thread_data[i].core_id = i;
+        thread_data[i].kind = kind;
+        thread_data[i].workload = workload;
+        thread_data[i].pool = &pool;
+
+        if (pthread_create(&threads[i], NULL, alloc_churn_test, &thread_data[i]) != 0) {
+            printf("Failed to create thread for core %d\n", i);
+            break;
+        }
+        created++;
+    }
+
+    for (int i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    double total_rate = 0, a76_ns = 0, a55_ns = 0;
+    long long total_ops = 0;
+    long total_faults = 0;
+    for (int i = 0; i < created; i++) {
+        AllocThreadData* d = &thread_data[i];
+        double ns_per_op = d->operations ? d->execution_time * 1000000000.0 / d->operations : 0;
+
+        if (d->execution_time > 0)
+            total_rate += d->operations / d->execution_time;
+        total_ops += d->operations;
+        total_faults += d->minor_faults;
+        if (i >= A76_CORE_START && i < A76_CORE_START + NUM_A76_CORES)
+            a76_ns += ns_per_op / NUM_A76_CORES;
+        else
+            a55_ns += ns_per_op / NUM_A55_CORES;
+    }
+
+    printf("%-14s | %-5s | %12.0f | %10.1f | %10.1f | %10.3f\n",
+           workload_names[workload], alloc_names[kind], total_rate,
+           a76_ns, a55_ns, total_ops ? (double)total_faults / total_ops : 0);
+
+    if (kind == ALLOC_POOL)
+        rk_pool_deinit(&pool);
+}
+
+int main(int argc, char** argv) {
+    printf("Starting allocator churn benchmark for RK3588...\n");
+    printf("%d threads, one per core, %d s per run\n\n", TOTAL_CORES, ALLOC_TEST_SEC);
+
+    printf("%-14s | %-5s | %12s | %10s | %10s | %10s\n",
+           "Workload", "Alloc", "ops/s total", "A76 ns/op", "A55 ns/op", "faults/op");
+    printf("-------------------------------------------------------------------------------\n");
+
+    for (int w = 0; w < WORKLOAD_COUNT; w++) {
+        for (int k = 0; k < ALLOC_KIND_COUNT; k++) {
+            run_alloc_benchmark(w, k);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef ALLOC_BENCH_H
+#define ALLOC_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "rk_alloc.h"
+
+// RK3588 CPU configuration
+#define NUM_A76_CORES     4
+#define NUM_A55_CORES     4
+#define TOTAL_CORES       (NUM_A76_CORES + NUM_A55_CORES)
+
+// A76 cores are 4-7, A55 cores are 0-3 on RK3588
+#define A76_CORE_START    4
+#define A55_CORE_START    0
+
+// Test configurations
+#define ALLOC_TEST_SEC    3
+#define SMALL_OBJ_MIN     32
+#define SMALL_OBJ_MAX     2048
+#define SMALL_BATCH       64                        // small objects live at once
+#define FRAME_4K_SIZE     (3840 * 2160 * 3 / 2)     // 4K NV12, below glibc's 32MB mmap cap
+#define FRAME_8K_SIZE     (7680 * 4320 * 3 / 2)     // 8K NV12, always mmap/munmap in glibc
+
+// Allocators under test
+typedef enum {
+    ALLOC_GLIBC = 0,
+    ALLOC_ARENA,
+    ALLOC_POOL,
+    ALLOC_KIND_COUNT
+} alloc_kind_t;
+
+// Workloads
+typedef enum {
+    WORKLOAD_SMALL = 0,
+    WORKLOAD_FRAME_4K,
+    WORKLOAD_FRAME_8K,
+    WORKLOAD_COUNT
+} workload_t;
+
+typedef struct {
+    int core_id;
+    alloc_kind_t kind;
+    workload_t workload;
+    RkPool *pool;               // shared by all threads of a pool run
+    long long operations;
+    double execution_time;
+    long minor_faults;
+} AllocThreadData;
+
+// Function declarations
+void* alloc_churn_test(void* arg);
+int pin_thread_to_core(int core_id);
+double get_time_in_seconds(void);
+void run_alloc_benchmark(workload_t workload, alloc_kind_t kind);
+
+#endif // ALLOC_BENCH_H
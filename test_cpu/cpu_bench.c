@@ -1,6 +1,9 @@
 #define _GNU_SOURCE
 #include "cpu_bench.h"
 
+// Extra rk_buf_alloc() flags for large buffers, e.g. RK_ALLOC_HUGE with -H
+static int buffer_flags = 0;
+
 // Get CPU frequency from sysfs
 static unsigned long get_cpu_freq_khz(int cpu) {
     char path[256];
@@ -57,27 +60,29 @@ void* cpu_compute_test(void* arg) {
         return NULL;
     }
     
-    float* matrix_a = (float*)malloc(MATRIX_SIZE * MATRIX_SIZE * sizeof(float));
-    float* matrix_b = (float*)malloc(MATRIX_SIZE * MATRIX_SIZE * sizeof(float));
-    float* matrix_c = (float*)malloc(MATRIX_SIZE * MATRIX_SIZE * sizeof(float));
+    const size_t matrix_bytes = MATRIX_SIZE * MATRIX_SIZE * sizeof(float);
+    float* matrix_a = (float*)rk_buf_alloc(matrix_bytes, buffer_flags);
+    float* matrix_b = (float*)rk_buf_alloc(matrix_bytes, buffer_flags);
+    float* matrix_c = (float*)rk_buf_alloc(matrix_bytes, buffer_flags | RK_ALLOC_POPULATE);
     
     if (!matrix_a || !matrix_b || !matrix_c) {
         printf("Memory allocation failed for core %d\n", data->core_id);
-        free(matrix_a);
-        free(matrix_b);
-        free(matrix_c);
+        rk_buf_free(matrix_a, matrix_bytes);
+        rk_buf_free(matrix_b, matrix_bytes);
+        rk_buf_free(matrix_c, matrix_bytes);
         return NULL;
     }
     
-    // Initialize matrices
+    // Initialize matrices with a per-thread RNG (rand() serializes on a lock);
+    // matrix_c is prefaulted and already zero
+    uint64_t rng = rk_rng_seed(data->core_id);
     for (int i = 0; i < MATRIX_SIZE * MATRIX_SIZE; i++) {
-        matrix_a[i] = (float)rand() / RAND_MAX;
-        matrix_b[i] = (float)rand() / RAND_MAX;
-        matrix_c[i] = 0.0f;
+        matrix_a[i] = (float)(rk_rng_next(&rng) >> 40) / (float)(1 << 24);
+        matrix_b[i] = (float)(rk_rng_next(&rng) >> 40) / (float)(1 << 24);
     }
     
     double start_time = get_time_in_seconds();
-    data->operations = 0;
+    long long operations = 0;
     
     while (get_time_in_seconds() - start_time < TEST_DURATION_SEC) {
         // Perform matrix multiplication
@@ -90,17 +95,19 @@ void* cpu_compute_test(void* arg) {
                 matrix_c[i * MATRIX_SIZE + j] = sum;
             }
         }
-        data->operations++;
+        operations++;
     }
     
+    // Publish the register-held counter once the timed loop is over
+    data->operations = operations;
     data->execution_time = get_time_in_seconds() - start_time;
     // Calculate GFLOPS: 2 * N^3 operations per matrix multiplication
     data->gflops = (2.0 * MATRIX_SIZE * MATRIX_SIZE * MATRIX_SIZE * data->operations) / 
                    (data->execution_time * 1000000000.0);
     
-    free(matrix_a);
-    free(matrix_b);
-    free(matrix_c);
+    rk_buf_free(matrix_a, matrix_bytes);
+    rk_buf_free(matrix_b, matrix_bytes);
+    rk_buf_free(matrix_c, matrix_bytes);
     return NULL;
 }
 
@@ -112,35 +119,35 @@ void* memory_bandwidth_test(void* arg) {
         return NULL;
     }
     
-    char* buffer = (char*)malloc(BUFFER_SIZE);
-    char* dest = (char*)malloc(BUFFER_SIZE);
+    char* buffer = (char*)rk_buf_alloc(BUFFER_SIZE, buffer_flags);
+    // Prefault the destination so the first memcpy does not pay page faults
+    char* dest = (char*)rk_buf_alloc(BUFFER_SIZE, buffer_flags | RK_ALLOC_POPULATE);
     
     if (!buffer || !dest) {
         printf("Memory allocation failed for core %d\n", data->core_id);
-        free(buffer);
-        free(dest);
+        rk_buf_free(buffer, BUFFER_SIZE);
+        rk_buf_free(dest, BUFFER_SIZE);
         return NULL;
     }
     
-    // Initialize buffer with random data
-    for (int i = 0; i < BUFFER_SIZE; i++) {
-        buffer[i] = (char)rand();
-    }
+    // Initialize buffer with random data, first-touched by this core
+    rk_buf_fill_random(buffer, BUFFER_SIZE, data->core_id);
     
     double start_time = get_time_in_seconds();
-    data->operations = 0;
+    long long operations = 0;
     
     while (get_time_in_seconds() - start_time < TEST_DURATION_SEC) {
         memcpy(dest, buffer, BUFFER_SIZE);
-        data->operations += BUFFER_SIZE;
+        operations += BUFFER_SIZE;
     }
     
+    data->operations = operations;
     data->execution_time = get_time_in_seconds() - start_time;
     // Calculate bandwidth in GB/s
     data->gflops = (data->operations) / (data->execution_time * 1024 * 1024 * 1024);
     
-    free(buffer);
-    free(dest);
+    rk_buf_free(buffer, BUFFER_SIZE);
+    rk_buf_free(dest, BUFFER_SIZE);
     return NULL;
 }
 
@@ -153,7 +160,7 @@ void* cache_latency_test(void* arg) {
     }
     
     const int array_size = 64 * 1024 * 1024; // 64MB
-    int* array = (int*)malloc(array_size * sizeof(int));
+    int* array = (int*)rk_buf_alloc(array_size * sizeof(int), buffer_flags);
     
     if (!array) {
         printf("Memory allocation failed for core %d\n", data->core_id);
@@ -168,21 +175,22 @@ void* cache_latency_test(void* arg) {
     }
     
     double start_time = get_time_in_seconds();
-    data->operations = 0;
+    long long operations = 0;
     int index = 0;
     
     while (get_time_in_seconds() - start_time < TEST_DURATION_SEC) {
         for (int i = 0; i < 1000000; i++) {
             index = array[index];
         }
-        data->operations += 1000000;
+        operations += 1000000;
     }
     
+    data->operations = operations;
     data->execution_time = get_time_in_seconds() - start_time;
     // Calculate average latency in nanoseconds
     data->gflops = (data->execution_time * 1000000000.0) / data->operations;
     
-    free(array);
+    rk_buf_free(array, array_size * sizeof(int));
     return NULL;
 }
 
@@ -275,6 +283,20 @@ void run_benchmark(int test_type, const char* test_name) {
 }
 
 int main(int argc, char** argv) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H")) != -1) {
+        switch (opt) {
+            case 'H':
+                buffer_flags |= RK_ALLOC_HUGE;
+                break;
+            default:
+                printf("Usage: %s [-H]\n", argv[0]);
+                printf("  -H  back large buffers with transparent huge pages\n");
+                return 1;
+        }
+    }
+
     print_cpu_info();
     
     printf("Starting CPU benchmark suite for RK3588...\n");
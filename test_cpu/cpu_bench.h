@@ -14,6 +14,7 @@
 #include <sys/sysinfo.h>
 #include <errno.h>
 #include <math.h>
+#include "rk_alloc.h"
 
 // RK3588 CPU configuration
 #define NUM_A76_CORES     4
@@ -29,13 +30,15 @@
 #define MATRIX_SIZE       1024
 #define BUFFER_SIZE       (64 * 1024 * 1024)  // 64MB for memory test
 
+// One cache line per thread so neighbouring results never share a line;
+// hot counters live in registers and are published here at the end
 typedef struct {
     int core_id;
     long long operations;
     double execution_time;
     double gflops;
     int test_type;
-} ThreadData;
+} __attribute__((aligned(RK_CACHE_LINE))) ThreadData;
 
 // Test types
 enum {
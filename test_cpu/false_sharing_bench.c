@@ -0,0 +1,142 @@
+#include "false_sharing_bench.h"
+
+static const char* layout_names[LAYOUT_COUNT] = {
+    "packed", "padded 64B", "padded 128B", "register"
+};
+
+static const CoreGroup core_groups[] = {
+    { "A55 pair (0,1)",        2, { 0, 1 } },
+    { "A76 same cluster (4,5)", 2, { 4, 5 } },
+    { "A76 cross cluster (4,6)", 2, { 4, 6 } },
+    { "A55 + A76 (0,4)",       2, { 0, 4 } },
+    { "all 8 cores",           8, { 0, 1, 2, 3, 4, 5, 6, 7 } },
+};
+
+static PackedCounter packed_counters[TOTAL_CORES] __attribute__((aligned(RK_CACHE_LINE)));
+static PaddedCounter padded_counters[TOTAL_CORES];
+static Padded128Counter padded128_counters[TOTAL_CORES];
+
+int pin_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    pthread_t current_thread = pthread_self();
+    return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+}
+
+double get_time_in_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Increment this thread's counter as fast as possible for FS_TEST_SEC
+void* counter_test(void* arg) {
+    FalseSharingThreadData* data = (FalseSharingThreadData*)arg;
+    long long increments = 0;
+
+    if (pin_thread_to_core(data->core_id) != 0)
+        printf("Failed to pin thread to core %d\n", data->core_id);
+
+    pthread_barrier_wait(data->start_barrier);
+    double start_time = get_time_in_seconds();
+
+    if (data->layout == LAYOUT_REGISTER) {
+        long long local = 0;
+        while (get_time_in_seconds() - start_time < FS_TEST_SEC) {
+            for (int i = 0; i < FS_CHECK_EVERY; i++) {
+                local++;
+                // Keep the loop from being folded into one add
+                __asm__ volatile("" : "+r"(local));
+            }
+            increments += FS_CHECK_EVERY;
+        }
+        *data->counter = local;
+    } else {
+        while (get_time_in_seconds() - start_time < FS_TEST_SEC) {
+            for (int i = 0; i < FS_CHECK_EVERY; i++)
+                (*data->counter)++;
+            increments += FS_CHECK_EVERY;
+        }
+    }
+
+    data->execution_time = get_time_in_seconds() - start_time;
+    data->increments = increments;
+    return NULL;
+}
+
+// Aggregate increments per second across the group
+double run_layout_test(const CoreGroup* group, counter_layout_t layout) {
+    pthread_t threads[TOTAL_CORES];
+    FalseSharingThreadData thread_data[TOTAL_CORES];
+    pthread_barrier_t barrier;
+    double total = 0;
+
+    pthread_barrier_init(&barrier, NULL, group->num_cores);
+
+    for (int i = 0; i < group->num_cores; i++) {
+        memset(&thread_data[i], 0, sizeof(thread_data[i]));
+        thread_data[i].core_id = group->cores[i];
+        thread_data[i].layout = layout;
+        thread_data[i].start_barrier = &barrier;
+
+        switch (layout) {
+            case LAYOUT_PACKED:
+                thread_data[i].counter = &packed_counters[i].value;
+                break;
+            case LAYOUT_PADDED_64:
+            case LAYOUT_REGISTER:
+                thread_data[i].counter = &padded_counters[i].value;
+                break;
+            case LAYOUT_PADDED_128:
+                thread_data[i].counter = &padded128_counters[i].value;
+                break;
+            default:
+                break;
+        }
+        *thread_data[i].counter = 0;
+
+        if (pthread_create(&threads[i], NULL, counter_test, &thread_data[i]) != 0) {
+            // Every core must take part or the barrier never opens
+            printf("Failed to create thread for core %d\n", group->cores[i]);
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < group->num_cores; i++) {
+        pthread_join(threads[i], NULL);
+        if (thread_data[i].execution_time > 0)
+            total += thread_data[i].increments / thread_data[i].execution_time;
+    }
+
+    pthread_barrier_destroy(&barrier);
+    return total;
+}
+
+int main(int argc, char** argv) {
+    const int num_groups = sizeof(core_groups) / sizeof(core_groups[0]);
+
+    printf("Starting false-sharing benchmark for RK3588...\n");
+    printf("Each thread increments its own counter for %d s\n\n", FS_TEST_SEC);
+
+    printf("%-24s |", "Cores");
+    for (int l = 0; l < LAYOUT_COUNT; l++)
+        printf(" %12s |", layout_names[l]);
+    printf(" %9s\n", "slowdown");
+    printf("-----------------------------------------------------------------------------------------------\n");
+
+    for (int g = 0; g < num_groups; g++) {
+        double rate[LAYOUT_COUNT];
+
+        printf("%-24s |", core_groups[g].name);
+        for (int l = 0; l < LAYOUT_COUNT; l++) {
+            rate[l] = run_layout_test(&core_groups[g], l);
+            printf(" %8.1f M/s |", rate[l] / 1000000.0);
+        }
+        // Packed versus one line per counter
+        printf(" %8.2fx\n", rate[LAYOUT_PACKED] > 0 ? rate[LAYOUT_PADDED_64] / rate[LAYOUT_PACKED] : 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef FALSE_SHARING_BENCH_H
+#define FALSE_SHARING_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include "rk_alloc.h"
+
+// RK3588 CPU configuration
+#define NUM_A76_CORES     4
+#define NUM_A55_CORES     4
+#define TOTAL_CORES       (NUM_A76_CORES + NUM_A55_CORES)
+
+// A76 cores are 4-7 (two clusters: 4-5 and 6-7), A55 cores are 0-3
+#define A76_CORE_START    4
+#define A55_CORE_START    0
+
+// Test configurations
+#define FS_TEST_SEC       1
+#define FS_CHECK_EVERY    4096          // increments between clock reads
+
+// Counter layouts under test
+typedef enum {
+    LAYOUT_PACKED = 0,                  // adjacent 8-byte counters, one shared line
+    LAYOUT_PADDED_64,                   // one 64B line per counter
+    LAYOUT_PADDED_128,                  // two lines per counter, beats adjacent-line prefetch
+    LAYOUT_REGISTER,                    // counter kept in a register, published at the end
+    LAYOUT_COUNT
+} counter_layout_t;
+
+typedef struct {
+    volatile long long value;
+} PackedCounter;
+
+typedef struct {
+    volatile long long value;
+} __attribute__((aligned(RK_CACHE_LINE))) PaddedCounter;
+
+typedef struct {
+    volatile long long value;
+} __attribute__((aligned(2 * RK_CACHE_LINE))) Padded128Counter;
+
+typedef struct {
+    int core_id;
+    counter_layout_t layout;
+    volatile long long* counter;
+    pthread_barrier_t* start_barrier;
+    long long increments;
+    double execution_time;
+} __attribute__((aligned(RK_CACHE_LINE))) FalseSharingThreadData;
+
+// Core groups to contend
+typedef struct {
+    const char* name;
+    int num_cores;
+    int cores[TOTAL_CORES];
+} CoreGroup;
+
+// Function declarations
+void* counter_test(void* arg);
+int pin_thread_to_core(int core_id);
+double get_time_in_seconds(void);
+double run_layout_test(const CoreGroup* group, counter_layout_t layout);
+
+#endif // FALSE_SHARING_BENCH_H
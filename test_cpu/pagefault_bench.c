@@ -0,0 +1,251 @@
+#include "pagefault_bench.h"
+
+static const char *mode_names[PAGE_MODE_COUNT] = {
+    "4K demand", "4K populate", "THP demand", "THP populate"
+};
+
+static const int mode_flags[PAGE_MODE_COUNT] = {
+    RK_ALLOC_NOHUGE,
+    RK_ALLOC_NOHUGE | RK_ALLOC_POPULATE,
+    RK_ALLOC_HUGE,
+    RK_ALLOC_HUGE | RK_ALLOC_POPULATE
+};
+
+int pin_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    pthread_t current_thread = pthread_self();
+    return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+}
+
+double get_time_in_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static long get_minor_faults(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_minflt;
+}
+
+// AnonHugePages of the whole process, in kB
+static long get_anon_huge_kb(void) {
+    char line[256];
+    long kb = 0;
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static void print_thp_setting(void) {
+    char line[256] = "unavailable";
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+
+    if (f) {
+        if (!fgets(line, sizeof(line), f))
+            strcpy(line, "unreadable\n");
+        fclose(f);
+    } else {
+        strcat(line, "\n");
+    }
+    printf("Transparent huge pages: %s", line);
+}
+
+// Allocate and first-touch PF_BUFFER_SIZE bytes with the given backing
+void measure_fault_cost(page_mode_t mode, FaultResult* result) {
+    long faults_start = get_minor_faults();
+    long huge_start = get_anon_huge_kb();
+    double start_time = get_time_in_seconds();
+
+    char* buffer = (char*)rk_buf_alloc(PF_BUFFER_SIZE, mode_flags[mode]);
+    result->alloc_time = get_time_in_seconds() - start_time;
+    if (!buffer) {
+        printf("Memory allocation failed for %s\n", mode_names[mode]);
+        memset(result, 0, sizeof(*result));
+        return;
+    }
+
+    start_time = get_time_in_seconds();
+    for (size_t off = 0; off < PF_BUFFER_SIZE; off += RK_PAGE_SIZE)
+        ((volatile char*)buffer)[off] = 1;
+    result->touch_time = get_time_in_seconds() - start_time;
+
+    result->minor_faults = get_minor_faults() - faults_start;
+    result->huge_kb = get_anon_huge_kb() - huge_start;
+
+    rk_buf_free(buffer, PF_BUFFER_SIZE);
+}
+
+// Average latency of a random page-to-page pointer chase over size bytes
+double measure_tlb_latency(size_t size, int huge) {
+    size_t pages = size / RK_PAGE_SIZE;
+    uint64_t rng = rk_rng_seed(size);
+    uint32_t* order;
+    char* buffer;
+
+    buffer = (char*)rk_buf_alloc(size, (huge ? RK_ALLOC_HUGE : RK_ALLOC_NOHUGE) | RK_ALLOC_POPULATE);
+    order = (uint32_t*)malloc(pages * sizeof(uint32_t));
+    if (!buffer || !order) {
+        printf("Memory allocation failed for TLB test\n");
+        rk_buf_free(buffer, size);
+        free(order);
+        return 0;
+    }
+
+    // Sattolo shuffle gives one cycle through every page
+    for (size_t i = 0; i < pages; i++)
+        order[i] = i;
+    for (size_t i = pages - 1; i > 0; i--) {
+        size_t j = rk_rng_next(&rng) % i;
+        uint32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    // One node per page; the in-page offset rotates through cache sets
+    for (size_t i = 0; i < pages; i++) {
+        size_t from = (size_t)i * RK_PAGE_SIZE + (i % 64) * RK_CACHE_LINE;
+        size_t to = (size_t)order[i] * RK_PAGE_SIZE + (order[i] % 64) * RK_CACHE_LINE;
+        *(void**)(buffer + from) = buffer + to;
+    }
+
+    void** p = (void**)buffer;
+    for (size_t i = 0; i < pages; i++)
+        p = (void**)*p;
+
+    double start_time = get_time_in_seconds();
+    for (int i = 0; i < TLB_ACCESSES; i++)
+        p = (void**)*p;
+    double elapsed = get_time_in_seconds() - start_time;
+
+    // Keep the chase live
+    if (p == NULL)
+        printf("unreachable\n");
+
+    free(order);
+    rk_buf_free(buffer, size);
+    return elapsed * 1000000000.0 / TLB_ACCESSES;
+}
+
+void run_fault_benchmark(int core_id) {
+    FaultResult result;
+
+    if (pin_thread_to_core(core_id) != 0) {
+        printf("Failed to pin thread to core %d\n", core_id);
+        return;
+    }
+
+    printf("\nPage-fault cost, %d MB buffer, core %d (Cortex-%s):\n",
+           PF_BUFFER_SIZE / (1024 * 1024), core_id, core_id >= A76_CORE_START ? "A76" : "A55");
+    printf("----------------------------------------------------------------------------\n");
+    printf("%-13s | %9s | %9s | %8s | %11s | %9s\n",
+           "Mode", "alloc ms", "touch ms", "faults", "ns/4K page", "THP MB");
+
+    for (int mode = 0; mode < PAGE_MODE_COUNT; mode++) {
+        measure_fault_cost(mode, &result);
+        double total = result.alloc_time + result.touch_time;
+        printf("%-13s | %9.2f | %9.2f | %8ld | %11.1f | %9ld\n",
+               mode_names[mode], result.alloc_time * 1000.0, result.touch_time * 1000.0,
+               result.minor_faults, total * 1000000000.0 / (PF_BUFFER_SIZE / RK_PAGE_SIZE),
+               result.huge_kb > 0 ? result.huge_kb / 1024 : 0);
+    }
+}
+
+// Buffer setup as cpu_bench used to do it versus the rk_buf fill helpers
+void run_init_benchmark(void) {
+    char* buffer;
+    double start_time, elapsed;
+    const double gb = PF_BUFFER_SIZE / (1024.0 * 1024.0 * 1024.0);
+
+    printf("\nBuffer initialisation, %d MB:\n", PF_BUFFER_SIZE / (1024 * 1024));
+    printf("----------------------------------------------------------------------------\n");
+
+    buffer = (char*)rk_buf_alloc(PF_BUFFER_SIZE, RK_ALLOC_NOHUGE);
+    if (!buffer) {
+        printf("Memory allocation failed\n");
+        return;
+    }
+    start_time = get_time_in_seconds();
+    for (int i = 0; i < PF_BUFFER_SIZE; i++)
+        buffer[i] = (char)rand();
+    elapsed = get_time_in_seconds() - start_time;
+    printf("%-30s: %8.1f ms  %6.2f GB/s\n", "rand() per byte, 4K pages", elapsed * 1000.0, gb / elapsed);
+    rk_buf_free(buffer, PF_BUFFER_SIZE);
+
+    buffer = (char*)rk_buf_alloc(PF_BUFFER_SIZE, RK_ALLOC_NOHUGE);
+    if (!buffer) {
+        printf("Memory allocation failed\n");
+        return;
+    }
+    start_time = get_time_in_seconds();
+    rk_buf_fill_random(buffer, PF_BUFFER_SIZE, 1);
+    elapsed = get_time_in_seconds() - start_time;
+    printf("%-30s: %8.1f ms  %6.2f GB/s\n", "xorshift, 1 thread, 4K pages", elapsed * 1000.0, gb / elapsed);
+    rk_buf_free(buffer, PF_BUFFER_SIZE);
+
+    buffer = (char*)rk_buf_alloc(PF_BUFFER_SIZE, RK_ALLOC_HUGE);
+    if (!buffer) {
+        printf("Memory allocation failed\n");
+        return;
+    }
+    start_time = get_time_in_seconds();
+    rk_buf_fill_random(buffer, PF_BUFFER_SIZE, 1);
+    elapsed = get_time_in_seconds() - start_time;
+    printf("%-30s: %8.1f ms  %6.2f GB/s\n", "xorshift, 1 thread, THP", elapsed * 1000.0, gb / elapsed);
+    rk_buf_free(buffer, PF_BUFFER_SIZE);
+
+    // Same page size as the row above, so only the thread count changes
+    buffer = (char*)rk_buf_alloc(PF_BUFFER_SIZE, RK_ALLOC_HUGE);
+    if (!buffer) {
+        printf("Memory allocation failed\n");
+        return;
+    }
+    start_time = get_time_in_seconds();
+    int used = rk_buf_parallel_fill(buffer, PF_BUFFER_SIZE, TOTAL_CORES, 1);
+    elapsed = get_time_in_seconds() - start_time;
+    printf("xorshift, %d threads, THP      : %8.1f ms  %6.2f GB/s\n", used, elapsed * 1000.0, gb / elapsed);
+    rk_buf_free(buffer, PF_BUFFER_SIZE);
+}
+
+void run_tlb_benchmark(int core_id) {
+    if (pin_thread_to_core(core_id) != 0) {
+        printf("Failed to pin thread to core %d\n", core_id);
+        return;
+    }
+
+    printf("\nRandom page chase latency, core %d (Cortex-%s):\n",
+           core_id, core_id >= A76_CORE_START ? "A76" : "A55");
+    printf("----------------------------------------------------------------------------\n");
+    printf("%10s | %10s | %10s | %8s\n", "Size", "4K ns", "THP ns", "saving");
+
+    for (size_t size = TLB_MIN_SIZE; size <= TLB_MAX_SIZE; size *= 2) {
+        double small_ns = measure_tlb_latency(size, 0);
+        double huge_ns = measure_tlb_latency(size, 1);
+        printf("%7zu MB | %10.1f | %10.1f | %7.1f%%\n", size / (1024 * 1024),
+               small_ns, huge_ns, small_ns > 0 ? (small_ns - huge_ns) * 100.0 / small_ns : 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    printf("Starting page-fault and TLB benchmark for RK3588...\n");
+    print_thp_setting();
+
+    run_fault_benchmark(A76_CORE_START);
+    run_fault_benchmark(A55_CORE_START);
+    run_init_benchmark();
+    run_tlb_benchmark(A76_CORE_START);
+    run_tlb_benchmark(A55_CORE_START);
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef PAGEFAULT_BENCH_H
+#define PAGEFAULT_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "rk_alloc.h"
+
+// RK3588 CPU configuration
+#define NUM_A76_CORES     4
+#define NUM_A55_CORES     4
+#define TOTAL_CORES       (NUM_A76_CORES + NUM_A55_CORES)
+
+// A76 cores are 4-7, A55 cores are 0-3 on RK3588
+#define A76_CORE_START    4
+#define A55_CORE_START    0
+
+// Test configurations
+#define PF_BUFFER_SIZE    (256 * 1024 * 1024)   // largest per-thread buffer in cpu_bench
+#define TLB_MIN_SIZE      (4 * 1024 * 1024)
+#define TLB_MAX_SIZE      (256 * 1024 * 1024)
+#define TLB_ACCESSES      (4 * 1024 * 1024)
+
+// Page backing modes under test
+typedef enum {
+    PAGE_MODE_4K = 0,
+    PAGE_MODE_4K_POPULATE,
+    PAGE_MODE_THP,
+    PAGE_MODE_THP_POPULATE,
+    PAGE_MODE_COUNT
+} page_mode_t;
+
+typedef struct {
+    double alloc_time;          // mmap (+ prefault) seconds
+    double touch_time;          // first write to every page, seconds
+    long minor_faults;
+    long huge_kb;               // AnonHugePages backing the buffer
+} FaultResult;
+
+// Function declarations
+int pin_thread_to_core(int core_id);
+double get_time_in_seconds(void);
+void measure_fault_cost(page_mode_t mode, FaultResult* result);
+double measure_tlb_latency(size_t size, int huge);
+void run_fault_benchmark(int core_id);
+void run_init_benchmark(void);
+void run_tlb_benchmark(int core_id);
+
+#endif // PAGEFAULT_BENCH_H
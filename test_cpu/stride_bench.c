@@ -0,0 +1,309 @@
+#include "stride_bench.h"
+
+#define ALIGN_UP(x, a)  (((x) + (a) - 1) / (a) * (a))
+
+// One THP-backed, prefaulted region per core so TLB misses stay out of the
+// bandwidth numbers
+static char* regions[TOTAL_CORES];
+
+int pin_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    pthread_t current_thread = pthread_self();
+    return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+}
+
+double get_time_in_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// Read one line every stride bytes starting at offset, four loads in flight
+static uint64_t read_strided(const char* base, size_t size, size_t offset,
+                             size_t stride, long long* lines) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t addr = offset;
+    long long count = 0;
+
+    for (; addr + 3 * stride < size; addr += 4 * stride) {
+        s0 += *(const uint64_t*)(base + addr);
+        s1 += *(const uint64_t*)(base + addr + stride);
+        s2 += *(const uint64_t*)(base + addr + 2 * stride);
+        s3 += *(const uint64_t*)(base + addr + 3 * stride);
+        count += 4;
+    }
+    for (; addr < size; addr += stride) {
+        s0 += *(const uint64_t*)(base + addr);
+        count++;
+    }
+
+    *lines += count;
+    return s0 + s1 + s2 + s3;
+}
+
+void* stride_read_test(void* arg) {
+    StrideThreadData* data = (StrideThreadData*)arg;
+    long long lines = 0;
+    uint64_t sink = 0;
+
+    if (pin_thread_to_core(data->core_id) != 0)
+        printf("Failed to pin thread to core %d\n", data->core_id);
+
+    pthread_barrier_wait(data->start_barrier);
+    double start_time = get_time_in_seconds();
+
+    while (get_time_in_seconds() - start_time < STRIDE_TEST_SEC) {
+        for (size_t offset = 0; offset < data->stride; offset += RK_CACHE_LINE) {
+            sink += read_strided(data->region, data->region_size, offset, data->stride, &lines);
+            if (get_time_in_seconds() - start_time >= STRIDE_TEST_SEC)
+                break;
+        }
+    }
+
+    data->execution_time = get_time_in_seconds() - start_time;
+    data->bytes = lines * RK_CACHE_LINE;
+    data->sink = sink;
+    return NULL;
+}
+
+// Aggregate GB/s of lines fetched by all cores for one stride
+double run_stride_pass(size_t stride, size_t region_size) {
+    pthread_t threads[TOTAL_CORES];
+    StrideThreadData thread_data[TOTAL_CORES];
+    pthread_barrier_t barrier;
+    double total = 0;
+
+    pthread_barrier_init(&barrier, NULL, TOTAL_CORES);
+
+    for (int i = 0; i < TOTAL_CORES; i++) {
+        memset(&thread_data[i], 0, sizeof(thread_data[i]));
+        thread_data[i].core_id = i;
+        thread_data[i].region = regions[i];
+        thread_data[i].region_size = region_size;
+        thread_data[i].stride = stride;
+        thread_data[i].start_barrier = &barrier;
+
+        if (pthread_create(&threads[i], NULL, stride_read_test, &thread_data[i]) != 0) {
+            // Every core must take part or the barrier never opens
+            printf("Failed to create thread for core %d\n", i);
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < TOTAL_CORES; i++) {
+        pthread_join(threads[i], NULL);
+        if (thread_data[i].execution_time > 0)
+            total += thread_data[i].bytes / (thread_data[i].execution_time * 1024 * 1024 * 1024);
+    }
+
+    pthread_barrier_destroy(&barrier);
+    return total;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+void run_stride_sweep(void) {
+    enum { PADDINGS = 3 };
+    static const size_t paddings[PADDINGS] = { 0, 64, 256 };
+    double results[32][PADDINGS], sorted[32 * PADDINGS];
+    size_t strides[32];
+    int count = 0;
+
+    printf("\nStride sweep, %d cores, %d MB per core:\n", TOTAL_CORES, STRIDE_REGION / (1024 * 1024));
+    printf("----------------------------------------------------------------\n");
+    printf("%10s | %10s | %10s | %10s\n", "Stride", "pow2 GB/s", "+64 GB/s", "+256 GB/s");
+
+    for (size_t stride = STRIDE_MIN; stride <= STRIDE_MAX && count < 32; stride *= 2, count++) {
+        strides[count] = stride;
+        printf("%10zu |", stride);
+        for (int p = 0; p < PADDINGS; p++) {
+            results[count][p] = run_stride_pass(stride + paddings[p], STRIDE_REGION);
+            sorted[count * PADDINGS + p] = results[count][p];
+            printf(" %10.2f |", results[count][p]);
+        }
+        printf("\n");
+    }
+
+    qsort(sorted, count * PADDINGS, sizeof(double), compare_double);
+    double median = sorted[count * PADDINGS / 2];
+
+    // Strides that fall well below the typical bandwidth map to one DDR
+    // channel or bank
+    printf("\nConflict strides (< %.0f%% of median %.2f GB/s):", CONFLICT_RATIO * 100, median);
+    int conflicts = 0;
+    for (int i = 0; i < count; i++) {
+        for (int p = 0; p < PADDINGS; p++) {
+            if (results[i][p] < median * CONFLICT_RATIO) {
+                printf(" %zu", strides[i] + paddings[p]);
+                conflicts++;
+            }
+        }
+    }
+    printf("%s\n", conflicts ? "" : " none");
+}
+
+static int add_candidate(size_t* list, int count, size_t stride) {
+    for (int i = 0; i < count; i++) {
+        if (list[i] == stride)
+            return count;
+    }
+    if (count < MAX_STRIDE_CANDIDATES)
+        list[count++] = stride;
+    return count;
+}
+
+// Walk 64B columns down luma planes of common widths at candidate hor_strides
+void run_frame_stride_test(void) {
+    static const size_t widths[] = { 1920, 3840, 7680 };
+    static const size_t heights[] = { 1088, 2160, 4320 };
+
+    printf("\nFrame column walk by hor_stride (8-bit luma):\n");
+    printf("----------------------------------------------------------------\n");
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        size_t candidates[MAX_STRIDE_CANDIDATES];
+        double gbps[MAX_STRIDE_CANDIDATES];
+        size_t pow2 = 64;
+        int count = 0, best = 0;
+
+        while (pow2 < widths[w])
+            pow2 *= 2;
+
+        count = add_candidate(candidates, count, ALIGN_UP(widths[w], 64));
+        count = add_candidate(candidates, count, ALIGN_UP(widths[w], 256));
+        // Odd multiple of 256, the rkvdec alignment rule
+        count = add_candidate(candidates, count, ALIGN_UP(widths[w], 256) | 256);
+        count = add_candidate(candidates, count, pow2);
+        count = add_candidate(candidates, count, pow2 + 64);
+        count = add_candidate(candidates, count, pow2 + 256);
+
+        printf("%zux%zu:\n", widths[w], heights[w]);
+        for (int i = 0; i < count; i++) {
+            size_t plane = candidates[i] * heights[w];
+            if (plane > STRIDE_REGION) {
+                gbps[i] = 0;
+                continue;
+            }
+            gbps[i] = run_stride_pass(candidates[i], plane);
+            if (gbps[i] > gbps[best])
+                best = i;
+        }
+        for (int i = 0; i < count; i++) {
+            printf("  hor_stride %6zu: %8.2f GB/s%s\n", candidates[i], gbps[i],
+                   i == best ? "  <- recommended" : "");
+        }
+    }
+}
+
+// Random chase touching one line in each of pages 4KB pages
+double measure_page_spread(size_t pages, int huge) {
+    size_t size = pages * RK_PAGE_SIZE;
+    uint64_t rng = rk_rng_seed(pages);
+    uint32_t* order;
+    char* buffer;
+
+    buffer = (char*)rk_buf_alloc(size, (huge ? RK_ALLOC_HUGE : RK_ALLOC_NOHUGE) | RK_ALLOC_POPULATE);
+    order = (uint32_t*)malloc(pages * sizeof(uint32_t));
+    if (!buffer || !order) {
+        printf("Memory allocation failed for TLB test\n");
+        rk_buf_free(buffer, size);
+        free(order);
+        return 0;
+    }
+
+    // Sattolo shuffle: a single cycle through every page
+    for (size_t i = 0; i < pages; i++)
+        order[i] = i;
+    for (size_t i = pages - 1; i > 0; i--) {
+        size_t j = rk_rng_next(&rng) % i;
+        uint32_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    for (size_t i = 0; i < pages; i++) {
+        size_t from = i * RK_PAGE_SIZE + (i % 64) * RK_CACHE_LINE;
+        size_t to = (size_t)order[i] * RK_PAGE_SIZE + (order[i] % 64) * RK_CACHE_LINE;
+        *(void**)(buffer + from) = buffer + to;
+    }
+
+    void** p = (void**)buffer;
+    for (size_t i = 0; i < pages; i++)
+        p = (void**)*p;
+
+    double start_time = get_time_in_seconds();
+    for (int i = 0; i < TLB_ACCESSES; i++)
+        p = (void**)*p;
+    double elapsed = get_time_in_seconds() - start_time;
+
+    if (p == NULL)
+        printf("unreachable\n");
+
+    free(order);
+    rk_buf_free(buffer, size);
+    return elapsed * 1000000000.0 / TLB_ACCESSES;
+}
+
+void run_tlb_reach_test(int core_id) {
+    size_t l1_reach = 0, l2_reach = 0, prev_pages = 0;
+
+    if (pin_thread_to_core(core_id) != 0) {
+        printf("Failed to pin thread to core %d\n", core_id);
+        return;
+    }
+
+    printf("\nTLB reach, core %d (Cortex-%s), one line per 4KB page:\n",
+           core_id, core_id >= A76_CORE_START ? "A76" : "A55");
+    printf("----------------------------------------------------------------\n");
+    printf("%8s | %10s | %8s | %8s | %6s\n", "Pages", "Footprint", "4K ns", "THP ns", "ratio");
+
+    for (size_t pages = TLB_MIN_PAGES; pages <= TLB_MAX_PAGES; pages *= 2) {
+        double small_ns = measure_page_spread(pages, 0);
+        double huge_ns = measure_page_spread(pages, 1);
+        double ratio = huge_ns > 0 ? small_ns / huge_ns : 0;
+
+        printf("%8zu | %7zu KB | %8.2f | %8.2f | %6.2f\n",
+               pages, pages * RK_PAGE_SIZE / 1024, small_ns, huge_ns, ratio);
+
+        if (!l1_reach && ratio > TLB_L1_RATIO)
+            l1_reach = prev_pages;
+        if (!l2_reach && ratio > TLB_L2_RATIO)
+            l2_reach = prev_pages;
+        prev_pages = pages;
+    }
+
+    // 0 means the ratio never crossed the threshold within TLB_MAX_PAGES
+    printf("Estimated 4KB reach: first-level TLB ~%zu pages (%zu KB), last-level TLB ~%zu pages (%zu KB)\n",
+           l1_reach, l1_reach * RK_PAGE_SIZE / 1024, l2_reach, l2_reach * RK_PAGE_SIZE / 1024);
+    printf("With 2MB pages the same footprints need %zu entries or fewer\n",
+           (size_t)TLB_MAX_PAGES * RK_PAGE_SIZE / RK_HUGE_PAGE_SIZE);
+}
+
+int main(int argc, char** argv) {
+    printf("Starting TLB reach and DDR stride sensitivity benchmark for RK3588...\n");
+
+    for (int i = 0; i < TOTAL_CORES; i++) {
+        regions[i] = (char*)rk_buf_alloc(STRIDE_REGION, RK_ALLOC_HUGE);
+        if (!regions[i]) {
+            printf("Memory allocation failed for core %d\n", i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < TOTAL_CORES; i++)
+        rk_buf_parallel_fill(regions[i], STRIDE_REGION, TOTAL_CORES, i);
+
+    run_tlb_reach_test(A76_CORE_START);
+    run_tlb_reach_test(A55_CORE_START);
+    run_stride_sweep();
+    run_frame_stride_test();
+
+    for (int i = 0; i < TOTAL_CORES; i++)
+        rk_buf_free(regions[i], STRIDE_REGION);
+    return 0;
+}
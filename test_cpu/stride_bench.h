@@ -0,0 +1,65 @@
+#ifndef STRIDE_BENCH_H
+#define STRIDE_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include "rk_alloc.h"
+
+// RK3588 CPU configuration
+#define NUM_A76_CORES     4
+#define NUM_A55_CORES     4
+#define TOTAL_CORES       (NUM_A76_CORES + NUM_A55_CORES)
+
+// A76 cores are 4-7, A55 cores are 0-3 on RK3588
+#define A76_CORE_START    4
+#define A55_CORE_START    0
+
+// Test configurations
+#define STRIDE_REGION     (48 * 1024 * 1024)    // per-thread region, fits an 8K luma plane
+#define STRIDE_MIN        64
+#define STRIDE_MAX        (1024 * 1024)
+#define STRIDE_TEST_SEC   0.25
+#define CONFLICT_RATIO    0.70                  // below this share of the median: conflict
+
+#define TLB_MIN_PAGES     8
+#define TLB_MAX_PAGES     (64 * 1024)
+#define TLB_ACCESSES      (2 * 1024 * 1024)
+#define TLB_L1_RATIO      1.30                  // 4K/THP latency ratio: first TLB level missed
+#define TLB_L2_RATIO      2.00                  // 4K/THP latency ratio: page walks dominate
+
+#define MAX_STRIDE_CANDIDATES 6
+
+/*
+ * Every thread reads one 64B line every stride bytes through its region,
+ * then repeats from the next line offset until the region is covered.
+ * With region_size = hor_stride * height this is a 64B-wide column walk
+ * down a frame plane.
+ */
+typedef struct {
+    int core_id;
+    const char* region;
+    size_t region_size;
+    size_t stride;
+    pthread_barrier_t* start_barrier;
+    long long bytes;
+    double execution_time;
+    uint64_t sink;
+} StrideThreadData;
+
+// Function declarations
+void* stride_read_test(void* arg);
+int pin_thread_to_core(int core_id);
+double get_time_in_seconds(void);
+double run_stride_pass(size_t stride, size_t region_size);
+double measure_page_spread(size_t pages, int huge);
+void run_stride_sweep(void);
+void run_frame_stride_test(void);
+void run_tlb_reach_test(int core_id);
+
+#endif // STRIDE_BENCH_H